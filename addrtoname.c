@@ -100,10 +100,17 @@
 #ifndef HAVE_GETSERVENT
 #include <getservent.h>
 #endif
+#include <errno.h>
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "netdissect.h"
 #include "addrtoname.h"
@@ -127,10 +134,8 @@ struct hnamemem {
 	struct hnamemem *nxt;
 };
 
-static struct hnamemem hnametable[HASHNAMESIZE];
 static struct hnamemem tporttable[HASHNAMESIZE];
 static struct hnamemem uporttable[HASHNAMESIZE];
-static struct hnamemem eprototable[HASHNAMESIZE];
 static struct hnamemem dnaddrtable[HASHNAMESIZE];
 static struct hnamemem ipxsaptable[HASHNAMESIZE];
 
@@ -174,46 +179,753 @@ win32_gethostbyaddr(const char *addr, int len, int type)
 #define gethostbyaddr win32_gethostbyaddr
 #endif /* _WIN32 */
 
-struct h6namemem {
-	nd_ipv6 addr;
-	char *name;
-	struct h6namemem *nxt;
+/*
+ * Caches of the names of the addresses seen in packets.
+ *
+ * Unlike the tables above, which hold names from a fixed list or are
+ * bounded by the range of the values, these are filled in by the traffic,
+ * so they are bounded by the number of names: each is an open-addressing
+ * hash table, with linear probing, that doubles as it fills up to
+ * name_cache_max names, after which each new name evicts one chosen by
+ * the CLOCK algorithm.  The hand sweeps the slots, giving a second chance
+ * to the names that have been looked up since it last went by.  Names
+ * wired in at startup (from the ethers file) don't count against the
+ * limit and are never evicted.
+ *
+ * The names are kept in an arena of large chunks rather than in heap
+ * blocks of their own.  Evicted names leave garbage behind, so once the
+ * arena is mostly garbage it is compacted, by copying the cached names
+ * to new chunks.  A printer may still be using names it got earlier in
+ * the packet, so the old chunks are only freed by
+ * addrtoname_packet_done(); a name returned by the functions below is
+ * thus valid until the end of the packet being printed.
+ */
+#define ISONSAP_MAX_LENGTH 20
+
+#define NAME_CACHE_MAX_KEY	ISONSAP_MAX_LENGTH	/* longest address cached */
+#define NAME_CACHE_MIN_SLOTS	64		/* a power of 2 */
+#define NAME_CACHE_DEFAULT_MAX	65536		/* names per cache */
+#define NAME_ARENA_CHUNK	65536		/* bytes per arena chunk */
+
+struct name_cache_entry {
+	const char *name;		/* NULL for an empty slot */
+	uint32_t hash;
+	u_char keylen;
+	u_char ref;			/* looked up since the hand went by */
+	u_char pinned;			/* never evicted, name not in the arena */
+	u_char key[NAME_CACHE_MAX_KEY];
+};
+
+struct name_cache {
+	struct name_cache_entry *slots;
+	u_int size;			/* number of slots, a power of 2 */
+	u_int count;			/* slots in use */
+	u_int npinned;			/* ... by pinned names */
+	u_int hand;			/* the CLOCK hand */
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
 };
 
-static struct h6namemem h6nametable[HASHNAMESIZE];
+static struct name_cache name_caches[ADDRTONAME_CACHES];
 
-struct enamemem {
-	u_short e_addr0;
-	u_short e_addr1;
-	u_short e_addr2;
-	const char *e_name;
-	u_char *e_nsap;			/* used only for nsaptable[] */
-	struct enamemem *e_nxt;
+static const char *name_cache_names[ADDRTONAME_CACHES] = {
+	"IPv4", "IPv6", "MAC", "EUI-64", "link-layer", "NSAP"
 };
 
-static struct enamemem enametable[HASHNAMESIZE];
-static struct enamemem nsaptable[HASHNAMESIZE];
-
-struct bsnamemem {
-	u_short bs_addr0;
-	u_short bs_addr1;
-	u_short bs_addr2;
-	const char *bs_name;
-	u_char *bs_bytes;
-	unsigned int bs_nbytes;
-	struct bsnamemem *bs_nxt;
+static u_int name_cache_max = NAME_CACHE_DEFAULT_MAX;
+
+struct name_chunk {
+	struct name_chunk *next;
+	size_t size;
+	size_t used;
 };
 
-static struct bsnamemem bytestringtable[HASHNAMESIZE];
+static struct name_chunk *name_arena;	/* newest chunk first */
+static struct name_chunk *name_arena_retired;	/* freed after the packet */
+static size_t name_arena_size;		/* bytes in the chunks of name_arena */
+static size_t name_arena_live;		/* ... used by cached names */
+
+static uint32_t
+name_cache_hash(const u_char *key, u_int keylen)
+{
+	uint32_t h = 2166136261U;
+
+	/* FNV-1a, mixed so that the low bits depend on all the key */
+	while (keylen-- != 0)
+		h = (h ^ *key++) * 16777619U;
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	return h;
+}
+
+static struct name_cache_entry *
+name_cache_find(struct name_cache *nc, const u_char *key, u_int keylen,
+		uint32_t h)
+{
+	struct name_cache_entry *e;
+	u_int i;
+
+	if (nc->size == 0)
+		return NULL;
+	for (i = h & (nc->size - 1); (e = &nc->slots[i])->name != NULL;
+	     i = (i + 1) & (nc->size - 1)) {
+		if (e->hash == h && e->keylen == keylen &&
+		    memcmp(e->key, key, keylen) == 0)
+			return e;
+	}
+	return NULL;
+}
+
+/*
+ * Look up the name of an address; returns NULL if it has to be made and
+ * given to name_cache_add(), along with *hp.
+ */
+static const char *
+name_cache_lookup(u_int which, const u_char *key, u_int keylen, uint32_t *hp)
+{
+	struct name_cache *nc = &name_caches[which];
+	struct name_cache_entry *e;
+
+	*hp = name_cache_hash(key, keylen);
+	if (keylen <= NAME_CACHE_MAX_KEY &&
+	    (e = name_cache_find(nc, key, keylen, *hp)) != NULL) {
+		e->ref = 1;
+		nc->hits++;
+		return e->name;
+	}
+	nc->misses++;
+	return NULL;
+}
+
+static void
+name_cache_grow(netdissect_options *ndo, struct name_cache *nc)
+{
+	struct name_cache_entry *old = nc->slots;
+	u_int oldsize = nc->size, i, j;
+
+	nc->size = oldsize != 0 ? oldsize * 2 : NAME_CACHE_MIN_SLOTS;
+	nc->slots = calloc(nc->size, sizeof(*nc->slots));
+	if (nc->slots == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
+	for (i = 0; i < oldsize; i++) {
+		if (old[i].name == NULL)
+			continue;
+		for (j = old[i].hash & (nc->size - 1); nc->slots[j].name != NULL;
+		     j = (j + 1) & (nc->size - 1))
+			;
+		nc->slots[j] = old[i];
+	}
+	nc->hand = 0;
+	free(old);
+}
+
+/*
+ * Empty slot i, moving back the entries after it that would otherwise
+ * no longer be found from their home slot.
+ */
+static void
+name_cache_delete(struct name_cache *nc, u_int i)
+{
+	u_int mask = nc->size - 1, j, k;
+
+	for (j = (i + 1) & mask; nc->slots[j].name != NULL; j = (j + 1) & mask) {
+		k = nc->slots[j].hash & mask;
+		if (i <= j ? (i < k && k <= j) : (i < k || k <= j))
+			continue;
+		nc->slots[i] = nc->slots[j];
+		i = j;
+	}
+	nc->slots[i].name = NULL;
+	nc->count--;
+}
+
+static void
+name_cache_evict(struct name_cache *nc)
+{
+	struct name_cache_entry *e;
+
+	for (;;) {
+		e = &nc->slots[nc->hand];
+		nc->hand = (nc->hand + 1) & (nc->size - 1);
+		if (e->name == NULL || e->pinned)
+			continue;
+		if (!e->ref)
+			break;
+		e->ref = 0;
+	}
+	name_arena_live -= strlen(e->name) + 1;
+	nc->evictions++;
+	name_cache_delete(nc, (u_int)(e - nc->slots));
+}
+
+static void
+name_cache_insert(netdissect_options *ndo, struct name_cache *nc,
+		  const u_char *key, u_int keylen, uint32_t h,
+		  const char *name, int pinned)
+{
+	struct name_cache_entry *e;
+	u_int i;
+
+	if (!pinned && nc->count - nc->npinned >= name_cache_max)
+		name_cache_evict(nc);
+	else if ((nc->count + 1) * 2 > nc->size)
+		name_cache_grow(ndo, nc);
+	for (i = h & (nc->size - 1); nc->slots[i].name != NULL;
+	     i = (i + 1) & (nc->size - 1))
+		;
+	e = &nc->slots[i];
+	e->name = name;
+	e->hash = h;
+	e->keylen = (u_char)keylen;
+	e->ref = 0;
+	e->pinned = (u_char)pinned;
+	memcpy(e->key, key, keylen);
+	nc->count++;
+	if (pinned)
+		nc->npinned++;
+}
+
+static char *
+name_arena_alloc(netdissect_options *ndo, size_t len)
+{
+	struct name_chunk *c = name_arena;
+	size_t size;
+
+	if (c == NULL || c->size - c->used < len) {
+		size = len > NAME_ARENA_CHUNK ? len : NAME_ARENA_CHUNK;
+		c = malloc(sizeof(*c) + size);
+		if (c == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+					  "%s: malloc", __func__);
+		c->next = name_arena;
+		c->size = size;
+		c->used = 0;
+		name_arena = c;
+		name_arena_size += size;
+	}
+	c->used += len;
+	return (char *)(c + 1) + c->used - len;
+}
+
+/*
+ * Copy the cached names to new chunks, and retire the old ones.
+ */
+static void
+name_arena_compact(netdissect_options *ndo)
+{
+	struct name_chunk *old = name_arena, *c;
+	struct name_cache_entry *e;
+	size_t len;
+	char *p;
+	u_int i, j;
+
+	name_arena = NULL;
+	name_arena_size = 0;
+	for (i = 0; i < ADDRTONAME_CACHES; i++) {
+		for (j = 0; j < name_caches[i].size; j++) {
+			e = &name_caches[i].slots[j];
+			if (e->name == NULL || e->pinned)
+				continue;
+			len = strlen(e->name) + 1;
+			p = name_arena_alloc(ndo, len);
+			memcpy(p, e->name, len);
+			e->name = p;
+		}
+	}
+	if (old != NULL) {
+		for (c = old; c->next != NULL; c = c->next)
+			;
+		c->next = name_arena_retired;
+		name_arena_retired = old;
+	}
+}
+
+/*
+ * Get room for a name of len bytes, NUL included, to be filled in and
+ * given to name_cache_add().
+ */
+static char *
+name_cache_alloc(netdissect_options *ndo, size_t len)
+{
+	if (name_arena_size > 2 * name_arena_live + 2 * NAME_ARENA_CHUNK)
+		name_arena_compact(ndo);
+	return name_arena_alloc(ndo, len);
+}
+
+/*
+ * Cache a name from name_cache_alloc() for an address that
+ * name_cache_lookup() didn't find.  Names of addresses too long to be
+ * cached are only kept until the arena is compacted.
+ */
+static const char *
+name_cache_add(netdissect_options *ndo, u_int which, const u_char *key,
+	       u_int keylen, uint32_t h, const char *name)
+{
+	if (keylen <= NAME_CACHE_MAX_KEY) {
+		name_arena_live += strlen(name) + 1;
+		name_cache_insert(ndo, &name_caches[which], key, keylen, h,
+				  name, 0);
+	}
+	return name;
+}
+
+/*
+ * Cache a copy of the first len characters of name.
+ */
+static const char *
+name_cache_enter(netdissect_options *ndo, u_int which, const u_char *key,
+		 u_int keylen, uint32_t h, const char *name, size_t len)
+{
+	char *p;
+
+	p = name_cache_alloc(ndo, len + 1);
+	memcpy(p, name, len);
+	p[len] = '\0';
+	return name_cache_add(ndo, which, key, keylen, h, p);
+}
+
+/*
+ * Wire in a name, which isn't copied, for good.
+ */
+static void
+name_cache_pin(netdissect_options *ndo, u_int which, const u_char *key,
+	       u_int keylen, const char *name)
+{
+	struct name_cache *nc = &name_caches[which];
+	struct name_cache_entry *e;
+	uint32_t h;
+
+	h = name_cache_hash(key, keylen);
+	e = name_cache_find(nc, key, keylen, h);
+	if (e != NULL) {
+		if (!e->pinned) {
+			name_arena_live -= strlen(e->name) + 1;
+			e->pinned = 1;
+			nc->npinned++;
+		}
+		e->name = name;
+		return;
+	}
+	name_cache_insert(ndo, nc, key, keylen, h, name, 1);
+}
+
+/*
+ * Free the arena chunks that were retired while printing the packet.
+ */
+void
+addrtoname_packet_done(void)
+{
+	struct name_chunk *c;
+
+	while ((c = name_arena_retired) != NULL) {
+		name_arena_retired = c->next;
+		free(c);
+	}
+}
+
+void
+addrtoname_get_cache_stats(u_int which, struct addrtoname_cache_stats *stats)
+{
+	const struct name_cache *nc = &name_caches[which];
+
+	stats->name = name_cache_names[which];
+	stats->hits = nc->hits;
+	stats->misses = nc->misses;
+	stats->evictions = nc->evictions;
+	stats->entries = nc->count;
+}
+
+/*
+ * The tables of services, ethers and IPX SAP names are filled in when
+ * first needed rather than by init_addrtoname(): walking the services
+ * database and reading the ethers file are most of the startup time of
+ * a short run, and many runs need neither.  addrtoname_load_tables()
+ * fills them in at once, for when the files won't be readable later.
+ */
+#define NAMES_SERV	0x01
+#define NAMES_ETHER	0x02
+#define NAMES_IPXSAP	0x04
+
+static u_int names_pending;		/* tables yet to be filled in */
+
+static void init_servarray(netdissect_options *);
+static void init_etherarray(netdissect_options *);
+static void init_ipxsaparray(netdissect_options *);
+
+/*
+ * A name snapshot, written by addrtoname_write_snapshot() and read by
+ * addrtoname_load_snapshot(), has the services and ethers names sorted
+ * by port and address, to be looked up in place, in a file mapped into
+ * memory; so loading one costs next to nothing, however many names
+ * there are.  It is made of, with all numbers big-endian:
+ *
+ *	the magic number, NAME_SNAPSHOT_MAGIC;
+ *	the numbers of TCP ports, UDP ports and ethers, 4 bytes each;
+ *	the size of the string table, 4 bytes;
+ *	the TCP ports, then the UDP ports, 8 bytes each: the port,
+ *	    2 bytes of padding and the offset of the name;
+ *	the ethers, 12 bytes each: the address, 2 bytes of padding and
+ *	    the offset of the name;
+ *	the string table, of NUL-terminated names.
+ */
+#define NAME_SNAPSHOT_MAGIC	"NDNAMES1"
+#define NAME_SNAPSHOT_HDRLEN	24
+#define NAME_SNAPSHOT_PORTLEN	8
+#define NAME_SNAPSHOT_ETHERLEN	12
+
+static struct {
+	const u_char *base;	/* NULL if no snapshot was loaded */
+	size_t size;
+	const u_char *tcp;
+	const u_char *udp;
+	const u_char *ether;
+	const char *strings;
+	uint32_t ntcp;
+	uint32_t nudp;
+	uint32_t nether;
+	uint32_t strsize;
+} name_snapshot;
+
+static int names_from_snapshot;		/* use it for names */
+static int ethers_loaded;		/* ether_ntohost() has nothing to add */
+
+static const char *
+name_snapshot_string(uint32_t off)
+{
+	/* the string table is checked to end with a NUL */
+	return (off < name_snapshot.strsize ? name_snapshot.strings + off :
+	    NULL);
+}
+
+static const char *
+name_snapshot_port(const u_char *tab, uint32_t n, u_int port)
+{
+	uint32_t lo = 0, hi = n, mid;
+	u_int p;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		p = EXTRACT_BE_U_2(tab + mid * NAME_SNAPSHOT_PORTLEN);
+		if (p == port)
+			return (name_snapshot_string(EXTRACT_BE_U_4(tab +
+			    mid * NAME_SNAPSHOT_PORTLEN + 4)));
+		if (p < port)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+static const char *
+name_snapshot_ether(const u_char *ep)
+{
+	uint32_t lo = 0, hi = name_snapshot.nether, mid;
+	const u_char *e;
+	int c;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		e = name_snapshot.ether + mid * NAME_SNAPSHOT_ETHERLEN;
+		c = memcmp(e, ep, MAC_ADDR_LEN);
+		if (c == 0)
+			return (name_snapshot_string(EXTRACT_BE_U_4(e + 8)));
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
+/*
+ * Map a name snapshot, to be used in place of the services database
+ * and the ethers file; returns -1, with a message in errbuf, if it
+ * can't be read or isn't a snapshot.
+ */
+int
+addrtoname_load_snapshot(const char *path, char *errbuf, size_t errbuf_size)
+{
+	const u_char *base;
+	uint64_t need;
+	size_t size;
+#ifdef _WIN32
+	FILE *fp;
+	long len;
+	u_char *buf;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		return (-1);
+	}
+	if (fseek(fp, 0, SEEK_END) != 0 || (len = ftell(fp)) < 0 ||
+	    fseek(fp, 0, SEEK_SET) != 0) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		fclose(fp);
+		return (-1);
+	}
+	size = (size_t)len;
+	buf = malloc(size != 0 ? size : 1);
+	if (buf == NULL || fread(buf, 1, size, fp) != size) {
+		snprintf(errbuf, errbuf_size, "%s: can't read it", path);
+		free(buf);
+		fclose(fp);
+		return (-1);
+	}
+	fclose(fp);
+	base = buf;
+#else
+	struct stat st;
+	void *map;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return (-1);
+	}
+	size = (size_t)st.st_size;
+	if (size < NAME_SNAPSHOT_HDRLEN) {
+		snprintf(errbuf, errbuf_size, "%s: not a name snapshot", path);
+		close(fd);
+		return (-1);
+	}
+	map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		return (-1);
+	}
+	base = map;
+#endif
+
+	if (size < NAME_SNAPSHOT_HDRLEN ||
+	    memcmp(base, NAME_SNAPSHOT_MAGIC, 8) != 0)
+		goto bad;
+	name_snapshot.ntcp = EXTRACT_BE_U_4(base + 8);
+	name_snapshot.nudp = EXTRACT_BE_U_4(base + 12);
+	name_snapshot.nether = EXTRACT_BE_U_4(base + 16);
+	name_snapshot.strsize = EXTRACT_BE_U_4(base + 20);
+	need = NAME_SNAPSHOT_HDRLEN +
+	    (uint64_t)name_snapshot.ntcp * NAME_SNAPSHOT_PORTLEN +
+	    (uint64_t)name_snapshot.nudp * NAME_SNAPSHOT_PORTLEN +
+	    (uint64_t)name_snapshot.nether * NAME_SNAPSHOT_ETHERLEN +
+	    name_snapshot.strsize;
+	if (need != size || name_snapshot.strsize == 0 ||
+	    base[size - 1] != '\0')
+		goto bad;
+	name_snapshot.tcp = base + NAME_SNAPSHOT_HDRLEN;
+	name_snapshot.udp = name_snapshot.tcp +
+	    (size_t)name_snapshot.ntcp * NAME_SNAPSHOT_PORTLEN;
+	name_snapshot.ether = name_snapshot.udp +
+	    (size_t)name_snapshot.nudp * NAME_SNAPSHOT_PORTLEN;
+	name_snapshot.strings = (const char *)name_snapshot.ether +
+	    (size_t)name_snapshot.nether * NAME_SNAPSHOT_ETHERLEN;
+	name_snapshot.size = size;
+	name_snapshot.base = base;
+	return (0);
+
+bad:
+	snprintf(errbuf, errbuf_size, "%s: not a name snapshot", path);
+#ifdef _WIN32
+	free(buf);
+#else
+	munmap(map, size);
+#endif
+	return (-1);
+}
 
-struct protoidmem {
-	uint32_t p_oui;
-	u_short p_proto;
-	const char *p_name;
-	struct protoidmem *p_nxt;
+struct snapshot_name {
+	u_char key[MAC_ADDR_LEN];	/* port, big-endian, or address */
+	u_int seq;			/* order in the database */
+	char *name;
 };
 
-static struct protoidmem protoidtable[HASHNAMESIZE];
+static int
+snapshot_name_cmp(const void *a, const void *b)
+{
+	const struct snapshot_name *na = a, *nb = b;
+	int c;
+
+	c = memcmp(na->key, nb->key, MAC_ADDR_LEN);
+	if (c != 0)
+		return (c);
+	return (na->seq < nb->seq ? -1 : na->seq > nb->seq);
+}
+
+/*
+ * Sort names by key and drop the duplicates, keeping the first or, if
+ * last is set, the last one of each key; returns the number left.
+ */
+static u_int
+snapshot_names_sort(struct snapshot_name *names, u_int n, int last)
+{
+	u_int i, j = 0;
+
+	qsort(names, n, sizeof(*names), snapshot_name_cmp);
+	for (i = 0; i < n; i++) {
+		if (j != 0 &&
+		    memcmp(names[j - 1].key, names[i].key, MAC_ADDR_LEN) == 0) {
+			if (last) {
+				free(names[j - 1].name);
+				names[j - 1] = names[i];
+			} else
+				free(names[i].name);
+			continue;
+		}
+		names[j++] = names[i];
+	}
+	return (j);
+}
+
+static int
+snapshot_names_add(struct snapshot_name **namesp, u_int *np, u_int *allocp,
+		   const u_char *key, u_int keylen, const char *name)
+{
+	struct snapshot_name *sn;
+
+	if (*np == *allocp) {
+		*allocp = *allocp != 0 ? *allocp * 2 : 256;
+		sn = realloc(*namesp, *allocp * sizeof(**namesp));
+		if (sn == NULL)
+			return (-1);
+		*namesp = sn;
+	}
+	sn = &(*namesp)[*np];
+	memset(sn->key, 0, sizeof(sn->key));
+	memcpy(sn->key, key, keylen);
+	sn->seq = *np;
+	sn->name = strdup(name);
+	if (sn->name == NULL)
+		return (-1);
+	(*np)++;
+	return (0);
+}
+
+static void
+snapshot_put_u4(u_char *p, uint32_t v)
+{
+	p[0] = (u_char)(v >> 24);
+	p[1] = (u_char)(v >> 16);
+	p[2] = (u_char)(v >> 8);
+	p[3] = (u_char)v;
+}
+
+/*
+ * Write the names from the services database and the ethers file
+ * that tcpdump would use to a name snapshot; returns -1, with a
+ * message in errbuf, on failure.  As without a snapshot, the first
+ * name of a port is used, and the first name of an address if the
+ * system's ether_ntohost() looks the names up, the last one otherwise.
+ */
+int
+addrtoname_write_snapshot(const char *path, char *errbuf, size_t errbuf_size)
+{
+	struct snapshot_name *names[3] = { NULL, NULL, NULL };
+	u_int n[3] = { 0, 0, 0 }, alloc[3] = { 0, 0, 0 }, i, j;
+	struct servent *sv;
+	struct pcap_etherent *ep;
+	u_char hdr[NAME_SNAPSHOT_HDRLEN], rec[NAME_SNAPSHOT_ETHERLEN];
+	u_char port[2];
+	uint32_t off;
+	FILE *fp;
+	int ret = -1;
+
+	/* 0 for TCP, 1 for UDP, 2 for ethers */
+	while ((sv = getservent()) != NULL) {
+		port[0] = (u_char)(ntohs(sv->s_port) >> 8);
+		port[1] = (u_char)ntohs(sv->s_port);
+		if (strcmp(sv->s_proto, "tcp") == 0)
+			i = 0;
+		else if (strcmp(sv->s_proto, "udp") == 0)
+			i = 1;
+		else
+			continue;
+		if (snapshot_names_add(&names[i], &n[i], &alloc[i], port, 2,
+		    sv->s_name) < 0) {
+			endservent();
+			goto nomem;
+		}
+	}
+	endservent();
+	fp = fopen(PCAP_ETHERS_FILE, "r");
+	if (fp != NULL) {
+		while ((ep = pcap_next_etherent(fp)) != NULL) {
+			if (snapshot_names_add(&names[2], &n[2], &alloc[2],
+			    ep->addr, MAC_ADDR_LEN, ep->name) < 0) {
+				fclose(fp);
+				goto nomem;
+			}
+		}
+		fclose(fp);
+	}
+#ifdef USE_ETHER_NTOHOST
+	for (i = 0; i < 3; i++)
+		n[i] = snapshot_names_sort(names[i], n[i], 0);
+#else
+	for (i = 0; i < 3; i++)
+		n[i] = snapshot_names_sort(names[i], n[i], i == 2);
+#endif
+
+	fp = fopen(path, "wb");
+	if (fp == NULL) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto out;
+	}
+	memcpy(hdr, NAME_SNAPSHOT_MAGIC, 8);
+	off = 0;
+	for (i = 0; i < 3; i++) {
+		snapshot_put_u4(hdr + 8 + 4 * i, n[i]);
+		for (j = 0; j < n[i]; j++)
+			off += (uint32_t)strlen(names[i][j].name) + 1;
+	}
+	snapshot_put_u4(hdr + 20, off != 0 ? off : 1);
+	fwrite(hdr, 1, sizeof(hdr), fp);
+	off = 0;
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < n[i]; j++) {
+			memset(rec, 0, sizeof(rec));
+			if (i < 2) {
+				memcpy(rec, names[i][j].key, 2);
+				snapshot_put_u4(rec + 4, off);
+				fwrite(rec, 1, NAME_SNAPSHOT_PORTLEN, fp);
+			} else {
+				memcpy(rec, names[i][j].key, MAC_ADDR_LEN);
+				snapshot_put_u4(rec + 8, off);
+				fwrite(rec, 1, NAME_SNAPSHOT_ETHERLEN, fp);
+			}
+			off += (uint32_t)strlen(names[i][j].name) + 1;
+		}
+	}
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < n[i]; j++)
+			fwrite(names[i][j].name, 1,
+			    strlen(names[i][j].name) + 1, fp);
+	}
+	if (off == 0)
+		fputc('\0', fp);
+	if (ferror(fp) || fclose(fp) != 0) {
+		snprintf(errbuf, errbuf_size, "%s: %s", path, strerror(errno));
+		goto out;
+	}
+	ret = 0;
+	goto out;
+
+nomem:
+	snprintf(errbuf, errbuf_size, "out of memory");
+out:
+	for (i = 0; i < 3; i++) {
+		for (j = 0; j < n[i]; j++)
+			free(names[i][j].name);
+		free(names[i]);
+	}
+	return (ret);
+}
 
 /*
  * A faster replacement for inet_ntoa().
@@ -277,16 +989,13 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 {
 	struct hostent *hp;
 	uint32_t addr;
-	struct hnamemem *p;
+	uint32_t h;
+	const char *name;
 
+	name = name_cache_lookup(ADDRTONAME_CACHE_IPV4, ap, 4, &h);
+	if (name != NULL)
+		return (name);
 	memcpy(&addr, ap, sizeof(addr));
-	p = &hnametable[addr & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (p->addr == addr)
-			return (p->name);
-	}
-	p->addr = addr;
-	p->nxt = newhnamemem(ndo);
 
 	/*
 	 * Print names unless:
@@ -305,26 +1014,15 @@ ipaddr_string(netdissect_options *ndo, const u_char *ap)
 #endif
 			hp = gethostbyaddr((char *)&addr, 4, AF_INET);
 		if (hp) {
-			char *dotp;
-
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
-			if (ndo->ndo_Nflag) {
-				/* Remove domain qualifications */
-				dotp = strchr(p->name, '.');
-				if (dotp)
-					*dotp = '\0';
-			}
-			return (p->name);
+			/* With -N, remove domain qualifications */
+			return (name_cache_enter(ndo, ADDRTONAME_CACHE_IPV4,
+			    ap, 4, h, hp->h_name, ndo->ndo_Nflag ?
+			    strcspn(hp->h_name, ".") : strlen(hp->h_name)));
 		}
 	}
-	p->name = strdup(intoa(addr));
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(intoa(addr))", __func__);
-	return (p->name);
+	name = intoa(addr);
+	return (name_cache_enter(ndo, ADDRTONAME_CACHE_IPV4, ap, 4, h,
+	    name, strlen(name)));
 }
 
 /*
@@ -335,25 +1033,15 @@ const char *
 ip6addr_string(netdissect_options *ndo, const u_char *ap)
 {
 	struct hostent *hp;
-	union {
-		nd_ipv6 addr;
-		struct for_hash_addr {
-			char fill[14];
-			uint16_t d;
-		} addra;
-	} addr;
-	struct h6namemem *p;
-	const char *cp;
+	nd_ipv6 addr;
+	uint32_t h;
+	const char *name;
 	char ntop_buf[INET6_ADDRSTRLEN];
 
+	name = name_cache_lookup(ADDRTONAME_CACHE_IPV6, ap, 16, &h);
+	if (name != NULL)
+		return (name);
 	memcpy(&addr, ap, sizeof(addr));
-	p = &h6nametable[addr.addra.d & (HASHNAMESIZE-1)];
-	for (; p->nxt; p = p->nxt) {
-		if (memcmp(&p->addr, &addr, sizeof(addr)) == 0)
-			return (p->name);
-	}
-	memcpy(p->addr, addr.addr, sizeof(nd_ipv6));
-	p->nxt = newh6namemem(ndo);
 
 	/*
 	 * Do not print names if -n was given.
@@ -368,27 +1056,15 @@ ip6addr_string(netdissect_options *ndo, const u_char *ap)
 			hp = gethostbyaddr((char *)&addr, sizeof(addr),
 			    AF_INET6);
 		if (hp) {
-			char *dotp;
-
-			p->name = strdup(hp->h_name);
-			if (p->name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(hp->h_name)", __func__);
-			if (ndo->ndo_Nflag) {
-				/* Remove domain qualifications */
-				dotp = strchr(p->name, '.');
-				if (dotp)
-					*dotp = '\0';
-			}
-			return (p->name);
+			/* With -N, remove domain qualifications */
+			return (name_cache_enter(ndo, ADDRTONAME_CACHE_IPV6,
+			    ap, 16, h, hp->h_name, ndo->ndo_Nflag ?
+			    strcspn(hp->h_name, ".") : strlen(hp->h_name)));
 		}
 	}
-	cp = addrtostr6(ap, ntop_buf, sizeof(ntop_buf));
-	p->name = strdup(cp);
-	if (p->name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(cp)", __func__);
-	return (p->name);
+	name = addrtostr6(ap, ntop_buf, sizeof(ntop_buf));
+	return (name_cache_enter(ndo, ADDRTONAME_CACHE_IPV6, ap, 16, h,
+	    name, strlen(name)));
 }
 
 static const char hex[16] = {
@@ -428,176 +1104,28 @@ octet_to_hex(char *cp, uint8_t octet)
 	return (cp);
 }
 
-/* Find the hash node that corresponds the ether address 'ep' */
-
-static struct enamemem *
-lookup_emem(netdissect_options *ndo, const u_char *ep)
-{
-	u_int i, j, k;
-	struct enamemem *tp;
-
-	k = (ep[0] << 8) | ep[1];
-	j = (ep[2] << 8) | ep[3];
-	i = (ep[4] << 8) | ep[5];
-
-	tp = &enametable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->e_nxt)
-		if (tp->e_addr0 == i &&
-		    tp->e_addr1 == j &&
-		    tp->e_addr2 == k)
-			return tp;
-		else
-			tp = tp->e_nxt;
-	tp->e_addr0 = (u_short)i;
-	tp->e_addr1 = (u_short)j;
-	tp->e_addr2 = (u_short)k;
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
-}
-
-/*
- * Find the hash node that corresponds to the bytestring 'bs'
- * with length 'nlen'
- */
-
-static struct bsnamemem *
-lookup_bytestring(netdissect_options *ndo, const u_char *bs,
-		  const unsigned int nlen)
-{
-	struct bsnamemem *tp;
-	u_int i, j, k;
-
-	if (nlen >= 6) {
-		k = (bs[0] << 8) | bs[1];
-		j = (bs[2] << 8) | bs[3];
-		i = (bs[4] << 8) | bs[5];
-	} else if (nlen >= 4) {
-		k = (bs[0] << 8) | bs[1];
-		j = (bs[2] << 8) | bs[3];
-		i = 0;
-	} else
-		i = j = k = 0;
-
-	tp = &bytestringtable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->bs_nxt)
-		if (nlen == tp->bs_nbytes &&
-		    tp->bs_addr0 == i &&
-		    tp->bs_addr1 == j &&
-		    tp->bs_addr2 == k &&
-		    memcmp((const char *)bs, (const char *)(tp->bs_bytes), nlen) == 0)
-			return tp;
-		else
-			tp = tp->bs_nxt;
-
-	tp->bs_addr0 = (u_short)i;
-	tp->bs_addr1 = (u_short)j;
-	tp->bs_addr2 = (u_short)k;
-
-	tp->bs_bytes = (u_char *) calloc(1, nlen);
-	if (tp->bs_bytes == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
-
-	memcpy(tp->bs_bytes, bs, nlen);
-	tp->bs_nbytes = nlen;
-	tp->bs_nxt = (struct bsnamemem *)calloc(1, sizeof(*tp));
-	if (tp->bs_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: calloc", __func__);
-
-	return tp;
-}
-
-/* Find the hash node that corresponds the NSAP 'nsap' */
-
-static struct enamemem *
-lookup_nsap(netdissect_options *ndo, const u_char *nsap,
-	    u_int nsap_length)
-{
-	u_int i, j, k;
-	struct enamemem *tp;
-	const u_char *ensap;
-
-	if (nsap_length > 6) {
-		ensap = nsap + nsap_length - 6;
-		k = (ensap[0] << 8) | ensap[1];
-		j = (ensap[2] << 8) | ensap[3];
-		i = (ensap[4] << 8) | ensap[5];
-	}
-	else
-		i = j = k = 0;
-
-	tp = &nsaptable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->e_nxt)
-		if (nsap_length == tp->e_nsap[0] &&
-		    tp->e_addr0 == i &&
-		    tp->e_addr1 == j &&
-		    tp->e_addr2 == k &&
-		    memcmp((const char *)nsap,
-			(char *)&(tp->e_nsap[1]), nsap_length) == 0)
-			return tp;
-		else
-			tp = tp->e_nxt;
-	tp->e_addr0 = (u_short)i;
-	tp->e_addr1 = (u_short)j;
-	tp->e_addr2 = (u_short)k;
-	tp->e_nsap = (u_char *)malloc(nsap_length + 1);
-	if (tp->e_nsap == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
-	tp->e_nsap[0] = (u_char)nsap_length;	/* guaranteed < ISONSAP_MAX_LENGTH */
-	memcpy((char *)&tp->e_nsap[1], (const char *)nsap, nsap_length);
-	tp->e_nxt = (struct enamemem *)calloc(1, sizeof(*tp));
-	if (tp->e_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
-}
-
-/* Find the hash node that corresponds the protoid 'pi'. */
-
-static struct protoidmem *
-lookup_protoid(netdissect_options *ndo, const u_char *pi)
-{
-	u_int i, j;
-	struct protoidmem *tp;
-
-	/* 5 octets won't be aligned */
-	i = (((pi[0] << 8) + pi[1]) << 8) + pi[2];
-	j =   (pi[3] << 8) + pi[4];
-	/* XXX should be endian-insensitive, but do big-endian testing  XXX */
-
-	tp = &protoidtable[(i ^ j) & (HASHNAMESIZE-1)];
-	while (tp->p_nxt)
-		if (tp->p_oui == i && tp->p_proto == j)
-			return tp;
-		else
-			tp = tp->p_nxt;
-	tp->p_oui = i;
-	tp->p_proto = (u_short)j;
-	tp->p_nxt = (struct protoidmem *)calloc(1, sizeof(*tp));
-	if (tp->p_nxt == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: calloc", __func__);
-
-	return tp;
-}
-
 const char *
 etheraddr_string(netdissect_options *ndo, const uint8_t *ep)
 {
-	int i;
+	u_int i;
 	char *cp;
-	struct enamemem *tp;
-	int oui;
-	char buf[BUFSIZE];
-
-	tp = lookup_emem(ndo, ep);
-	if (tp->e_name)
-		return (tp->e_name);
+	const char *name, *ouiname = NULL;
+	size_t len;
+	uint32_t h;
+
+	if (names_pending & NAMES_ETHER)
+		init_etherarray(ndo);
+	name = name_cache_lookup(ADDRTONAME_CACHE_MAC, ep, MAC_ADDR_LEN, &h);
+	if (name != NULL)
+		return (name);
+	if (names_from_snapshot) {
+		name = name_snapshot_ether(ep);
+		if (name != NULL)
+			return (name_cache_enter(ndo, ADDRTONAME_CACHE_MAC,
+			    ep, MAC_ADDR_LEN, h, name, strlen(name)));
+	}
 #ifdef USE_ETHER_NTOHOST
-	if (!ndo->ndo_nflag) {
+	if (!ndo->ndo_nflag && !ethers_loaded) {
 		char buf2[BUFSIZE];
 		/*
 		 * This is a non-const copy of ep for ether_ntohost(), which
@@ -607,33 +1135,35 @@ etheraddr_string(netdissect_options *ndo, const uint8_t *ep)
 		struct ether_addr ea;
 
 		memcpy (&ea, ep, MAC_ADDR_LEN);
-		if (ether_ntohost(buf2, &ea) == 0) {
-			tp->e_name = strdup(buf2);
-			if (tp->e_name == NULL)
-				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					"%s: strdup(buf2)", __func__);
-			return (tp->e_name);
-		}
+		if (ether_ntohost(buf2, &ea) == 0)
+			return (name_cache_enter(ndo, ADDRTONAME_CACHE_MAC,
+			    ep, MAC_ADDR_LEN, h, buf2, strlen(buf2)));
 	}
 #endif
-	cp = buf;
-	oui = EXTRACT_BE_U_3(ep);
-	cp = octet_to_hex(cp, *ep++);
-	for (i = 5; --i >= 0;) {
+	len = MAC_ADDR_LEN * 3;
+	if (!ndo->ndo_nflag) {
+		ouiname = oui_name(EXTRACT_BE_U_3(ep));
+		if (ouiname == NULL)
+			ouiname = "Unknown";
+		len += sizeof(" (oui )") - 1 + strlen(ouiname);
+	}
+	name = cp = name_cache_alloc(ndo, len);
+	cp = octet_to_hex(cp, ep[0]);
+	for (i = 1; i < MAC_ADDR_LEN; i++) {
 		*cp++ = ':';
-		cp = octet_to_hex(cp, *ep++);
+		cp = octet_to_hex(cp, ep[i]);
 	}
-
-	if (!ndo->ndo_nflag) {
-		snprintf(cp, BUFSIZE - (2 + 5*3), " (oui %s)",
-		    tok2str(oui_values, "Unknown", oui));
-	} else
-		*cp = '\0';
-	tp->e_name = strdup(buf);
-	if (tp->e_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
-	return (tp->e_name);
+	if (ouiname != NULL) {
+		memcpy(cp, " (oui ", 6);
+		cp += 6;
+		len = strlen(ouiname);
+		memcpy(cp, ouiname, len);
+		cp += len;
+		*cp++ = ')';
+	}
+	*cp = '\0';
+	return (name_cache_add(ndo, ADDRTONAME_CACHE_MAC, ep, MAC_ADDR_LEN,
+	    h, name));
 }
 
 const char *
@@ -642,14 +1172,14 @@ le64addr_string(netdissect_options *ndo, const uint8_t *ep)
 	const unsigned int len = 8;
 	u_int i;
 	char *cp;
-	struct bsnamemem *tp;
-	char buf[BUFSIZE];
+	const char *name;
+	uint32_t h;
 
-	tp = lookup_bytestring(ndo, ep, len);
-	if (tp->bs_name)
-		return (tp->bs_name);
+	name = name_cache_lookup(ADDRTONAME_CACHE_EUI64, ep, len, &h);
+	if (name != NULL)
+		return (name);
 
-	cp = buf;
+	name = cp = name_cache_alloc(ndo, len*3);
 	for (i = len; i > 0 ; --i) {
 		cp = octet_to_hex(cp, *(ep + i - 1));
 		*cp++ = ':';
@@ -658,12 +1188,7 @@ le64addr_string(netdissect_options *ndo, const uint8_t *ep)
 
 	*cp = '\0';
 
-	tp->bs_name = strdup(buf);
-	if (tp->bs_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: strdup(buf)", __func__);
-
-	return (tp->bs_name);
+	return (name_cache_add(ndo, ADDRTONAME_CACHE_EUI64, ep, len, h, name));
 }
 
 const char *
@@ -672,7 +1197,8 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 {
 	u_int i;
 	char *cp;
-	struct bsnamemem *tp;
+	const char *name;
+	uint32_t h;
 
 	if (len == 0)
 		return ("<empty>");
@@ -683,53 +1209,47 @@ linkaddr_string(netdissect_options *ndo, const uint8_t *ep,
 	if (type == LINKADDR_FRELAY)
 		return (q922_string(ndo, ep, len));
 
-	tp = lookup_bytestring(ndo, ep, len);
-	if (tp->bs_name)
-		return (tp->bs_name);
+	name = name_cache_lookup(ADDRTONAME_CACHE_LINK, ep, len, &h);
+	if (name != NULL)
+		return (name);
 
-	tp->bs_name = cp = (char *)malloc(len*3);
-	if (tp->bs_name == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: malloc", __func__);
-	cp = octet_to_hex(cp, *ep++);
-	for (i = len-1; i > 0 ; --i) {
+	name = cp = name_cache_alloc(ndo, (size_t)len*3);
+	cp = octet_to_hex(cp, ep[0]);
+	for (i = 1; i < len; i++) {
 		*cp++ = ':';
-		cp = octet_to_hex(cp, *ep++);
+		cp = octet_to_hex(cp, ep[i]);
 	}
 	*cp = '\0';
-	return (tp->bs_name);
+	return (name_cache_add(ndo, ADDRTONAME_CACHE_LINK, ep, len, h, name));
 }
 
-#define ISONSAP_MAX_LENGTH 20
 const char *
 isonsap_string(netdissect_options *ndo, const uint8_t *nsap,
 	       u_int nsap_length)
 {
 	u_int nsap_idx;
 	char *cp;
-	struct enamemem *tp;
+	const char *name;
+	uint32_t h;
 
 	if (nsap_length < 1 || nsap_length > ISONSAP_MAX_LENGTH)
 		return ("isonsap_string: illegal length");
 
-	tp = lookup_nsap(ndo, nsap, nsap_length);
-	if (tp->e_name)
-		return tp->e_name;
-
-	tp->e_name = cp = (char *)malloc(sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx"));
-	if (cp == NULL)
-		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				  "%s: malloc", __func__);
+	name = name_cache_lookup(ADDRTONAME_CACHE_NSAP, nsap, nsap_length, &h);
+	if (name != NULL)
+		return (name);
 
+	name = cp = name_cache_alloc(ndo, sizeof("xx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xxxx.xx"));
 	for (nsap_idx = 0; nsap_idx < nsap_length; nsap_idx++) {
-		cp = octet_to_hex(cp, *nsap++);
+		cp = octet_to_hex(cp, nsap[nsap_idx]);
 		if (((nsap_idx & 1) == 0) &&
 		     (nsap_idx + 1 < nsap_length)) {
 			*cp++ = '.';
 		}
 	}
 	*cp = '\0';
-	return (tp->e_name);
+	return (name_cache_add(ndo, ADDRTONAME_CACHE_NSAP, nsap, nsap_length,
+	    h, name));
 }
 
 const char *
@@ -739,12 +1259,20 @@ tcpport_string(netdissect_options *ndo, u_short port)
 	uint32_t i = port;
 	char buf[sizeof("00000")];
 
+	if (names_pending & NAMES_SERV)
+		init_servarray(ndo);
 	for (tp = &tporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
 
 	tp->addr = i;
 	tp->nxt = newhnamemem(ndo);
+	if (names_from_snapshot) {
+		tp->name = name_snapshot_port(name_snapshot.tcp,
+		    name_snapshot.ntcp, i);
+		if (tp->name != NULL)
+			return (tp->name);
+	}
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
@@ -761,12 +1289,20 @@ udpport_string(netdissect_options *ndo, u_short port)
 	uint32_t i = port;
 	char buf[sizeof("00000")];
 
+	if (names_pending & NAMES_SERV)
+		init_servarray(ndo);
 	for (tp = &uporttable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
 
 	tp->addr = i;
 	tp->nxt = newhnamemem(ndo);
+	if (names_from_snapshot) {
+		tp->name = name_snapshot_port(name_snapshot.udp,
+		    name_snapshot.nudp, i);
+		if (tp->name != NULL)
+			return (tp->name);
+	}
 
 	(void)snprintf(buf, sizeof(buf), "%u", i);
 	tp->name = strdup(buf);
@@ -784,6 +1320,8 @@ ipxsap_string(netdissect_options *ndo, u_short port)
 	uint32_t i = port;
 	char buf[sizeof("0000")];
 
+	if (names_pending & NAMES_IPXSAP)
+		init_ipxsaparray(ndo);
 	for (tp = &ipxsaptable[i & (HASHNAMESIZE-1)]; tp->nxt; tp = tp->nxt)
 		if (tp->addr == i)
 			return (tp->name);
@@ -813,6 +1351,7 @@ init_servarray(netdissect_options *ndo)
 	int i;
 	char buf[sizeof("0000000000")];
 
+	names_pending &= ~NAMES_SERV;
 	while ((sv = getservent()) != NULL) {
 		int port = ntohs(sv->s_port);
 		i = port & (HASHNAMESIZE-1);
@@ -840,90 +1379,6 @@ init_servarray(netdissect_options *ndo)
 	endservent();
 }
 
-static const struct eproto {
-	const char *s;
-	u_short p;
-} eproto_db[] = {
-	{ "aarp", ETHERTYPE_AARP },
-	{ "arp", ETHERTYPE_ARP },
-	{ "atalk", ETHERTYPE_ATALK },
-	{ "decnet", ETHERTYPE_DN },
-	{ "ip", ETHERTYPE_IP },
-	{ "ip6", ETHERTYPE_IPV6 },
-	{ "lat", ETHERTYPE_LAT },
-	{ "loopback", ETHERTYPE_LOOPBACK },
-	{ "mopdl", ETHERTYPE_MOPDL },
-	{ "moprc", ETHERTYPE_MOPRC },
-	{ "rarp", ETHERTYPE_REVARP },
-	{ "sca", ETHERTYPE_SCA },
-	{ (char *)0, 0 }
-};
-
-static void
-init_eprotoarray(netdissect_options *ndo)
-{
-	int i;
-	struct hnamemem *table;
-
-	for (i = 0; eproto_db[i].s; i++) {
-		int j = htons(eproto_db[i].p) & (HASHNAMESIZE-1);
-		table = &eprototable[j];
-		while (table->name)
-			table = table->nxt;
-		table->name = eproto_db[i].s;
-		table->addr = htons(eproto_db[i].p);
-		table->nxt = newhnamemem(ndo);
-	}
-}
-
-static const struct protoidlist {
-	const u_char protoid[5];
-	const char *name;
-} protoidlist[] = {
-	{{ 0x00, 0x00, 0x0c, 0x01, 0x07 }, "CiscoMLS" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x00 }, "CiscoCDP" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x01 }, "CiscoCGMP" },
-	{{ 0x00, 0x00, 0x0c, 0x20, 0x03 }, "CiscoVTP" },
-	{{ 0x00, 0xe0, 0x2b, 0x00, 0xbb }, "ExtremeEDP" },
-	{{ 0x00, 0x00, 0x00, 0x00, 0x00 }, NULL }
-};
-
-/*
- * SNAP proto IDs with org code 0:0:0 are actually encapsulated Ethernet
- * types.
- */
-static void
-init_protoidarray(netdissect_options *ndo)
-{
-	int i;
-	struct protoidmem *tp;
-	const struct protoidlist *pl;
-	u_char protoid[5];
-
-	protoid[0] = 0;
-	protoid[1] = 0;
-	protoid[2] = 0;
-	for (i = 0; eproto_db[i].s; i++) {
-		u_short etype = htons(eproto_db[i].p);
-
-		memcpy((char *)&protoid[3], (char *)&etype, 2);
-		tp = lookup_protoid(ndo, protoid);
-		tp->p_name = strdup(eproto_db[i].s);
-		if (tp->p_name == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-				"%s: strdup(eproto_db[i].s)", __func__);
-	}
-	/* Hardwire some SNAP proto ID names */
-	for (pl = protoidlist; pl->name != NULL; ++pl) {
-		tp = lookup_protoid(ndo, pl->protoid);
-		/* Don't override existing name */
-		if (tp->p_name != NULL)
-			continue;
-
-		tp->p_name = pl->name;
-	}
-}
-
 static const struct etherlist {
 	const nd_mac_addr addr;
 	const char *name;
@@ -933,13 +1388,14 @@ static const struct etherlist {
 };
 
 /*
- * Initialize the ethers hash table.  We take two different approaches
- * depending on whether or not the system provides the ethers name
- * service.  If it does, we just wire in a few names at startup,
- * and etheraddr_string() fills in the table on demand.  If it doesn't,
- * then we suck in the entire /etc/ethers file at startup.  The idea
- * is that parsing the local file will be fast, but spinning through
- * all the ethers entries via NIS & next_etherent might be very slow.
+ * Initialize the ethers hash table.  We suck in the entire /etc/ethers
+ * file, once, rather than have the ethers name service re-read it for
+ * every new address; only if there's no such file, and the system
+ * provides the service, does etheraddr_string() fill in the table on
+ * demand, as spinning through all the ethers entries via NIS &
+ * next_etherent might be very slow.  Either way, this is done when the
+ * first address is looked up, and with a name snapshot the ethers
+ * names come from it instead.
  *
  * XXX pcap_next_etherent doesn't belong in the pcap interface, but
  * since the pcap module already does name-to-address translation,
@@ -950,33 +1406,50 @@ static void
 init_etherarray(netdissect_options *ndo)
 {
 	const struct etherlist *el;
-	struct enamemem *tp;
+	char *name;
 #ifdef USE_ETHER_NTOHOST
-	char name[256];
-#else
+	char buf[256];
+#endif
 	struct pcap_etherent *ep;
 	FILE *fp;
 
-	/* Suck in entire ethers file */
-	fp = fopen(PCAP_ETHERS_FILE, "r");
+	names_pending &= ~NAMES_ETHER;
+	ethers_loaded = names_from_snapshot;
+	/* Suck in entire ethers file, unless it's in the snapshot */
+	fp = names_from_snapshot ? NULL : fopen(PCAP_ETHERS_FILE, "r");
 	if (fp != NULL) {
+		ethers_loaded = 1;
 		while ((ep = pcap_next_etherent(fp)) != NULL) {
-			tp = lookup_emem(ndo, ep->addr);
-			tp->e_name = strdup(ep->name);
-			if (tp->e_name == NULL)
+#ifdef USE_ETHER_NTOHOST
+			/* ether_ntohost() would find the first entry */
+			if (name_cache_find(&name_caches[ADDRTONAME_CACHE_MAC],
+			    ep->addr, MAC_ADDR_LEN,
+			    name_cache_hash(ep->addr, MAC_ADDR_LEN)) != NULL)
+				continue;
+#endif
+			name = strdup(ep->name);
+			if (name == NULL)
 				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 					"%s: strdup(ep->addr)", __func__);
+			name_cache_pin(ndo, ADDRTONAME_CACHE_MAC, ep->addr,
+			    MAC_ADDR_LEN, name);
 		}
 		(void)fclose(fp);
 	}
-#endif
 
 	/* Hardwire some ethernet names */
 	for (el = etherlist; el->name != NULL; ++el) {
-		tp = lookup_emem(ndo, el->addr);
 		/* Don't override existing name */
-		if (tp->e_name != NULL)
+		if (name_cache_find(&name_caches[ADDRTONAME_CACHE_MAC], el->addr,
+		    MAC_ADDR_LEN, name_cache_hash(el->addr, MAC_ADDR_LEN)) != NULL)
+			continue;
+		if (names_from_snapshot) {
+			if (name_snapshot_ether(el->addr) != NULL)
+				continue;
+			name_cache_pin(ndo, ADDRTONAME_CACHE_MAC, el->addr,
+			    MAC_ADDR_LEN, el->name);
 			continue;
+		}
 
 #ifdef USE_ETHER_NTOHOST
 		/*
@@ -985,15 +1458,18 @@ init_etherarray(netdissect_options *ndo)
 		/* Same workaround as in etheraddr_string(). */
 		struct ether_addr ea;
 		memcpy (&ea, el->addr, MAC_ADDR_LEN);
-		if (ether_ntohost(name, &ea) == 0) {
-			tp->e_name = strdup(name);
-			if (tp->e_name == NULL)
+		if (!ethers_loaded && ether_ntohost(buf, &ea) == 0) {
+			name = strdup(buf);
+			if (name == NULL)
 				(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
 					"%s: strdup(name)", __func__);
+			name_cache_pin(ndo, ADDRTONAME_CACHE_MAC, el->addr,
+			    MAC_ADDR_LEN, name);
 			continue;
 		}
 #endif
-		tp->e_name = el->name;
+		name_cache_pin(ndo, ADDRTONAME_CACHE_MAC, el->addr,
+		    MAC_ADDR_LEN, el->name);
 	}
 }
 
@@ -1223,6 +1699,7 @@ init_ipxsaparray(netdissect_options *ndo)
 	int i;
 	struct hnamemem *table;
 
+	names_pending &= ~NAMES_IPXSAP;
 	for (i = 0; ipxsap_db[i].s != NULL; i++) {
 		u_int j = htons(ipxsap_db[i].v) & (HASHNAMESIZE-1);
 		table = &ipxsaptable[j];
@@ -1243,6 +1720,8 @@ init_ipxsaparray(netdissect_options *ndo)
 void
 init_addrtoname(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 {
+	if (ndo->ndo_name_cache_size != 0)
+		name_cache_max = ndo->ndo_name_cache_size;
 	if (ndo->ndo_fflag) {
 		f_localnet = localnet;
 		f_netmask = mask;
@@ -1253,11 +1732,25 @@ init_addrtoname(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 		 */
 		return;
 
-	init_etherarray(ndo);
-	init_servarray(ndo);
-	init_eprotoarray(ndo);
-	init_protoidarray(ndo);
-	init_ipxsaparray(ndo);
+	names_from_snapshot = (name_snapshot.base != NULL);
+	names_pending = NAMES_ETHER | NAMES_IPXSAP;
+	if (!names_from_snapshot)
+		names_pending |= NAMES_SERV;
+}
+
+/*
+ * Fill in the name tables now rather than when they are first needed,
+ * before chrooting or entering a sandbox makes the files unreadable.
+ */
+void
+addrtoname_load_tables(netdissect_options *ndo)
+{
+	if (names_pending & NAMES_SERV)
+		init_servarray(ndo);
+	if (names_pending & NAMES_ETHER)
+		init_etherarray(ndo);
+	if (names_pending & NAMES_IPXSAP)
+		init_ipxsaparray(ndo);
 }
 
 const char *
@@ -1297,26 +1790,6 @@ newhnamemem(netdissect_options *ndo)
 	return (p);
 }
 
-/* Return a zero'ed h6namemem struct and cuts down on calloc() overhead */
-struct h6namemem *
-newh6namemem(netdissect_options *ndo)
-{
-	struct h6namemem *p;
-	static struct h6namemem *ptr = NULL;
-	static u_int num = 0;
-
-	if (num  == 0) {
-		num = 64;
-		ptr = (struct h6namemem *)calloc(num, sizeof (*ptr));
-		if (ptr == NULL)
-			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
-					  "%s: calloc", __func__);
-	}
-	--num;
-	p = ptr++;
-	return (p);
-}
-
 /* Represent TCI part of the 802.1Q 4-octet tag as text. */
 const char *
 ieee8021q_tci_string(const uint16_t tci)
@@ -59,10 +59,35 @@ extern const char *ip6addr_string(netdissect_options *, const u_char *);
 extern const char *intoa(uint32_t);
 
 extern void init_addrtoname(netdissect_options *, uint32_t, uint32_t);
+extern void addrtoname_load_tables(netdissect_options *);
+extern int addrtoname_load_snapshot(const char *, char *, size_t);
+extern int addrtoname_write_snapshot(const char *, char *, size_t);
 extern struct hnamemem *newhnamemem(netdissect_options *);
-extern struct h6namemem *newh6namemem(netdissect_options *);
 extern const char * ieee8021q_tci_string(const uint16_t);
 
+/* Caches of the names of addresses seen in packets */
+enum {
+    ADDRTONAME_CACHE_IPV4,
+    ADDRTONAME_CACHE_IPV6,
+    ADDRTONAME_CACHE_MAC,
+    ADDRTONAME_CACHE_EUI64,
+    ADDRTONAME_CACHE_LINK,
+    ADDRTONAME_CACHE_NSAP,
+    ADDRTONAME_CACHES
+};
+
+struct addrtoname_cache_stats {
+	const char *name;	/* the kind of address */
+	uint64_t hits;		/* names found in the cache */
+	uint64_t misses;	/* ... made and cached */
+	uint64_t evictions;	/* names evicted to make room */
+	u_int entries;		/* names currently cached */
+};
+
+/* Free what the caches no longer need once a packet has been printed. */
+extern void addrtoname_packet_done(void);
+extern void addrtoname_get_cache_stats(u_int, struct addrtoname_cache_stats *);
+
 /* macro(s) and inline function(s) with setjmp/longjmp logic to call
  * the X_string() function(s) after bounds checking.
  * The macro(s) must be used on a packet buffer pointer.
@@ -124,3 +149,7 @@ get_ip6addr_string(netdissect_options *ndo, const u_char *p)
 #define GET_ISONSAP_STRING(nsap, nsap_length) get_isonsap_string(ndo, (const u_char *)(nsap), nsap_length)
 #define GET_IPADDR_STRING(p) get_ipaddr_string(ndo, (const u_char *)(p))
 #define GET_IP6ADDR_STRING(p) get_ip6addr_string(ndo, (const u_char *)(p))
+
+/* Addresses in a header checked to have been captured; see extract.h */
+#define SPAN_IPADDR_STRING(sp, m) ipaddr_string(ndo, ND_SPAN_MEMBER(sp, m, 4))
+#define SPAN_IP6ADDR_STRING(sp, m) ip6addr_string(ndo, ND_SPAN_MEMBER(sp, m, 16))
@@ -0,0 +1,611 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * tcpdump-bench: dissection throughput benchmark.
+ *
+ * Each savefile is read into memory once and then run through
+ * pretty_print_packet() repeatedly, with the output formatted into a
+ * scratch buffer and thrown away, so what is measured is the cost of
+ * dissecting and formatting, not of reading files or writing a
+ * terminal.  Short files can be replicated in memory (-R) to get a
+ * meaningful run time out of them.
+ *
+ * Results are one line per file:
+ *
+ *	name packets iterations packets/s ns/packet nd_malloc/packet
+ *
+ * and with -c they are compared against a previous run's results;
+ * any file whose ns/packet grew by more than the tolerance (-t, in
+ * percent) is reported and makes the exit status 1.
+ *
+ * -p additionally prints the --profile-dissectors table for the whole
+ * run, to see which dissectors the time and the allocations went to.
+ *
+ * -q and -v dissect as tcpdump's -q and -v do.
+ *
+ * With -s program, startup latency is measured instead: for each
+ * savefile, "program -c 1 -r file", plus any -a arguments, is run as
+ * many times as the iteration count, and the results are
+ *
+ *	name runs median-us min-us
+ *
+ * compared, with -c, on the median.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "netdissect-alloc.h"
+#include "print.h"
+
+#define BENCH_FORMAT	"tcpdump-bench 1"	/* first line of results */
+#define BENCH_STARTUP_FORMAT	"tcpdump-bench-startup 1"	/* ... with -s */
+#define BENCH_MAX_ARGS	32		/* most -a arguments */
+
+struct bench_pkt {
+	struct pcap_pkthdr hdr;
+	u_char *data;
+};
+
+struct bench_file {
+	struct bench_pkt *pkts;
+	u_int n;
+	u_int alloc;
+};
+
+struct bench_result {
+	char *name;
+	u_int packets;
+	u_int iterations;
+	double pps;
+	double ns_per_pkt;
+	double allocs_per_pkt;
+	double median_us;		/* with -s */
+	double min_us;
+};
+
+static const char *program_name = "tcpdump-bench";
+
+static void NORETURN PRINTFLIKE(1, 2)
+bench_error(FORMAT_STRING(const char *fmt), ...)
+{
+	va_list ap;
+
+	(void)fprintf(stderr, "%s: ", program_name);
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	(void)fputc('\n', stderr);
+	exit(2);
+}
+
+/*
+ * Null output sink: do the formatting, drop the result.
+ */
+static int PRINTFLIKE(2, 3)
+bench_printf(netdissect_options *ndo _U_, FORMAT_STRING(const char *fmt), ...)
+{
+	char buf[1024];
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	return (ret);
+}
+
+static const char *
+bench_basename(const char *path)
+{
+	const char *p;
+
+	p = strrchr(path, '/');
+	return (p != NULL ? p + 1 : path);
+}
+
+static void
+bench_grow(struct bench_file *bf)
+{
+	if (bf->n < bf->alloc)
+		return;
+	bf->alloc = bf->alloc ? bf->alloc * 2 : 64;
+	bf->pkts = realloc(bf->pkts, bf->alloc * sizeof(*bf->pkts));
+	if (bf->pkts == NULL)
+		bench_error("out of memory");
+}
+
+static void
+bench_add_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct bench_file *bf = (struct bench_file *)user;
+	struct bench_pkt *pkt;
+
+	bench_grow(bf);
+	pkt = &bf->pkts[bf->n++];
+	pkt->hdr = *h;
+	pkt->data = malloc(h->caplen ? h->caplen : 1);
+	if (pkt->data == NULL)
+		bench_error("out of memory");
+	memcpy(pkt->data, sp, h->caplen);
+}
+
+/*
+ * Read a savefile into memory, replicated until there are at least
+ * min_packets packets.  Returns the number of packets, 0 if the file
+ * can't be read or is empty; *nfilep is set to the number of packets
+ * in the file itself, the replicas sharing their data.
+ */
+static u_int
+bench_load(const char *path, u_int min_packets, int *dltp, int *snaplenp,
+	   struct bench_pkt **pktsp, u_int *nfilep)
+{
+	char ebuf[PCAP_ERRBUF_SIZE];
+	struct bench_file bf;
+	u_int nfile;
+	pcap_t *pd;
+
+	memset(&bf, 0, sizeof(bf));
+	*pktsp = NULL;
+	*nfilep = 0;
+	pd = pcap_open_offline(path, ebuf);
+	if (pd == NULL) {
+		(void)fprintf(stderr, "%s: skipping %s: %s\n", program_name,
+		    path, ebuf);
+		return (0);
+	}
+	*dltp = pcap_datalink(pd);
+	*snaplenp = pcap_snapshot(pd);
+	if (pcap_loop(pd, -1, bench_add_packet, (u_char *)&bf) == -1)
+		(void)fprintf(stderr, "%s: %s: %s\n", program_name, path,
+		    pcap_geterr(pd));
+	pcap_close(pd);
+
+	/* replicate, sharing the packet data */
+	nfile = bf.n;
+	while (nfile != 0 && bf.n < min_packets) {
+		bench_grow(&bf);
+		bf.pkts[bf.n] = bf.pkts[bf.n % nfile];
+		bf.n++;
+	}
+	*pktsp = bf.pkts;
+	*nfilep = nfile;
+	return (bf.n);
+}
+
+static void
+bench_free(struct bench_pkt *pkts, u_int nfile)
+{
+	u_int i;
+
+	for (i = 0; i < nfile; i++)
+		free(pkts[i].data);
+	free(pkts);
+}
+
+static int
+bench_run(netdissect_options *ndo, const char *path, u_int iterations,
+	  u_int min_packets, struct bench_result *res)
+{
+	struct bench_pkt *pkts;
+	u_int n, i, j, nfile;
+	uint64_t start, elapsed;
+	u_int allocs;
+	int dlt, snaplen;
+
+	n = bench_load(path, min_packets, &dlt, &snaplen, &pkts, &nfile);
+	if (n == 0) {
+		free(pkts);
+		return (0);
+	}
+
+	ndo->ndo_if_printer = get_if_printer(dlt);
+	ndo->ndo_snaplen = snaplen;
+
+	allocs = nd_malloc_count();
+	start = nd_profile_now();
+	for (i = 0; i < iterations; i++) {
+		for (j = 0; j < n; j++)
+			pretty_print_packet(ndo, &pkts[j].hdr, pkts[j].data,
+			    j + 1);
+	}
+	elapsed = nd_profile_now() - start;
+	allocs = nd_malloc_count() - allocs;
+
+	res->name = strdup(bench_basename(path));
+	if (res->name == NULL)
+		bench_error("out of memory");
+	res->packets = n;
+	res->iterations = iterations;
+	if (elapsed == 0)
+		elapsed = 1;
+	res->pps = (double)n * iterations * 1e9 / (double)elapsed;
+	res->ns_per_pkt = (double)elapsed / ((double)n * iterations);
+	res->allocs_per_pkt = (double)allocs / ((double)n * iterations);
+
+	bench_free(pkts, nfile);
+	return (1);
+}
+
+static void
+bench_write(FILE *f, const struct bench_result *res, u_int nres)
+{
+	u_int i;
+
+	(void)fprintf(f, "%s\n", BENCH_FORMAT);
+	for (i = 0; i < nres; i++)
+		(void)fprintf(f, "%s %u %u %.0f %.1f %.3f\n",
+		    res[i].name, res[i].packets, res[i].iterations,
+		    res[i].pps, res[i].ns_per_pkt, res[i].allocs_per_pkt);
+}
+
+/*
+ * Compare against a baseline written by an earlier run; returns the
+ * number of regressions.
+ */
+static u_int
+bench_compare(const char *baseline, const struct bench_result *res,
+	      u_int nres, double tolerance)
+{
+	char line[1024], name[512];
+	u_int packets, iterations, i, nregress = 0;
+	double pps, ns, allocs;
+	FILE *f;
+
+	f = fopen(baseline, "r");
+	if (f == NULL)
+		bench_error("can't open baseline %s: %s", baseline,
+		    strerror(errno));
+	if (fgets(line, sizeof(line), f) == NULL ||
+	    strncmp(line, BENCH_FORMAT, strlen(BENCH_FORMAT)) != 0)
+		bench_error("%s is not a %s results file", baseline,
+		    program_name);
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "%511s %u %u %lf %lf %lf", name, &packets,
+		    &iterations, &pps, &ns, &allocs) != 6)
+			continue;
+		for (i = 0; i < nres; i++) {
+			if (strcmp(res[i].name, name) != 0)
+				continue;
+			if (res[i].ns_per_pkt > ns * (1.0 + tolerance / 100.0)) {
+				(void)fprintf(stderr,
+				    "REGRESSION %s: %.1f ns/packet, baseline %.1f (%+.1f%%)\n",
+				    name, res[i].ns_per_pkt, ns,
+				    (res[i].ns_per_pkt - ns) * 100.0 / ns);
+				nregress++;
+			}
+			/* allow for the rounding in the results file */
+			if (res[i].allocs_per_pkt > allocs + 0.0005) {
+				(void)fprintf(stderr,
+				    "REGRESSION %s: %.3f nd_malloc/packet, baseline %.3f\n",
+				    name, res[i].allocs_per_pkt, allocs);
+				nregress++;
+			}
+			break;
+		}
+	}
+	fclose(f);
+	return (nregress);
+}
+
+#ifndef _WIN32
+static int
+bench_cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Run "program -c 1 -r path args..." runs times, with its output thrown
+ * away, and time it.
+ */
+static int
+bench_startup(const char *program, char **args, u_int nargs,
+	      const char *path, u_int runs, struct bench_result *res)
+{
+	static char count_opt[] = "-c", count[] = "1", read_opt[] = "-r";
+	char *argv[BENCH_MAX_ARGS + 6];
+	char *program_arg, *path_arg;
+	uint64_t *times, start;
+	u_int i, argc = 0;
+	pid_t pid;
+	int status, fd;
+
+	/* execvp() takes writable strings */
+	program_arg = strdup(program);
+	path_arg = strdup(path);
+	times = calloc(runs, sizeof(*times));
+	if (program_arg == NULL || path_arg == NULL || times == NULL)
+		bench_error("out of memory");
+	argv[argc++] = program_arg;
+	argv[argc++] = count_opt;
+	argv[argc++] = count;
+	argv[argc++] = read_opt;
+	argv[argc++] = path_arg;
+	for (i = 0; i < nargs; i++)
+		argv[argc++] = args[i];
+	argv[argc] = NULL;
+
+	for (i = 0; i < runs; i++) {
+		start = nd_profile_now();
+		pid = fork();
+		if (pid == -1)
+			bench_error("fork: %s", strerror(errno));
+		if (pid == 0) {
+			fd = open("/dev/null", O_RDWR);
+			if (fd >= 0) {
+				(void)dup2(fd, 1);
+				(void)dup2(fd, 2);
+			}
+			execvp(program, argv);
+			_exit(127);
+		}
+		if (waitpid(pid, &status, 0) == -1)
+			bench_error("waitpid: %s", strerror(errno));
+		times[i] = nd_profile_now() - start;
+		if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) {
+			(void)fprintf(stderr, "%s: skipping %s: %s failed\n",
+			    program_name, path, program);
+			free(times);
+			free(path_arg);
+			free(program_arg);
+			return (0);
+		}
+	}
+	free(path_arg);
+	free(program_arg);
+	qsort(times, runs, sizeof(*times), bench_cmp_u64);
+
+	res->name = strdup(bench_basename(path));
+	if (res->name == NULL)
+		bench_error("out of memory");
+	res->iterations = runs;
+	res->median_us = (double)times[runs / 2] / 1000.0;
+	res->min_us = (double)times[0] / 1000.0;
+	free(times);
+	return (1);
+}
+#endif /* _WIN32 */
+
+static void
+bench_startup_write(FILE *f, const struct bench_result *res, u_int nres)
+{
+	u_int i;
+
+	(void)fprintf(f, "%s\n", BENCH_STARTUP_FORMAT);
+	for (i = 0; i < nres; i++)
+		(void)fprintf(f, "%s %u %.1f %.1f\n", res[i].name,
+		    res[i].iterations, res[i].median_us, res[i].min_us);
+}
+
+/*
+ * Compare startup times against a baseline; returns the number of
+ * regressions.
+ */
+static u_int
+bench_startup_compare(const char *baseline, const struct bench_result *res,
+		      u_int nres, double tolerance)
+{
+	char line[1024], name[512];
+	u_int runs, i, nregress = 0;
+	double median, min;
+	FILE *f;
+
+	f = fopen(baseline, "r");
+	if (f == NULL)
+		bench_error("can't open baseline %s: %s", baseline,
+		    strerror(errno));
+	if (fgets(line, sizeof(line), f) == NULL ||
+	    strncmp(line, BENCH_STARTUP_FORMAT,
+	    strlen(BENCH_STARTUP_FORMAT)) != 0)
+		bench_error("%s is not a %s startup results file", baseline,
+		    program_name);
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "%511s %u %lf %lf", name, &runs, &median,
+		    &min) != 4)
+			continue;
+		for (i = 0; i < nres; i++) {
+			if (strcmp(res[i].name, name) != 0)
+				continue;
+			if (res[i].median_us > median * (1.0 + tolerance / 100.0)) {
+				(void)fprintf(stderr,
+				    "REGRESSION %s: %.1f us to start, baseline %.1f (%+.1f%%)\n",
+				    name, res[i].median_us, median,
+				    (res[i].median_us - median) * 100.0 / median);
+				nregress++;
+			}
+			break;
+		}
+	}
+	fclose(f);
+	return (nregress);
+}
+
+static void
+usage(void)
+{
+	(void)fprintf(stderr,
+"Usage: %s [ -pqv ] [ -c baseline ] [ -n iterations ] [ -o results ]\n"
+"\t\t[ -R min-packets ] [ -t tolerance-percent ] file ...\n"
+"       %s -s program [ -a argument ]... [ -c baseline ] [ -n runs ]\n"
+"\t\t[ -o results ] [ -t tolerance-percent ] file ...\n",
+	    program_name, program_name);
+	exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+	netdissect_options Ndo, *ndo = &Ndo;
+	char ebuf[PCAP_ERRBUF_SIZE];
+	const char *baseline = NULL, *output = NULL, *startup = NULL;
+	char *startup_args[BENCH_MAX_ARGS];
+	u_int iterations = 10, min_packets = 0, nres = 0, nregress;
+	u_int nstartup_args = 0;
+	double tolerance = 10.0;
+	int pflag = 0, qflag = 0, vflag = 0, op, i;
+	struct bench_result *res;
+	FILE *f;
+
+	while ((op = getopt(argc, argv, "a:c:n:o:pqR:s:t:v")) != -1) {
+		switch (op) {
+
+		case 'a':
+			if (nstartup_args == BENCH_MAX_ARGS)
+				bench_error("too many -a arguments");
+			startup_args[nstartup_args++] = optarg;
+			break;
+
+		case 'c':
+			baseline = optarg;
+			break;
+
+		case 'n':
+			iterations = (u_int)strtoul(optarg, NULL, 10);
+			if (iterations == 0)
+				bench_error("invalid iteration count %s", optarg);
+			break;
+
+		case 'o':
+			output = optarg;
+			break;
+
+		case 'p':
+			pflag = 1;
+			break;
+
+		case 'q':
+			qflag++;
+			break;
+
+		case 'R':
+			min_packets = (u_int)strtoul(optarg, NULL, 10);
+			break;
+
+		case 's':
+			startup = optarg;
+			break;
+
+		case 't':
+			tolerance = strtod(optarg, NULL);
+			break;
+
+		case 'v':
+			vflag++;
+			break;
+
+		default:
+			usage();
+		}
+	}
+	if (optind == argc)
+		usage();
+
+	if (startup != NULL) {
+#ifdef _WIN32
+		bench_error("-s is not supported on this platform");
+#else
+		res = calloc(argc - optind, sizeof(*res));
+		if (res == NULL)
+			bench_error("out of memory");
+		for (i = optind; i < argc; i++) {
+			if (bench_startup(startup, startup_args, nstartup_args,
+			    argv[i], iterations, &res[nres]))
+				nres++;
+		}
+		bench_startup_write(stdout, res, nres);
+		if (output != NULL) {
+			f = fopen(output, "w");
+			if (f == NULL)
+				bench_error("can't create %s: %s", output,
+				    strerror(errno));
+			bench_startup_write(f, res, nres);
+			fclose(f);
+		}
+		nregress = 0;
+		if (baseline != NULL)
+			nregress = bench_startup_compare(baseline, res, nres,
+			    tolerance);
+		if (nregress != 0) {
+			(void)fprintf(stderr, "%s: %u regression%s\n",
+			    program_name, nregress, PLURAL_SUFFIX(nregress));
+			return (1);
+		}
+		return (0);
+#endif
+	}
+
+	if (nd_init(ebuf, sizeof(ebuf)) == -1)
+		bench_error("%s", ebuf);
+	memset(ndo, 0, sizeof(*ndo));
+	ndo_set_function_pointers(ndo);
+	ndo->ndo_printf = bench_printf;
+	ndo->program_name = program_name;
+	ndo->ndo_nflag = 1;
+	ndo->ndo_qflag = qflag;
+	ndo->ndo_vflag = vflag;
+	if (pflag) {
+		ndo->ndo_profile = 1;
+		nd_profile_init();
+	}
+	init_print(ndo, 0, 0);
+
+	res = calloc(argc - optind, sizeof(*res));
+	if (res == NULL)
+		bench_error("out of memory");
+	for (i = optind; i < argc; i++) {
+		if (bench_run(ndo, argv[i], iterations, min_packets,
+		    &res[nres]))
+			nres++;
+	}
+
+	bench_write(stdout, res, nres);
+	if (output != NULL) {
+		f = fopen(output, "w");
+		if (f == NULL)
+			bench_error("can't create %s: %s", output,
+			    strerror(errno));
+		bench_write(f, res, nres);
+		fclose(f);
+	}
+	nd_profile_print(stderr);
+
+	nregress = 0;
+	if (baseline != NULL)
+		nregress = bench_compare(baseline, res, nres, tolerance);
+	nd_cleanup();
+	if (nregress != 0) {
+		(void)fprintf(stderr, "%s: %u regression%s\n", program_name,
+		    nregress, PLURAL_SUFFIX(nregress));
+		return (1);
+	}
+	return (0);
+}
@@ -123,12 +123,124 @@ verify_crc10_cksum(uint16_t accum, const u_char *p, int length)
     return accum;
 }
 
-/* precompute checksum tables */
+/*
+ * The OSI Fletcher checksum is computed from two sums over the PDU,
+ * modulo 255:
+ *
+ *	c0 = sum of b[i]
+ *	c1 = sum of c0 after each byte = sum of (length - i) * b[i]
+ *
+ * The modulo can be deferred over a block of bytes as long as c1 can't
+ * overflow: starting from c0, c1 < 255, n bytes add at most 255 * n to
+ * c0 and 254 * n + 255 * n * (n + 1) / 2 to c1, which is less than
+ * 2^32 for n = 4096.
+ */
+#define OSI_CKSUM_BLOCK	4096
+
+static void
+osi_cksum_sums_generic(const uint8_t *p, u_int length,
+		       uint32_t *c0p, uint32_t *c1p)
+{
+    uint32_t c0 = 0;
+    uint32_t c1 = 0;
+    u_int n;
+
+    while (length != 0) {
+        n = length < OSI_CKSUM_BLOCK ? length : OSI_CKSUM_BLOCK;
+        length -= n;
+        for (; n >= 4; n -= 4, p += 4) {
+            c0 += p[0]; c1 += c0;
+            c0 += p[1]; c1 += c0;
+            c0 += p[2]; c1 += c0;
+            c0 += p[3]; c1 += c0;
+        }
+        for (; n != 0; n--) {
+            c0 += *p++;
+            c1 += c0;
+        }
+        c0 %= 255;
+        c1 %= 255;
+    }
+    *c0p = c0;
+    *c1p = c1;
+}
+
+/*
+ * With SSSE3, 16 bytes are summed at a time: a chunk adds the sum of
+ * its bytes to c0, and 16 * c0 plus the bytes weighted 16, 15, ... 1
+ * to c1.  It's chosen at run time, as SSSE3 isn't part of the x86-64
+ * baseline.
+ */
+#if (defined(__x86_64__) || defined(__i386__)) && \
+    (ND_IS_AT_LEAST_GNUC_VERSION(4,9) || ND_IS_AT_LEAST_CLANG_VERSION(3,8))
+#define OSI_CKSUM_SSSE3
+#include <tmmintrin.h>
+
+static inline uint32_t __attribute__((target("ssse3")))
+osi_cksum_hsum(__m128i v)
+{
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (uint32_t)_mm_cvtsi128_si32(v);
+}
+
+static void __attribute__((target("ssse3")))
+osi_cksum_sums_ssse3(const uint8_t *p, u_int length,
+		     uint32_t *c0p, uint32_t *c1p)
+{
+    const __m128i weights = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                          8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i chunk, vs, vps, vw;
+    uint64_t c0 = 0;
+    uint64_t c1 = 0;
+    u_int nchunks, i;
+
+    while (length >= 16) {
+        nchunks = length / 16;
+        if (nchunks > OSI_CKSUM_BLOCK / 16)
+            nchunks = OSI_CKSUM_BLOCK / 16;
+        length -= nchunks * 16;
+        c1 += (uint64_t)16 * nchunks * c0;
+        vs = zero;      /* sum of the bytes so far in this block */
+        vps = zero;     /* sum of vs before each chunk */
+        vw = zero;      /* weighted sums of the chunks */
+        for (i = 0; i < nchunks; i++, p += 16) {
+            chunk = _mm_loadu_si128((const __m128i *)p);
+            vps = _mm_add_epi32(vps, vs);
+            vs = _mm_add_epi32(vs, _mm_sad_epu8(chunk, zero));
+            vw = _mm_add_epi32(vw,
+                _mm_madd_epi16(_mm_maddubs_epi16(chunk, weights), ones));
+        }
+        c0 += osi_cksum_hsum(vs);
+        c1 += (uint64_t)16 * osi_cksum_hsum(vps) + osi_cksum_hsum(vw);
+        c0 %= 255;
+        c1 %= 255;
+    }
+    for (; length != 0; length--) {
+        c0 += *p++;
+        c1 += c0;
+    }
+    *c0p = (uint32_t)(c0 % 255);
+    *c1p = (uint32_t)(c1 % 255);
+}
+#endif /* OSI_CKSUM_SSSE3 */
+
+static void (*osi_cksum_sums)(const uint8_t *, u_int, uint32_t *, uint32_t *) =
+    osi_cksum_sums_generic;
+
+/* precompute checksum tables, and pick the fastest implementations */
 void
 init_checksum(void) {
 
     init_crc10_table();
 
+#ifdef OSI_CKSUM_SSSE3
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("ssse3"))
+        osi_cksum_sums = osi_cksum_sums_ssse3;
+#endif
 }
 
 /*
@@ -150,22 +262,19 @@ create_osi_cksum (const uint8_t *pptr, int checksum_offset, int length)
     c0 = 0;
     c1 = 0;
 
-    for (idx = 0; idx < length; idx++) {
-        /*
-         * Ignore the contents of the checksum field.
-         */
-        if (idx == checksum_offset ||
-            idx == checksum_offset+1) {
-            c1 += c0;
-            pptr++;
-        } else {
-            c0 = c0 + *(pptr++);
-            c1 += c0;
-        }
-    }
+    if (length > 0)
+        (*osi_cksum_sums)(pptr, length, &c0, &c1);
 
-    c0 = c0 % 255;
-    c1 = c1 % 255;
+    /*
+     * Ignore the contents of the checksum field: take its bytes back
+     * out of the sums, as if they had been zero.
+     */
+    for (idx = checksum_offset; idx < checksum_offset + 2; idx++) {
+        if (idx < 0 || idx >= length)
+            continue;
+        c0 = (c0 + 255 - pptr[idx] % 255) % 255;
+        c1 = (c1 + 255 - ((length - idx) % 255) * pptr[idx] % 255) % 255;
+    }
 
     mul = (length - checksum_offset)*(c0);
 
@@ -1,12 +1,28 @@
 #ifndef COLORS_H
 #define COLORS_H
 
-#define C_RESET   "\033[0m"
-#define C_RED     "\033[31m"
-#define C_GREEN   "\033[32m"
-#define C_YELLOW  "\033[33m"
-#define C_BLUE    "\033[34m"
-#define C_MAGENTA "\033[35m"
-#define C_CYAN    "\033[36m"
+/*
+ * Styles for ND_PRINT().  Text is written as is; with --color, the
+ * escape sequence for a style is written only where the style of the
+ * text changes.
+ */
+enum nd_style {
+	ND_STYLE_DEFAULT,
+	ND_STYLE_RED,
+	ND_STYLE_GREEN,
+	ND_STYLE_YELLOW,
+	ND_STYLE_BLUE,
+	ND_STYLE_MAGENTA,
+	ND_STYLE_CYAN,
+	ND_STYLE_COUNT
+};
+
+#define C_RESET   ND_STYLE_DEFAULT
+#define C_RED     ND_STYLE_RED
+#define C_GREEN   ND_STYLE_GREEN
+#define C_YELLOW  ND_STYLE_YELLOW
+#define C_BLUE    ND_STYLE_BLUE
+#define C_MAGENTA ND_STYLE_MAGENTA
+#define C_CYAN    ND_STYLE_CYAN
 
 #endif
@@ -0,0 +1,518 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * DNS transaction analysis (--dns-analysis).
+ *
+ * domain_print() hands every message it prints to dns_analysis_message().
+ * A query is kept, by client, server, ports and ID, until the response
+ * to it comes; the time between the two goes into a latency histogram
+ * for the server and the type of the query, and the response code is
+ * counted.  A query asked again before it's answered is counted as
+ * retransmitted, and timed from the first time.
+ *
+ * Queries not answered within DNSA_TIMEOUT_NS of packet time are
+ * counted as timed out.  There is a fixed number of queries waiting
+ * for an answer; when they're all in use, the oldest is dropped and
+ * counted as evicted.  Servers and query types beyond DNSA_STATS are
+ * added up together.
+ *
+ * The histograms have DNSA_SUB buckets of one microsecond, then
+ * DNSA_SUB per power of 2, so that the percentiles are within 1/DNSA_SUB
+ * of the latencies seen.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "addrtostr.h"
+
+extern const struct tok ns_type2str[];
+extern const char *ns_rcode(u_int);
+
+#define DNSA_TIMEOUT_NS	5000000000ULL	/* unanswered after this long */
+#define DNSA_STATS	1024		/* servers and query types kept */
+#define DNSA_RCODES	24		/* rcodes counted apart; then the rest */
+
+#define DNSA_SUB_BITS	4
+#define DNSA_SUB	(1 << DNSA_SUB_BITS)
+#define DNSA_BUCKETS	(DNSA_SUB + (32 - DNSA_SUB_BITS) * DNSA_SUB)
+
+/* Latencies of queries to a server of one type */
+struct dnsa_stats {
+	struct dnsa_stats *hnext;	/* hash chain */
+	u_char server[16];
+	uint16_t port;
+	uint16_t qtype;
+	u_char af6;
+	uint64_t queries;
+	uint64_t answered;
+	uint64_t timeouts;
+	uint64_t retransmissions;
+	uint64_t rcodes[DNSA_RCODES + 1];
+	uint64_t min_us;
+	uint64_t max_us;
+	uint64_t sum_us;
+	uint32_t hist[DNSA_BUCKETS];
+};
+
+struct dnsa_key {
+	u_char client[16];
+	u_char server[16];
+	uint16_t cport;
+	uint16_t sport;
+	uint16_t id;
+	u_char af6;
+};
+
+/* A query waiting for its response */
+struct dnsa_txn {
+	struct dnsa_txn *hnext;		/* hash chain, or free list */
+	struct dnsa_txn *newer;		/* in the order they were asked */
+	struct dnsa_txn *older;
+	struct dnsa_key key;
+	uint32_t hash;			/* of the key */
+	uint64_t ns;			/* first asked then */
+	struct dnsa_stats *stats;
+};
+
+static struct dnsa_txn *dnsa_txns;	/* all of them */
+static struct dnsa_txn *dnsa_free;
+static u_int dnsa_max;			/* size of dnsa_txns */
+static u_int dnsa_pending;
+static struct dnsa_txn **dnsa_hash;
+static u_int dnsa_hash_mask;
+static struct dnsa_txn *dnsa_newest, *dnsa_oldest;
+
+static struct dnsa_stats *dnsa_stats;
+static u_int dnsa_nstats;
+static struct dnsa_stats **dnsa_stats_hash;
+static struct dnsa_stats dnsa_other;	/* those that didn't fit */
+
+static struct {
+	uint64_t queries;
+	uint64_t answered;
+	uint64_t timeouts;
+	uint64_t retransmissions;
+	uint64_t evicted;
+	uint64_t unmatched;		/* responses to no query seen */
+} dnsa_totals;
+
+static void
+dnsa_init(netdissect_options *ndo)
+{
+	u_int i, n;
+
+	dnsa_max = ndo->ndo_dns_analysis;
+	for (n = 1; n < dnsa_max; n <<= 1)
+		;
+	dnsa_txns = calloc(dnsa_max, sizeof(*dnsa_txns));
+	dnsa_hash = calloc(n, sizeof(*dnsa_hash));
+	dnsa_stats = calloc(DNSA_STATS, sizeof(*dnsa_stats));
+	dnsa_stats_hash = calloc(DNSA_STATS * 2, sizeof(*dnsa_stats_hash));
+	if (dnsa_txns == NULL || dnsa_hash == NULL || dnsa_stats == NULL ||
+	    dnsa_stats_hash == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+		    "%s: calloc", __func__);
+	dnsa_hash_mask = n - 1;
+	for (i = 0; i < dnsa_max; i++) {
+		dnsa_txns[i].hnext = dnsa_free;
+		dnsa_free = &dnsa_txns[i];
+	}
+}
+
+static uint32_t
+dnsa_hash_bytes(const void *key, size_t len)
+{
+	const u_char *p = key;
+	uint32_t h = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static uint64_t
+dnsa_now(netdissect_options *ndo)
+{
+	uint64_t ns = (uint64_t)ndo->ndo_ts.tv_sec * 1000000000;
+
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		return (ns + ndo->ndo_ts.tv_usec);
+#endif
+	return (ns + (uint64_t)ndo->ndo_ts.tv_usec * 1000);
+}
+
+static u_int
+dnsa_bucket(uint64_t us)
+{
+	u_int e;
+
+	if (us > 0xffffffff)
+		us = 0xffffffff;
+	if (us < DNSA_SUB)
+		return ((u_int)us);
+	for (e = DNSA_SUB_BITS; (us >> (e + 1)) != 0; e++)
+		;
+	return (DNSA_SUB + (e - DNSA_SUB_BITS) * DNSA_SUB +
+	    (u_int)((us >> (e - DNSA_SUB_BITS)) & (DNSA_SUB - 1)));
+}
+
+/* The largest latency that goes into bucket "b" */
+static uint64_t
+dnsa_bucket_max(u_int b)
+{
+	u_int e, sub;
+
+	if (b < DNSA_SUB)
+		return (b);
+	e = (b - DNSA_SUB) / DNSA_SUB + DNSA_SUB_BITS;
+	sub = (b - DNSA_SUB) % DNSA_SUB;
+	return (((uint64_t)(DNSA_SUB + sub + 1) << (e - DNSA_SUB_BITS)) - 1);
+}
+
+static struct dnsa_stats *
+dnsa_stats_lookup(const u_char *server, uint16_t port, uint16_t qtype,
+		  u_char af6)
+{
+	struct {
+		u_char server[16];
+		uint16_t port;
+		uint16_t qtype;
+	} key;
+	struct dnsa_stats *s, **head;
+
+	memset(&key, 0, sizeof(key));
+	memcpy(key.server, server, af6 ? 16 : 4);
+	key.port = port;
+	key.qtype = qtype;
+	head = &dnsa_stats_hash[dnsa_hash_bytes(&key, sizeof(key)) &
+	    (DNSA_STATS * 2 - 1)];
+	for (s = *head; s != NULL; s = s->hnext)
+		if (s->af6 == af6 && s->port == port && s->qtype == qtype &&
+		    memcmp(s->server, key.server, sizeof(key.server)) == 0)
+			return (s);
+	if (dnsa_nstats == DNSA_STATS)
+		return (&dnsa_other);
+	s = &dnsa_stats[dnsa_nstats++];
+	memcpy(s->server, key.server, sizeof(s->server));
+	s->port = port;
+	s->qtype = qtype;
+	s->af6 = af6;
+	s->hnext = *head;
+	*head = s;
+	return (s);
+}
+
+static struct dnsa_txn *
+dnsa_lookup(const struct dnsa_key *k, uint32_t h)
+{
+	struct dnsa_txn *t;
+
+	for (t = dnsa_hash[h & dnsa_hash_mask]; t != NULL; t = t->hnext)
+		if (t->hash == h && memcmp(&t->key, k, sizeof(*k)) == 0)
+			return (t);
+	return (NULL);
+}
+
+static void
+dnsa_remove(struct dnsa_txn *t)
+{
+	struct dnsa_txn **tp;
+
+	for (tp = &dnsa_hash[t->hash & dnsa_hash_mask]; *tp != t;
+	    tp = &(*tp)->hnext)
+		;
+	*tp = t->hnext;
+	if (t->newer != NULL)
+		t->newer->older = t->older;
+	else
+		dnsa_newest = t->older;
+	if (t->older != NULL)
+		t->older->newer = t->newer;
+	else
+		dnsa_oldest = t->newer;
+	t->hnext = dnsa_free;
+	dnsa_free = t;
+	dnsa_pending--;
+}
+
+/*
+ * Time out the queries that have waited too long by "now".
+ */
+static void
+dnsa_expire(uint64_t now)
+{
+	struct dnsa_txn *t;
+
+	while ((t = dnsa_oldest) != NULL && now > t->ns &&
+	    now - t->ns >= DNSA_TIMEOUT_NS) {
+		t->stats->timeouts++;
+		dnsa_totals.timeouts++;
+		dnsa_remove(t);
+	}
+}
+
+void
+dns_analysis_message(netdissect_options *ndo, const struct dns_analysis_msg *m)
+{
+	struct dnsa_key key;
+	struct dnsa_txn *t, **head;
+	struct dnsa_stats *s;
+	uint64_t now, us;
+	uint32_t h;
+
+	if (dnsa_txns == NULL)
+		dnsa_init(ndo);
+	now = dnsa_now(ndo);
+	dnsa_expire(now);
+
+	memset(&key, 0, sizeof(key));
+	key.af6 = (m->addrlen == 16);
+	key.id = m->id;
+	if (m->response) {
+		memcpy(key.client, m->dst, m->addrlen);
+		memcpy(key.server, m->src, m->addrlen);
+		key.cport = m->dport;
+		key.sport = m->sport;
+	} else {
+		memcpy(key.client, m->src, m->addrlen);
+		memcpy(key.server, m->dst, m->addrlen);
+		key.cport = m->sport;
+		key.sport = m->dport;
+	}
+	h = dnsa_hash_bytes(&key, sizeof(key));
+	t = dnsa_lookup(&key, h);
+
+	if (m->response) {
+		if (t == NULL) {
+			dnsa_totals.unmatched++;
+			return;
+		}
+		s = t->stats;
+		us = now > t->ns ? (now - t->ns) / 1000 : 0;
+		if (s->answered == 0 || us < s->min_us)
+			s->min_us = us;
+		if (us > s->max_us)
+			s->max_us = us;
+		s->sum_us += us;
+		s->hist[dnsa_bucket(us)]++;
+		s->rcodes[m->rcode < DNSA_RCODES ? m->rcode : DNSA_RCODES]++;
+		s->answered++;
+		dnsa_totals.answered++;
+		dnsa_remove(t);
+		return;
+	}
+
+	if (t != NULL) {
+		t->stats->retransmissions++;
+		dnsa_totals.retransmissions++;
+		return;
+	}
+	s = dnsa_stats_lookup(key.server, key.sport, (uint16_t)m->qtype,
+	    key.af6);
+	s->queries++;
+	dnsa_totals.queries++;
+	if (dnsa_free == NULL) {
+		dnsa_totals.evicted++;
+		dnsa_remove(dnsa_oldest);
+	}
+	t = dnsa_free;
+	dnsa_free = t->hnext;
+	memcpy(&t->key, &key, sizeof(key));
+	t->hash = h;
+	t->ns = now;
+	t->stats = s;
+	head = &dnsa_hash[h & dnsa_hash_mask];
+	t->hnext = *head;
+	*head = t;
+	t->older = dnsa_newest;
+	t->newer = NULL;
+	if (dnsa_newest != NULL)
+		dnsa_newest->newer = t;
+	else
+		dnsa_oldest = t;
+	dnsa_newest = t;
+	dnsa_pending++;
+}
+
+/* The latency under which "pct" percent of the answers came */
+static uint64_t
+dnsa_percentile(const struct dnsa_stats *s, u_int pct)
+{
+	uint64_t want, seen;
+	u_int b;
+
+	want = (s->answered * pct + 99) / 100;
+	seen = 0;
+	for (b = 0; b < DNSA_BUCKETS; b++) {
+		seen += s->hist[b];
+		if (seen >= want)
+			break;
+	}
+	/* Not above what was seen */
+	return (b < DNSA_BUCKETS && dnsa_bucket_max(b) < s->max_us ?
+	    dnsa_bucket_max(b) : s->max_us);
+}
+
+static void
+dnsa_print_counts(FILE *fp, const struct dnsa_stats *s)
+{
+	(void)fprintf(fp, "%" PRIu64 " quer%s, %" PRIu64 " answered",
+	    s->queries, s->queries == 1 ? "y" : "ies", s->answered);
+	if (s->timeouts != 0)
+		(void)fprintf(fp, ", %" PRIu64 " timed out", s->timeouts);
+	if (s->retransmissions != 0)
+		(void)fprintf(fp, ", %" PRIu64 " retransmitted",
+		    s->retransmissions);
+}
+
+static void
+dnsa_print_server(FILE *fp, const struct dnsa_stats **sorted, u_int n)
+{
+	struct dnsa_stats sum;
+	char addr[INET6_ADDRSTRLEN];
+	const char *name;
+	u_int i, r;
+
+	memset(&sum, 0, sizeof(sum));
+	for (i = 0; i < n; i++) {
+		sum.queries += sorted[i]->queries;
+		sum.answered += sorted[i]->answered;
+		sum.timeouts += sorted[i]->timeouts;
+		sum.retransmissions += sorted[i]->retransmissions;
+		for (r = 0; r <= DNSA_RCODES; r++)
+			sum.rcodes[r] += sorted[i]->rcodes[r];
+	}
+	if (sorted[0] == &dnsa_other)
+		(void)fprintf(fp, "  other servers and types: ");
+	else {
+		if (sorted[0]->af6)
+			addrtostr6(sorted[0]->server, addr, sizeof(addr));
+		else
+			addrtostr(sorted[0]->server, addr, sizeof(addr));
+		(void)fprintf(fp, "  %s.%u: ", addr, sorted[0]->port);
+	}
+	dnsa_print_counts(fp, &sum);
+	(void)fprintf(fp, "\n");
+	if (sum.answered != 0) {
+		(void)fprintf(fp, "    rcodes:");
+		for (r = 0; r < DNSA_RCODES; r++) {
+			if (sum.rcodes[r] == 0)
+				continue;
+			name = r == 0 ? "NoError" : ns_rcode(r);
+			if (*name == ' ')
+				name++;
+			(void)fprintf(fp, " %s %" PRIu64, name, sum.rcodes[r]);
+		}
+		if (sum.rcodes[DNSA_RCODES] != 0)
+			(void)fprintf(fp, " other %" PRIu64,
+			    sum.rcodes[DNSA_RCODES]);
+		(void)fprintf(fp, "\n");
+	}
+
+	for (i = 0; i < n; i++) {
+		const struct dnsa_stats *s = sorted[i];
+
+		if (s != &dnsa_other)
+			(void)fprintf(fp, "    %s: ",
+			    tok2str(ns_type2str, "Type%u", s->qtype));
+		else
+			(void)fprintf(fp, "    all: ");
+		dnsa_print_counts(fp, s);
+		if (s->answered != 0)
+			(void)fprintf(fp, ", latency min %.3f avg %.3f p50 %.3f p90 %.3f p99 %.3f max %.3f ms",
+			    (double)s->min_us / 1e3,
+			    (double)s->sum_us / s->answered / 1e3,
+			    (double)dnsa_percentile(s, 50) / 1e3,
+			    (double)dnsa_percentile(s, 90) / 1e3,
+			    (double)dnsa_percentile(s, 99) / 1e3,
+			    (double)s->max_us / 1e3);
+		(void)fprintf(fp, "\n");
+	}
+}
+
+static int
+dnsa_cmp(const void *a, const void *b)
+{
+	const struct dnsa_stats *sa = *(const struct dnsa_stats * const *)a;
+	const struct dnsa_stats *sb = *(const struct dnsa_stats * const *)b;
+	int c;
+
+	if (sa->af6 != sb->af6)
+		return (sa->af6 - sb->af6);
+	c = memcmp(sa->server, sb->server, sizeof(sa->server));
+	if (c != 0)
+		return (c);
+	if (sa->port != sb->port)
+		return (sa->port - sb->port);
+	return (sa->qtype - sb->qtype);
+}
+
+/*
+ * Print what's known of each server, by address and query type.
+ */
+void
+dns_analysis_print(FILE *fp)
+{
+	const struct dnsa_stats **sorted, *other;
+	u_int i, j;
+
+	if (dnsa_txns == NULL)
+		return;
+	sorted = calloc(dnsa_nstats + 1, sizeof(*sorted));
+	if (sorted == NULL)
+		return;
+	for (i = 0; i < dnsa_nstats; i++)
+		sorted[i] = &dnsa_stats[i];
+	qsort(sorted, dnsa_nstats, sizeof(*sorted), dnsa_cmp);
+
+	(void)fprintf(fp, "DNS analysis: %" PRIu64 " quer%s, %" PRIu64 " answered, %" PRIu64 " timed out, %u waiting, %" PRIu64 " retransmitted",
+	    dnsa_totals.queries, dnsa_totals.queries == 1 ? "y" : "ies",
+	    dnsa_totals.answered, dnsa_totals.timeouts, dnsa_pending,
+	    dnsa_totals.retransmissions);
+	if (dnsa_totals.evicted != 0)
+		(void)fprintf(fp, ", %" PRIu64 " evicted", dnsa_totals.evicted);
+	if (dnsa_totals.unmatched != 0)
+		(void)fprintf(fp, ", %" PRIu64 " unmatched response%s",
+		    dnsa_totals.unmatched, PLURAL_SUFFIX(dnsa_totals.unmatched));
+	(void)fprintf(fp, "\n");
+	for (i = 0; i < dnsa_nstats; i = j) {
+		for (j = i + 1; j < dnsa_nstats; j++)
+			if (sorted[j]->af6 != sorted[i]->af6 ||
+			    sorted[j]->port != sorted[i]->port ||
+			    memcmp(sorted[j]->server, sorted[i]->server,
+			    sizeof(sorted[i]->server)) != 0)
+				break;
+		dnsa_print_server(fp, sorted + i, j - i);
+	}
+	if (dnsa_other.queries != 0) {
+		other = &dnsa_other;
+		dnsa_print_server(fp, &other, 1);
+	}
+	free(sorted);
+}
@@ -0,0 +1,555 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Group-commit savefile writer.
+ *
+ * libpcap writes a savefile through a stdio stream; with -U, tcpdump
+ * used to flush that stream after every packet, which costs a write()
+ * per packet.  Here the stream is a custom one (fopencookie() or
+ * funopen()) whose output goes into one of two large buffers.  When
+ * the buffer being filled is full, or the oldest data in it has been
+ * waiting for the maximum latency, it is handed to a flush thread
+ * and filling continues in the other one; the capture loop only
+ * waits if both are busy.  Without threads, the buffer is written
+ * synchronously instead, and the latency bound is only checked when
+ * data arrives.
+ *
+ * With O_DIRECT, writes must be whole, aligned blocks: each buffer
+ * starts at a block boundary of the file and is written rounded up
+ * to a whole block, and the partial block at its end is carried over
+ * to the start of the next buffer, to be rewritten with the data that
+ * follows it.  The padding is truncated away when the file is closed,
+ * as is whatever was preallocated and not used.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "netdissect-stdinc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#ifdef HAVE_PTHREAD_CREATE
+#include <pthread.h>
+#endif
+
+#include "dumpwriter.h"
+
+#ifdef HAVE_DUMP_WRITER
+
+#define DW_ALIGN	4096	/* buffer and O_DIRECT block alignment */
+
+struct dump_writer {
+	struct dump_writer *next;	/* list of open writers */
+	FILE *fp;		/* the stream writing to it */
+	int fd;
+	int direct;		/* fd is O_DIRECT */
+	int truncate;		/* truncate to the data written on close */
+	int closed;
+	int error;		/* errno of the first failed write */
+	size_t bufsize;
+	u_char *buf[2];
+	size_t len[2];		/* bytes in each buffer */
+	off_t off[2];		/* file offset of each buffer's first byte */
+	int active;		/* buffer being filled */
+	uint64_t active_since;	/* when unwritten data was first added to
+				   the active buffer, 0 if there's none */
+	uint64_t latency_ns;
+	uint64_t total;		/* bytes accepted, i.e. the file size */
+#ifdef HAVE_PTHREAD_CREATE
+	int flushing;		/* buffer being written, -1 if none */
+	int stop;		/* the flush thread should exit */
+	pthread_t thread;
+	pthread_mutex_t mtx;
+	pthread_cond_t wake;	/* to the flush thread */
+	pthread_cond_t done;	/* from the flush thread */
+#endif
+};
+
+static struct dump_writer *dw_list;
+static pid_t dw_atexit_pid;		/* 0 if dw_atexit() isn't registered */
+#ifdef HAVE_PTHREAD_CREATE
+static pthread_mutex_t dw_list_mtx = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+#ifdef HAVE_PTHREAD_CREATE
+#define DW_LOCK(dw)	pthread_mutex_lock(&(dw)->mtx)
+#define DW_UNLOCK(dw)	pthread_mutex_unlock(&(dw)->mtx)
+#define DW_LIST_LOCK()	pthread_mutex_lock(&dw_list_mtx)
+#define DW_LIST_UNLOCK() pthread_mutex_unlock(&dw_list_mtx)
+#else
+#define DW_LOCK(dw)
+#define DW_UNLOCK(dw)
+#define DW_LIST_LOCK()
+#define DW_LIST_UNLOCK()
+#endif
+
+/*
+ * The clock of the latency deadline, which pthread_cond_timedwait()
+ * must use too.  That's CLOCK_REALTIME unless the condition variable
+ * can be told otherwise; then a step of the wall clock can't hold
+ * buffered packets back.
+ */
+#if defined(HAVE_PTHREAD_CONDATTR_SETCLOCK) && defined(CLOCK_MONOTONIC)
+#define DW_CLOCK	CLOCK_MONOTONIC
+#define DW_CLOCK_MONOTONIC
+#else
+#define DW_CLOCK	CLOCK_REALTIME
+#endif
+
+static uint64_t
+dw_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(DW_CLOCK, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+static void
+dw_write_buffer(struct dump_writer *dw, u_char *buf, size_t len, off_t off)
+{
+	size_t n = len;
+	ssize_t ret;
+
+	if (dw->direct) {
+		n = (len + DW_ALIGN - 1) / DW_ALIGN * DW_ALIGN;
+		memset(buf + len, 0, n - len);
+	}
+	while (n != 0) {
+		ret = pwrite(dw->fd, buf, n, off);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (dw->error == 0)
+				dw->error = errno;
+			return;
+		}
+		buf += ret;
+		n -= ret;
+		off += ret;
+	}
+}
+
+/*
+ * Commit the active buffer and switch to the other one.  Called with
+ * the lock held.
+ */
+static void
+dw_handoff(struct dump_writer *dw)
+{
+	int cur = dw->active, next = !cur;
+	size_t carry;
+
+#ifdef HAVE_PTHREAD_CREATE
+	while (dw->flushing != -1)
+		pthread_cond_wait(&dw->done, &dw->mtx);
+#endif
+	carry = dw->direct ? dw->len[cur] % DW_ALIGN : 0;
+	memcpy(dw->buf[next], dw->buf[cur] + dw->len[cur] - carry, carry);
+	dw->len[next] = carry;
+	dw->off[next] = dw->off[cur] + dw->len[cur] - carry;
+	dw->active = next;
+	dw->active_since = 0;
+#ifdef HAVE_PTHREAD_CREATE
+	dw->flushing = cur;
+	pthread_cond_signal(&dw->wake);
+#else
+	dw_write_buffer(dw, dw->buf[cur], dw->len[cur], dw->off[cur]);
+#endif
+}
+
+#ifdef HAVE_PTHREAD_CREATE
+static void *
+dw_flush_thread(void *arg)
+{
+	struct dump_writer *dw = arg;
+	struct timespec ts;
+	uint64_t deadline;
+	int idx;
+
+	pthread_mutex_lock(&dw->mtx);
+	for (;;) {
+		if (dw->flushing != -1) {
+			/* the capture side doesn't touch this buffer */
+			idx = dw->flushing;
+			pthread_mutex_unlock(&dw->mtx);
+			dw_write_buffer(dw, dw->buf[idx], dw->len[idx],
+			    dw->off[idx]);
+			pthread_mutex_lock(&dw->mtx);
+			dw->flushing = -1;
+			pthread_cond_broadcast(&dw->done);
+			continue;
+		}
+		if (dw->stop)
+			break;
+		if (dw->active_since == 0) {
+			pthread_cond_wait(&dw->wake, &dw->mtx);
+			continue;
+		}
+		deadline = dw->active_since + dw->latency_ns;
+		if (dw_now() >= deadline) {
+			dw_handoff(dw);
+			continue;
+		}
+		ts.tv_sec = (time_t)(deadline / 1000000000);
+		ts.tv_nsec = (long)(deadline % 1000000000);
+		pthread_cond_timedwait(&dw->wake, &dw->mtx, &ts);
+	}
+	pthread_mutex_unlock(&dw->mtx);
+	return (NULL);
+}
+#endif
+
+static ssize_t
+dw_write(void *cookie, const char *data, size_t size)
+{
+	struct dump_writer *dw = cookie;
+	size_t n, done;
+
+	if (dw->closed) {
+		errno = EBADF;
+		return (-1);
+	}
+	DW_LOCK(dw);
+	/* fail, so that ferror() tells, once a write has */
+	if (dw->error != 0) {
+		DW_UNLOCK(dw);
+		errno = dw->error;
+		return (-1);
+	}
+	for (done = 0; done < size; done += n) {
+		n = dw->bufsize - dw->len[dw->active];
+		if (n > size - done)
+			n = size - done;
+		memcpy(dw->buf[dw->active] + dw->len[dw->active], data + done,
+		    n);
+		dw->len[dw->active] += n;
+		if (dw->active_since == 0) {
+			dw->active_since = dw_now();
+#ifdef HAVE_PTHREAD_CREATE
+			/* start the latency clock */
+			pthread_cond_signal(&dw->wake);
+#endif
+		}
+		if (dw->len[dw->active] == dw->bufsize)
+			dw_handoff(dw);
+	}
+#ifndef HAVE_PTHREAD_CREATE
+	if (dw->active_since != 0 &&
+	    dw_now() - dw->active_since >= dw->latency_ns)
+		dw_handoff(dw);
+#endif
+	dw->total += size;
+	DW_UNLOCK(dw);
+	return ((ssize_t)size);
+}
+
+/* Only the current position can be asked for, for pcap_dump_ftell() */
+static int
+dw_tell(struct dump_writer *dw, int64_t offset, int whence, int64_t *posp)
+{
+	if (whence != SEEK_CUR || offset != 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+	*posp = (int64_t)dw->total;
+	return (0);
+}
+
+/*
+ * Write out everything and close the descriptor, but leave the
+ * structure, which stdio may still point to.
+ */
+static int
+dw_finish(struct dump_writer *dw)
+{
+	struct dump_writer **dwp;
+	int ret = 0;
+
+	if (dw->closed)
+		return (0);
+	DW_LOCK(dw);
+	if (dw->active_since != 0)
+		dw_handoff(dw);
+#ifdef HAVE_PTHREAD_CREATE
+	dw->stop = 1;
+	pthread_cond_signal(&dw->wake);
+	DW_UNLOCK(dw);
+	pthread_join(dw->thread, NULL);
+#endif
+	if (dw->truncate && ftruncate(dw->fd, (off_t)dw->total) == -1 &&
+	    dw->error == 0)
+		dw->error = errno;
+	if (close(dw->fd) == -1 && dw->error == 0)
+		dw->error = errno;
+	dw->closed = 1;
+	if (dw->error != 0) {
+		errno = dw->error;
+		ret = -1;
+	}
+
+	DW_LIST_LOCK();
+	for (dwp = &dw_list; *dwp != NULL; dwp = &(*dwp)->next) {
+		if (*dwp == dw) {
+			*dwp = dw->next;
+			break;
+		}
+	}
+	DW_LIST_UNLOCK();
+	return (ret);
+}
+
+/* The writer behind fp, NULL if it isn't one */
+static struct dump_writer *
+dw_lookup(FILE *fp)
+{
+	struct dump_writer *dw;
+
+	DW_LIST_LOCK();
+	for (dw = dw_list; dw != NULL; dw = dw->next) {
+		if (dw->fp == fp)
+			break;
+	}
+	DW_LIST_UNLOCK();
+	return (dw);
+}
+
+int
+dump_writer_flush(FILE *fp)
+{
+	struct dump_writer *dw;
+	int err;
+
+	dw = dw_lookup(fp);
+	if (dw == NULL)
+		return (0);
+	DW_LOCK(dw);
+	if (dw->active_since != 0)
+		dw_handoff(dw);
+#ifdef HAVE_PTHREAD_CREATE
+	while (dw->flushing != -1)
+		pthread_cond_wait(&dw->done, &dw->mtx);
+#endif
+	err = dw->error;
+	DW_UNLOCK(dw);
+	if (err != 0) {
+		errno = err;
+		return (-1);
+	}
+	return (0);
+}
+
+int
+dump_writer_finish(FILE *fp)
+{
+	struct dump_writer *dw;
+
+	dw = dw_lookup(fp);
+	if (dw == NULL)
+		return (0);
+	return (dw_finish(dw));
+}
+
+static void
+dw_free(struct dump_writer *dw)
+{
+#ifdef HAVE_PTHREAD_CREATE
+	pthread_cond_destroy(&dw->done);
+	pthread_cond_destroy(&dw->wake);
+	pthread_mutex_destroy(&dw->mtx);
+#endif
+	free(dw->buf[0]);
+	free(dw->buf[1]);
+	free(dw);
+}
+
+static int
+dw_close(void *cookie)
+{
+	struct dump_writer *dw = cookie;
+	int ret;
+
+	ret = dw_finish(dw);
+	dw_free(dw);
+	return (ret);
+}
+
+/*
+ * On exit, including after a SIGTERM or SIGINT has ended the capture
+ * loop, write out whatever is still buffered.  Not in a child process
+ * that exits after a failed exec, though; the buffers belong to the
+ * parent and the flush threads don't exist there.
+ */
+static void
+dw_atexit(void)
+{
+	if (getpid() != dw_atexit_pid)
+		return;
+	while (dw_list != NULL)
+		(void)dw_finish(dw_list);
+}
+
+#ifdef HAVE_FOPENCOOKIE
+static int
+dw_seek(void *cookie, off64_t *pos, int whence)
+{
+	int64_t newpos;
+
+	if (dw_tell(cookie, *pos, whence, &newpos) == -1)
+		return (-1);
+	*pos = newpos;
+	return (0);
+}
+#else
+static int
+dw_funopen_write(void *cookie, const char *data, int size)
+{
+	return ((int)dw_write(cookie, data, (size_t)size));
+}
+
+static fpos_t
+dw_funopen_seek(void *cookie, fpos_t offset, int whence)
+{
+	int64_t newpos;
+
+	if (dw_tell(cookie, offset, whence, &newpos) == -1)
+		return (-1);
+	return ((fpos_t)newpos);
+}
+#endif
+
+FILE *
+dump_writer_fdopen(int fd, const struct dump_writer_params *params)
+{
+	struct dump_writer *dw;
+	FILE *fp;
+	int err;
+#ifdef HAVE_FOPENCOOKIE
+	cookie_io_functions_t funcs;
+#endif
+#ifdef HAVE_PTHREAD_CREATE
+	sigset_t all, old;
+#endif
+#ifdef DW_CLOCK_MONOTONIC
+	pthread_condattr_t wake_attr;
+#endif
+
+	dw = calloc(1, sizeof(*dw));
+	if (dw == NULL)
+		return (NULL);
+	dw->fd = fd;
+	dw->bufsize = params->commit_bytes < DW_ALIGN ? DW_ALIGN :
+	    (params->commit_bytes + DW_ALIGN - 1) / DW_ALIGN * DW_ALIGN;
+	dw->latency_ns = (uint64_t)params->latency_ms * 1000000;
+	if (posix_memalign((void **)&dw->buf[0], DW_ALIGN, dw->bufsize) != 0 ||
+	    posix_memalign((void **)&dw->buf[1], DW_ALIGN, dw->bufsize) != 0) {
+		free(dw->buf[0]);
+		free(dw);
+		errno = ENOMEM;
+		return (NULL);
+	}
+
+	if (params->direct) {
+#if defined(O_DIRECT)
+		int flags = fcntl(fd, F_GETFL);
+
+		/* not all file systems support it; then do without */
+		if (flags != -1 && fcntl(fd, F_SETFL, flags | O_DIRECT) != -1)
+			dw->direct = dw->truncate = 1;
+#elif defined(F_NOCACHE)
+		/* no alignment requirements */
+		(void)fcntl(fd, F_NOCACHE, 1);
+#endif
+	}
+#ifdef HAVE_POSIX_FALLOCATE
+	if (params->preallocate != 0 &&
+	    posix_fallocate(fd, 0, (off_t)params->preallocate) == 0)
+		dw->truncate = 1;
+#endif
+
+#ifdef HAVE_PTHREAD_CREATE
+	dw->flushing = -1;
+	pthread_mutex_init(&dw->mtx, NULL);
+#ifdef DW_CLOCK_MONOTONIC
+	pthread_condattr_init(&wake_attr);
+	pthread_condattr_setclock(&wake_attr, DW_CLOCK);
+	pthread_cond_init(&dw->wake, &wake_attr);
+	pthread_condattr_destroy(&wake_attr);
+#else
+	pthread_cond_init(&dw->wake, NULL);
+#endif
+	pthread_cond_init(&dw->done, NULL);
+	/*
+	 * Signals must keep going to the capture thread, so that, for
+	 * example, pcap_breakloop() in the SIGINT handler interrupts it.
+	 */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	err = pthread_create(&dw->thread, NULL, dw_flush_thread, dw);
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	if (err != 0) {
+		dw_free(dw);
+		errno = err;
+		return (NULL);
+	}
+#endif
+
+#ifdef HAVE_FOPENCOOKIE
+	funcs.read = NULL;
+	funcs.write = dw_write;
+	funcs.seek = dw_seek;
+	funcs.close = dw_close;
+	fp = fopencookie(dw, "w", funcs);
+#else
+	fp = funopen(dw, NULL, dw_funopen_write, dw_funopen_seek, dw_close);
+#endif
+	if (fp == NULL) {
+		err = errno;
+		dw->fd = -1;	/* the caller still owns it */
+#ifdef HAVE_PTHREAD_CREATE
+		DW_LOCK(dw);
+		dw->stop = 1;
+		pthread_cond_signal(&dw->wake);
+		DW_UNLOCK(dw);
+		pthread_join(dw->thread, NULL);
+#endif
+		dw_free(dw);
+		errno = err;
+		return (NULL);
+	}
+	/* our buffers replace stdio's */
+	setvbuf(fp, NULL, _IONBF, 0);
+	dw->fp = fp;
+
+	DW_LIST_LOCK();
+	dw->next = dw_list;
+	dw_list = dw;
+	if (dw_atexit_pid == 0) {
+		atexit(dw_atexit);
+		dw_atexit_pid = getpid();
+	}
+	DW_LIST_UNLOCK();
+	return (fp);
+}
+#endif /* HAVE_DUMP_WRITER */
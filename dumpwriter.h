@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef dumpwriter_h
+#define dumpwriter_h
+
+/*
+ * Group-commit savefile writer, used for -U.
+ *
+ * Instead of one write() per packet, data is collected in large
+ * buffers and written when a buffer fills or when the oldest data in
+ * it has waited for the maximum latency, whichever comes first.
+ */
+#if defined(HAVE_FOPENCOOKIE) || defined(HAVE_FUNOPEN)
+#define HAVE_DUMP_WRITER
+#endif
+
+struct dump_writer_params {
+	size_t commit_bytes;	/* buffer size; a full buffer is written */
+	u_int latency_ms;	/* most time data waits before it's written */
+	int direct;		/* bypass the page cache (O_DIRECT) */
+	uint64_t preallocate;	/* bytes to preallocate for each file */
+};
+
+#define DUMP_WRITER_DEFAULT_COMMIT_BYTES	(1024*1024)
+#define DUMP_WRITER_DEFAULT_LATENCY_MS		10
+
+#ifdef HAVE_DUMP_WRITER
+/*
+ * Return a stdio stream, to be handed to pcap_dump_fopen(), that writes
+ * to fd through a group-commit writer; fclose() on it writes out what's
+ * left and closes fd.  Data still buffered when the program exits is
+ * written out too.
+ */
+extern FILE *dump_writer_fdopen(int, const struct dump_writer_params *);
+
+/*
+ * Write out what's buffered for such a stream and wait until it's
+ * written; returns -1, with errno set, if that or any earlier write
+ * failed.  dump_writer_finish() does the same and closes the file,
+ * so that fclose() can no longer fail.  Both return 0 for any other
+ * stream.
+ */
+extern int dump_writer_flush(FILE *);
+extern int dump_writer_finish(FILE *);
+#endif
+
+#endif /* dumpwriter_h */
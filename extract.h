@@ -907,4 +907,55 @@ get_cpy_bytes(netdissect_options *ndo, u_char *dst, const u_char *p, size_t len)
 
 #define GET_CPY_BYTES(dst, p, len) get_cpy_bytes(ndo, (u_char *)(dst), (const u_char *)(p), len)
 
+/*
+ * Spans.
+ *
+ * A printer that reads several fields of a fixed-size header can check
+ * once that all of the header was captured, with ND_TCHECK_SIZE() or
+ * ND_SPAN_CHECK(), and then read the fields with the SPAN_ macros,
+ * which, unlike the GET_ macros, don't check the fields themselves.
+ *
+ * The SPAN_ macros take a pointer to the structure for the header and
+ * the name of the member to read, rather than a pointer to the field,
+ * so they can only read within the structure that was checked; that the
+ * member is as large as what's read from it is checked at compile time.
+ */
+
+/* Check that all of *(sp) was captured, longjmp'ing out if not */
+#define ND_SPAN_CHECK(sp) \
+	do { \
+		if (!ND_TTEST_SIZE(sp)) \
+			nd_trunc_longjmp(ndo); \
+	} while (0)
+
+/* Pointer to member m of *(sp), which must be at least n bytes long */
+#ifdef ND_SPAN_DEBUG
+#include <stdlib.h>
+
+/*
+ * For fuzzing (see fuzz.c): abort if the member wasn't captured after
+ * all, i.e. if a SPAN_ read isn't covered by a check.
+ */
+static inline const u_char *
+nd_span_member(netdissect_options *ndo, const u_char *p, u_int n)
+{
+	if (!ND_TTEST_LEN(p, n))
+		abort();
+	return (p);
+}
+
+#define ND_SPAN_MEMBER(sp, m, n) \
+	nd_span_member(ndo, (const u_char *)(sp)->m + \
+	    0 * sizeof(char [sizeof((sp)->m) >= (n) ? 1 : -1]), n)
+#else
+#define ND_SPAN_MEMBER(sp, m, n) \
+	((const u_char *)(sp)->m + \
+	 0 * sizeof(char [sizeof((sp)->m) >= (n) ? 1 : -1]))
+#endif
+
+#define SPAN_U_1(sp, m) EXTRACT_U_1(ND_SPAN_MEMBER(sp, m, 1))
+
+#define SPAN_BE_U_2(sp, m) EXTRACT_BE_U_2(ND_SPAN_MEMBER(sp, m, 2))
+#define SPAN_BE_U_4(sp, m) EXTRACT_BE_U_4(ND_SPAN_MEMBER(sp, m, 4))
+
 #endif /* EXTRACT_H */
@@ -0,0 +1,544 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Summaries of NetFlow and sFlow exports (--flow-export-summary).
+ *
+ * Instead of printing each record, the NetFlow and sFlow printers hand
+ * it to this module: flow_export_datagram() for the header of each
+ * export datagram, flow_export_flow() for each flow record or flow
+ * sample and flow_export_counters() for each set of interface counters.
+ * Flows are added up per exporter, addresses, ports, protocol and
+ * interfaces; interface counters are turned into the increase since the
+ * exporter last reported them.
+ *
+ * Every ndo_flow_export seconds of packet time stamps, the first
+ * datagram of the next interval is followed by a report on the one that
+ * ended: for each exporter, the datagrams, records and sequence numbers
+ * missed, then the flows with the most bytes and the interfaces with the
+ * most traffic.  The last interval is reported at exit.
+ *
+ * All the tables have a fixed size.  Flows that don't fit are only
+ * counted, interfaces and exporters that don't fit aren't followed.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "addrtoname.h"
+#include "addrtostr.h"
+#include "ipproto.h"
+
+#define FX_FLOWS	16384	/* flows kept per interval */
+#define FX_IFACES	4096	/* interfaces followed */
+#define FX_EXPORTERS	256	/* exporters followed */
+#define FX_TOP		10	/* flows and interfaces reported */
+
+struct fx_exporter {
+	u_int type;		/* FLOW_EXPORT_NETFLOW or FLOW_EXPORT_SFLOW */
+	u_char addr[16];
+	u_int addrlen;
+	uint32_t id;		/* NetFlow engine, sFlow sub-agent */
+	uint32_t seq;		/* sequence number expected next... */
+	u_char seq_valid;	/* ...if there was one */
+	/* For the current interval */
+	uint64_t datagrams;
+	uint64_t flows;
+	uint64_t counters;
+	uint64_t missed;	/* flows (NetFlow) or datagrams (sFlow) */
+};
+
+struct fx_flow_key {
+	u_char src[16];
+	u_char dst[16];
+	uint32_t input;
+	uint32_t output;
+	uint16_t sport;
+	uint16_t dport;
+	uint16_t exporter;	/* index into fx_exporters */
+	u_char proto;
+	u_char addrlen;
+};
+
+struct fx_flow {
+	struct fx_flow *hnext;	/* hash chain */
+	struct fx_flow_key key;
+	uint64_t packets;
+	uint64_t bytes;
+	uint64_t records;
+};
+
+struct fx_iface {
+	struct fx_iface *hnext;	/* hash chain */
+	u_int exporter;
+	uint32_t ifindex;
+	uint64_t last[FLOW_EXPORT_COUNTERS];	/* as last reported */
+	uint64_t delta[FLOW_EXPORT_COUNTERS];	/* increase this interval */
+	u_char updated;		/* delta is valid */
+};
+
+static struct fx_exporter fx_exporters[FX_EXPORTERS];
+static u_int fx_nexporters;
+static u_int fx_cur;		/* exporter of the current datagram... */
+static int fx_cur_valid;	/* ...if it's followed */
+
+static struct fx_flow *fx_flows;
+static u_int fx_nflows;
+static struct fx_flow **fx_flow_hash;
+static struct fx_iface *fx_ifaces;
+static u_int fx_nifaces;
+static struct fx_iface **fx_iface_hash;
+
+static time_t fx_start;		/* the current interval started then... */
+static int fx_started;		/* ...if there is one */
+
+/* Flows that didn't fit, this interval */
+static struct {
+	uint64_t flows;
+	uint64_t packets;
+	uint64_t bytes;
+} fx_dropped;
+
+/* The counters that are 64 bits wide; the others wrap at 2^32 */
+#define FX_COUNTER_IS_64(i) \
+	((i) == FLOW_EXPORT_IN_OCTETS || (i) == FLOW_EXPORT_OUT_OCTETS)
+
+/* A 32-bit counter this far up that goes back is taken to have wrapped */
+#define FX_COUNTER_WRAP_32	0xc0000000U
+
+static void
+fx_init(netdissect_options *ndo)
+{
+	fx_flows = calloc(FX_FLOWS, sizeof(*fx_flows));
+	fx_flow_hash = calloc(FX_FLOWS * 2, sizeof(*fx_flow_hash));
+	fx_ifaces = calloc(FX_IFACES, sizeof(*fx_ifaces));
+	fx_iface_hash = calloc(FX_IFACES * 2, sizeof(*fx_iface_hash));
+	if (fx_flows == NULL || fx_flow_hash == NULL || fx_ifaces == NULL ||
+	    fx_iface_hash == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+		    "%s: calloc", __func__);
+}
+
+static uint32_t
+fx_hash(const void *key, size_t len)
+{
+	const u_char *p = key;
+	uint32_t h = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static void
+fx_exporter_name(const struct fx_exporter *e, char *buf, size_t size)
+{
+	char addr[INET6_ADDRSTRLEN];
+
+	if (e->addrlen == 16)
+		addrtostr6(e->addr, addr, sizeof(addr));
+	else
+		addrtostr(e->addr, addr, sizeof(addr));
+	if (e->type == FLOW_EXPORT_NETFLOW)
+		snprintf(buf, size, "NetFlow %s engine %u/%u", addr,
+		    e->id >> 8, e->id & 0xff);
+	else
+		snprintf(buf, size, "sFlow %s agent-id %u", addr, e->id);
+}
+
+static void
+fx_endpoint(const u_char *addr, u_int addrlen, u_int port, char *buf,
+	    size_t size)
+{
+	char s[INET6_ADDRSTRLEN];
+
+	if (addrlen == 16)
+		addrtostr6(addr, s, sizeof(s));
+	else
+		addrtostr(addr, s, sizeof(s));
+	snprintf(buf, size, "%s.%u", s, port);
+}
+
+/*
+ * Keep the FX_TOP largest of "n" items in "top", largest first.
+ */
+static u_int
+fx_top_insert(const void **top, uint64_t *topval, u_int n, const void *p,
+	      uint64_t val)
+{
+	u_int i;
+
+	if (n == FX_TOP) {
+		if (val <= topval[FX_TOP - 1])
+			return (n);
+		n--;
+	}
+	for (i = n; i != 0 && topval[i - 1] < val; i--) {
+		top[i] = top[i - 1];
+		topval[i] = topval[i - 1];
+	}
+	top[i] = p;
+	topval[i] = val;
+	return (n + 1);
+}
+
+static void
+fx_print_flows(netdissect_options *ndo)
+{
+	const void *top[FX_TOP];
+	uint64_t topval[FX_TOP];
+	const struct fx_flow *f;
+	const char *p_name;
+	char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8];
+	char name[INET6_ADDRSTRLEN + 32];
+	u_int i, n;
+
+	n = 0;
+	for (i = 0; i < fx_nflows; i++)
+		n = fx_top_insert(top, topval, n, &fx_flows[i],
+		    fx_flows[i].bytes);
+	ND_PRINT(C_RESET, "\n\t  top %u of %u flow%s by bytes:", n, fx_nflows,
+	    PLURAL_SUFFIX(fx_nflows));
+	for (i = 0; i < n; i++) {
+		f = top[i];
+		ND_PRINT(C_RESET, "\n\t    ");
+		if (f->key.addrlen != 0) {
+			fx_endpoint(f->key.src, f->key.addrlen, f->key.sport,
+			    src, sizeof(src));
+			fx_endpoint(f->key.dst, f->key.addrlen, f->key.dport,
+			    dst, sizeof(dst));
+			ND_PRINT(C_RESET, "%s > %s ", src, dst);
+			if (!ndo->ndo_nflag &&
+			    (p_name = netdb_protoname(f->key.proto)) != NULL)
+				ND_PRINT(C_RESET, "%s, ", p_name);
+			else
+				ND_PRINT(C_RESET, "proto %u, ", f->key.proto);
+		}
+		ND_PRINT(C_RESET, "if %u > %u", f->key.input, f->key.output);
+		if (fx_nexporters > 1) {
+			fx_exporter_name(&fx_exporters[f->key.exporter], name,
+			    sizeof(name));
+			ND_PRINT(C_RESET, " via %s", name);
+		}
+		ND_PRINT(C_RESET, ": %" PRIu64 " byte%s, %" PRIu64 " packet%s",
+		    f->bytes, PLURAL_SUFFIX(f->bytes), f->packets,
+		    PLURAL_SUFFIX(f->packets));
+	}
+	if (fx_dropped.flows != 0)
+		ND_PRINT(C_RESET, "\n\t    %" PRIu64 " more flow records not kept: %" PRIu64 " byte%s, %" PRIu64 " packet%s",
+		    fx_dropped.flows, fx_dropped.bytes,
+		    PLURAL_SUFFIX(fx_dropped.bytes), fx_dropped.packets,
+		    PLURAL_SUFFIX(fx_dropped.packets));
+}
+
+/*
+ * One direction of an interface, from the FLOW_EXPORT_IN_* or
+ * FLOW_EXPORT_OUT_* counters, which are in the same order.
+ */
+static void
+fx_print_iface_dir(netdissect_options *ndo, const char *dir,
+		   const uint64_t *d)
+{
+	uint64_t packets;
+
+	packets = d[FLOW_EXPORT_IN_UCAST] + d[FLOW_EXPORT_IN_MCAST] +
+	    d[FLOW_EXPORT_IN_BCAST];
+	ND_PRINT(C_RESET, "%s %" PRIu64 " byte%s, %" PRIu64 " packet%s, %" PRIu64 " discard%s, %" PRIu64 " error%s",
+	    dir, d[FLOW_EXPORT_IN_OCTETS],
+	    PLURAL_SUFFIX(d[FLOW_EXPORT_IN_OCTETS]), packets,
+	    PLURAL_SUFFIX(packets), d[FLOW_EXPORT_IN_DISCARDS],
+	    PLURAL_SUFFIX(d[FLOW_EXPORT_IN_DISCARDS]),
+	    d[FLOW_EXPORT_IN_ERRORS], PLURAL_SUFFIX(d[FLOW_EXPORT_IN_ERRORS]));
+}
+
+static void
+fx_print_ifaces(netdissect_options *ndo)
+{
+	const void *top[FX_TOP];
+	uint64_t topval[FX_TOP];
+	const struct fx_iface *f;
+	char name[INET6_ADDRSTRLEN + 32];
+	u_int i, n, updated;
+
+	n = updated = 0;
+	for (i = 0; i < fx_nifaces; i++) {
+		f = &fx_ifaces[i];
+		if (!f->updated)
+			continue;
+		updated++;
+		n = fx_top_insert(top, topval, n, f,
+		    f->delta[FLOW_EXPORT_IN_OCTETS] +
+		    f->delta[FLOW_EXPORT_OUT_OCTETS]);
+	}
+	if (updated == 0)
+		return;
+	ND_PRINT(C_RESET, "\n\t  top %u of %u interface%s by bytes:", n,
+	    updated, PLURAL_SUFFIX(updated));
+	for (i = 0; i < n; i++) {
+		f = top[i];
+		fx_exporter_name(&fx_exporters[f->exporter], name,
+		    sizeof(name));
+		ND_PRINT(C_RESET, "\n\t    %s if %u: ", name, f->ifindex);
+		fx_print_iface_dir(ndo, "in", &f->delta[FLOW_EXPORT_IN_OCTETS]);
+		ND_PRINT(C_RESET, "; ");
+		fx_print_iface_dir(ndo, "out", &f->delta[FLOW_EXPORT_OUT_OCTETS]);
+	}
+}
+
+/*
+ * Report on the current interval and start the next one.
+ */
+static void
+fx_report(netdissect_options *ndo)
+{
+	struct fx_exporter *e;
+	struct fx_iface *f;
+	struct tm *tm;
+	char when[32], name[INET6_ADDRSTRLEN + 32];
+	uint64_t flows, counters;
+	u_int i, active;
+
+	flows = counters = 0;
+	active = 0;
+	for (i = 0; i < fx_nexporters; i++) {
+		e = &fx_exporters[i];
+		flows += e->flows;
+		counters += e->counters;
+		active += (e->datagrams != 0);
+	}
+	tm = gmtime(&fx_start);
+	if (tm == NULL || strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S",
+	    tm) == 0)
+		strcpy(when, "?");
+	ND_PRINT(C_RESET, "\tflow export summary, %u s from %s: %u exporter%s, %" PRIu64 " flow record%s, %" PRIu64 " counter record%s",
+	    ndo->ndo_flow_export, when, active, PLURAL_SUFFIX(active), flows,
+	    PLURAL_SUFFIX(flows), counters, PLURAL_SUFFIX(counters));
+	for (i = 0; i < fx_nexporters; i++) {
+		e = &fx_exporters[i];
+		if (e->datagrams == 0)
+			continue;
+		fx_exporter_name(e, name, sizeof(name));
+		ND_PRINT(C_RESET, "\n\t  %s: %" PRIu64 " datagram%s, %" PRIu64 " flow record%s, %" PRIu64 " counter record%s",
+		    name, e->datagrams, PLURAL_SUFFIX(e->datagrams),
+		    e->flows, PLURAL_SUFFIX(e->flows), e->counters,
+		    PLURAL_SUFFIX(e->counters));
+		if (e->missed != 0)
+			ND_PRINT(C_RESET, ", %" PRIu64 " %s%s missed", e->missed,
+			    e->type == FLOW_EXPORT_NETFLOW ?
+			    "flow record" : "datagram",
+			    PLURAL_SUFFIX(e->missed));
+	}
+	if (flows != 0)
+		fx_print_flows(ndo);
+	fx_print_ifaces(ndo);
+
+	for (i = 0; i < fx_nexporters; i++) {
+		e = &fx_exporters[i];
+		e->datagrams = e->flows = e->counters = e->missed = 0;
+	}
+	memset(fx_flow_hash, 0, FX_FLOWS * 2 * sizeof(*fx_flow_hash));
+	fx_nflows = 0;
+	memset(&fx_dropped, 0, sizeof(fx_dropped));
+	for (i = 0; i < fx_nifaces; i++) {
+		f = &fx_ifaces[i];
+		memset(f->delta, 0, sizeof(f->delta));
+		f->updated = 0;
+	}
+}
+
+/*
+ * The header of an export datagram; "seq" should be "incr" more in the
+ * next one, if "incr" isn't 0.  Reports on the interval that ended
+ * before it, if it's the first since.
+ */
+void
+flow_export_datagram(netdissect_options *ndo, u_int type,
+		     const u_char *addr, u_int addrlen, uint32_t id,
+		     uint32_t seq, uint32_t incr)
+{
+	struct fx_exporter *e;
+	time_t now;
+	u_int i;
+
+	if (fx_flows == NULL)
+		fx_init(ndo);
+	now = ndo->ndo_ts.tv_sec;
+	if (!fx_started) {
+		fx_start = now - now % ndo->ndo_flow_export;
+		fx_started = 1;
+	} else if (now - fx_start >= (time_t)ndo->ndo_flow_export) {
+		ND_PRINT(C_RESET, "\n");
+		fx_report(ndo);
+		fx_start = now - now % ndo->ndo_flow_export;
+	}
+
+	fx_cur_valid = 0;
+	if (addrlen > sizeof(e->addr))
+		return;
+	e = NULL;
+	for (i = 0; i < fx_nexporters; i++) {
+		e = &fx_exporters[i];
+		if (e->type == type && e->id == id && e->addrlen == addrlen &&
+		    memcmp(e->addr, addr, addrlen) == 0)
+			break;
+	}
+	if (i == fx_nexporters) {
+		if (fx_nexporters == FX_EXPORTERS)
+			return;
+		e = &fx_exporters[fx_nexporters++];
+		e->type = type;
+		memcpy(e->addr, addr, addrlen);
+		e->addrlen = addrlen;
+		e->id = id;
+	}
+	fx_cur = i;
+	fx_cur_valid = 1;
+
+	e->datagrams++;
+	if (incr != 0) {
+		/* Missed some unless it went back, as on a restart */
+		if (e->seq_valid && (int32_t)(seq - e->seq) > 0)
+			e->missed += seq - e->seq;
+		e->seq = seq + incr;
+		e->seq_valid = 1;
+	}
+}
+
+void
+flow_export_flow(netdissect_options *ndo _U_,
+		 const struct flow_export_flow *rec)
+{
+	struct fx_flow_key key;
+	struct fx_flow *f, **head;
+
+	if (!fx_cur_valid)
+		return;
+	fx_exporters[fx_cur].flows++;
+
+	memset(&key, 0, sizeof(key));
+	if (rec->addrlen <= sizeof(key.src)) {
+		memcpy(key.src, rec->src, rec->addrlen);
+		memcpy(key.dst, rec->dst, rec->addrlen);
+		key.addrlen = (u_char)rec->addrlen;
+		key.sport = rec->sport;
+		key.dport = rec->dport;
+		key.proto = (u_char)rec->proto;
+	}
+	key.input = rec->input;
+	key.output = rec->output;
+	key.exporter = (uint16_t)fx_cur;
+
+	head = &fx_flow_hash[fx_hash(&key, sizeof(key)) & (FX_FLOWS * 2 - 1)];
+	for (f = *head; f != NULL; f = f->hnext)
+		if (memcmp(&f->key, &key, sizeof(key)) == 0)
+			break;
+	if (f == NULL) {
+		if (fx_nflows == FX_FLOWS) {
+			fx_dropped.flows++;
+			fx_dropped.packets += rec->packets;
+			fx_dropped.bytes += rec->bytes;
+			return;
+		}
+		f = &fx_flows[fx_nflows++];
+		memset(f, 0, sizeof(*f));
+		memcpy(&f->key, &key, sizeof(key));
+		f->hnext = *head;
+		*head = f;
+	}
+	f->packets += rec->packets;
+	f->bytes += rec->bytes;
+	f->records++;
+}
+
+/*
+ * The increase of counter i from last to now.  A counter that goes back
+ * was reset, by a restart of the interface or the agent, and what it
+ * counted since isn't known; only a 32-bit one that was near the top
+ * of its range is taken to have wrapped instead.
+ */
+static uint64_t
+fx_counter_delta(u_int i, uint64_t last, uint64_t now)
+{
+	if (now >= last)
+		return (now - last);
+	if (!FX_COUNTER_IS_64(i) && last >= FX_COUNTER_WRAP_32)
+		return ((uint32_t)(now - last));
+	return (0);
+}
+
+void
+flow_export_counters(netdissect_options *ndo _U_, uint32_t ifindex,
+		     const uint64_t *counters)
+{
+	struct {
+		uint32_t exporter;
+		uint32_t ifindex;
+	} key;
+	struct fx_iface *f, **head;
+	u_int i;
+
+	if (!fx_cur_valid)
+		return;
+	fx_exporters[fx_cur].counters++;
+
+	key.exporter = fx_cur;
+	key.ifindex = ifindex;
+	head = &fx_iface_hash[fx_hash(&key, sizeof(key)) & (FX_IFACES * 2 - 1)];
+	for (f = *head; f != NULL; f = f->hnext)
+		if (f->exporter == fx_cur && f->ifindex == ifindex)
+			break;
+	if (f == NULL) {
+		/* The first report only gives the starting point */
+		if (fx_nifaces == FX_IFACES)
+			return;
+		f = &fx_ifaces[fx_nifaces++];
+		memset(f, 0, sizeof(*f));
+		f->exporter = fx_cur;
+		f->ifindex = ifindex;
+		memcpy(f->last, counters, sizeof(f->last));
+		f->hnext = *head;
+		*head = f;
+		return;
+	}
+	for (i = 0; i < FLOW_EXPORT_COUNTERS; i++) {
+		f->delta[i] += fx_counter_delta(i, f->last[i], counters[i]);
+		f->last[i] = counters[i];
+	}
+	f->updated = 1;
+}
+
+/*
+ * Report on the last interval, at exit.
+ */
+void
+flow_export_print(netdissect_options *ndo)
+{
+	if (!fx_started)
+		return;
+	fx_report(ndo);
+	ND_PRINT(C_RESET, "\n");
+}
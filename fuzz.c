@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * tcpdump-fuzz: fuzz target for the printers.
+ *
+ * Built with TCPDUMP_FUZZER defined and a fuzzing engine's flags (e.g.
+ * -fsanitize=fuzzer,address), it's a libFuzzer-style target whose input
+ * is one packet:
+ *
+ *	link-layer type (2 bytes, big-endian), options (1 byte), data
+ *
+ * where the low 2 bits of the options are the -v level and the next
+ * ones turn on -e and -x.  Otherwise it's a driver that runs savefiles
+ * through the same code, each packet whole and cut short at every
+ * length up to FUZZ_MAX_CUT, at each -v level, which is how "make
+ * fuzz-check" exercises the truncation checks with the test savefiles.
+ *
+ * Output is formatted and thrown away, as in tcpdump-bench.  Building
+ * with -DND_SPAN_DEBUG (see extract.h) makes the SPAN_ accessors abort
+ * on a read of uncaptured data, which the sanitizers might not catch
+ * when the packet buffer is larger than what was captured.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "extract.h"
+#include "print.h"
+
+#define FUZZ_MAX_CUT	256	/* driver: cut packets at up to this length */
+#define FUZZ_SNAPLEN	262144
+
+#define FUZZ_OPT_VFLAG	0x03
+#define FUZZ_OPT_EFLAG	0x04
+#define FUZZ_OPT_XFLAG	0x08
+
+static const char *program_name = "tcpdump-fuzz";
+static netdissect_options Ndo;
+static u_int fuzz_packets;
+
+/*
+ * Null output sink: do the formatting, drop the result.
+ */
+static int PRINTFLIKE(2, 3)
+fuzz_printf(netdissect_options *ndo _U_, FORMAT_STRING(const char *fmt), ...)
+{
+	char buf[1024];
+	va_list args;
+	int ret;
+
+	va_start(args, fmt);
+	ret = vsnprintf(buf, sizeof(buf), fmt, args);
+	va_end(args);
+	return (ret);
+}
+
+static void
+fuzz_init(void)
+{
+	netdissect_options *ndo = &Ndo;
+	char ebuf[PCAP_ERRBUF_SIZE];
+
+	if (nd_init(ebuf, sizeof(ebuf)) == -1) {
+		(void)fprintf(stderr, "%s: %s\n", program_name, ebuf);
+		exit(2);
+	}
+	memset(ndo, 0, sizeof(*ndo));
+	ndo_set_function_pointers(ndo);
+	ndo->ndo_printf = fuzz_printf;
+	ndo->program_name = program_name;
+	ndo->ndo_nflag = 1;
+	ndo->ndo_snaplen = FUZZ_SNAPLEN;
+	init_print(ndo, 0, 0);
+}
+
+/*
+ * Print the packet at data, caplen bytes of it captured out of len,
+ * as from a link of type dlt.  The data is copied to a buffer of
+ * exactly caplen bytes, so that the sanitizers catch a read past it.
+ */
+static void
+fuzz_one(u_int dlt, u_int opts, const u_char *data, u_int caplen, u_int len)
+{
+	netdissect_options *ndo = &Ndo;
+	struct pcap_pkthdr h;
+	u_char *buf;
+
+	buf = malloc(caplen ? caplen : 1);
+	if (buf == NULL)
+		return;
+	memcpy(buf, data, caplen);
+	memset(&h, 0, sizeof(h));
+	h.caplen = caplen;
+	h.len = len;
+
+	ndo->ndo_if_printer = get_if_printer(dlt);
+	ndo->ndo_vflag = opts & FUZZ_OPT_VFLAG;
+	ndo->ndo_eflag = (opts & FUZZ_OPT_EFLAG) != 0;
+	ndo->ndo_xflag = (opts & FUZZ_OPT_XFLAG) != 0;
+	pretty_print_packet(ndo, &h, buf, ++fuzz_packets);
+	free(buf);
+}
+
+#ifdef TCPDUMP_FUZZER
+int LLVMFuzzerTestOneInput(const uint8_t *, size_t);
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static int initialized;
+
+	if (!initialized) {
+		fuzz_init();
+		initialized = 1;
+	}
+	if (size < 3 || size - 3 > FUZZ_SNAPLEN)
+		return (0);
+	fuzz_one(EXTRACT_BE_U_2(data), EXTRACT_U_1(data + 2), data + 3,
+	    (u_int)(size - 3), (u_int)(size - 3));
+	return (0);
+}
+#else /* TCPDUMP_FUZZER */
+static void
+fuzz_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	u_int dlt = *(u_int *)user;
+	u_int cut, v;
+
+	for (v = 0; v <= FUZZ_OPT_VFLAG; v++) {
+		fuzz_one(dlt, v, sp, h->caplen, h->len);
+		for (cut = 0; cut < h->caplen && cut <= FUZZ_MAX_CUT; cut++)
+			fuzz_one(dlt, v, sp, cut, h->len);
+	}
+}
+
+int
+main(int argc, char **argv)
+{
+	char ebuf[PCAP_ERRBUF_SIZE];
+	pcap_t *pd;
+	u_int dlt;
+	int i;
+
+	if (argc < 2) {
+		(void)fprintf(stderr, "Usage: %s file ...\n", program_name);
+		return (2);
+	}
+	fuzz_init();
+	for (i = 1; i < argc; i++) {
+		pd = pcap_open_offline(argv[i], ebuf);
+		if (pd == NULL) {
+			(void)fprintf(stderr, "%s: skipping %s: %s\n",
+			    program_name, argv[i], ebuf);
+			continue;
+		}
+		dlt = (u_int)pcap_datalink(pd);
+		if (pcap_loop(pd, -1, fuzz_packet, (u_char *)&dlt) == -1)
+			(void)fprintf(stderr, "%s: %s: %s\n", program_name,
+			    argv[i], pcap_geterr(pd));
+		pcap_close(pd);
+	}
+	(void)printf("%u packets printed\n", fuzz_packets);
+	nd_cleanup();
+	return (0);
+}
+#endif /* TCPDUMP_FUZZER */
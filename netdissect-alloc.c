@@ -23,6 +23,9 @@
 
 static void nd_add_alloc_list(netdissect_options *, nd_mem_chunk_t *);
 
+/* Number of nd_malloc() calls so far, for tcpdump-bench */
+static u_int nd_malloc_calls;
+
 /*
  * nd_free_all() is intended to be used after a packet printing
  */
@@ -43,6 +46,9 @@ void *
 nd_malloc(netdissect_options *ndo, size_t size)
 {
 	nd_mem_chunk_t *chunkp = malloc(sizeof(nd_mem_chunk_t) + size);
+	nd_malloc_calls++;
+	if (ndo->ndo_profile)
+		nd_profile_alloc(ndo);
 	if (chunkp == NULL)
 		return NULL;
 	nd_add_alloc_list(ndo, chunkp);
@@ -62,3 +68,10 @@ nd_free_all(netdissect_options *ndo)
 	}
 	ndo->ndo_last_mem_p = NULL;
 }
+
+/* Return the number of nd_malloc() calls made so far */
+u_int
+nd_malloc_count(void)
+{
+	return nd_malloc_calls;
+}
@@ -28,5 +28,6 @@ typedef struct nd_mem_chunk {
 
 void * nd_malloc(netdissect_options *, size_t);
 void nd_free_all(netdissect_options *);
+u_int nd_malloc_count(void);
 
 #endif /* netdissect_alloc_h */
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Dissector registry (--disable-dissector).
+ *
+ * Each demultiplexing point lists the dissectors it can hand off to
+ * and, at startup, registers them into a table indexed directly by the
+ * Ethernet type, IP protocol or port, so that a packet costs one load
+ * however many dissectors there are.  A disabled dissector is simply
+ * not registered, and its packets get the treatment of an unknown
+ * type, protocol or port.
+ *
+ * A dissector is named after its printer, print-name.c; a name can
+ * cover several demultiplexing points ("smb" is NetBIOS over UDP and
+ * TCP and SMB over TCP).
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+
+#define ND_DISABLED_MAX	64	/* --disable-dissector options */
+
+static struct {
+	const char *name;
+	int known;		/* a demultiplexer registers it */
+} nd_disabled[ND_DISABLED_MAX];
+static u_int nd_ndisabled;
+
+/*
+ * Disable the dissector "name"; returns -1 if too many are.
+ */
+int
+nd_disable_dissector(const char *name)
+{
+	if (nd_ndisabled == ND_DISABLED_MAX)
+		return (-1);
+	nd_disabled[nd_ndisabled++].name = name;
+	return (0);
+}
+
+/*
+ * After init_dissectors(), a disabled dissector that no demultiplexer
+ * knows about, if any.
+ */
+const char *
+nd_unknown_dissector(void)
+{
+	u_int i;
+
+	for (i = 0; i < nd_ndisabled; i++)
+		if (!nd_disabled[i].known)
+			return (nd_disabled[i].name);
+	return (NULL);
+}
+
+int
+nd_dissector_enabled(const char *name)
+{
+	int enabled = 1;
+	u_int i;
+
+	for (i = 0; i < nd_ndisabled; i++) {
+		if (strcmp(nd_disabled[i].name, name) == 0) {
+			nd_disabled[i].known = 1;
+			enabled = 0;
+		}
+	}
+	return (enabled);
+}
+
+void
+nd_port_table_init(struct nd_port_table *t, const struct nd_port_dissector *d,
+		   u_int n)
+{
+	u_int i, port;
+
+	memset(t, 0, sizeof(*t));
+	for (i = 0; i < n; i++) {
+		if (!nd_dissector_enabled(d[i].name))
+			continue;
+		for (port = d[i].lo; port <= d[i].hi; port++) {
+			if ((d[i].dir & ND_PORT_SRC) &&
+			    (t->src[port] == 0 || d[i].id < t->src[port]))
+				t->src[port] = d[i].id;
+			if ((d[i].dir & ND_PORT_DST) &&
+			    (t->dst[port] == 0 || d[i].id < t->dst[port]))
+				t->dst[port] = d[i].id;
+		}
+	}
+}
+
+/*
+ * Set disabled[key] for the keys of the disabled dissectors.
+ */
+void
+nd_key_table_init(uint8_t *disabled, const struct nd_key_dissector *d,
+		  u_int n)
+{
+	u_int i;
+
+	for (i = 0; i < n; i++)
+		if (!nd_dissector_enabled(d[i].name))
+			disabled[d[i].key] = 1;
+}
+
+void
+init_dissectors(void)
+{
+	ether_init_dissectors();
+	ip_demux_init_dissectors();
+	tcp_init_dissectors();
+	udp_init_dissectors();
+#ifndef ENABLE_SMB
+	/* not built in, which is as good as disabled */
+	(void)nd_dissector_enabled("smb");
+#endif
+}
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Per-dissector profiling (--profile-dissectors).
+ *
+ * Unlike the -finstrument-functions support, this is always compiled
+ * in and costs a test of ndo_profile per instrumented call when it's
+ * off.  When it's on, each instrumented call reads a monotonic clock on
+ * entry and exit and charges the elapsed time to its slot, both in
+ * total and net of the instrumented calls it makes itself ("self").
+ * nd_malloc() calls are charged to the innermost open call, so that
+ * tcpdump-bench -p can tell which dissectors allocate.
+ *
+ * A printer that runs off the end of the captured data longjmps back
+ * to pretty_print_packet(), skipping the exits of everything it was
+ * called from; nd_profile_unwind() closes those frames.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "ethertype.h"
+#include "ipproto.h"
+
+#define ND_PROFILE_SLOTS	1024	/* a power of 2 */
+#define ND_PROFILE_DEPTH	32	/* deepest nesting tracked */
+
+struct nd_profile_slot {
+	uint32_t id;		/* (layer << 16 | key) + 1, 0 if unused */
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t total_ns;	/* including instrumented callees */
+	uint64_t self_ns;	/* excluding them */
+	uint64_t allocs;	/* nd_malloc() calls, excluding them */
+};
+
+struct nd_profile_frame {
+	struct nd_profile_slot *slot;
+	uint64_t start;
+	uint64_t child_ns;
+};
+
+static int nd_profile_on;
+static struct nd_profile_slot nd_profile_slots[ND_PROFILE_SLOTS];
+static u_int nd_profile_used;
+static struct nd_profile_slot nd_profile_overflow;	/* table full */
+static struct nd_profile_frame nd_profile_stack[ND_PROFILE_DEPTH];
+static u_int nd_profile_depth;
+static u_int nd_profile_untracked;	/* frames nested too deep */
+
+/*
+ * Monotonic clock, in nanoseconds; also used by tcpdump-bench.
+ */
+uint64_t
+nd_profile_now(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	if (freq.QuadPart == 0)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000 +
+	    (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000 /
+	    freq.QuadPart;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+void
+nd_profile_init(void)
+{
+	nd_profile_on = 1;
+}
+
+static struct nd_profile_slot *
+nd_profile_slot(u_int layer, u_int key)
+{
+	uint32_t id = ((layer << 16) | (key & 0xffff)) + 1;
+	u_int i, n;
+
+	i = (id * 2654435761U) >> 22;	/* top log2(ND_PROFILE_SLOTS) bits */
+	for (n = 0; n < ND_PROFILE_SLOTS; n++) {
+		if (nd_profile_slots[i].id == id)
+			return &nd_profile_slots[i];
+		if (nd_profile_slots[i].id == 0) {
+			/* keep the table at most 3/4 full */
+			if (nd_profile_used >= ND_PROFILE_SLOTS / 4 * 3)
+				break;
+			nd_profile_used++;
+			nd_profile_slots[i].id = id;
+			return &nd_profile_slots[i];
+		}
+		i = (i + 1) & (ND_PROFILE_SLOTS - 1);
+	}
+	return &nd_profile_overflow;
+}
+
+void
+nd_profile_enter(netdissect_options *ndo _U_, u_int layer, u_int key,
+		 u_int len)
+{
+	struct nd_profile_frame *fp;
+
+	if (nd_profile_depth >= ND_PROFILE_DEPTH) {
+		nd_profile_untracked++;
+		return;
+	}
+	fp = &nd_profile_stack[nd_profile_depth++];
+	fp->slot = nd_profile_slot(layer, key);
+	fp->slot->calls++;
+	fp->slot->bytes += len;
+	fp->child_ns = 0;
+	fp->start = nd_profile_now();
+}
+
+static void
+nd_profile_pop(uint64_t now)
+{
+	struct nd_profile_frame *fp;
+	uint64_t elapsed;
+
+	fp = &nd_profile_stack[--nd_profile_depth];
+	elapsed = now - fp->start;
+	fp->slot->total_ns += elapsed;
+	fp->slot->self_ns += elapsed - fp->child_ns;
+	if (nd_profile_depth != 0)
+		nd_profile_stack[nd_profile_depth - 1].child_ns += elapsed;
+}
+
+void
+nd_profile_exit(netdissect_options *ndo _U_)
+{
+	if (nd_profile_untracked != 0) {
+		nd_profile_untracked--;
+		return;
+	}
+	if (nd_profile_depth != 0)
+		nd_profile_pop(nd_profile_now());
+}
+
+/*
+ * Charge an nd_malloc() call to the innermost open frame, or to the
+ * overflow slot if it's nested too deep or made outside any.
+ */
+void
+nd_profile_alloc(netdissect_options *ndo _U_)
+{
+	if (nd_profile_untracked != 0 || nd_profile_depth == 0)
+		nd_profile_overflow.allocs++;
+	else
+		nd_profile_stack[nd_profile_depth - 1].slot->allocs++;
+}
+
+/*
+ * Close the frames left open by a longjmp out of a printer.
+ */
+void
+nd_profile_unwind(netdissect_options *ndo _U_)
+{
+	uint64_t now;
+
+	nd_profile_untracked = 0;
+	if (nd_profile_depth == 0)
+		return;
+	now = nd_profile_now();
+	while (nd_profile_depth != 0)
+		nd_profile_pop(now);
+}
+
+static void
+nd_profile_name(const struct nd_profile_slot *sp, char *buf, size_t bufsize)
+{
+	u_int layer, key;
+	const char *name;
+
+	if (sp == &nd_profile_overflow) {
+		strlcpy(buf, "(other)", bufsize);
+		return;
+	}
+	layer = (sp->id - 1) >> 16;
+	key = (sp->id - 1) & 0xffff;
+	switch (layer) {
+
+	case ND_PROFILE_LINK:
+		name = pcap_datalink_val_to_name(key);
+		if (name != NULL)
+			snprintf(buf, bufsize, "link/%s", name);
+		else
+			snprintf(buf, bufsize, "link/DLT %u", key);
+		break;
+
+	case ND_PROFILE_ETHERTYPE:
+		snprintf(buf, bufsize, "ethertype/%s",
+		    tok2str(ethertype_values, "0x%04x", key));
+		break;
+
+	case ND_PROFILE_IP:
+		snprintf(buf, bufsize, "ip/%s",
+		    tok2str(ipproto_values, "%u", key));
+		break;
+
+	case ND_PROFILE_UDP:
+		strlcpy(buf, "udp", bufsize);
+		break;
+
+	default:
+		snprintf(buf, bufsize, "layer %u/%u", layer, key);
+		break;
+	}
+}
+
+static int
+nd_profile_cmp(const void *a, const void *b)
+{
+	const struct nd_profile_slot *sa = *(const struct nd_profile_slot * const *)a;
+	const struct nd_profile_slot *sb = *(const struct nd_profile_slot * const *)b;
+
+	if (sa->self_ns != sb->self_ns)
+		return (sa->self_ns < sb->self_ns) ? 1 : -1;
+	if (sa->calls != sb->calls)
+		return (sa->calls < sb->calls) ? 1 : -1;
+	return (sa->id < sb->id) ? -1 : (sa->id > sb->id);
+}
+
+/*
+ * Print the profile, the dissector with the most self time first.
+ * Times are in microseconds.
+ */
+void
+nd_profile_print(FILE *f)
+{
+	const struct nd_profile_slot *sorted[ND_PROFILE_SLOTS + 1];
+	const struct nd_profile_slot *sp;
+	char name[64];
+	u_int i, n;
+
+	if (!nd_profile_on)
+		return;
+	n = 0;
+	for (i = 0; i < ND_PROFILE_SLOTS; i++) {
+		if (nd_profile_slots[i].calls != 0)
+			sorted[n++] = &nd_profile_slots[i];
+	}
+	if (nd_profile_overflow.calls != 0 || nd_profile_overflow.allocs != 0)
+		sorted[n++] = &nd_profile_overflow;
+	qsort(sorted, n, sizeof(sorted[0]), nd_profile_cmp);
+
+	(void)fprintf(f, "Dissector profile:\n");
+	(void)fprintf(f, "%12s %14s %12s %12s %8s %10s  %s\n",
+	    "calls", "bytes", "total-us", "self-us", "ns/call", "allocs",
+	    "dissector");
+	for (i = 0; i < n; i++) {
+		sp = sorted[i];
+		nd_profile_name(sp, name, sizeof(name));
+		(void)fprintf(f,
+		    "%12" PRIu64 " %14" PRIu64 " %12" PRIu64 " %12" PRIu64
+		    " %8" PRIu64 " %10" PRIu64 "  %s\n",
+		    sp->calls, sp->bytes, sp->total_ns / 1000,
+		    sp->self_ns / 1000,
+		    sp->calls != 0 ? sp->self_ns / sp->calls : 0,
+		    sp->allocs, name);
+	}
+}
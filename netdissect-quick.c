@@ -0,0 +1,232 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Quick output (-q) of the common case, TCP and UDP over IPv4 and IPv6
+ * over Ethernet, without going through the printers.
+ *
+ * All -q prints of such a packet is its addresses, ports, protocol and
+ * length, so this reads just those, checking lengths itself as
+ * netdissect-slice.c does, and prints the line in one go.  Anything
+ * the printers would print differently -- another protocol, a later
+ * fragment, IPv6 extension headers, a truncated or malformed header --
+ * is left to them, as is everything when an option adds to the output;
+ * the printers define what's printed, and this must print exactly that.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "addrtoname.h"
+#include "extract.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "ip.h"
+#include "ip6.h"
+#include "tcp.h"
+#include "udp.h"
+
+/* What -q prints of a TCP or UDP header */
+struct quick_transport {
+	uint16_t sport;
+	uint16_t dport;
+	u_int length;		/* payload length */
+	u_int ulen;		/* UDP length field, less the header */
+	int bad_length;		/* UDP length past the end of the datagram */
+};
+
+/*
+ * Called by init_print(), once the options are set: use the quick path
+ * only if the printers would print nothing but what it does.
+ */
+void
+nd_quick_init(netdissect_options *ndo)
+{
+	ndo->ndo_quick = ndo->ndo_qflag && !ndo->ndo_vflag &&
+	    !ndo->ndo_eflag && !ndo->ndo_packettype && !ndo->ndo_profile &&
+	    !ndo->ndo_tcp_analysis &&
+	    nd_dissector_enabled("ip") && nd_dissector_enabled("ip6") &&
+	    nd_dissector_enabled("tcp") && nd_dissector_enabled("udp");
+}
+
+/*
+ * Get what's printed of the TCP or UDP header at bp, of which caplen
+ * bytes were captured out of length; returns 0 if the printers would
+ * print anything more, or less.
+ */
+static int
+quick_transport(u_int nh, const u_char *bp, u_int length, u_int caplen,
+		int fragmented, struct quick_transport *qt)
+{
+	u_int hlen;
+
+	switch (nh) {
+
+	case IPPROTO_TCP:
+		if (caplen < sizeof(struct tcphdr))
+			return (0);
+		hlen = (EXTRACT_U_1(bp + offsetof(struct tcphdr, th_offx2)) >>
+		    4) * 4;
+		if (hlen < sizeof(struct tcphdr) || hlen > length)
+			return (0);
+		qt->length = length - hlen;
+		break;
+
+	case IPPROTO_UDP:
+		if (caplen < sizeof(struct udphdr) ||
+		    length < sizeof(struct udphdr))
+			return (0);
+		qt->ulen = EXTRACT_BE_U_2(bp + offsetof(struct udphdr, uh_ulen));
+		if (qt->ulen < sizeof(struct udphdr))
+			return (0);
+		qt->ulen -= sizeof(struct udphdr);
+		length -= sizeof(struct udphdr);
+		if (qt->ulen < length)
+			length = qt->ulen;
+		qt->length = length;
+		/* not if the rest of it is in later fragments */
+		qt->bad_length = qt->ulen > length && !fragmented;
+		break;
+
+	default:
+		return (0);
+	}
+	qt->sport = EXTRACT_BE_U_2(bp);
+	qt->dport = EXTRACT_BE_U_2(bp + 2);
+	return (1);
+}
+
+static void
+quick_transport_print(netdissect_options *ndo, const char *ip,
+		      const char *src, const char *dst, u_int nh,
+		      const struct quick_transport *qt)
+{
+	if (nh == IPPROTO_TCP)
+		ND_PRINT(C_RESET, "%s %s.%s > %s.%s: tcp %u", ip,
+			 src, tcpport_string(ndo, qt->sport),
+			 dst, tcpport_string(ndo, qt->dport), qt->length);
+	else if (qt->bad_length)
+		ND_PRINT(C_RESET, "%s %s.%s > %s.%s: UDP, bad length %u > %u",
+			 ip, src, udpport_string(ndo, qt->sport),
+			 dst, udpport_string(ndo, qt->dport),
+			 qt->ulen, qt->length);
+	else
+		ND_PRINT(C_RESET, "%s %s.%s > %s.%s: UDP, length %u", ip,
+			 src, udpport_string(ndo, qt->sport),
+			 dst, udpport_string(ndo, qt->dport), qt->ulen);
+}
+
+static int
+quick_ip4(netdissect_options *ndo, const u_char *bp, u_int length,
+	  u_int caplen)
+{
+	struct quick_transport qt;
+	u_int hlen, len, off;
+
+	if (caplen < sizeof(struct ip) || length < sizeof(struct ip))
+		return (0);
+	if ((EXTRACT_U_1(bp) >> 4) != 4)
+		return (0);
+	hlen = (EXTRACT_U_1(bp) & 0x0f) * 4;
+	len = EXTRACT_BE_U_2(bp + offsetof(struct ip, ip_len));
+	if (hlen < sizeof(struct ip) || len < hlen || length < len ||
+	    caplen < hlen)
+		return (0);
+	off = EXTRACT_BE_U_2(bp + offsetof(struct ip, ip_off));
+	if ((off & IP_OFFMASK) != 0)
+		return (0);
+	/* what's past the IP datagram isn't looked at */
+	if (caplen > len)
+		caplen = len;
+	if (!quick_transport(EXTRACT_U_1(bp + offsetof(struct ip, ip_p)),
+	    bp + hlen, len - hlen, caplen - hlen, off & IP_MF, &qt))
+		return (0);
+	quick_transport_print(ndo, "IP",
+	    ipaddr_string(ndo, bp + offsetof(struct ip, ip_src)),
+	    ipaddr_string(ndo, bp + offsetof(struct ip, ip_dst)),
+	    EXTRACT_U_1(bp + offsetof(struct ip, ip_p)), &qt);
+	return (1);
+}
+
+static int
+quick_ip6(netdissect_options *ndo, const u_char *bp, u_int length,
+	  u_int caplen)
+{
+	struct quick_transport qt;
+	u_int len, nh;
+
+	if (caplen < sizeof(struct ip6_hdr) || length < sizeof(struct ip6_hdr))
+		return (0);
+	if ((EXTRACT_U_1(bp) >> 4) != 6)
+		return (0);
+	/* a payload length of 0 means a Jumbo Payload option */
+	len = EXTRACT_BE_U_2(bp + offsetof(struct ip6_hdr, ip6_plen));
+	if (len == 0)
+		return (0);
+	len += sizeof(struct ip6_hdr);
+	if (length < len)
+		return (0);
+	if (caplen > len)
+		caplen = len;
+	nh = EXTRACT_U_1(bp + offsetof(struct ip6_hdr, ip6_nxt));
+	if (!quick_transport(nh, bp + sizeof(struct ip6_hdr),
+	    len - sizeof(struct ip6_hdr), caplen - sizeof(struct ip6_hdr),
+	    0, &qt))
+		return (0);
+	quick_transport_print(ndo, "IP6",
+	    ip6addr_string(ndo, bp + offsetof(struct ip6_hdr, ip6_src)),
+	    ip6addr_string(ndo, bp + offsetof(struct ip6_hdr, ip6_dst)),
+	    nh, &qt);
+	return (1);
+}
+
+/*
+ * Print the Ethernet frame p as -q would, if it's one the quick path
+ * handles; returns the length of the Ethernet header, with any VLAN
+ * tags, if so and 0 if it's left to the printers.
+ */
+u_int
+nd_quick_ether_print(netdissect_options *ndo, const u_char *p, u_int length,
+		     u_int caplen)
+{
+	const u_char *l3 = p;
+	u_int l3len = caplen;
+	u_int hdrlen;
+	int printed;
+
+	switch (nd_link_ethertype(DLT_EN10MB, &l3, &l3len)) {
+
+	case ETHERTYPE_IP:
+		hdrlen = (u_int)(l3 - p);
+		printed = quick_ip4(ndo, l3, length - hdrlen, l3len);
+		break;
+
+	case ETHERTYPE_IPV6:
+		hdrlen = (u_int)(l3 - p);
+		printed = quick_ip6(ndo, l3, length - hdrlen, l3len);
+		break;
+
+	default:
+		return (0);
+	}
+	return (printed ? hdrlen : 0);
+}
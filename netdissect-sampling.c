@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Choosing which packets to print, before they are dissected.
+ *
+ * --print-flow-sampling N keeps the packets of 1 in N flows, chosen by
+ * a hash of the protocol, addresses and ports that is the same in both
+ * directions, so that the conversations that are printed are printed
+ * whole.  Only the headers needed for the hash are looked at, without
+ * the printers' bounds checking machinery; packets that aren't IPv4 or
+ * IPv6 over a link layer understood here are kept 1 in N by count.
+ *
+ * --print-rate-limit R[,B] then lets at most R packets per second,
+ * with bursts of up to B, through a token bucket driven by the packet
+ * time stamps, so that it works the same on a savefile as live.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <string.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "extract.h"
+#include "ethertype.h"
+#include "ipproto.h"
+
+#define TOKEN	1000000		/* a token, in microsecond-packets */
+
+static struct nd_sampling_stats nd_sampling_stats;
+static u_int nd_sampling_nonflow;	/* packets with no flow seen */
+static uint64_t nd_sampling_tokens;	/* in 1/TOKEN of a token */
+static uint64_t nd_sampling_last_us;	/* time of the last refill */
+static int nd_sampling_started;
+
+/*
+ * Find the IPv4 or IPv6 header after the link-layer header; returns
+ * the IP version, or 0 if there's none.
+ */
+static u_int
+nd_sampling_link(u_int dlt, const u_char **pp, u_int *lenp)
+{
+	switch (nd_link_ethertype(dlt, pp, lenp)) {
+
+	case ETHERTYPE_IP:
+		return 4;
+
+	case ETHERTYPE_IPV6:
+		return 6;
+
+	default:
+		return 0;
+	}
+}
+
+static uint32_t
+nd_sampling_fnv(uint32_t h, const u_char *p, u_int len)
+{
+	while (len-- != 0) {
+		h ^= *p++;
+		h *= 16777619;
+	}
+	return h;
+}
+
+/*
+ * Hash the flow the packet belongs to, the same way for both directions;
+ * returns 0 if it isn't IP or is too short to tell.  Fragments are
+ * hashed without ports, as all but the first have none.
+ */
+static int
+nd_sampling_flow_hash(u_int dlt, const u_char *p, u_int len, uint32_t *hashp)
+{
+	const u_char *src, *dst, *ports = NULL;
+	u_int addrlen, hdrlen, nh;
+	u_char proto, portbuf[4];
+	int frag = 0;
+	uint32_t h;
+
+	switch (nd_sampling_link(dlt, &p, &len)) {
+
+	case 4:
+		if (len < 20 || (p[0] >> 4) != 4)
+			return 0;
+		hdrlen = (p[0] & 0x0f) * 4;
+		if (hdrlen < 20 || len < hdrlen)
+			return 0;
+		proto = p[9];
+		src = p + 12;
+		dst = p + 16;
+		addrlen = 4;
+		frag = (EXTRACT_BE_U_2(p + 6) & 0x3fff) != 0;
+		break;
+
+	case 6:
+		if (len < 40 || (p[0] >> 4) != 6)
+			return 0;
+		nh = p[6];
+		src = p + 8;
+		dst = p + 24;
+		addrlen = 16;
+		hdrlen = 40;
+		for (;;) {
+			if (nh == IPPROTO_HOPOPTS || nh == IPPROTO_ROUTING ||
+			    nh == IPPROTO_DSTOPTS) {
+				if (len < hdrlen + 2)
+					break;
+				nh = p[hdrlen];
+				hdrlen += (p[hdrlen + 1] + 1) * 8;
+			} else if (nh == IPPROTO_FRAGMENT) {
+				if (len < hdrlen + 8)
+					break;
+				nh = p[hdrlen];
+				if ((EXTRACT_BE_U_2(p + hdrlen + 2) & 0xfff9) != 0)
+					frag = 1;
+				hdrlen += 8;
+			} else
+				break;
+		}
+		proto = (u_char)nh;
+		break;
+
+	default:
+		return 0;
+	}
+
+	if (!frag && len >= hdrlen + 4 &&
+	    (proto == IPPROTO_TCP || proto == IPPROTO_UDP ||
+	     proto == IPPROTO_SCTP || proto == IPPROTO_DCCP))
+		ports = p + hdrlen;
+
+	/* put the lower address (and its port) first */
+	if (memcmp(src, dst, addrlen) > 0 ||
+	    (ports != NULL && memcmp(src, dst, addrlen) == 0 &&
+	     memcmp(ports, ports + 2, 2) > 0)) {
+		const u_char *t = src;
+
+		src = dst;
+		dst = t;
+		if (ports != NULL) {
+			portbuf[0] = ports[2];
+			portbuf[1] = ports[3];
+			portbuf[2] = ports[0];
+			portbuf[3] = ports[1];
+			ports = portbuf;
+		}
+	}
+
+	h = nd_sampling_fnv(2166136261U, &proto, 1);
+	h = nd_sampling_fnv(h, src, addrlen);
+	h = nd_sampling_fnv(h, dst, addrlen);
+	if (ports != NULL)
+		h = nd_sampling_fnv(h, ports, 4);
+	/* mix, so that every bit counts for h % N */
+	h ^= h >> 16;
+	h *= 0x85ebca6b;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35;
+	h ^= h >> 16;
+	*hashp = h;
+	return 1;
+}
+
+static int
+nd_sampling_rate_ok(netdissect_options *ndo, const struct pcap_pkthdr *h)
+{
+	uint64_t now, burst, elapsed, fill;
+
+	now = (uint64_t)h->ts.tv_sec * 1000000 + h->ts.tv_usec;
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		now = (uint64_t)h->ts.tv_sec * 1000000 + h->ts.tv_usec / 1000;
+#endif
+
+	burst = (uint64_t)ndo->ndo_print_burst * TOKEN;
+	if (!nd_sampling_started) {
+		nd_sampling_started = 1;
+		nd_sampling_tokens = burst;
+		nd_sampling_last_us = now;
+	} else if (now > nd_sampling_last_us) {
+		/*
+		 * Time going backwards doesn't refill the bucket; a long
+		 * gap fills it, and no more, lest the product overflow.
+		 */
+		elapsed = now - nd_sampling_last_us;
+		fill = (burst + ndo->ndo_print_rate - 1) / ndo->ndo_print_rate;
+		if (elapsed > fill)
+			elapsed = fill;
+		nd_sampling_tokens += elapsed * ndo->ndo_print_rate;
+		if (nd_sampling_tokens > burst)
+			nd_sampling_tokens = burst;
+		nd_sampling_last_us = now;
+	}
+
+	if (nd_sampling_tokens < TOKEN)
+		return 0;
+	nd_sampling_tokens -= TOKEN;
+	return 1;
+}
+
+/*
+ * Returns 1 if the packet is to be printed.
+ */
+int
+nd_print_sample(netdissect_options *ndo, u_int dlt,
+		const struct pcap_pkthdr *h, const u_char *sp)
+{
+	uint32_t hash;
+	u_int n = (u_int)ndo->ndo_print_flow_sampling;
+
+	if (n > 1) {
+		if (nd_sampling_flow_hash(dlt, sp, h->caplen, &hash)) {
+			if (hash % n != 0) {
+				nd_sampling_stats.flow_skipped++;
+				return 0;
+			}
+		} else if (nd_sampling_nonflow++ % n != 0) {
+			nd_sampling_stats.flow_skipped++;
+			return 0;
+		}
+	}
+	if (ndo->ndo_print_rate != 0 && !nd_sampling_rate_ok(ndo, h)) {
+		nd_sampling_stats.rate_suppressed++;
+		return 0;
+	}
+	return 1;
+}
+
+void
+nd_sampling_get_stats(struct nd_sampling_stats *stats)
+{
+	*stats = nd_sampling_stats;
+}
@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Finding where a packet's headers end, for --slice-headers, which
+ * writes packets to savefiles with the payload cut off.
+ *
+ * This is a walk over the headers only, not dissection: it uses the
+ * header layouts the printers use, checking lengths itself rather than
+ * going through the printers' bounds checking machinery, and stops at
+ * the first header it doesn't know.  Tunnels are followed, so that the
+ * headers of the encapsulated packets are kept: VLAN tags, MPLS, IP in
+ * IP, GRE, VXLAN and Geneve.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stddef.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "extract.h"
+#include "af.h"
+#include "ethertype.h"
+#include "ipproto.h"
+#include "ip.h"
+#include "ip6.h"
+#include "mpls.h"
+#include "tcp.h"
+#include "udp.h"
+
+#define ETHER_HDRLEN	14
+#define VXLAN_HDRLEN	8
+#define GENEVE_HDRLEN	8
+#define GRE_HDRLEN	4
+
+/* GRE flags, as in print-gre.c */
+#define GRE_CP		0x8000		/* checksum present */
+#define GRE_RP		0x4000		/* routing present */
+#define GRE_KP		0x2000		/* key present */
+#define GRE_SP		0x1000		/* sequence# present */
+#define GRE_VERS_MASK	0x0007
+
+/* more tunnels than this in one packet and we stop following them */
+#define MAX_DEPTH	8
+
+static u_int nd_headers_ethertype(u_int, const u_char *, u_int, u_int, int);
+
+/*
+ * Skip the link-layer header, and any VLAN tags after it; returns the
+ * Ethernet type of what follows, or 0 if it isn't known.
+ */
+u_int
+nd_link_ethertype(u_int dlt, const u_char **pp, u_int *lenp)
+{
+	const u_char *p = *pp;
+	u_int len = *lenp;
+	u_int type, hdrlen;
+	uint32_t family;
+
+	switch (dlt) {
+
+	case DLT_EN10MB:
+		if (len < ETHER_HDRLEN)
+			return 0;
+		type = EXTRACT_BE_U_2(p + 12);
+		hdrlen = ETHER_HDRLEN;
+		while ((type == ETHERTYPE_8021Q || type == ETHERTYPE_8021QinQ ||
+		    type == ETHERTYPE_8021Q9100) && len >= hdrlen + 4) {
+			type = EXTRACT_BE_U_2(p + hdrlen + 2);
+			hdrlen += 4;
+		}
+		if (type <= MAX_ETHERNET_LENGTH_VAL)
+			return 0;	/* 802.3 */
+		break;
+
+#ifdef DLT_LINUX_SLL
+	case DLT_LINUX_SLL:
+		if (len < 16)
+			return 0;
+		type = EXTRACT_BE_U_2(p + 14);
+		hdrlen = 16;
+		break;
+#endif
+
+#ifdef DLT_LINUX_SLL2
+	case DLT_LINUX_SLL2:
+		if (len < 20)
+			return 0;
+		type = EXTRACT_BE_U_2(p);
+		hdrlen = 20;
+		break;
+#endif
+
+	case DLT_NULL:
+#ifdef DLT_LOOP
+	case DLT_LOOP:
+#endif
+		/* host or network byte order, whichever makes sense */
+		if (len < 4)
+			return 0;
+		family = EXTRACT_HE_U_4(p);
+		if ((family & 0xFFFF0000) != 0)
+			family = EXTRACT_U_1(p) | EXTRACT_U_1(p + 1) << 8 |
+			    EXTRACT_U_1(p + 2) << 16 | EXTRACT_U_1(p + 3) << 24;
+		if (family == BSD_AFNUM_INET)
+			type = ETHERTYPE_IP;
+		else if (family == BSD_AFNUM_INET6_BSD ||
+		    family == BSD_AFNUM_INET6_FREEBSD ||
+		    family == BSD_AFNUM_INET6_DARWIN)
+			type = ETHERTYPE_IPV6;
+		else
+			return 0;
+		hdrlen = 4;
+		break;
+
+	case DLT_RAW:
+#ifdef DLT_IPV4
+	case DLT_IPV4:
+#endif
+#ifdef DLT_IPV6
+	case DLT_IPV6:
+#endif
+		if (len < 1)
+			return 0;
+		type = (p[0] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
+		hdrlen = 0;
+		break;
+
+	default:
+		return 0;
+	}
+
+	*pp = p + hdrlen;
+	*lenp = len - hdrlen;
+	return type;
+}
+
+/*
+ * Each of these is handed the whole packet and the offset of its
+ * header, and returns the offset of the end of the headers, which may
+ * be past the end of the captured data if it's cut short.
+ */
+
+static u_int
+nd_headers_ether(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int type;
+
+	if (len < off + ETHER_HDRLEN)
+		return len;
+	type = EXTRACT_BE_U_2(p + off + 12);
+	off += ETHER_HDRLEN;
+	while ((type == ETHERTYPE_8021Q || type == ETHERTYPE_8021QinQ ||
+	    type == ETHERTYPE_8021Q9100) && len >= off + 4) {
+		type = EXTRACT_BE_U_2(p + off + 2);
+		off += 4;
+	}
+	return nd_headers_ethertype(type, p, len, off, depth);
+}
+
+static u_int
+nd_headers_ip(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int ver;
+
+	if (len < off + 1)
+		return len;
+	ver = p[off] >> 4;
+	if (ver == 4)
+		return nd_headers_ethertype(ETHERTYPE_IP, p, len, off, depth);
+	if (ver == 6)
+		return nd_headers_ethertype(ETHERTYPE_IPV6, p, len, off, depth);
+	return off;
+}
+
+static u_int
+nd_headers_mpls(const u_char *p, u_int len, u_int off, int depth)
+{
+	uint32_t label;
+
+	do {
+		if (len < off + 4)
+			return len;
+		label = EXTRACT_BE_U_4(p + off);
+		off += 4;
+	} while (MPLS_STACK(label) == 0);
+	/* what the labels carry isn't said; guess, as print-mpls.c does */
+	return nd_headers_ip(p, len, off, depth);
+}
+
+static u_int
+nd_headers_udp(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int sport, dport, optlen;
+
+	if (len < off + sizeof(struct udphdr))
+		return len;
+	sport = EXTRACT_BE_U_2(p + off + offsetof(struct udphdr, uh_sport));
+	dport = EXTRACT_BE_U_2(p + off + offsetof(struct udphdr, uh_dport));
+	off += sizeof(struct udphdr);
+
+	if (dport == VXLAN_PORT || sport == VXLAN_PORT) {
+		if (len < off + VXLAN_HDRLEN)
+			return len;
+		return nd_headers_ether(p, len, off + VXLAN_HDRLEN, depth);
+	}
+	if (dport == GENEVE_PORT || sport == GENEVE_PORT) {
+		if (len < off + GENEVE_HDRLEN)
+			return len;
+		optlen = (p[off] & 0x3f) * 4;
+		return nd_headers_ethertype(EXTRACT_BE_U_2(p + off + 2),
+		    p, len, off + GENEVE_HDRLEN + optlen, depth);
+	}
+	if (dport == MPLS_PORT || sport == MPLS_PORT)
+		return nd_headers_mpls(p, len, off, depth);
+	return off;
+}
+
+static u_int
+nd_headers_gre(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int flags, type;
+
+	if (len < off + GRE_HDRLEN)
+		return len;
+	flags = EXTRACT_BE_U_2(p + off);
+	type = EXTRACT_BE_U_2(p + off + 2);
+	if ((flags & GRE_VERS_MASK) != 0 || (flags & GRE_RP) != 0) {
+		/* PPTP's GRE, or source routes; not followed */
+		return off + GRE_HDRLEN;
+	}
+	off += GRE_HDRLEN;
+	if (flags & GRE_CP)
+		off += 4;
+	if (flags & GRE_KP)
+		off += 4;
+	if (flags & GRE_SP)
+		off += 4;
+	return nd_headers_ethertype(type, p, len, off, depth);
+}
+
+static u_int
+nd_headers_ipproto(u_int proto, const u_char *p, u_int len, u_int off,
+		   int depth)
+{
+	switch (proto) {
+
+	case IPPROTO_TCP:
+		if (len < off + sizeof(struct tcphdr))
+			return len;
+		return off +
+		    ((p[off + offsetof(struct tcphdr, th_offx2)] & 0xf0) >> 4) * 4;
+
+	case IPPROTO_UDP:
+		return nd_headers_udp(p, len, off, depth);
+
+	case IPPROTO_ICMP:
+	case IPPROTO_ICMPV6:
+		return off + 8;
+
+	case IPPROTO_SCTP:
+		return off + 12;
+
+	case IPPROTO_GRE:
+		return nd_headers_gre(p, len, off, depth);
+
+	case IPPROTO_IPV4:
+		return nd_headers_ethertype(ETHERTYPE_IP, p, len, off, depth);
+
+	case IPPROTO_IPV6:
+		return nd_headers_ethertype(ETHERTYPE_IPV6, p, len, off, depth);
+
+	default:
+		return off;
+	}
+}
+
+static u_int
+nd_headers_ip4(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int hlen, proto;
+
+	if (len < off + sizeof(struct ip))
+		return len;
+	hlen = (p[off] & 0x0f) * 4;
+	if (hlen < sizeof(struct ip))
+		return off;
+	proto = p[off + offsetof(struct ip, ip_p)];
+	if ((EXTRACT_BE_U_2(p + off + offsetof(struct ip, ip_off)) &
+	    IP_OFFMASK) != 0) {
+		/* not the first fragment; no more headers */
+		return off + hlen;
+	}
+	return nd_headers_ipproto(proto, p, len, off + hlen, depth);
+}
+
+static u_int
+nd_headers_ip6(const u_char *p, u_int len, u_int off, int depth)
+{
+	u_int nh;
+
+	if (len < off + sizeof(struct ip6_hdr))
+		return len;
+	nh = p[off + offsetof(struct ip6_hdr, ip6_nxt)];
+	off += sizeof(struct ip6_hdr);
+	for (;;) {
+		switch (nh) {
+
+		case IPPROTO_HOPOPTS:
+		case IPPROTO_ROUTING:
+		case IPPROTO_DSTOPTS:
+			if (len < off + sizeof(struct ip6_ext))
+				return len;
+			nh = p[off];
+			off += (p[off + 1] + 1) * 8;
+			break;
+
+		case IPPROTO_FRAGMENT:
+			if (len < off + sizeof(struct ip6_frag))
+				return len;
+			nh = p[off];
+			if ((EXTRACT_BE_U_2(p + off +
+			    offsetof(struct ip6_frag, ip6f_offlg)) &
+			    IP6F_OFF_MASK) != 0)
+				return off + sizeof(struct ip6_frag);
+			off += sizeof(struct ip6_frag);
+			break;
+
+		default:
+			return nd_headers_ipproto(nh, p, len, off, depth);
+		}
+	}
+}
+
+static u_int
+nd_headers_ethertype(u_int type, const u_char *p, u_int len, u_int off,
+		     int depth)
+{
+	if (++depth > MAX_DEPTH)
+		return off;
+
+	switch (type) {
+
+	case ETHERTYPE_IP:
+		return nd_headers_ip4(p, len, off, depth);
+
+	case ETHERTYPE_IPV6:
+		return nd_headers_ip6(p, len, off, depth);
+
+	case ETHERTYPE_MPLS:
+	case ETHERTYPE_MPLS_MULTI:
+		return nd_headers_mpls(p, len, off, depth);
+
+	case ETHERTYPE_TEB:
+		return nd_headers_ether(p, len, off, depth);
+
+	default:
+		return off;
+	}
+}
+
+/*
+ * Returns the length of the headers of a packet: at most len, and all
+ * of it if the link layer, or the protocol it carries, isn't one we
+ * know, so that only payload we recognize as such is cut off.
+ */
+u_int
+nd_headers_length(u_int dlt, const u_char *p, u_int len)
+{
+	const u_char *l3 = p;
+	u_int l3len = len;
+	u_int type, off;
+
+	type = nd_link_ethertype(dlt, &l3, &l3len);
+	if (type != ETHERTYPE_IP && type != ETHERTYPE_IPV6 &&
+	    type != ETHERTYPE_MPLS && type != ETHERTYPE_MPLS_MULTI)
+		return len;
+	off = nd_headers_ethertype(type, p, len, (u_int)(l3 - p), 0);
+	return off < len ? off : len;
+}
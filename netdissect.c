@@ -90,7 +90,9 @@ nd_cleanup(void)
 	/*
 	 * This appears, in libsmi 0.4.8, to do nothing if smiInit()
 	 * wasn't done or failed, so we call it unconditionally.
+	 * The OID cache points into libsmi's data, so drop it first.
 	 */
+	nd_smi_cache_flush();
 	smiExit();
 #endif
 
@@ -128,6 +130,8 @@ nd_load_smi_module(const char *module, char *errbuf, size_t errbuf_size)
 		return (-1);
 	}
 	nd_smi_module_loaded = 1;
+	/* cached lookups may resolve differently now */
+	nd_smi_cache_flush();
 	return (0);
 #else
 	snprintf(errbuf, errbuf_size, "MIB module %s not loaded: no libsmi support",
@@ -162,6 +162,20 @@ extern int nd_smi_module_loaded;
 /* Version number of the SMI library, or NULL if we don't have libsmi support. */
 extern const char *nd_smi_version_string(void);
 
+/* Statistics of the SNMP printer's cache of libsmi OID lookups. */
+struct nd_smi_cache_stats {
+	u_int lookups;		/* OIDs looked up */
+	u_int hits;		/* ... found in the cache */
+	u_int misses;		/* ... looked up in libsmi and cached */
+	u_int evictions;	/* entries replaced by a colliding OID */
+	u_int entries;		/* slots currently in use */
+	u_int uncacheable;	/* OIDs too long or truncated to be cached */
+};
+/* Empty the OID cache; needed whenever the set of loaded MIBs changes. */
+extern void nd_smi_cache_flush(void);
+/* Get the OID cache statistics (all zero without libsmi support). */
+extern void nd_smi_cache_get_stats(struct nd_smi_cache_stats *);
+
 typedef struct netdissect_options netdissect_options;
 
 #define IF_PRINTER_ARGS (netdissect_options *, const struct pcap_pkthdr *, const u_char *)
@@ -205,6 +219,7 @@ struct netdissect_options {
   int ndo_nflag;		/* leave addresses as numbers */
   int ndo_Nflag;		/* remove domains from printed host names */
   int ndo_qflag;		/* quick (shorter) output */
+  int ndo_quick;		/* -q output of Ethernet takes the quick path */
   int ndo_Sflag;		/* print raw TCP sequence numbers */
   int ndo_tflag;		/* print packet arrival time */
   int ndo_uflag;		/* Print undecoded NFS handles */
@@ -220,6 +235,15 @@ struct netdissect_options {
   void *ndo_last_mem_p;		/* pointer to the last allocated memory chunk */
   int ndo_packet_number;	/* print a packet number in the beginning of line */
   int ndo_print_sampling;	/* print every Nth packet */
+  int ndo_print_flow_sampling;	/* print 1 in N flows */
+  u_int ndo_name_cache_size;	/* most names per address-name cache */
+  u_int ndo_print_rate;		/* print at most this many packets/s... */
+  u_int ndo_print_burst;	/* ...in bursts of at most this many */
+  int ndo_summary;		/* print BGP UPDATE summaries (--summary) */
+  int ndo_profile;		/* profile dissectors (--profile-dissectors) */
+  u_int ndo_tcp_analysis;	/* analyze at most this many TCP connections */
+  u_int ndo_flow_export;	/* summarize flow exports every this many s */
+  u_int ndo_dns_analysis;	/* match at most this many DNS queries */
   int ndo_suppress_default_print; /* don't use default_print() for unknown packet types */
   int ndo_tstamp_precision;	/* requested time stamp precision */
   const char *program_name;	/* Name of the program using the library */
@@ -235,6 +259,9 @@ struct netdissect_options {
   int   ndo_snaplen;
   int   ndo_ll_hdr_len;	/* link-layer header length */
   int   ndo_color;	/* print using colors */
+  int   ndo_style;	/* style of the text being printed */
+  int   ndo_style_out;	/* style the output is in, with colors */
+  struct timeval ndo_ts;	/* time stamp of the packet being printed */
 
   /*global pointers to beginning and end of current packet (during printing) */
   const u_char *ndo_packetp;
@@ -432,8 +459,19 @@ goto invalid; \
 #define ND_ICHECK_ZU(expression_1, operator, expression_2) \
 ND_ICHECKMSG_ZU((#expression_1), (expression_1), operator, (expression_2))
 
-#define ND_PRINT(COLOR, FMT, ...) if(ndo->ndo_color) (ndo->ndo_printf)(ndo, COLOR FMT C_RESET __VA_OPT__(,) __VA_ARGS__); \
-	else (ndo->ndo_printf)(ndo, FMT __VA_OPT__(,) __VA_ARGS__)
+/*
+ * Print in a style; in the default style, as nearly all callers do,
+ * this is only the ndo_printf call.  The style is rendered, if at
+ * all, by ndo_printf.
+ */
+#define ND_PRINT(STYLE, FMT, ...) \
+	do { \
+		if ((STYLE) != ND_STYLE_DEFAULT) \
+			ndo->ndo_style = (STYLE); \
+		(ndo->ndo_printf)(ndo, FMT __VA_OPT__(,) __VA_ARGS__); \
+		if ((STYLE) != ND_STYLE_DEFAULT) \
+			ndo->ndo_style = ND_STYLE_DEFAULT; \
+	} while (0)
 
 #define ND_DEFAULTPRINT(ap, length) (*ndo->ndo_default_print)(ndo, ap, length)
 
@@ -623,11 +661,11 @@ extern void cdp_print(netdissect_options *, const u_char *, u_int);
 extern void cfm_print(netdissect_options *, const u_char *, u_int);
 extern void chdlc_print(netdissect_options *, const u_char *, u_int);
 extern void cisco_autorp_print(netdissect_options *, const u_char *, u_int);
-extern void cnfp_print(netdissect_options *, const u_char *);
+extern void cnfp_print(netdissect_options *, const u_char *, const u_char *);
 extern void dccp_print(netdissect_options *, const u_char *, const u_char *, u_int);
 extern void decnet_print(netdissect_options *, const u_char *, u_int, u_int);
 extern void dhcp6_print(netdissect_options *, const u_char *, u_int);
-extern void domain_print(netdissect_options *, const u_char *, u_int, int, int);
+extern void domain_print(netdissect_options *, const u_char *, u_int, int, int, uint16_t, uint16_t, const u_char *);
 extern int dstopt_process(netdissect_options *, const u_char *);
 extern void dtp_print(netdissect_options *, const u_char *, u_int);
 extern void dvmrp_print(netdissect_options *, const u_char *, u_int);
@@ -793,6 +831,185 @@ extern void nd_print_protocol(netdissect_options *);
 extern void nd_print_protocol_caps(netdissect_options *);
 extern void nd_print_invalid(netdissect_options *);
 
+/*
+ * Per-dissector profiling (--profile-dissectors), in
+ * netdissect-profile.c.  The link-layer printers and the main
+ * demultiplexing points account their calls, bytes and time to a slot
+ * identified by a layer and a key within it.
+ */
+#define ND_PROFILE_LINK		0	/* key: DLT_ value */
+#define ND_PROFILE_ETHERTYPE	1	/* key: Ethernet type */
+#define ND_PROFILE_IP		2	/* key: IP protocol number */
+#define ND_PROFILE_UDP		3	/* key: 0 */
+
+extern uint64_t nd_profile_now(void);
+extern void nd_profile_init(void);
+extern void nd_profile_enter(netdissect_options *, u_int, u_int, u_int);
+extern void nd_profile_exit(netdissect_options *);
+extern void nd_profile_alloc(netdissect_options *);
+extern void nd_profile_unwind(netdissect_options *);
+extern void nd_profile_print(FILE *);
+
+/*
+ * Dissector registry (--disable-dissector), in netdissect-dissector.c.
+ * The Ethernet type, IP protocol and TCP and UDP port demultiplexing
+ * points register the dissectors they can hand off to, by the name of
+ * their printer, into tables indexed by the type, protocol or port;
+ * those that have been disabled are left out.
+ */
+#define ND_PORT_SRC	0x01	/* match the source port */
+#define ND_PORT_DST	0x02	/* match the destination port */
+#define ND_PORT_ANY	(ND_PORT_SRC|ND_PORT_DST)
+
+/* Ports lo through hi go to "id"; where several match, the lowest id wins */
+struct nd_port_dissector {
+	uint8_t id;		/* the demultiplexer's own code, non-zero */
+	uint8_t dir;		/* ND_PORT_ flags */
+	uint16_t lo;
+	uint16_t hi;
+	const char *name;
+};
+
+struct nd_port_table {
+	uint8_t src[65536];	/* id for a source port, 0 if none */
+	uint8_t dst[65536];	/* id for a destination port */
+};
+
+/* Lookups of "key" are to fail if "name" is disabled */
+struct nd_key_dissector {
+	u_int key;
+	const char *name;
+};
+
+extern int nd_disable_dissector(const char *);
+extern const char *nd_unknown_dissector(void);
+extern int nd_dissector_enabled(const char *);
+extern void nd_port_table_init(struct nd_port_table *, const struct nd_port_dissector *, u_int);
+extern void nd_key_table_init(uint8_t *, const struct nd_key_dissector *, u_int);
+extern void init_dissectors(void);
+
+/*
+ * The lowest id registered for either port, 0 if none.
+ */
+static inline u_int
+nd_port_lookup(const struct nd_port_table *t, u_int sport, u_int dport)
+{
+	u_int s = t->src[sport], d = t->dst[dport];
+
+	return (s != 0 && (d == 0 || s < d)) ? s : d;
+}
+
+extern void ether_init_dissectors(void);
+extern void ip_demux_init_dissectors(void);
+extern void tcp_init_dissectors(void);
+extern void udp_init_dissectors(void);
+
+/*
+ * TCP performance analysis (--tcp-analysis); a segment as tcp_print()
+ * sees it.
+ */
+struct tcp_analysis_seg {
+	const u_char *src;	/* IPv4 or IPv6 addresses */
+	const u_char *dst;
+	u_int addrlen;		/* 4 or 16 */
+	uint16_t sport;
+	uint16_t dport;
+	uint8_t flags;
+	uint16_t win;
+	uint32_t seq;
+	uint32_t ack;
+	u_int length;		/* of the payload */
+	int has_ts;		/* has the time stamp option, with... */
+	uint32_t tsval;
+	uint32_t tsecr;
+};
+
+extern void tcp_analysis_segment(netdissect_options *, const struct tcp_analysis_seg *);
+extern void tcp_analysis_print(FILE *);
+
+/*
+ * DNS transaction analysis (--dns-analysis); a message as domain_print()
+ * sees it.
+ */
+struct dns_analysis_msg {
+	const u_char *src;	/* IPv4 or IPv6 addresses */
+	const u_char *dst;
+	u_int addrlen;		/* 4 or 16 */
+	uint16_t sport;
+	uint16_t dport;
+	uint16_t id;
+	int response;		/* QR is set */
+	u_int rcode;		/* with the extended bits, if any */
+	u_int qtype;		/* of the first question, if any */
+};
+
+extern void dns_analysis_message(netdissect_options *, const struct dns_analysis_msg *);
+extern void dns_analysis_print(FILE *);
+
+/*
+ * Summaries of NetFlow and sFlow exports (--flow-export-summary), in
+ * flow-export.c; what the printers decode records into.
+ */
+#define FLOW_EXPORT_NETFLOW	0
+#define FLOW_EXPORT_SFLOW	1
+
+struct flow_export_flow {
+	u_char src[16];		/* IPv4 or IPv6 addresses, if addrlen != 0 */
+	u_char dst[16];
+	u_int addrlen;
+	uint16_t sport;
+	uint16_t dport;
+	u_int proto;
+	uint32_t input;		/* interface indexes */
+	uint32_t output;
+	uint64_t packets;
+	uint64_t bytes;
+};
+
+/* Interface counters, as in the sFlow generic ones; in and out alike */
+#define FLOW_EXPORT_IN_OCTETS		0
+#define FLOW_EXPORT_IN_UCAST		1
+#define FLOW_EXPORT_IN_MCAST		2
+#define FLOW_EXPORT_IN_BCAST		3
+#define FLOW_EXPORT_IN_DISCARDS		4
+#define FLOW_EXPORT_IN_ERRORS		5
+#define FLOW_EXPORT_OUT_OCTETS		6
+#define FLOW_EXPORT_OUT_UCAST		7
+#define FLOW_EXPORT_OUT_MCAST		8
+#define FLOW_EXPORT_OUT_BCAST		9
+#define FLOW_EXPORT_OUT_DISCARDS	10
+#define FLOW_EXPORT_OUT_ERRORS		11
+#define FLOW_EXPORT_COUNTERS		12
+
+extern void flow_export_datagram(netdissect_options *, u_int, const u_char *, u_int, uint32_t, uint32_t, uint32_t);
+extern void flow_export_flow(netdissect_options *, const struct flow_export_flow *);
+extern void flow_export_counters(netdissect_options *, uint32_t, const uint64_t *);
+extern void flow_export_print(netdissect_options *);
+
+/*
+ * Flow sampling and rate limiting of the packets printed
+ * (--print-flow-sampling, --print-rate-limit), in netdissect-sampling.c.
+ */
+struct nd_sampling_stats {
+	uint64_t flow_skipped;		/* not in a sampled flow */
+	uint64_t rate_suppressed;	/* over the rate limit */
+};
+
+extern int nd_print_sample(netdissect_options *, u_int,
+    const struct pcap_pkthdr *, const u_char *);
+extern void nd_sampling_get_stats(struct nd_sampling_stats *);
+
+/*
+ * Walking the headers of a packet, without dissecting it, in
+ * netdissect-slice.c.
+ */
+extern u_int nd_link_ethertype(u_int, const u_char **, u_int *);
+extern u_int nd_headers_length(u_int, const u_char *, u_int);
+
+/* The -q quick path, in netdissect-quick.c */
+extern void nd_quick_init(netdissect_options *);
+extern u_int nd_quick_ether_print(netdissect_options *, const u_char *, u_int, u_int);
+
 extern int mask2plen(uint32_t);
 extern int mask62plen(const u_char *);
 
@@ -18,6 +18,9 @@
 #endif
 
 #include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+
 #include "netdissect.h"
 #include "oui.h"
 
@@ -54,6 +57,57 @@ const struct tok oui_values[] = {
     { 0, NULL }
 };
 
+/*
+ * oui_values[] sorted by OUI, without the terminator; an OUI listed
+ * more than once keeps its first name, as with tok2str().
+ */
+static const struct tok *oui_index[sizeof(oui_values) / sizeof(oui_values[0]) - 1];
+static u_int oui_index_len;
+
+static int
+oui_index_cmp(const void *a, const void *b)
+{
+	const struct tok *x = *(const struct tok * const *)a;
+	const struct tok *y = *(const struct tok * const *)b;
+
+	if (x->v != y->v)
+		return (x->v < y->v ? -1 : 1);
+	return (x < y ? -1 : x > y);
+}
+
+/*
+ * Return the name of an OUI, or NULL if it isn't known.
+ */
+const char *
+oui_name(u_int oui)
+{
+	u_int i, n, lo, hi, mid;
+
+	if (oui_index_len == 0) {
+		for (i = 0; oui_values[i].s != NULL; i++)
+			oui_index[i] = &oui_values[i];
+		qsort(oui_index, i, sizeof(oui_index[0]), oui_index_cmp);
+		for (n = 0, lo = 0; lo < i; lo++) {
+			if (n == 0 || oui_index[n - 1]->v != oui_index[lo]->v)
+				oui_index[n++] = oui_index[lo];
+		}
+		oui_index_len = n;
+	}
+
+	lo = 0;
+	hi = oui_index_len;
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (oui_index[mid]->v == oui)
+			return (oui_index[mid]->s);
+		if (oui_index[mid]->v < oui)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (NULL);
+}
+
 /*
  * SMI Network Management Private Enterprise Codes for organizations.
  *
@@ -16,6 +16,8 @@
 extern const struct tok oui_values[];
 extern const struct tok smi_values[];
 
+extern const char *oui_name(u_int);
+
 #define OUI_ENCAP_ETHER       0x000000  /* encapsulated Ethernet */
 #define OUI_CISCO             0x00000c  /* Cisco protocols */
 #define OUI_IANA              0x00005E  /* IANA */
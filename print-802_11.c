@@ -35,7 +35,6 @@
 
 #include "extract.h"
 
-#include "cpack.h"
 
 
 /* Lengths of 802.11 header components. */
@@ -2748,22 +2747,23 @@ print_chaninfo(netdissect_options *ndo,
 	ND_PRINT(C_RESET, " ");
 }
 
+/*
+ * Print a radiotap field; f points to it, and the caller has checked
+ * that all of it is within the radiotap header.
+ */
 static int
 print_radiotap_field(netdissect_options *ndo,
-		     struct cpack_state *s, uint32_t bit, uint8_t *flagsp,
+		     const u_char *f, uint32_t bit, uint8_t *flagsp,
 		     uint32_t presentflags)
 {
 	u_int i;
-	int rc;
 
 	switch (bit) {
 
 	case IEEE80211_RADIOTAP_TSFT: {
 		uint64_t tsft;
 
-		rc = nd_cpack_uint64(ndo, s, &tsft);
-		if (rc != 0)
-			goto trunc;
+		tsft = GET_LE_U_8(f);
 		ND_PRINT(C_RESET, "%" PRIu64 "us tsft ", tsft);
 		break;
 		}
@@ -2771,9 +2771,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_FLAGS: {
 		uint8_t flagsval;
 
-		rc = nd_cpack_uint8(ndo, s, &flagsval);
-		if (rc != 0)
-			goto trunc;
+		flagsval = GET_U_1(f);
 		*flagsp = flagsval;
 		if (flagsval & IEEE80211_RADIOTAP_F_CFP)
 			ND_PRINT(C_RESET, "cfp ");
@@ -2791,9 +2789,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_RATE: {
 		uint8_t rate;
 
-		rc = nd_cpack_uint8(ndo, s, &rate);
-		if (rc != 0)
-			goto trunc;
+		rate = GET_U_1(f);
 		/*
 		 * XXX On FreeBSD rate & 0x80 means we have an MCS. On
 		 * Linux and AirPcap it does not.  (What about
@@ -2842,12 +2838,8 @@ print_radiotap_field(netdissect_options *ndo,
 		uint16_t frequency;
 		uint16_t flags;
 
-		rc = nd_cpack_uint16(ndo, s, &frequency);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint16(ndo, s, &flags);
-		if (rc != 0)
-			goto trunc;
+		frequency = GET_LE_U_2(f);
+		flags = GET_LE_U_2(f + 2);
 		/*
 		 * If CHANNEL and XCHANNEL are both present, skip
 		 * CHANNEL.
@@ -2862,12 +2854,8 @@ print_radiotap_field(netdissect_options *ndo,
 		uint8_t hopset;
 		uint8_t hoppat;
 
-		rc = nd_cpack_uint8(ndo, s, &hopset);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &hoppat);
-		if (rc != 0)
-			goto trunc;
+		hopset = GET_U_1(f);
+		hoppat = GET_U_1(f + 1);
 		ND_PRINT(C_RESET, "fhset %u fhpat %u ", hopset, hoppat);
 		break;
 		}
@@ -2875,9 +2863,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DBM_ANTSIGNAL: {
 		int8_t dbm_antsignal;
 
-		rc = nd_cpack_int8(ndo, s, &dbm_antsignal);
-		if (rc != 0)
-			goto trunc;
+		dbm_antsignal = GET_S_1(f);
 		ND_PRINT(C_RESET, "%ddBm signal ", dbm_antsignal);
 		break;
 		}
@@ -2885,9 +2871,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DBM_ANTNOISE: {
 		int8_t dbm_antnoise;
 
-		rc = nd_cpack_int8(ndo, s, &dbm_antnoise);
-		if (rc != 0)
-			goto trunc;
+		dbm_antnoise = GET_S_1(f);
 		ND_PRINT(C_RESET, "%ddBm noise ", dbm_antnoise);
 		break;
 		}
@@ -2895,9 +2879,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_LOCK_QUALITY: {
 		uint16_t lock_quality;
 
-		rc = nd_cpack_uint16(ndo, s, &lock_quality);
-		if (rc != 0)
-			goto trunc;
+		lock_quality = GET_LE_U_2(f);
 		ND_PRINT(C_RESET, "%u sq ", lock_quality);
 		break;
 		}
@@ -2905,9 +2887,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_TX_ATTENUATION: {
 		int16_t tx_attenuation;
 
-		rc = nd_cpack_int16(ndo, s, &tx_attenuation);
-		if (rc != 0)
-			goto trunc;
+		tx_attenuation = GET_LE_S_2(f);
 		ND_PRINT(C_RESET, "%d tx power ", -tx_attenuation);
 		break;
 		}
@@ -2915,9 +2895,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DB_TX_ATTENUATION: {
 		int8_t db_tx_attenuation;
 
-		rc = nd_cpack_int8(ndo, s, &db_tx_attenuation);
-		if (rc != 0)
-			goto trunc;
+		db_tx_attenuation = GET_S_1(f);
 		ND_PRINT(C_RESET, "%ddB tx attenuation ", -db_tx_attenuation);
 		break;
 		}
@@ -2925,9 +2903,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DBM_TX_POWER: {
 		int8_t dbm_tx_power;
 
-		rc = nd_cpack_int8(ndo, s, &dbm_tx_power);
-		if (rc != 0)
-			goto trunc;
+		dbm_tx_power = GET_S_1(f);
 		ND_PRINT(C_RESET, "%ddBm tx power ", dbm_tx_power);
 		break;
 		}
@@ -2935,9 +2911,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_ANTENNA: {
 		uint8_t antenna;
 
-		rc = nd_cpack_uint8(ndo, s, &antenna);
-		if (rc != 0)
-			goto trunc;
+		antenna = GET_U_1(f);
 		ND_PRINT(C_RESET, "antenna %u ", antenna);
 		break;
 		}
@@ -2945,9 +2919,7 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DB_ANTSIGNAL: {
 		uint8_t db_antsignal;
 
-		rc = nd_cpack_uint8(ndo, s, &db_antsignal);
-		if (rc != 0)
-			goto trunc;
+		db_antsignal = GET_U_1(f);
 		ND_PRINT(C_RESET, "%udB signal ", db_antsignal);
 		break;
 		}
@@ -2955,41 +2927,22 @@ print_radiotap_field(netdissect_options *ndo,
 	case IEEE80211_RADIOTAP_DB_ANTNOISE: {
 		uint8_t db_antnoise;
 
-		rc = nd_cpack_uint8(ndo, s, &db_antnoise);
-		if (rc != 0)
-			goto trunc;
+		db_antnoise = GET_U_1(f);
 		ND_PRINT(C_RESET, "%udB noise ", db_antnoise);
 		break;
 		}
 
-	case IEEE80211_RADIOTAP_RX_FLAGS: {
-		uint16_t rx_flags;
-
-		rc = nd_cpack_uint16(ndo, s, &rx_flags);
-		if (rc != 0)
-			goto trunc;
+	case IEEE80211_RADIOTAP_RX_FLAGS:
 		/* Do nothing for now */
 		break;
-		}
 
 	case IEEE80211_RADIOTAP_XCHANNEL: {
 		uint32_t flags;
 		uint16_t frequency;
-		uint8_t channel;
-		uint8_t maxpower;
 
-		rc = nd_cpack_uint32(ndo, s, &flags);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint16(ndo, s, &frequency);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &channel);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &maxpower);
-		if (rc != 0)
-			goto trunc;
+		/* followed by the channel number and maximum power */
+		flags = GET_LE_U_4(f);
+		frequency = GET_LE_U_2(f + 4);
 		print_chaninfo(ndo, frequency, flags, presentflags);
 		break;
 		}
@@ -3006,15 +2959,9 @@ print_radiotap_field(netdissect_options *ndo,
 		};
 		float htrate;
 
-		rc = nd_cpack_uint8(ndo, s, &known);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &flags);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &mcs_index);
-		if (rc != 0)
-			goto trunc;
+		known = GET_U_1(f);
+		flags = GET_U_1(f + 1);
+		mcs_index = GET_U_1(f + 2);
 		if (known & IEEE80211_RADIOTAP_MCS_MCS_INDEX_KNOWN) {
 			/*
 			 * We know the MCS index.
@@ -3088,27 +3035,9 @@ print_radiotap_field(netdissect_options *ndo,
 		break;
 		}
 
-	case IEEE80211_RADIOTAP_AMPDU_STATUS: {
-		uint32_t reference_num;
-		uint16_t flags;
-		uint8_t delim_crc;
-		uint8_t reserved;
-
-		rc = nd_cpack_uint32(ndo, s, &reference_num);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint16(ndo, s, &flags);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &delim_crc);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &reserved);
-		if (rc != 0)
-			goto trunc;
+	case IEEE80211_RADIOTAP_AMPDU_STATUS:
 		/* Do nothing for now */
 		break;
-		}
 
 	case IEEE80211_RADIOTAP_VHT: {
 		uint16_t known;
@@ -3116,8 +3045,6 @@ print_radiotap_field(netdissect_options *ndo,
 		uint8_t bandwidth;
 		uint8_t mcs_nss[4];
 		uint8_t coding;
-		uint8_t group_id;
-		uint16_t partial_aid;
 		static const char *vht_bandwidth[32] = {
 			"20 MHz",
 			"40 MHz",
@@ -3153,29 +3080,13 @@ print_radiotap_field(netdissect_options *ndo,
 			"unknown (31)"
 		};
 
-		rc = nd_cpack_uint16(ndo, s, &known);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &flags);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &bandwidth);
-		if (rc != 0)
-			goto trunc;
-		for (i = 0; i < 4; i++) {
-			rc = nd_cpack_uint8(ndo, s, &mcs_nss[i]);
-			if (rc != 0)
-				goto trunc;
-		}
-		rc = nd_cpack_uint8(ndo, s, &coding);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint8(ndo, s, &group_id);
-		if (rc != 0)
-			goto trunc;
-		rc = nd_cpack_uint16(ndo, s, &partial_aid);
-		if (rc != 0)
-			goto trunc;
+		known = GET_LE_U_2(f);
+		flags = GET_U_1(f + 2);
+		bandwidth = GET_U_1(f + 3);
+		for (i = 0; i < 4; i++)
+			mcs_nss[i] = GET_U_1(f + 4 + i);
+		/* followed by the group ID and partial AID */
+		coding = GET_U_1(f + 8);
 		for (i = 0; i < 4; i++) {
 			u_int nss, mcs;
 			nss = mcs_nss[i] & IEEE80211_RADIOTAP_VHT_NSS_MASK;
@@ -3211,140 +3122,148 @@ print_radiotap_field(netdissect_options *ndo,
 	}
 
 	return 0;
-
-trunc:
-	nd_print_trunc(ndo);
-	return rc;
 }
 
 
+/*
+ * The alignment and size of the fields we know, by bit number; a size
+ * of 0 means one we don't know, so that we can't get past it.
+ */
+static const struct radiotap_field_info {
+	uint8_t align;
+	uint8_t size;
+} radiotap_fields[] = {
+	{ 8, 8 },	/* IEEE80211_RADIOTAP_TSFT */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_FLAGS */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_RATE */
+	{ 2, 4 },	/* IEEE80211_RADIOTAP_CHANNEL */
+	{ 1, 2 },	/* IEEE80211_RADIOTAP_FHSS */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_ANTSIGNAL */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_ANTNOISE */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_LOCK_QUALITY */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_TX_ATTENUATION */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_TX_ATTENUATION */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DBM_TX_POWER */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_ANTENNA */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_ANTSIGNAL */
+	{ 1, 1 },	/* IEEE80211_RADIOTAP_DB_ANTNOISE */
+	{ 2, 2 },	/* IEEE80211_RADIOTAP_RX_FLAGS */
+	{ 0, 0 },
+	{ 0, 0 },
+	{ 0, 0 },
+	{ 4, 8 },	/* IEEE80211_RADIOTAP_XCHANNEL */
+	{ 1, 3 },	/* IEEE80211_RADIOTAP_MCS */
+	{ 4, 8 },	/* IEEE80211_RADIOTAP_AMPDU_STATUS */
+	{ 2, 12 },	/* IEEE80211_RADIOTAP_VHT */
+};
+
+/*
+ * Where the fields of a radiotap header are, worked out from its
+ * presence bitmaps, length and the lengths of any vendor namespaces,
+ * as a list of things to do to print it.
+ *
+ * Almost all the frames of a capture have the same presence bitmaps,
+ * so layouts are cached, and each frame's fields are then printed
+ * straight from their offsets.
+ */
+#define RADIOTAP_FIELD		0	/* print the field at offset */
+#define RADIOTAP_TRUNC		1	/* report truncation, and carry on */
+#define RADIOTAP_STOP		2	/* report truncation, and stop */
+#define RADIOTAP_UNKNOWN	3	/* report a field we can't get past */
+
+struct radiotap_item {
+	uint8_t action;
+	uint8_t bit;
+	uint16_t offset;
+	uint32_t presentflags;	/* the presence word it's in */
+};
+
+#define RADIOTAP_MAX_WORDS	8
+#define RADIOTAP_MAX_ITEMS	48
+#define RADIOTAP_CACHE_SIZE	16	/* power of 2 */
+
+struct radiotap_layout {
+	u_int nwords;		/* 0 if the cache entry is unused */
+	uint32_t present[RADIOTAP_MAX_WORDS];
+	u_int len;		/* it_len */
+	u_int nvendor;		/* vendor namespace lengths it depends on */
+	uint16_t vendor_offset[RADIOTAP_MAX_WORDS];
+	uint16_t vendor_skip[RADIOTAP_MAX_WORDS];
+	u_int nitems;
+	struct radiotap_item items[RADIOTAP_MAX_ITEMS];
+};
+
+static struct radiotap_layout radiotap_cache[RADIOTAP_CACHE_SIZE];
+
+/*
+ * Do one thing, or, if layout isn't null, add it to the layout;
+ * returns -1 if the layout is full.
+ */
 static int
-print_in_radiotap_namespace(netdissect_options *ndo,
-			    struct cpack_state *s, uint8_t *flags,
-			    uint32_t presentflags, int bit0)
+radiotap_item(netdissect_options *ndo, struct radiotap_layout *layout,
+	      const u_char *p, u_int action, u_int bit, u_int offset,
+	      uint32_t presentflags, uint8_t *flagsp)
 {
-#define	BITNO_32(x) (((x) >> 16) ? 16 + BITNO_16((x) >> 16) : BITNO_16((x)))
-#define	BITNO_16(x) (((x) >> 8) ? 8 + BITNO_8((x) >> 8) : BITNO_8((x)))
-#define	BITNO_8(x) (((x) >> 4) ? 4 + BITNO_4((x) >> 4) : BITNO_4((x)))
-#define	BITNO_4(x) (((x) >> 2) ? 2 + BITNO_2((x) >> 2) : BITNO_2((x)))
-#define	BITNO_2(x) (((x) & 2) ? 1 : 0)
-	uint32_t present, next_present;
-	int bitno;
-	enum ieee80211_radiotap_type bit;
-	int rc;
-
-	for (present = presentflags; present; present = next_present) {
-		/*
-		 * Clear the least significant bit that is set.
-		 */
-		next_present = present & (present - 1);
+	struct radiotap_item *item;
 
-		/*
-		 * Get the bit number, within this presence word,
-		 * of the remaining least significant bit that
-		 * is set.
-		 */
-		bitno = BITNO_32(present ^ next_present);
+	if (layout == NULL) {
+		switch (action) {
 
-		/*
-		 * Stop if this is one of the "same meaning
-		 * in all presence flags" bits.
-		 */
-		if (bitno >= IEEE80211_RADIOTAP_NAMESPACE)
-			break;
+		case RADIOTAP_FIELD:
+			return print_radiotap_field(ndo, p + offset, bit,
+			    flagsp, presentflags);
 
-		/*
-		 * Get the radiotap bit number of that bit.
-		 */
-		bit = (enum ieee80211_radiotap_type)(bit0 + bitno);
+		case RADIOTAP_UNKNOWN:
+			ND_PRINT(C_RESET, "[bit %u] ", bit);
+			break;
 
-		rc = print_radiotap_field(ndo, s, bit, flags, presentflags);
-		if (rc != 0)
-			return rc;
+		default:
+			nd_print_trunc(ndo);
+			break;
+		}
+		return 0;
 	}
-
+	if (layout->nitems == RADIOTAP_MAX_ITEMS)
+		return -1;
+	item = &layout->items[layout->nitems++];
+	item->action = (uint8_t)action;
+	item->bit = (uint8_t)bit;
+	item->offset = (uint16_t)offset;
+	item->presentflags = presentflags;
 	return 0;
 }
 
-u_int
-ieee802_11_radio_print(netdissect_options *ndo,
-		       const u_char *p, u_int length, u_int caplen)
+/*
+ * Walk the fields of the radiotap header, in the default radiotap
+ * namespace, its extensions and vendor namespaces, either printing
+ * them or, if layout isn't null, making a layout of them.  Returns -1
+ * if the layout couldn't be made.
+ */
+static int
+radiotap_walk(netdissect_options *ndo, struct radiotap_layout *layout,
+	      const u_char *p, u_int len, u_int nwords, uint8_t *flagsp)
 {
 #define	BIT(n)	(1U << n)
-#define	IS_EXTENDED(__p)	\
-	    (GET_LE_U_4(__p) & BIT(IEEE80211_RADIOTAP_EXT)) != 0
-
-	struct cpack_state cpacker;
+#define	ALIGN(off, n)	(((off) + (n) - 1) & ~((n) - 1))
 	const struct ieee80211_radiotap_header *hdr;
-	uint32_t presentflags;
-	const nd_uint32_t *presentp, *last_presentp;
+	uint32_t presentflags, present, next_present;
 	int vendor_namespace;
-	uint8_t vendor_oui[3];
-	uint8_t vendor_subnamespace;
 	uint16_t skip_length;
-	int bit0;
-	u_int len;
-	uint8_t flags;
-	int pad;
-	u_int fcslen;
-
-	ndo->ndo_protocol = "802.11_radio";
-	if (caplen < sizeof(*hdr)) {
-		nd_print_trunc(ndo);
-		return caplen;
-	}
+	u_int bit0, bitno, bit, off, w;
+	const struct radiotap_field_info *info;
 
 	hdr = (const struct ieee80211_radiotap_header *)p;
-
-	len = GET_LE_U_2(hdr->it_len);
-	if (len < sizeof(*hdr)) {
-		/*
-		 * The length is the length of the entire header, so
-		 * it must be as large as the fixed-length part of
-		 * the header.
-		 */
-		nd_print_trunc(ndo);
-		return caplen;
-	}
-
-	/*
-	 * If we don't have the entire radiotap header, just give up.
-	 */
-	if (caplen < len) {
-		nd_print_trunc(ndo);
-		return caplen;
-	}
-	nd_cpack_init(&cpacker, (const uint8_t *)hdr, len); /* align against header start */
-	nd_cpack_advance(&cpacker, sizeof(*hdr)); /* includes the 1st bitmap */
-	for (last_presentp = &hdr->it_present;
-	     (const u_char*)(last_presentp + 1) <= p + len &&
-	     IS_EXTENDED(last_presentp);
-	     last_presentp++)
-	  nd_cpack_advance(&cpacker, sizeof(hdr->it_present)); /* more bitmaps */
-
-	/* are there more bitmap extensions than bytes in header? */
-	if ((const u_char*)(last_presentp + 1) > p + len) {
-		nd_print_trunc(ndo);
-		return caplen;
-	}
+	/* after the bitmaps */
+	off = sizeof(*hdr) + (nwords - 1) * sizeof(hdr->it_present);
 
 	/*
 	 * Start out at the beginning of the default radiotap namespace.
 	 */
 	bit0 = 0;
 	vendor_namespace = 0;
-	memset(vendor_oui, 0, 3);
-	vendor_subnamespace = 0;
 	skip_length = 0;
-	/* Assume no flags */
-	flags = 0;
-	/* Assume no Atheros padding between 802.11 header and body */
-	pad = 0;
-	/* Assume no FCS at end of frame */
-	fcslen = 0;
-	for (presentp = &hdr->it_present; presentp <= last_presentp;
-	    presentp++) {
-		presentflags = GET_LE_U_4(presentp);
+	for (w = 0; w < nwords; w++) {
+		presentflags = GET_LE_U_4(&hdr->it_present + w);
 
 		/*
 		 * If this is a vendor namespace, we don't handle it.
@@ -3353,15 +3272,15 @@ ieee802_11_radio_print(netdissect_options *ndo,
 			/*
 			 * Skip past the stuff we don't understand.
 			 * If we add support for any vendor namespaces,
-			 * it'd be added here; use vendor_oui and
-			 * vendor_subnamespace to interpret the fields.
+			 * it'd be added here.
 			 */
-			if (nd_cpack_advance(&cpacker, skip_length) != 0) {
+			if (off + skip_length > len) {
 				/*
 				 * Ran out of space in the packet.
 				 */
 				break;
 			}
+			off += skip_length;
 
 			/*
 			 * We've skipped it all; nothing more to
@@ -3369,13 +3288,49 @@ ieee802_11_radio_print(netdissect_options *ndo,
 			 */
 			skip_length = 0;
 		} else {
-			if (print_in_radiotap_namespace(ndo, &cpacker,
-			    &flags, presentflags, bit0) != 0) {
+			for (present = presentflags; present;
+			    present = next_present) {
 				/*
-				 * Fatal error - can't process anything
-				 * more in the radiotap header.
+				 * Clear the least significant bit that
+				 * is set, and stop if that's one of the
+				 * "same meaning in all presence flags"
+				 * bits.
 				 */
-				break;
+				next_present = present & (present - 1);
+				for (bitno = 0;
+				    ((present ^ next_present) >> bitno) != 1;
+				    bitno++)
+					;
+				if (bitno >= IEEE80211_RADIOTAP_NAMESPACE)
+					break;
+
+				bit = bit0 + bitno;
+				if (bit >= sizeof(radiotap_fields) / sizeof(radiotap_fields[0]) ||
+				    radiotap_fields[bit].size == 0) {
+					/*
+					 * This bit indicates a field whose
+					 * size we do not know, so we cannot
+					 * proceed.  Just print the bit number.
+					 */
+					if (radiotap_item(ndo, layout, p,
+					    RADIOTAP_UNKNOWN, bit, 0, 0,
+					    NULL) != 0)
+						return -1;
+					return 0;
+				}
+				info = &radiotap_fields[bit];
+				off = ALIGN(off, info->align);
+				if (off + info->size > len) {
+					if (radiotap_item(ndo, layout, p,
+					    RADIOTAP_STOP, 0, 0, 0, NULL) != 0)
+						return -1;
+					return 0;
+				}
+				if (radiotap_item(ndo, layout, p,
+				    RADIOTAP_FIELD, bit, off, presentflags,
+				    flagsp) != 0)
+					return -1;
+				off += info->size;
 			}
 		}
 
@@ -3404,8 +3359,6 @@ ieee802_11_radio_print(netdissect_options *ndo,
 			 */
 			bit0 = 0;
 			vendor_namespace = 0;
-			memset(vendor_oui, 0, 3);
-			vendor_subnamespace = 0;
 			skip_length = 0;
 			break;
 
@@ -3414,35 +3367,42 @@ ieee802_11_radio_print(netdissect_options *ndo,
 			 * We're switching to a vendor namespace.
 			 * Reset the presence-bitmap index to 0,
 			 * note that we're in a vendor namespace,
-			 * and fetch the fields of the Vendor Namespace
-			 * item.
+			 * and get the length of the Vendor Namespace
+			 * item, after the OUI and sub namespace.
 			 */
 			bit0 = 0;
 			vendor_namespace = 1;
-			if ((nd_cpack_align_and_reserve(&cpacker, 2)) == NULL) {
-				nd_print_trunc(ndo);
+			if (ALIGN(off, 2) + 2 > len) {
+				if (radiotap_item(ndo, layout, p,
+				    RADIOTAP_TRUNC, 0, 0, 0, NULL) != 0)
+					return -1;
 				break;
 			}
-			if (nd_cpack_uint8(ndo, &cpacker, &vendor_oui[0]) != 0) {
-				nd_print_trunc(ndo);
+			/* the OUI and sub namespace */
+			if (off + 4 > len) {
+				off = len;
+				if (radiotap_item(ndo, layout, p,
+				    RADIOTAP_TRUNC, 0, 0, 0, NULL) != 0)
+					return -1;
 				break;
 			}
-			if (nd_cpack_uint8(ndo, &cpacker, &vendor_oui[1]) != 0) {
-				nd_print_trunc(ndo);
+			off += 4;
+			if (ALIGN(off, 2) + 2 > len) {
+				if (radiotap_item(ndo, layout, p,
+				    RADIOTAP_TRUNC, 0, 0, 0, NULL) != 0)
+					return -1;
 				break;
 			}
-			if (nd_cpack_uint8(ndo, &cpacker, &vendor_oui[2]) != 0) {
-				nd_print_trunc(ndo);
-				break;
-			}
-			if (nd_cpack_uint8(ndo, &cpacker, &vendor_subnamespace) != 0) {
-				nd_print_trunc(ndo);
-				break;
-			}
-			if (nd_cpack_uint16(ndo, &cpacker, &skip_length) != 0) {
-				nd_print_trunc(ndo);
-				break;
+			off = ALIGN(off, 2);
+			skip_length = GET_LE_U_2(p + off);
+			if (layout != NULL) {
+				layout->vendor_offset[layout->nvendor] =
+				    (uint16_t)off;
+				layout->vendor_skip[layout->nvendor] =
+				    skip_length;
+				layout->nvendor++;
 			}
+			off += 2;
 			break;
 
 		default:
@@ -3454,6 +3414,137 @@ ieee802_11_radio_print(netdissect_options *ndo,
 			break;
 		}
 	}
+	return 0;
+#undef ALIGN
+#undef BIT
+}
+
+/*
+ * Get the cached layout for this radiotap header, making it if it's
+ * not there; returns NULL if there's none to be had.
+ */
+static const struct radiotap_layout *
+radiotap_layout(netdissect_options *ndo, const u_char *p, u_int len,
+		u_int nwords)
+{
+	const struct ieee80211_radiotap_header *hdr;
+	struct radiotap_layout *layout;
+	uint32_t hash, present[RADIOTAP_MAX_WORDS];
+	u_int i;
+
+	if (nwords > RADIOTAP_MAX_WORDS)
+		return NULL;
+	hdr = (const struct ieee80211_radiotap_header *)p;
+	hash = len;
+	for (i = 0; i < nwords; i++) {
+		present[i] = GET_LE_U_4(&hdr->it_present + i);
+		hash = (hash ^ present[i]) * 16777619;
+	}
+	hash ^= hash >> 16;
+	layout = &radiotap_cache[hash & (RADIOTAP_CACHE_SIZE - 1)];
+
+	if (layout->nwords == nwords && layout->len == len &&
+	    memcmp(layout->present, present, nwords * sizeof(present[0])) == 0) {
+		for (i = 0; i < layout->nvendor; i++) {
+			if (GET_LE_U_2(p + layout->vendor_offset[i]) !=
+			    layout->vendor_skip[i])
+				break;
+		}
+		if (i == layout->nvendor)
+			return layout;
+	}
+
+	/* not there, or different vendor namespace lengths; make it */
+	layout->nwords = nwords;
+	memcpy(layout->present, present, nwords * sizeof(present[0]));
+	layout->len = len;
+	layout->nvendor = 0;
+	layout->nitems = 0;
+	if (radiotap_walk(ndo, layout, p, len, nwords, NULL) != 0) {
+		layout->nwords = 0;
+		return NULL;
+	}
+	return layout;
+}
+
+u_int
+ieee802_11_radio_print(netdissect_options *ndo,
+		       const u_char *p, u_int length, u_int caplen)
+{
+#define	BIT(n)	(1U << n)
+#define	IS_EXTENDED(__p)	\
+	    (GET_LE_U_4(__p) & BIT(IEEE80211_RADIOTAP_EXT)) != 0
+
+	const struct ieee80211_radiotap_header *hdr;
+	const nd_uint32_t *last_presentp;
+	const struct radiotap_layout *layout;
+	const struct radiotap_item *item;
+	u_int len, nwords, i;
+	uint8_t flags;
+	int pad;
+	u_int fcslen;
+
+	ndo->ndo_protocol = "802.11_radio";
+	if (caplen < sizeof(*hdr)) {
+		nd_print_trunc(ndo);
+		return caplen;
+	}
+
+	hdr = (const struct ieee80211_radiotap_header *)p;
+
+	len = GET_LE_U_2(hdr->it_len);
+	if (len < sizeof(*hdr)) {
+		/*
+		 * The length is the length of the entire header, so
+		 * it must be as large as the fixed-length part of
+		 * the header.
+		 */
+		nd_print_trunc(ndo);
+		return caplen;
+	}
+
+	/*
+	 * If we don't have the entire radiotap header, just give up.
+	 */
+	if (caplen < len) {
+		nd_print_trunc(ndo);
+		return caplen;
+	}
+	for (last_presentp = &hdr->it_present;
+	     (const u_char*)(last_presentp + 1) <= p + len &&
+	     IS_EXTENDED(last_presentp);
+	     last_presentp++)
+		;
+
+	/* are there more bitmap extensions than bytes in header? */
+	if ((const u_char*)(last_presentp + 1) > p + len) {
+		nd_print_trunc(ndo);
+		return caplen;
+	}
+	nwords = (u_int)(last_presentp - &hdr->it_present) + 1;
+
+	/* Assume no flags */
+	flags = 0;
+	/* Assume no Atheros padding between 802.11 header and body */
+	pad = 0;
+	/* Assume no FCS at end of frame */
+	fcslen = 0;
+	layout = radiotap_layout(ndo, p, len, nwords);
+	if (layout != NULL) {
+		for (i = 0; i < layout->nitems; i++) {
+			item = &layout->items[i];
+			if (item->action == RADIOTAP_FIELD) {
+				if (print_radiotap_field(ndo,
+				    p + item->offset, item->bit, &flags,
+				    item->presentflags) != 0)
+					break;
+			} else if (item->action == RADIOTAP_UNKNOWN)
+				ND_PRINT(C_RESET, "[bit %u] ", item->bit);
+			else
+				nd_print_trunc(ndo);
+		}
+	} else
+		radiotap_walk(ndo, NULL, p, len, nwords, &flags);
 
 	if (flags & IEEE80211_RADIOTAP_F_DATAPAD)
 		pad = 1;	/* Atheros padding */
@@ -3461,11 +3552,7 @@ ieee802_11_radio_print(netdissect_options *ndo,
 		fcslen = 4;	/* FCS at end of packet */
 	return len + ieee802_11_print(ndo, p + len, length - len, caplen - len, pad,
 	    fcslen);
-#undef BITNO_32
-#undef BITNO_16
-#undef BITNO_8
-#undef BITNO_4
-#undef BITNO_2
+#undef IS_EXTENDED
 #undef BIT
 }
 
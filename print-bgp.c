@@ -45,6 +45,7 @@
 
 #include "netdissect.h"
 #include "addrtoname.h"
+#include "addrtostr.h"
 #include "extract.h"
 #include "af.h"
 #include "l2vpn.h"
@@ -1476,6 +1477,126 @@ badtlv:
     return -2;
 }
 
+/*
+ * bgp_prefix_fmt
+ *
+ * Format an IPv4 or IPv6 prefix as "address/length" without going through
+ * snprintf() or the address-to-name cache.  Only valid with -n, where
+ * ipaddr_string()/ip6addr_string() would produce exactly the same text.
+ */
+static const char *
+bgp_prefix_fmt(char *buf, size_t buflen, const u_char *addr, u_int addrlen,
+               u_int plen)
+{
+    char *cp = buf;
+    u_int i, v;
+
+    if (addrlen == sizeof(nd_ipv4)) {
+        for (i = 0; i < sizeof(nd_ipv4); i++) {
+            v = addr[i];
+            if (i != 0)
+                *cp++ = '.';
+            if (v >= 100)
+                *cp++ = (char)('0' + v / 100);
+            if (v >= 10)
+                *cp++ = (char)('0' + (v / 10) % 10);
+            *cp++ = (char)('0' + v % 10);
+        }
+    } else {
+        addrtostr6(addr, buf, buflen);
+        cp = buf + strlen(buf);
+    }
+    *cp++ = '/';
+    if (plen >= 100)
+        *cp++ = (char)('0' + plen / 100);
+    if (plen >= 10)
+        *cp++ = (char)('0' + (plen / 10) % 10);
+    *cp++ = (char)('0' + plen % 10);
+    *cp = '\0';
+    return buf;
+}
+
+/*
+ * bgp_prefix_addrlen
+ *
+ * Address length for the AFI/SAFI pairs whose NLRI is a plain list of
+ * <length, prefix> tuples, 0 for everything else.
+ */
+static u_int
+bgp_prefix_addrlen(uint16_t af, uint8_t safi)
+{
+    switch (af<<8 | safi) {
+    case (AFNUM_INET<<8 | SAFNUM_UNICAST):
+    case (AFNUM_INET<<8 | SAFNUM_MULTICAST):
+    case (AFNUM_INET<<8 | SAFNUM_UNIMULTICAST):
+        return sizeof(nd_ipv4);
+    case (AFNUM_INET6<<8 | SAFNUM_UNICAST):
+    case (AFNUM_INET6<<8 | SAFNUM_MULTICAST):
+    case (AFNUM_INET6<<8 | SAFNUM_UNIMULTICAST):
+        return sizeof(nd_ipv6);
+    }
+    return 0;
+}
+
+/*
+ * bgp_prefix_run
+ *
+ * Batch decoder for a run of plain IPv4/IPv6 prefixes, as found in the
+ * withdrawn routes and NLRI fields of an UPDATE and in the unicast and
+ * multicast MP_(UN)REACH_NLRI attributes.  Full-table transfers carry
+ * hundreds of thousands of these, so the run is bounds-checked once by
+ * the caller and each prefix is then read with the unchecked EXTRACT_
+ * macros.
+ *
+ * Each prefix is printed on its own line after "indent", if that isn't
+ * NULL, and counted in *countp, if that isn't NULL.  The walk stops at
+ * the first malformed or incomplete prefix; the number of bytes consumed
+ * is returned and the caller's per-prefix code deals with (and reports)
+ * whatever is left.
+ */
+static u_int
+bgp_prefix_run(netdissect_options *ndo, const u_char *pptr, u_int len,
+               u_int addrlen, int add_path, const char *indent,
+               char *buf, size_t buflen, u_int *countp)
+{
+    const u_char *p = pptr;
+    nd_ipv6 addr;
+    u_int hdrlen, plen, plenbytes;
+
+    hdrlen = add_path ? 5 : 1;
+    while (len >= hdrlen) {
+        plen = EXTRACT_U_1(p + hdrlen - 1);
+        if (plen > addrlen * 8)
+            break;
+        plenbytes = (plen + 7) / 8;
+        if (len - hdrlen < plenbytes)
+            break;
+        if (indent != NULL) {
+            memset(&addr, 0, sizeof(addr));
+            memcpy(&addr, p + hdrlen, plenbytes);
+            if (plen % 8) {
+                addr[plenbytes - 1] &= ((0xff00 >> (plen % 8)) & 0xff);
+            }
+            if (ndo->ndo_nflag)
+                bgp_prefix_fmt(buf, buflen, addr, addrlen, plen);
+            else if (addrlen == sizeof(nd_ipv4))
+                snprintf(buf, buflen, "%s/%u",
+                         ipaddr_string(ndo, (const u_char *)&addr), plen);
+            else
+                snprintf(buf, buflen, "%s/%u",
+                         ip6addr_string(ndo, (const u_char *)&addr), plen);
+            ND_PRINT(C_RESET, "%s%s", indent, buf);
+            if (add_path)
+                ND_PRINT(C_RESET, "   Path Id: %u", EXTRACT_BE_U_4(p));
+        }
+        if (countp != NULL)
+            (*countp)++;
+        p += hdrlen + plenbytes;
+        len -= hdrlen + plenbytes;
+    }
+    return ND_BYTES_BETWEEN(p, pptr);
+}
+
 static int
 decode_labeled_prefix6(netdissect_options *ndo,
                const u_char *pptr, u_int itemlen, char *buf, size_t buflen)
@@ -1977,6 +2098,7 @@ bgp_attr_print(netdissect_options *ndo,
     u_int as_size;
     int add_path4, add_path6;
     int ret;
+    u_int addrlen;
 
     tptr = pptr;
     tlen = len;
@@ -2330,6 +2452,15 @@ bgp_attr_print(netdissect_options *ndo,
         add_path4 = check_add_path(ndo, tptr, (len-ND_BYTES_BETWEEN(tptr, pptr)), 32);
         add_path6 = check_add_path(ndo, tptr, (len-ND_BYTES_BETWEEN(tptr, pptr)), 128);
 
+        addrlen = bgp_prefix_addrlen(af, safi);
+        if (addrlen != 0 && tptr < pptr + len &&
+            ND_TTEST_LEN(tptr, len - ND_BYTES_BETWEEN(tptr, pptr)))
+            tptr += bgp_prefix_run(ndo, tptr,
+                                   len - ND_BYTES_BETWEEN(tptr, pptr),
+                                   addrlen,
+                                   addrlen == sizeof(nd_ipv4) ? add_path4 : add_path6,
+                                   "\n\t      ", buf, sizeof(buf), NULL);
+
         while (tptr < pptr + len) {
             advance = bgp_nlri_print(ndo, af, safi, tptr, len, buf, sizeof(buf),
                     add_path4, add_path6);
@@ -2357,6 +2488,15 @@ bgp_attr_print(netdissect_options *ndo,
         add_path4 = check_add_path(ndo, tptr, (len-ND_BYTES_BETWEEN(tptr, pptr)), 32);
         add_path6 = check_add_path(ndo, tptr, (len-ND_BYTES_BETWEEN(tptr, pptr)), 128);
 
+        addrlen = bgp_prefix_addrlen(af, safi);
+        if (addrlen != 0 && tptr < pptr + len &&
+            ND_TTEST_LEN(tptr, len - ND_BYTES_BETWEEN(tptr, pptr)))
+            tptr += bgp_prefix_run(ndo, tptr,
+                                   len - ND_BYTES_BETWEEN(tptr, pptr),
+                                   addrlen,
+                                   addrlen == sizeof(nd_ipv4) ? add_path4 : add_path6,
+                                   "\n\t      ", buf, sizeof(buf), NULL);
+
         while (tptr < pptr + len) {
             advance = bgp_nlri_print(ndo, af, safi, tptr, len, buf, sizeof(buf),
                     add_path4, add_path6);
@@ -2925,6 +3065,7 @@ bgp_update_print(netdissect_options *ndo,
     int i;
     int add_path;
     u_int path_id = 0;
+    u_int npfx;
 
     ND_TCHECK_LEN(dat, BGP_SIZE);
     if (length < BGP_SIZE)
@@ -2950,6 +3091,12 @@ bgp_update_print(netdissect_options *ndo,
             goto trunc;
         ND_PRINT(C_RESET, "\n\t  Withdrawn routes:");
         add_path = check_add_path(ndo, p, withdrawn_routes_len, 32);
+        npfx = bgp_prefix_run(ndo, p, withdrawn_routes_len,
+                              sizeof(nd_ipv4), add_path, "\n\t    ",
+                              buf, sizeof(buf), NULL);
+        p += npfx;
+        length -= npfx;
+        withdrawn_routes_len -= npfx;
         while (withdrawn_routes_len != 0) {
             if (add_path) {
                 if (withdrawn_routes_len < 4) {
@@ -3068,6 +3215,13 @@ bgp_update_print(netdissect_options *ndo,
     if (length) {
         add_path = check_add_path(ndo, p, length, 32);
         ND_PRINT(C_RESET, "\n\t  Updated routes:");
+        if (ND_TTEST_LEN(p, length)) {
+            npfx = bgp_prefix_run(ndo, p, length, sizeof(nd_ipv4),
+                                  add_path, "\n\t    ",
+                                  buf, sizeof(buf), NULL);
+            p += npfx;
+            length -= npfx;
+        }
         while (length != 0) {
             if (add_path) {
                 ND_TCHECK_4(p);
@@ -3098,6 +3252,156 @@ trunc:
     nd_print_trunc(ndo);
 }
 
+/*
+ * bgp_nlri_summary_print
+ *
+ * Summary form of a withdrawn routes, NLRI or MP_(UN)REACH_NLRI prefix
+ * block: only the number of prefixes is reported.  NLRI encodings other
+ * than plain prefix lists are reported by size.
+ */
+static void
+bgp_nlri_summary_print(netdissect_options *ndo, const char *what,
+                       const u_char *pptr, u_int len, u_int addrlen)
+{
+    u_int consumed, count = 0;
+
+    if (addrlen == 0) {
+        ND_PRINT(C_RESET, "%s: %u byte%s", what, len, PLURAL_SUFFIX(len));
+        return;
+    }
+    ND_TCHECK_LEN(pptr, len);
+    consumed = bgp_prefix_run(ndo, pptr, len, addrlen,
+                              check_add_path(ndo, pptr, len, addrlen * 8),
+                              NULL, NULL, 0, &count);
+    ND_PRINT(C_RESET, "%s: %u prefix%s", what, count, count == 1 ? "" : "es");
+    if (consumed != len)
+        ND_PRINT(C_RESET, " (%u bytes undecoded)", len - consumed);
+    return;
+trunc:
+    nd_print_trunc(ndo);
+}
+
+/*
+ * bgp_update_summary_print
+ *
+ * With --summary, an UPDATE is reduced to its prefix counts per AFI/SAFI
+ * and the set of path attributes it carries; individual routes are not
+ * formatted.  This keeps full-table transfers readable (and fast) at -v.
+ */
+static void
+bgp_update_summary_print(netdissect_options *ndo,
+                         const u_char *dat, u_int length)
+{
+    const u_char *p, *ap;
+    u_int withdrawn_routes_len, len, alen, alenlen, nhlen, snpa;
+    uint8_t aflags, atype, safi;
+    uint16_t af;
+    const char *sep;
+
+    if (length < BGP_SIZE + 2)
+        goto trunc;
+    ND_TCHECK_LEN(dat, length);
+    p = dat + BGP_SIZE;
+    length -= BGP_SIZE;
+
+    withdrawn_routes_len = GET_BE_U_2(p);
+    p += 2;
+    length -= 2;
+    if (length < withdrawn_routes_len + 2)
+        goto trunc;
+    if (withdrawn_routes_len != 0)
+        bgp_nlri_summary_print(ndo, "\n\t  Withdrawn routes",
+                               p, withdrawn_routes_len, sizeof(nd_ipv4));
+    p += withdrawn_routes_len;
+    length -= withdrawn_routes_len;
+
+    len = GET_BE_U_2(p);
+    p += 2;
+    length -= 2;
+    if (withdrawn_routes_len == 0 && len == 0 && length == 0) {
+        ND_PRINT(C_RESET, "\n\t  End-of-Rib Marker (empty NLRI)");
+        return;
+    }
+    if (length < len)
+        goto trunc;
+
+    /* First pass: the attribute set. */
+    sep = "\n\t  Attributes: ";
+    for (ap = p; ap + 2 <= p + len; ap += alen) {
+        aflags = GET_U_1(ap);
+        atype = GET_U_1(ap + 1);
+        ap += 2;
+        alenlen = bgp_attr_lenlen(aflags, ap);
+        if (ap + alenlen > p + len)
+            break;
+        alen = bgp_attr_len(aflags, ap);
+        ap += alenlen;
+        if (ap + alen > p + len)
+            break;
+        ND_PRINT(C_RESET, "%s%s", sep,
+                 tok2str(bgp_attr_values, "Unknown Attribute (%u)", atype));
+        sep = ", ";
+    }
+    if (ap != p + len)
+        ND_PRINT(C_RESET, "\n\t  [path attrs too short]");
+
+    /* Second pass: prefix counts of the multiprotocol attributes. */
+    for (ap = p; ap + 2 <= p + len; ap += alen) {
+        aflags = GET_U_1(ap);
+        atype = GET_U_1(ap + 1);
+        ap += 2;
+        alenlen = bgp_attr_lenlen(aflags, ap);
+        if (ap + alenlen > p + len)
+            break;
+        alen = bgp_attr_len(aflags, ap);
+        ap += alenlen;
+        if (ap + alen > p + len)
+            break;
+        if (atype != BGPTYPE_MP_REACH_NLRI &&
+            atype != BGPTYPE_MP_UNREACH_NLRI)
+            continue;
+        if (alen < BGP_MP_NLRI_MINSIZE)
+            continue;
+        af = GET_BE_U_2(ap);
+        safi = GET_U_1(ap + 2);
+        ND_PRINT(C_RESET, "\n\t  %s AFI %s (%u), SAFI %s (%u)",
+                 atype == BGPTYPE_MP_REACH_NLRI ? "Reach" : "Unreach",
+                 tok2str(af_values, "Unknown AFI", af), af,
+                 tok2str(bgp_safi_values, "Unknown SAFI", safi), safi);
+        if (atype == BGPTYPE_MP_UNREACH_NLRI) {
+            bgp_nlri_summary_print(ndo, "", ap + 3, alen - 3,
+                                   bgp_prefix_addrlen(af, safi));
+            continue;
+        }
+        /* skip the nexthop and the (RFC 2858) SNPAs */
+        nhlen = 3;
+        if (nhlen + 1 > alen)
+            continue;
+        nhlen += 1 + GET_U_1(ap + nhlen);
+        if (nhlen + 1 > alen)
+            continue;
+        snpa = GET_U_1(ap + nhlen);
+        nhlen++;
+        while (snpa != 0 && nhlen + 1 <= alen) {
+            nhlen += 1 + GET_U_1(ap + nhlen);
+            snpa--;
+        }
+        if (snpa != 0 || nhlen > alen)
+            continue;
+        bgp_nlri_summary_print(ndo, "", ap + nhlen, alen - nhlen,
+                               bgp_prefix_addrlen(af, safi));
+    }
+    p += len;
+    length -= len;
+
+    if (length != 0)
+        bgp_nlri_summary_print(ndo, "\n\t  Updated routes",
+                               p, length, sizeof(nd_ipv4));
+    return;
+trunc:
+    nd_print_trunc(ndo);
+}
+
 static void
 bgp_notification_print_code(netdissect_options *ndo,
                             const u_char *dat, u_int length,
@@ -3298,7 +3602,10 @@ bgp_pdu_print(netdissect_options *ndo,
         bgp_open_print(ndo, dat, length);
         break;
     case BGP_UPDATE:
-        bgp_update_print(ndo, dat, length);
+        if (ndo->ndo_summary)
+            bgp_update_summary_print(ndo, dat, length);
+        else
+            bgp_update_print(ndo, dat, length);
         break;
     case BGP_NOTIFICATION:
         bgp_notification_print(ndo, dat, length);
@@ -52,6 +52,8 @@
 #include "extract.h"
 
 #include "tcp.h"
+#include "ip.h"
+#include "ip6.h"
 #include "ipproto.h"
 
 struct nfhdr_v1 {
@@ -152,8 +154,58 @@ struct nfrec_v6 {
 	nd_ipv4		peer_nexthop;	/* v6: IP address of the nexthop within the peer (FIB)*/
 };
 
+/*
+ * With --flow-export-summary, start summarizing a datagram from the
+ * exporter that sent it, per bp2, the IP header.
+ */
+static void
+cnfp_export_datagram(netdissect_options *ndo, const u_char *bp2,
+		     uint32_t engine, uint32_t seq, u_int nrecs)
+{
+	const struct ip *ip = (const struct ip *)bp2;
+	u_char addr[16];
+	u_int addrlen;
+
+	if (IP_V(ip) == 6) {
+		addrlen = 16;
+		GET_CPY_BYTES(addr, ((const struct ip6_hdr *)bp2)->ip6_src,
+		    addrlen);
+	} else {
+		addrlen = 4;
+		GET_CPY_BYTES(addr, ip->ip_src, addrlen);
+	}
+	flow_export_datagram(ndo, FLOW_EXPORT_NETFLOW, addr, addrlen, engine,
+	    seq, nrecs);
+}
+
+/*
+ * With --flow-export-summary, a record that isn't printed but added up.
+ */
+static void
+cnfp_export_flow(netdissect_options *ndo, const nd_ipv4 src,
+		 const nd_ipv4 dst, const nd_uint16_t sport,
+		 const nd_uint16_t dport, const nd_uint8_t proto,
+		 const nd_uint16_t input, const nd_uint16_t output,
+		 const nd_uint32_t packets, const nd_uint32_t octets)
+{
+	struct flow_export_flow rec;
+
+	rec.addrlen = 4;
+	GET_CPY_BYTES(rec.src, src, 4);
+	GET_CPY_BYTES(rec.dst, dst, 4);
+	rec.sport = GET_BE_U_2(sport);
+	rec.dport = GET_BE_U_2(dport);
+	rec.proto = GET_U_1(proto);
+	rec.input = GET_BE_U_2(input);
+	rec.output = GET_BE_U_2(output);
+	rec.packets = GET_BE_U_4(packets);
+	rec.bytes = GET_BE_U_4(octets);
+	flow_export_flow(ndo, &rec);
+}
+
 static void
-cnfp_v1_print(netdissect_options *ndo, const u_char *cp)
+cnfp_v1_print(netdissect_options *ndo, const u_char *cp,
+	      const u_char *bp2)
 {
 	const struct nfhdr_v1 *nh;
 	const struct nfrec_v1 *nr;
@@ -167,7 +219,7 @@ cnfp_v1_print(netdissect_options *ndo, const u_char *cp)
 	nh = (const struct nfhdr_v1 *)cp;
 
 	ver = GET_BE_U_2(nh->version);
-	nrecs = GET_BE_U_4(nh->count);
+	nrecs = GET_BE_U_2(nh->count);
 #if 0
 	/*
 	 * This is seconds since the UN*X epoch, and is followed by
@@ -186,6 +238,17 @@ cnfp_v1_print(netdissect_options *ndo, const u_char *cp)
 
 	ND_PRINT(C_RESET, "%2u recs", nrecs);
 
+	if (ndo->ndo_flow_export) {
+		cnfp_export_datagram(ndo, bp2, 0, 0, 0);
+		for (; nrecs != 0; nr++, nrecs--) {
+			cnfp_export_flow(ndo, nr->src_ina, nr->dst_ina,
+			    nr->srcport, nr->dstport, nr->proto, nr->input,
+			    nr->output, nr->packets, nr->octets);
+			ND_TCHECK_SIZE(nr);
+		}
+		return;
+	}
+
 	for (; nrecs != 0; nr++, nrecs--) {
 		ND_PRINT(C_RESET, "\n  started %u.%03u, last %u.%03u",
 		       GET_BE_U_4(nr->start_time)/1000,
@@ -228,7 +291,8 @@ cnfp_v1_print(netdissect_options *ndo, const u_char *cp)
 }
 
 static void
-cnfp_v5_print(netdissect_options *ndo, const u_char *cp)
+cnfp_v5_print(netdissect_options *ndo, const u_char *cp,
+	      const u_char *bp2)
 {
 	const struct nfhdr_v5 *nh;
 	const struct nfrec_v5 *nr;
@@ -242,7 +306,7 @@ cnfp_v5_print(netdissect_options *ndo, const u_char *cp)
 	nh = (const struct nfhdr_v5 *)cp;
 
 	ver = GET_BE_U_2(nh->version);
-	nrecs = GET_BE_U_4(nh->count);
+	nrecs = GET_BE_U_2(nh->count);
 #if 0
 	/*
 	 * This is seconds since the UN*X epoch, and is followed by
@@ -264,6 +328,18 @@ cnfp_v5_print(netdissect_options *ndo, const u_char *cp)
 
 	ND_PRINT(C_RESET, "%2u recs", nrecs);
 
+	if (ndo->ndo_flow_export) {
+		cnfp_export_datagram(ndo, bp2, GET_U_1(nh->engine_type) << 8 |
+		    GET_U_1(nh->engine_id), GET_BE_U_4(nh->sequence), nrecs);
+		for (; nrecs != 0; nr++, nrecs--) {
+			cnfp_export_flow(ndo, nr->src_ina, nr->dst_ina,
+			    nr->srcport, nr->dstport, nr->proto, nr->input,
+			    nr->output, nr->packets, nr->octets);
+			ND_TCHECK_SIZE(nr);
+		}
+		return;
+	}
+
 	for (; nrecs != 0; nr++, nrecs--) {
 		ND_PRINT(C_RESET, "\n  started %u.%03u, last %u.%03u",
 		       GET_BE_U_4(nr->start_time)/1000,
@@ -308,7 +384,8 @@ cnfp_v5_print(netdissect_options *ndo, const u_char *cp)
 }
 
 static void
-cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
+cnfp_v6_print(netdissect_options *ndo, const u_char *cp,
+	      const u_char *bp2)
 {
 	const struct nfhdr_v6 *nh;
 	const struct nfrec_v6 *nr;
@@ -322,7 +399,7 @@ cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
 	nh = (const struct nfhdr_v6 *)cp;
 
 	ver = GET_BE_U_2(nh->version);
-	nrecs = GET_BE_U_4(nh->count);
+	nrecs = GET_BE_U_2(nh->count);
 #if 0
 	/*
 	 * This is seconds since the UN*X epoch, and is followed by
@@ -344,6 +421,17 @@ cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
 
 	ND_PRINT(C_RESET, "%2u recs", nrecs);
 
+	if (ndo->ndo_flow_export) {
+		cnfp_export_datagram(ndo, bp2, 0, GET_BE_U_4(nh->sequence), nrecs);
+		for (; nrecs != 0; nr++, nrecs--) {
+			cnfp_export_flow(ndo, nr->src_ina, nr->dst_ina,
+			    nr->srcport, nr->dstport, nr->proto, nr->input,
+			    nr->output, nr->packets, nr->octets);
+			ND_TCHECK_SIZE(nr);
+		}
+		return;
+	}
+
 	for (; nrecs != 0; nr++, nrecs--) {
 		ND_PRINT(C_RESET, "\n  started %u.%03u, last %u.%03u",
 		       GET_BE_U_4(nr->start_time)/1000,
@@ -390,7 +478,7 @@ cnfp_v6_print(netdissect_options *ndo, const u_char *cp)
 }
 
 void
-cnfp_print(netdissect_options *ndo, const u_char *cp)
+cnfp_print(netdissect_options *ndo, const u_char *cp, const u_char *bp2)
 {
 	int ver;
 
@@ -402,15 +490,15 @@ cnfp_print(netdissect_options *ndo, const u_char *cp)
 	switch (ver) {
 
 	case 1:
-		cnfp_v1_print(ndo, cp);
+		cnfp_v1_print(ndo, cp, bp2);
 		break;
 
 	case 5:
-		cnfp_v5_print(ndo, cp);
+		cnfp_v5_print(ndo, cp, bp2);
 		break;
 
 	case 6:
-		cnfp_v6_print(ndo, cp);
+		cnfp_v6_print(ndo, cp, bp2);
 		break;
 
 	default:
@@ -34,6 +34,8 @@
 #include "addrtostr.h"
 #include "extract.h"
 
+#include "ip.h"
+#include "ip6.h"
 #include "nameser.h"
 
 static const char *ns_ops[] = {
@@ -51,7 +53,9 @@ static const char *ns_resp[] = {
 	" Resp20", "Resp21", " Resp22", " BadCookie",
 };
 
-static const char *
+extern const char *ns_rcode(u_int);
+
+const char *
 ns_rcode(u_int rcode) {
 	static char buf[sizeof(" Resp4095")];
 
@@ -899,12 +903,45 @@ ns_rprint(netdissect_options *ndo,
 	return (rp);		/* XXX This isn't always right */
 }
 
+/*
+ * With --dns-analysis, match queries and responses; bp2 is the IP
+ * header, for the addresses.
+ */
+static void
+domain_analyze(netdissect_options *ndo, const u_char *bp2, uint16_t sport,
+	       uint16_t dport, uint16_t id, uint16_t flags, u_int rcode,
+	       u_int qtype)
+{
+	const struct ip *ip = (const struct ip *)bp2;
+	const struct ip6_hdr *ip6;
+	struct dns_analysis_msg m;
+
+	if (IP_V(ip) == 6) {
+		ip6 = (const struct ip6_hdr *)bp2;
+		m.src = ip6->ip6_src;
+		m.dst = ip6->ip6_dst;
+		m.addrlen = 16;
+	} else {
+		m.src = ip->ip_src;
+		m.dst = ip->ip_dst;
+		m.addrlen = 4;
+	}
+	m.sport = sport;
+	m.dport = dport;
+	m.id = id;
+	m.response = DNS_QR(flags) != 0;
+	m.rcode = rcode;
+	m.qtype = qtype;
+	dns_analysis_message(ndo, &m);
+}
+
 void
 domain_print(netdissect_options *ndo,
-             const u_char *bp, u_int length, int over_tcp, int is_mdns)
+             const u_char *bp, u_int length, int over_tcp, int is_mdns,
+             uint16_t sport, uint16_t dport, const u_char *bp2)
 {
 	const dns_header_t *np;
-	uint16_t flags, rcode, rdlen, type;
+	uint16_t flags, rcode, rdlen, type, qtype;
 	u_int qdcount, ancount, nscount, arcount;
 	u_int i;
 	const u_char *cp;
@@ -959,9 +996,12 @@ domain_print(netdissect_options *ndo,
 	/* find the opt record to extract extended rcode */
 	cp = (const u_char *)(np + 1);
 	rcode = DNS_RCODE(flags);
+	qtype = 0;
 	for (i = 0; i < qdcount; i++) {
 		if ((cp = ns_nskip(ndo, cp)) == NULL)
 			goto print;
+		if (i == 0 && cp + 2 <= ndo->ndo_snapend)
+			qtype = GET_BE_U_2(cp);
 		cp += 4;	/* skip QTYPE and QCLASS */
 		if (cp >= ndo->ndo_snapend)
 			goto print;
@@ -1000,6 +1040,9 @@ domain_print(netdissect_options *ndo,
 	}
 
  print:
+	if (ndo->ndo_dns_analysis && !is_mdns)
+		domain_analyze(ndo, bp2, sport, dport, GET_BE_U_2(np->id),
+		    flags, rcode, qtype);
 	if (DNS_QR(flags)) {
 		/* this is a response */
 		ND_PRINT(C_RESET, "%u%s%s%s%s%s%s",
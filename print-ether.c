@@ -42,6 +42,14 @@ struct	ether_header {
 	nd_uint16_t	ether_length_type;
 };
 
+/*
+ * Structure of the rest of an 802.1Q tag, after its TPID.
+ */
+struct	vlan_tag {
+	nd_uint16_t	vlan_tci;
+	nd_uint16_t	vlan_length_type;	/* of what it encapsulates */
+};
+
 /*
  * Length of an Ethernet header; note that some compilers may pad
  * "struct ether_header" to a multiple of 4 bytes, for example, so
@@ -143,6 +151,7 @@ ether_common_print(netdissect_options *ndo, const u_char *p, u_int length,
     const u_char *encap_header_arg)
 {
 	const struct ether_header *ehp;
+	const struct vlan_tag *vtp;
 	u_int orig_length;
 	u_int hdrlen;
 	u_short length_type;
@@ -268,8 +277,10 @@ recurse:
 			nd_print_trunc(ndo);
 			return hdrlen + length;
 		}
+		vtp = (const struct vlan_tag *)p;
+		ND_SPAN_CHECK(vtp);
 		if (ndo->ndo_eflag) {
-			uint16_t tag = GET_BE_U_2(p);
+			uint16_t tag = SPAN_BE_U_2(vtp, vlan_tci);
 
 			ether_type_print(ndo, length_type);
 			if (!printed_length) {
@@ -280,7 +291,7 @@ recurse:
 			 ND_PRINT(C_RESET, "%s, ", ieee8021q_tci_string(tag));
 		}
 
-		length_type = GET_BE_U_2(p + 2);
+		length_type = SPAN_BE_U_2(vtp, vlan_length_type);
 		p += 4;
 		length -= 4;
 		caplen -= 4;
@@ -459,7 +470,14 @@ void
 ether_if_print(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	       const u_char *p)
 {
+	u_int hdrlen;
+
 	ndo->ndo_protocol = "ether";
+	if (ndo->ndo_quick &&
+	    (hdrlen = nd_quick_ether_print(ndo, p, h->len, h->caplen)) != 0) {
+		ndo->ndo_ll_hdr_len += hdrlen;
+		return;
+	}
 	ndo->ndo_ll_hdr_len +=
 		ether_print(ndo, p, h->len, h->caplen, NULL, NULL);
 }
@@ -517,15 +535,63 @@ netanalyzer_transparent_if_print(netdissect_options *ndo,
 		ether_print(ndo, p + 12, h->len - 12, h->caplen - 12, NULL, NULL);
 }
 
+/*
+ * The dissectors ethertype_print() hands off to, for --disable-dissector.
+ */
+static const struct nd_key_dissector ethertype_dissectors[] = {
+	{ ETHERTYPE_IP,		"ip" },
+	{ ETHERTYPE_IPV6,	"ip6" },
+	{ ETHERTYPE_ARP,	"arp" },
+	{ ETHERTYPE_REVARP,	"arp" },
+	{ ETHERTYPE_DN,		"decnet" },
+	{ ETHERTYPE_ATALK,	"atalk" },
+	{ ETHERTYPE_AARP,	"atalk" },
+	{ ETHERTYPE_IPX,	"ipx" },
+	{ ETHERTYPE_ISO,	"isoclns" },
+	{ ETHERTYPE_PPPOED,	"pppoe" },
+	{ ETHERTYPE_PPPOES,	"pppoe" },
+	{ ETHERTYPE_PPPOED2,	"pppoe" },
+	{ ETHERTYPE_PPPOES2,	"pppoe" },
+	{ ETHERTYPE_EAPOL,	"eapol" },
+	{ ETHERTYPE_REALTEK,	"realtek" },
+	{ ETHERTYPE_PPP,	"ppp" },
+	{ ETHERTYPE_MPCP,	"mpcp" },
+	{ ETHERTYPE_SLOW,	"slow" },
+	{ ETHERTYPE_CFM,	"cfm" },
+	{ ETHERTYPE_CFM_OLD,	"cfm" },
+	{ ETHERTYPE_LLDP,	"lldp" },
+	{ ETHERTYPE_NSH,	"nsh" },
+	{ ETHERTYPE_LOOPBACK,	"loopback" },
+	{ ETHERTYPE_MPLS,	"mpls" },
+	{ ETHERTYPE_MPLS_MULTI,	"mpls" },
+	{ ETHERTYPE_TIPC,	"tipc" },
+	{ ETHERTYPE_MS_NLB_HB,	"msnlb" },
+	{ ETHERTYPE_GEONET_OLD,	"geonet" },
+	{ ETHERTYPE_GEONET,	"geonet" },
+	{ ETHERTYPE_CALM_FAST,	"calm-fast" },
+	{ ETHERTYPE_AOE,	"aoe" },
+	{ ETHERTYPE_PTP,	"ptp" },
+};
+
+static uint8_t ethertype_disabled[65536];
+
+void
+ether_init_dissectors(void)
+{
+	nd_key_table_init(ethertype_disabled, ethertype_dissectors,
+	    sizeof(ethertype_dissectors) / sizeof(ethertype_dissectors[0]));
+}
+
 /*
  * Prints the packet payload, given an Ethernet type code for the payload's
  * protocol.
  *
- * Returns non-zero if it can do so, zero if the ethertype is unknown.
+ * Returns non-zero if it can do so, zero if the ethertype is unknown
+ * or its dissector has been disabled.
  */
 
-int
-ethertype_print(netdissect_options *ndo,
+static int
+ethertype_print_1(netdissect_options *ndo,
 		u_short ether_type, const u_char *p,
 		u_int length, u_int caplen,
 		const struct lladdr_info *src, const struct lladdr_info *dst)
@@ -663,3 +729,22 @@ ethertype_print(netdissect_options *ndo,
 		return (0);
 	}
 }
+
+int
+ethertype_print(netdissect_options *ndo,
+		u_short ether_type, const u_char *p,
+		u_int length, u_int caplen,
+		const struct lladdr_info *src, const struct lladdr_info *dst)
+{
+	int ret;
+
+	if (ethertype_disabled[ether_type])
+		return (0);
+	if (!ndo->ndo_profile)
+		return ethertype_print_1(ndo, ether_type, p, length, caplen,
+		    src, dst);
+	nd_profile_enter(ndo, ND_PROFILE_ETHERTYPE, ether_type, length);
+	ret = ethertype_print_1(ndo, ether_type, p, length, caplen, src, dst);
+	nd_profile_exit(ndo);
+	return ret;
+}
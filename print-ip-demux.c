@@ -34,18 +34,71 @@
 #include "ip.h"
 #include "ipproto.h"
 
+/*
+ * The dissectors ip_demux_print() hands off to, for --disable-dissector.
+ */
+static const struct nd_key_dissector ip_demux_dissectors[] = {
+	{ IPPROTO_AH,		"ah" },
+	{ IPPROTO_ESP,		"esp" },
+	{ IPPROTO_IPCOMP,	"ipcomp" },
+	{ IPPROTO_SCTP,		"sctp" },
+	{ IPPROTO_DCCP,		"dccp" },
+	{ IPPROTO_TCP,		"tcp" },
+	{ IPPROTO_UDP,		"udp" },
+	{ IPPROTO_ICMP,		"icmp" },
+	{ IPPROTO_ICMPV6,	"icmp6" },
+	{ IPPROTO_PIGP,		"igrp" },
+	{ IPPROTO_EIGRP,	"eigrp" },
+	{ IPPROTO_EGP,		"egp" },
+	{ IPPROTO_OSPF,		"ospf" },
+	{ IPPROTO_IGMP,		"igmp" },
+	{ IPPROTO_IPV4,		"ip" },
+	{ IPPROTO_IPV6,		"ip6" },
+	{ IPPROTO_RSVP,		"rsvp" },
+	{ IPPROTO_GRE,		"gre" },
+	{ IPPROTO_MOBILE,	"mobile" },
+	{ IPPROTO_PIM,		"pim" },
+	{ IPPROTO_VRRP,		"vrrp" },
+	{ IPPROTO_PGM,		"pgm" },
+	{ IPPROTO_ETHERNET,	"ether" },
+};
+
+static uint8_t ip_demux_disabled[256];
+
 void
-ip_demux_print(netdissect_options *ndo,
+ip_demux_init_dissectors(void)
+{
+	nd_key_table_init(ip_demux_disabled, ip_demux_dissectors,
+	    sizeof(ip_demux_dissectors) / sizeof(ip_demux_dissectors[0]));
+}
+
+static void
+ip_demux_print_unknown(netdissect_options *ndo, u_int length, uint8_t nh)
+{
+	const char *p_name;
+
+	if (ndo->ndo_nflag==0 && (p_name = netdb_protoname(nh)) != NULL)
+		ND_PRINT(C_RESET, " %s", p_name);
+	else
+		ND_PRINT(C_RESET, " ip-proto-%u", nh);
+	ND_PRINT(C_RESET, " %u", length);
+}
+
+static void
+ip_demux_print_1(netdissect_options *ndo,
 	       const u_char *bp,
 	       u_int length, u_int ver, int fragmented, u_int ttl_hl,
 	       uint8_t nh, const u_char *iph)
 {
 	int advance;
-	const char *p_name;
 
 	advance = 0;
 
 again:
+	if (ip_demux_disabled[nh]) {
+		ip_demux_print_unknown(ndo, length, nh);
+		return;
+	}
 	switch (nh) {
 
 	case IPPROTO_AH:
@@ -221,11 +274,23 @@ again:
 		break;
 
 	default:
-		if (ndo->ndo_nflag==0 && (p_name = netdb_protoname(nh)) != NULL)
-			ND_PRINT(C_RESET, " %s", p_name);
-		else
-			ND_PRINT(C_RESET, " ip-proto-%u", nh);
-		ND_PRINT(C_RESET, " %u", length);
+		ip_demux_print_unknown(ndo, length, nh);
 		break;
 	}
 }
+
+void
+ip_demux_print(netdissect_options *ndo,
+	       const u_char *bp,
+	       u_int length, u_int ver, int fragmented, u_int ttl_hl,
+	       uint8_t nh, const u_char *iph)
+{
+	if (!ndo->ndo_profile) {
+		ip_demux_print_1(ndo, bp, length, ver, fragmented, ttl_hl,
+		    nh, iph);
+		return;
+	}
+	nd_profile_enter(ndo, ND_PROFILE_IP, nh, length);
+	ip_demux_print_1(ndo, bp, length, ver, fragmented, ttl_hl, nh, iph);
+	nd_profile_exit(ndo);
+}
@@ -343,6 +343,10 @@ ip_print(netdissect_options *ndo,
 	if (!ndo->ndo_eflag)
 		ND_PRINT(C_RESET, "IP ");
 
+	/*
+	 * All of the fixed-length part of the header is there, so its
+	 * fields can be read with the SPAN_ macros from here on.
+	 */
 	ND_TCHECK_SIZE(ip);
 	if (length < sizeof (struct ip)) {
 		ND_PRINT(C_RESET, "truncated-ip %u", length);
@@ -354,7 +358,7 @@ ip_print(netdissect_options *ndo,
 		return;
 	}
 
-	len = GET_BE_U_2(ip->ip_len);
+	len = SPAN_BE_U_2(ip, ip_len);
 	if (length < len)
 		ND_PRINT(C_RESET, "truncated-ip - %u bytes missing! ",
 			len - length);
@@ -384,12 +388,12 @@ ip_print(netdissect_options *ndo,
 
 	len -= hlen;
 
-	off = GET_BE_U_2(ip->ip_off);
+	off = SPAN_BE_U_2(ip, ip_off);
 
-        ip_proto = GET_U_1(ip->ip_p);
+        ip_proto = SPAN_U_1(ip, ip_p);
 
         if (ndo->ndo_vflag) {
-            ip_tos = GET_U_1(ip->ip_tos);
+            ip_tos = SPAN_U_1(ip, ip_tos);
             ND_PRINT(C_RESET, "(tos 0x%x", ip_tos);
             /* ECN bits */
             switch (ip_tos & 0x03) {
@@ -410,7 +414,7 @@ ip_print(netdissect_options *ndo,
                 break;
             }
 
-            ip_ttl = GET_U_1(ip->ip_ttl);
+            ip_ttl = SPAN_U_1(ip, ip_ttl);
             if (ip_ttl >= 1)
                 ND_PRINT(C_RESET, ", ttl %u", ip_ttl);
 
@@ -420,13 +424,13 @@ ip_print(netdissect_options *ndo,
 	     * For unfragmented datagrams, note the don't fragment flag.
 	     */
 	    ND_PRINT(C_RESET, ", id %u, offset %u, flags [%s], proto %s (%u)",
-                         GET_BE_U_2(ip->ip_id),
+                         SPAN_BE_U_2(ip, ip_id),
                          (off & IP_OFFMASK) * 8,
                          bittok2str(ip_frag_values, "none", off & (IP_RES|IP_DF|IP_MF)),
                          tok2str(ipproto_values, "unknown", ip_proto),
                          ip_proto);
 
-            ND_PRINT(C_RESET, ", length %u", GET_BE_U_2(ip->ip_len));
+            ND_PRINT(C_RESET, ", length %u", SPAN_BE_U_2(ip, ip_len));
 
             if ((hlen - sizeof(struct ip)) > 0) {
                 ND_PRINT(C_RESET, ", options (");
@@ -443,7 +447,7 @@ ip_print(netdissect_options *ndo,
 	        vec[0].len = hlen;
 	        sum = in_cksum(vec, 1);
 		if (sum != 0) {
-		    ip_sum = GET_BE_U_2(ip->ip_sum);
+		    ip_sum = SPAN_BE_U_2(ip, ip_sum);
 		    ND_PRINT(C_RESET, ", bad cksum %x (->%x)!", ip_sum,
 			     in_cksum_shouldbe(ip_sum, sum));
 		}
@@ -452,8 +456,8 @@ ip_print(netdissect_options *ndo,
 	    ND_PRINT(C_RESET, ")\n    ");
 	    if (truncated) {
 		ND_PRINT(C_RESET, "%s > %s: ",
-			 GET_IPADDR_STRING(ip->ip_src),
-			 GET_IPADDR_STRING(ip->ip_dst));
+			 SPAN_IPADDR_STRING(ip, ip_src),
+			 SPAN_IPADDR_STRING(ip, ip_dst));
 		nd_print_trunc(ndo);
 		nd_pop_packet_info(ndo);
 		return;
@@ -466,13 +470,13 @@ ip_print(netdissect_options *ndo,
 	 * fragments.
 	 */
 	if ((off & IP_OFFMASK) == 0) {
-		uint8_t nh = GET_U_1(ip->ip_p);
+		uint8_t nh = SPAN_U_1(ip, ip_p);
 
 		if (nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
 		    nh != IPPROTO_SCTP && nh != IPPROTO_DCCP) {
 			ND_PRINT(C_RESET, "%s > %s: ",
-				     GET_IPADDR_STRING(ip->ip_src),
-				     GET_IPADDR_STRING(ip->ip_dst));
+				     SPAN_IPADDR_STRING(ip, ip_src),
+				     SPAN_IPADDR_STRING(ip, ip_dst));
 		}
 		/*
 		 * Do a bounds check before calling ip_demux_print().
@@ -485,7 +489,7 @@ ip_print(netdissect_options *ndo,
 			nd_trunc_longjmp(ndo);
 		}
 		ip_demux_print(ndo, (const u_char *)ip + hlen, len, 4,
-			       off & IP_MF, GET_U_1(ip->ip_ttl), nh, bp);
+			       off & IP_MF, SPAN_U_1(ip, ip_ttl), nh, bp);
 	} else {
 		/*
 		 * Ultra quiet now means that all this stuff should be
@@ -501,8 +505,8 @@ ip_print(netdissect_options *ndo,
 		 * next level protocol header.  print the ip addr
 		 * and the protocol.
 		 */
-		ND_PRINT(C_RESET, "%s > %s:", GET_IPADDR_STRING(ip->ip_src),
-		          GET_IPADDR_STRING(ip->ip_dst));
+		ND_PRINT(C_RESET, "%s > %s:", SPAN_IPADDR_STRING(ip, ip_src),
+		          SPAN_IPADDR_STRING(ip, ip_dst));
 		if (!ndo->ndo_nflag && (p_name = netdb_protoname(ip_proto)) != NULL)
 			ND_PRINT(C_RESET, " %s", p_name);
 		else
@@ -255,7 +255,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	  return;
 	}
 
-	payload_len = GET_BE_U_2(ip6->ip6_plen);
+	payload_len = SPAN_BE_U_2(ip6, ip6_plen);
 	/*
 	 * RFC 1883 says:
 	 *
@@ -287,9 +287,9 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 		len = length + sizeof(struct ip6_hdr);
 
 	ph = 255;
-	nh = GET_U_1(ip6->ip6_nxt);
+	nh = SPAN_U_1(ip6, ip6_nxt);
 	if (ndo->ndo_vflag) {
-	    flow = GET_BE_U_4(ip6->ip6_flow);
+	    flow = SPAN_BE_U_4(ip6, ip6_flow);
 	    ND_PRINT(C_RESET, "(");
 	    /* RFC 2460 */
 	    if (flow & 0x0ff00000)
@@ -298,7 +298,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 	        ND_PRINT(C_RESET, "flowlabel 0x%05x, ", flow & 0x000fffff);
 
 	    ND_PRINT(C_RESET, "hlim %u, next-header %s (%u) payload length: %u) ",
-	                 GET_U_1(ip6->ip6_hlim),
+	                 SPAN_U_1(ip6, ip6_hlim),
 	                 tok2str(ipproto_values,"unknown",nh),
 	                 nh,
 	                 payload_len);
@@ -329,8 +329,8 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 		if (cp == (const u_char *)(ip6 + 1) &&
 		    nh != IPPROTO_TCP && nh != IPPROTO_UDP &&
 		    nh != IPPROTO_DCCP && nh != IPPROTO_SCTP) {
-			ND_PRINT(C_RESET, "%s > %s: ", GET_IP6ADDR_STRING(ip6->ip6_src),
-				     GET_IP6ADDR_STRING(ip6->ip6_dst));
+			ND_PRINT(C_RESET, "%s > %s: ", SPAN_IP6ADDR_STRING(ip6, ip6_src),
+				     SPAN_IP6ADDR_STRING(ip6, ip6_dst));
 		}
 
 		switch (nh) {
@@ -485,7 +485,7 @@ ip6_print(netdissect_options *ndo, const u_char *bp, u_int length)
 				}
 			}
 			ip_demux_print(ndo, cp, len, 6, fragmented,
-				       GET_U_1(ip6->ip6_hlim), nh, bp);
+				       SPAN_U_1(ip6, ip6_hlim), nh, bp);
 			nd_pop_packet_info(ndo);
 			return;
 		}
@@ -31,6 +31,10 @@
 #include "netdissect.h"
 #include "extract.h"
 #include "addrtoname.h"
+#include "ethertype.h"
+#include "ip.h"
+#include "ip6.h"
+#include "ipproto.h"
 
 /*
  * sFlow datagram
@@ -189,6 +193,28 @@ struct sflow_extended_switch_data_t {
     nd_uint32_t dst_pri;
 };
 
+struct sflow_ipv4_data_t {
+    nd_uint32_t length;
+    nd_uint32_t protocol;
+    nd_ipv4     src_ip;
+    nd_ipv4     dst_ip;
+    nd_uint32_t src_port;
+    nd_uint32_t dst_port;
+    nd_uint32_t tcp_flags;
+    nd_uint32_t tos;
+};
+
+struct sflow_ipv6_data_t {
+    nd_uint32_t length;
+    nd_uint32_t protocol;
+    nd_ipv6     src_ip;
+    nd_ipv6     dst_ip;
+    nd_uint32_t src_port;
+    nd_uint32_t dst_port;
+    nd_uint32_t tcp_flags;
+    nd_uint32_t priority;
+};
+
 struct sflow_counter_record_t {
     nd_uint32_t    format;
     nd_uint32_t    length;
@@ -811,6 +837,325 @@ sflow_print_expanded_flow_sample(netdissect_options *ndo,
 				    nrecords);
 }
 
+/*
+ * With --flow-export-summary, the samples are decoded into the summary
+ * rather than printed.
+ */
+
+/*
+ * Take the addresses, protocol and ports of a sampled packet from the
+ * first "len" bytes of its headers.
+ */
+static void
+sflow_export_header(netdissect_options *ndo, u_int protocol,
+                    const u_char *p, u_int len, struct flow_export_flow *rec)
+{
+    const struct ip *ip;
+    const struct ip6_hdr *ip6;
+    u_int ethertype, hlen;
+
+    if (protocol == SFLOW_HEADER_PROTOCOL_ETHERNET) {
+	if (len < 14)
+	    return;
+	ethertype = GET_BE_U_2(p + 12);
+	p += 14;
+	len -= 14;
+	while ((ethertype == ETHERTYPE_8021Q ||
+	        ethertype == ETHERTYPE_8021QinQ) && len >= 4) {
+	    ethertype = GET_BE_U_2(p + 2);
+	    p += 4;
+	    len -= 4;
+	}
+	if (ethertype == ETHERTYPE_IP)
+	    protocol = SFLOW_HEADER_PROTOCOL_IPV4;
+	else if (ethertype == ETHERTYPE_IPV6)
+	    protocol = SFLOW_HEADER_PROTOCOL_IPV6;
+	else
+	    return;
+    }
+
+    switch (protocol) {
+    case SFLOW_HEADER_PROTOCOL_IPV4:
+	ip = (const struct ip *)p;
+	if (len < sizeof(struct ip) || IP_V(ip) != 4)
+	    return;
+	rec->addrlen = 4;
+	GET_CPY_BYTES(rec->src, ip->ip_src, 4);
+	GET_CPY_BYTES(rec->dst, ip->ip_dst, 4);
+	rec->proto = GET_U_1(ip->ip_p);
+	/* Only the first fragment has the ports */
+	if (GET_BE_U_2(ip->ip_off) & IP_OFFMASK)
+	    return;
+	hlen = IP_HL(ip) * 4;
+	break;
+    case SFLOW_HEADER_PROTOCOL_IPV6:
+	ip6 = (const struct ip6_hdr *)p;
+	if (len < sizeof(struct ip6_hdr) || IP6_VERSION(ip6) != 6)
+	    return;
+	rec->addrlen = 16;
+	GET_CPY_BYTES(rec->src, ip6->ip6_src, 16);
+	GET_CPY_BYTES(rec->dst, ip6->ip6_dst, 16);
+	rec->proto = GET_U_1(ip6->ip6_nxt);
+	hlen = sizeof(struct ip6_hdr);
+	break;
+    default:
+	return;
+    }
+    if ((rec->proto == IPPROTO_TCP || rec->proto == IPPROTO_UDP ||
+         rec->proto == IPPROTO_SCTP) && len >= hlen + 4) {
+	rec->sport = GET_BE_U_2(p + hlen);
+	rec->dport = GET_BE_U_2(p + hlen + 2);
+    }
+}
+
+/*
+ * A flow sample stands for "rate" packets like the one sampled; take
+ * what's known of it from the first record that tells.
+ */
+static int
+sflow_export_flow_sample(netdissect_options *ndo,
+                         const u_char *pointer, u_int len, int expanded)
+{
+    const struct sflow_flow_sample_t *sflow_flow_sample;
+    const struct sflow_expanded_flow_sample_t *sflow_expanded_flow_sample;
+    const struct sflow_flow_record_t *sflow_flow_record;
+    const struct sflow_expanded_flow_raw_t *sflow_flow_raw;
+    const struct sflow_ipv4_data_t *sflow_ipv4_data;
+    const struct sflow_ipv6_data_t *sflow_ipv6_data;
+    struct flow_export_flow rec;
+    u_int nrecords, rate, enterprise, flow_type, flow_len, header_size;
+    int found;
+
+    memset(&rec, 0, sizeof(rec));
+    if (expanded) {
+	if (len < sizeof(struct sflow_expanded_flow_sample_t))
+	    return 1;
+	sflow_expanded_flow_sample = (const struct sflow_expanded_flow_sample_t *)pointer;
+	rate = GET_BE_U_4(sflow_expanded_flow_sample->rate);
+	rec.input = GET_BE_U_4(sflow_expanded_flow_sample->in_interface_value);
+	rec.output = GET_BE_U_4(sflow_expanded_flow_sample->out_interface_value);
+	nrecords = GET_BE_U_4(sflow_expanded_flow_sample->records);
+	pointer += sizeof(struct sflow_expanded_flow_sample_t);
+	len -= sizeof(struct sflow_expanded_flow_sample_t);
+    } else {
+	if (len < sizeof(struct sflow_flow_sample_t))
+	    return 1;
+	sflow_flow_sample = (const struct sflow_flow_sample_t *)pointer;
+	rate = GET_BE_U_4(sflow_flow_sample->rate);
+	/* The top 2 bits are the format of the rest */
+	rec.input = GET_BE_U_4(sflow_flow_sample->in_interface) & 0x3FFFFFFF;
+	rec.output = GET_BE_U_4(sflow_flow_sample->out_interface) & 0x3FFFFFFF;
+	nrecords = GET_BE_U_4(sflow_flow_sample->records);
+	pointer += sizeof(struct sflow_flow_sample_t);
+	len -= sizeof(struct sflow_flow_sample_t);
+    }
+    rec.packets = rate;
+
+    found = 0;
+    while (nrecords > 0 && !found) {
+	if (len < sizeof(struct sflow_flow_record_t))
+	    return 1;
+	sflow_flow_record = (const struct sflow_flow_record_t *)pointer;
+	enterprise = GET_BE_U_4(sflow_flow_record->format);
+	flow_type = enterprise & 0x0FFF;
+	enterprise = enterprise >> 12;
+	flow_len = GET_BE_U_4(sflow_flow_record->length);
+	pointer += sizeof(struct sflow_flow_record_t);
+	len -= sizeof(struct sflow_flow_record_t);
+	if (len < flow_len)
+	    return 1;
+
+	if (enterprise == 0) {
+	    switch (flow_type) {
+	    case SFLOW_FLOW_RAW_PACKET:
+		if (flow_len < sizeof(struct sflow_expanded_flow_raw_t))
+		    return 1;
+		sflow_flow_raw = (const struct sflow_expanded_flow_raw_t *)pointer;
+		rec.bytes = (uint64_t)GET_BE_U_4(sflow_flow_raw->length) * rate;
+		header_size = GET_BE_U_4(sflow_flow_raw->header_size);
+		if (header_size > flow_len - sizeof(struct sflow_expanded_flow_raw_t))
+		    header_size = flow_len - sizeof(struct sflow_expanded_flow_raw_t);
+		sflow_export_header(ndo, GET_BE_U_4(sflow_flow_raw->protocol),
+				    pointer + sizeof(struct sflow_expanded_flow_raw_t),
+				    header_size, &rec);
+		found = 1;
+		break;
+	    case SFLOW_FLOW_IPV4_DATA:
+		if (flow_len < sizeof(struct sflow_ipv4_data_t))
+		    return 1;
+		sflow_ipv4_data = (const struct sflow_ipv4_data_t *)pointer;
+		rec.bytes = (uint64_t)GET_BE_U_4(sflow_ipv4_data->length) * rate;
+		rec.addrlen = 4;
+		GET_CPY_BYTES(rec.src, sflow_ipv4_data->src_ip, 4);
+		GET_CPY_BYTES(rec.dst, sflow_ipv4_data->dst_ip, 4);
+		rec.proto = GET_BE_U_4(sflow_ipv4_data->protocol);
+		rec.sport = (uint16_t)GET_BE_U_4(sflow_ipv4_data->src_port);
+		rec.dport = (uint16_t)GET_BE_U_4(sflow_ipv4_data->dst_port);
+		found = 1;
+		break;
+	    case SFLOW_FLOW_IPV6_DATA:
+		if (flow_len < sizeof(struct sflow_ipv6_data_t))
+		    return 1;
+		sflow_ipv6_data = (const struct sflow_ipv6_data_t *)pointer;
+		rec.bytes = (uint64_t)GET_BE_U_4(sflow_ipv6_data->length) * rate;
+		rec.addrlen = 16;
+		GET_CPY_BYTES(rec.src, sflow_ipv6_data->src_ip, 16);
+		GET_CPY_BYTES(rec.dst, sflow_ipv6_data->dst_ip, 16);
+		rec.proto = GET_BE_U_4(sflow_ipv6_data->protocol);
+		rec.sport = (uint16_t)GET_BE_U_4(sflow_ipv6_data->src_port);
+		rec.dport = (uint16_t)GET_BE_U_4(sflow_ipv6_data->dst_port);
+		found = 1;
+		break;
+	    }
+	}
+	pointer += flow_len;
+	len -= flow_len;
+	nrecords--;
+    }
+    flow_export_flow(ndo, &rec);
+    return 0;
+}
+
+static int
+sflow_export_counter_sample(netdissect_options *ndo,
+                            const u_char *pointer, u_int len, int expanded)
+{
+    const struct sflow_counter_record_t *sflow_counter_record;
+    const struct sflow_generic_counter_t *sflow_gen_counter;
+    uint64_t counters[FLOW_EXPORT_COUNTERS];
+    u_int nrecords, enterprise, counter_type, counter_len;
+
+    if (expanded) {
+	if (len < sizeof(struct sflow_expanded_counter_sample_t))
+	    return 1;
+	nrecords = GET_BE_U_4(((const struct sflow_expanded_counter_sample_t *)pointer)->records);
+	pointer += sizeof(struct sflow_expanded_counter_sample_t);
+	len -= sizeof(struct sflow_expanded_counter_sample_t);
+    } else {
+	if (len < sizeof(struct sflow_counter_sample_t))
+	    return 1;
+	nrecords = GET_BE_U_4(((const struct sflow_counter_sample_t *)pointer)->records);
+	pointer += sizeof(struct sflow_counter_sample_t);
+	len -= sizeof(struct sflow_counter_sample_t);
+    }
+
+    while (nrecords > 0) {
+	if (len < sizeof(struct sflow_counter_record_t))
+	    return 1;
+	sflow_counter_record = (const struct sflow_counter_record_t *)pointer;
+	enterprise = GET_BE_U_4(sflow_counter_record->format);
+	counter_type = enterprise & 0x0FFF;
+	enterprise = enterprise >> 12;
+	counter_len = GET_BE_U_4(sflow_counter_record->length);
+	pointer += sizeof(struct sflow_counter_record_t);
+	len -= sizeof(struct sflow_counter_record_t);
+	if (len < counter_len)
+	    return 1;
+
+	if (enterprise == 0 && counter_type == SFLOW_COUNTER_GENERIC) {
+	    if (counter_len < sizeof(struct sflow_generic_counter_t))
+		return 1;
+	    sflow_gen_counter = (const struct sflow_generic_counter_t *)pointer;
+	    counters[FLOW_EXPORT_IN_OCTETS] = GET_BE_U_8(sflow_gen_counter->ifinoctets);
+	    counters[FLOW_EXPORT_IN_UCAST] = GET_BE_U_4(sflow_gen_counter->ifinunicastpkts);
+	    counters[FLOW_EXPORT_IN_MCAST] = GET_BE_U_4(sflow_gen_counter->ifinmulticastpkts);
+	    counters[FLOW_EXPORT_IN_BCAST] = GET_BE_U_4(sflow_gen_counter->ifinbroadcastpkts);
+	    counters[FLOW_EXPORT_IN_DISCARDS] = GET_BE_U_4(sflow_gen_counter->ifindiscards);
+	    counters[FLOW_EXPORT_IN_ERRORS] = GET_BE_U_4(sflow_gen_counter->ifinerrors);
+	    counters[FLOW_EXPORT_OUT_OCTETS] = GET_BE_U_8(sflow_gen_counter->ifoutoctets);
+	    counters[FLOW_EXPORT_OUT_UCAST] = GET_BE_U_4(sflow_gen_counter->ifoutunicastpkts);
+	    counters[FLOW_EXPORT_OUT_MCAST] = GET_BE_U_4(sflow_gen_counter->ifoutmulticastpkts);
+	    counters[FLOW_EXPORT_OUT_BCAST] = GET_BE_U_4(sflow_gen_counter->ifoutbroadcastpkts);
+	    counters[FLOW_EXPORT_OUT_DISCARDS] = GET_BE_U_4(sflow_gen_counter->ifoutdiscards);
+	    counters[FLOW_EXPORT_OUT_ERRORS] = GET_BE_U_4(sflow_gen_counter->ifouterrors);
+	    flow_export_counters(ndo, GET_BE_U_4(sflow_gen_counter->ifindex),
+				 counters);
+	}
+	pointer += counter_len;
+	len -= counter_len;
+	nrecords--;
+    }
+    return 0;
+}
+
+static void
+sflow_export(netdissect_options *ndo,
+             const u_char *pptr, u_int len, uint32_t ip_version)
+{
+    const struct sflow_datagram_t *sflow_datagram;
+    const struct sflow_v6_datagram_t *sflow_v6_datagram;
+    const struct sflow_sample_header *sflow_sample;
+    const u_char *tptr;
+    u_int tlen;
+    uint32_t sflow_sample_type, sflow_sample_len;
+    uint32_t nsamples;
+    int ret;
+
+    if (ip_version == 1) {
+	if (len < sizeof(struct sflow_datagram_t))
+	    goto invalid;
+	sflow_datagram = (const struct sflow_datagram_t *)pptr;
+	flow_export_datagram(ndo, FLOW_EXPORT_SFLOW, sflow_datagram->agent,
+			     4, GET_BE_U_4(sflow_datagram->agent_id),
+			     GET_BE_U_4(sflow_datagram->seqnum), 1);
+	nsamples = GET_BE_U_4(sflow_datagram->samples);
+	tptr = pptr + sizeof(struct sflow_datagram_t);
+	tlen = len - sizeof(struct sflow_datagram_t);
+    } else {
+	if (len < sizeof(struct sflow_v6_datagram_t))
+	    goto invalid;
+	sflow_v6_datagram = (const struct sflow_v6_datagram_t *)pptr;
+	ND_TCHECK_SIZE(sflow_v6_datagram);
+	flow_export_datagram(ndo, FLOW_EXPORT_SFLOW, sflow_v6_datagram->agent,
+			     16, GET_BE_U_4(sflow_v6_datagram->agent_id),
+			     GET_BE_U_4(sflow_v6_datagram->seqnum), 1);
+	nsamples = GET_BE_U_4(sflow_v6_datagram->samples);
+	tptr = pptr + sizeof(struct sflow_v6_datagram_t);
+	tlen = len - sizeof(struct sflow_v6_datagram_t);
+    }
+
+    while (nsamples > 0 && tlen > 0) {
+	if (tlen < sizeof(struct sflow_sample_header))
+	    goto invalid;
+	sflow_sample = (const struct sflow_sample_header *)tptr;
+	sflow_sample_type = (GET_BE_U_4(sflow_sample->format)&0x0FFF);
+	sflow_sample_len = GET_BE_U_4(sflow_sample->len);
+	tptr += sizeof(struct sflow_sample_header);
+	tlen -= sizeof(struct sflow_sample_header);
+
+	if (sflow_sample_type == 0 || sflow_sample_len == 0)
+	    return;
+	if (tlen < sflow_sample_len)
+	    goto invalid;
+	ND_TCHECK_LEN(tptr, sflow_sample_len);
+
+	switch (sflow_sample_type) {
+	case SFLOW_FLOW_SAMPLE:
+	case SFLOW_EXPANDED_FLOW_SAMPLE:
+	    ret = sflow_export_flow_sample(ndo, tptr, sflow_sample_len,
+		sflow_sample_type == SFLOW_EXPANDED_FLOW_SAMPLE);
+	    break;
+	case SFLOW_COUNTER_SAMPLE:
+	case SFLOW_EXPANDED_COUNTER_SAMPLE:
+	    ret = sflow_export_counter_sample(ndo, tptr, sflow_sample_len,
+		sflow_sample_type == SFLOW_EXPANDED_COUNTER_SAMPLE);
+	    break;
+	default:
+	    ret = 0;
+	    break;
+	}
+	if (ret)
+	    goto invalid;
+	tptr += sflow_sample_len;
+	tlen -= sflow_sample_len;
+	nsamples--;
+    }
+    return;
+
+invalid:
+    nd_print_invalid(ndo);
+}
+
 void
 sflow_print(netdissect_options *ndo,
             const u_char *pptr, u_int len)
@@ -850,7 +1195,7 @@ sflow_print(netdissect_options *ndo,
         return;
     }
 
-    if (ndo->ndo_vflag < 1) {
+    if (ndo->ndo_vflag < 1 || ndo->ndo_flow_export) {
         ND_PRINT(C_RESET, "sFlowv%u, %s agent %s, agent-id %u, length %u",
                GET_BE_U_4(sflow_datagram->version),
                ip_version == 1 ? "IPv4" : "IPv6",
@@ -859,6 +1204,8 @@ sflow_print(netdissect_options *ndo,
                ip_version == 1 ? GET_BE_U_4(sflow_datagram->agent_id) :
                                  GET_BE_U_4(sflow_v6_datagram->agent_id),
                len);
+        if (ndo->ndo_flow_export)
+            sflow_export(ndo, pptr, len, ip_version);
         return;
     }
 
@@ -65,6 +65,7 @@
 #include "netdissect-stdinc.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 #ifdef USE_LIBSMI
@@ -1026,29 +1027,213 @@ static int smi_check_range(SmiType *smiType, struct be *elem)
 	return ok;
 }
 
+/*
+ * Cache of libsmi OID lookups.
+ *
+ * Polling traffic (bulk walks of interface tables in particular) names
+ * the same objects over and over, and smiGetNodeByOID() plus the walk of
+ * the named-number list are the bulk of the cost of printing a varbind.
+ * The cache is keyed by the BER encoding of the OID and holds the
+ * resolved node (or the fact that there is none), its module name and
+ * type, and, once needed, the type's named numbers.
+ *
+ * It is a fixed-size, direct-mapped table: a colliding OID evicts the
+ * previous occupant, which bounds memory regardless of the traffic.
+ * It must be flushed whenever another MIB module is loaded.
+ */
+#define SMI_CACHE_SIZE		4096	/* number of slots, a power of 2 */
+#define SMI_CACHE_MAX_OID	64	/* longest cacheable BER-encoded OID */
+#define SMI_CACHE_MAX_NN	256	/* most named numbers kept per entry */
+
+struct smi_cache_nn {
+	int32_t value;
+	const char *name;
+};
+
+struct smi_cache_entry {
+	u_int rawlen;			/* 0 for an empty slot */
+	u_char raw[SMI_CACHE_MAX_OID];	/* BER-encoded OID (the key) */
+	SmiNode *node;			/* NULL if the OID isn't in the MIBs */
+	const char *module;		/* name of the node's module */
+	SmiType *type;			/* the node's type, or NULL */
+	int nn_valid;			/* nn/nnn have been filled in */
+	int nn_partial;			/* ... but not with all of them */
+	u_int nnn;
+	struct smi_cache_nn *nn;	/* named numbers of an enum type */
+};
+
+static struct smi_cache_entry *smi_cache;
+static struct nd_smi_cache_stats smi_cache_stats;
+
+static void
+smi_cache_clear(struct smi_cache_entry *ce)
+{
+	free(ce->nn);
+	memset(ce, 0, sizeof(*ce));
+}
+
+/*
+ * Look up the node for an OID, through the cache if possible.  The OID
+ * is always decoded into oid/oidlen, as callers print the instance
+ * part from it.  Returns the cache entry, or NULL if the OID couldn't
+ * be cached, in which case *nodep is looked up directly.
+ */
+static struct smi_cache_entry *
+smi_cache_lookup(netdissect_options *ndo, struct be *elem,
+		 unsigned int *oid, unsigned int oidsize,
+		 unsigned int *oidlen, SmiNode **nodep)
+{
+	const u_char *raw = (const u_char *)elem->data.raw;
+	struct smi_cache_entry *ce;
+	uint32_t h;
+	u_int i;
+
+	smi_decode_oid(ndo, elem, oid, oidsize, oidlen);
+	smi_cache_stats.lookups++;
+	if (elem->asnlen == 0 || elem->asnlen > SMI_CACHE_MAX_OID) {
+		smi_cache_stats.uncacheable++;
+		*nodep = smiGetNodeByOID(*oidlen, oid);
+		return NULL;
+	}
+	if (smi_cache == NULL) {
+		smi_cache = calloc(SMI_CACHE_SIZE, sizeof(*smi_cache));
+		if (smi_cache == NULL)
+			(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+					  "%s: calloc", __func__);
+	}
+
+	/* FNV-1a over the encoded OID */
+	h = 2166136261U;
+	for (i = 0; i < elem->asnlen; i++)
+		h = (h ^ raw[i]) * 16777619U;
+	ce = &smi_cache[h & (SMI_CACHE_SIZE - 1)];
+	if (ce->rawlen == elem->asnlen &&
+	    memcmp(ce->raw, raw, elem->asnlen) == 0) {
+		smi_cache_stats.hits++;
+		*nodep = ce->node;
+		return ce;
+	}
+
+	smi_cache_stats.misses++;
+	if (ce->rawlen != 0) {
+		smi_cache_stats.evictions++;
+		smi_cache_clear(ce);
+	} else
+		smi_cache_stats.entries++;
+	ce->rawlen = elem->asnlen;
+	memcpy(ce->raw, raw, elem->asnlen);
+	ce->node = smiGetNodeByOID(*oidlen, oid);
+	if (ce->node != NULL) {
+		ce->module = smiGetNodeModule(ce->node)->name;
+		ce->type = smiGetNodeType(ce->node);
+	}
+	*nodep = ce->node;
+	return ce;
+}
+
+/*
+ * Return the label of "value" in the enumeration type of a cached node,
+ * or NULL.  The named numbers are copied out of libsmi the first time
+ * they are needed; types with more than SMI_CACHE_MAX_NN of them only
+ * have the first ones cached, and libsmi is asked about the rest.
+ */
+static const char *
+smi_cache_named_number(struct smi_cache_entry *ce, int32_t value)
+{
+	SmiNamedNumber *nn;
+	struct smi_cache_nn *p;
+	u_int i;
+
+	if (!ce->nn_valid) {
+		ce->nn_valid = 1;
+		for (nn = smiGetFirstNamedNumber(ce->type);
+		     nn != NULL && ce->nnn < SMI_CACHE_MAX_NN;
+		     nn = smiGetNextNamedNumber(nn)) {
+			if ((ce->nnn & (ce->nnn - 1)) == 0) {
+				/* grow in powers of 2 */
+				p = realloc(ce->nn, (ce->nnn ? ce->nnn * 2 : 1) *
+				    sizeof(*ce->nn));
+				if (p == NULL)
+					break;
+				ce->nn = p;
+			}
+			ce->nn[ce->nnn].value = nn->value.value.integer32;
+			ce->nn[ce->nnn].name = nn->name;
+			ce->nnn++;
+		}
+		ce->nn_partial = (nn != NULL);
+	}
+	for (i = 0; i < ce->nnn; i++) {
+		if (ce->nn[i].value == value)
+			return ce->nn[i].name;
+	}
+	if (ce->nn_partial) {
+		for (nn = smiGetFirstNamedNumber(ce->type);
+		     nn != NULL;
+		     nn = smiGetNextNamedNumber(nn)) {
+			if (nn->value.value.integer32 == value)
+				return nn->name;
+		}
+	}
+	return NULL;
+}
+#endif /* USE_LIBSMI */
+
+/*
+ * Drop everything in the OID cache; the nodes it refers to belong to
+ * libsmi and may change when a module is loaded or libsmi is shut down.
+ */
+void
+nd_smi_cache_flush(void)
+{
+#ifdef USE_LIBSMI
+	u_int i;
+
+	if (smi_cache == NULL)
+		return;
+	for (i = 0; i < SMI_CACHE_SIZE; i++)
+		smi_cache_clear(&smi_cache[i]);
+	free(smi_cache);
+	smi_cache = NULL;
+	smi_cache_stats.entries = 0;
+#endif
+}
+
+void
+nd_smi_cache_get_stats(struct nd_smi_cache_stats *stats)
+{
+#ifdef USE_LIBSMI
+	*stats = smi_cache_stats;
+#else
+	memset(stats, 0, sizeof(*stats));
+#endif
+}
+
+#ifdef USE_LIBSMI
 static SmiNode *
 smi_print_variable(netdissect_options *ndo,
-                   struct be *elem, int *status)
+                   struct be *elem, struct smi_cache_entry **cep, int *status)
 {
 	unsigned int oid[128], oidlen;
 	SmiNode *smiNode = NULL;
+	struct smi_cache_entry *ce;
 	unsigned int i;
 
+	*cep = NULL;
 	if (!nd_smi_module_loaded) {
 		*status = asn1_print(ndo, elem);
 		return NULL;
 	}
-	*status = smi_decode_oid(ndo, elem, oid, sizeof(oid) / sizeof(unsigned int),
-	    &oidlen);
-	if (*status < 0)
-		return NULL;
-	smiNode = smiGetNodeByOID(oidlen, oid);
+	ce = smi_cache_lookup(ndo, elem, oid, sizeof(oid) / sizeof(unsigned int),
+	    &oidlen, &smiNode);
 	if (! smiNode) {
 		*status = asn1_print(ndo, elem);
 		return NULL;
 	}
+	*cep = ce;
 	if (ndo->ndo_vflag) {
-		ND_PRINT(C_RESET, "%s::", smiGetNodeModule(smiNode)->name);
+		ND_PRINT(C_RESET, "%s::", ce != NULL ? ce->module :
+		    smiGetNodeModule(smiNode)->name);
 	}
 	ND_PRINT(C_RESET, "%s", smiNode->name);
 	if (smiNode->oidlen < oidlen) {
@@ -1062,11 +1247,14 @@ smi_print_variable(netdissect_options *ndo,
 
 static int
 smi_print_value(netdissect_options *ndo,
-                SmiNode *smiNode, u_short pduid, struct be *elem)
+                SmiNode *smiNode, struct smi_cache_entry *ce,
+                u_short pduid, struct be *elem)
 {
 	unsigned int i, oid[128], oidlen;
 	SmiType *smiType;
 	SmiNamedNumber *nn;
+	struct smi_cache_entry *vce;
+	const char *label;
 	int done = 0;
 
 	if (! smiNode || ! (smiNode->nodekind
@@ -1097,7 +1285,7 @@ smi_print_value(netdissect_options *ndo,
 	    ND_PRINT(C_RESET, "[noAccess]");
 	}
 
-	smiType = smiGetNodeType(smiNode);
+	smiType = ce != NULL ? ce->type : smiGetNodeType(smiNode);
 	if (! smiType) {
 	    return asn1_print(ndo, elem);
 	}
@@ -1123,14 +1311,15 @@ smi_print_value(netdissect_options *ndo,
 	        if (smiType->basetype == SMI_BASETYPE_BITS) {
 		        /* print bit labels */
 		} else {
-			if (nd_smi_module_loaded &&
-			    smi_decode_oid(ndo, elem, oid,
-					   sizeof(oid)/sizeof(unsigned int),
-					   &oidlen) == 0) {
-				smiNode = smiGetNodeByOID(oidlen, oid);
+			if (nd_smi_module_loaded) {
+				vce = smi_cache_lookup(ndo, elem, oid,
+				    sizeof(oid)/sizeof(unsigned int),
+				    &oidlen, &smiNode);
 				if (smiNode) {
 				        if (ndo->ndo_vflag) {
-						ND_PRINT(C_RESET, "%s::", smiGetNodeModule(smiNode)->name);
+						ND_PRINT(C_RESET, "%s::", vce != NULL ?
+						    vce->module :
+						    smiGetNodeModule(smiNode)->name);
 					}
 					ND_PRINT(C_RESET, "%s", smiNode->name);
 					if (smiNode->oidlen < oidlen) {
@@ -1147,17 +1336,26 @@ smi_print_value(netdissect_options *ndo,
 
 	case BE_INT:
 	        if (smiType->basetype == SMI_BASETYPE_ENUM) {
-		        for (nn = smiGetFirstNamedNumber(smiType);
-			     nn;
-			     nn = smiGetNextNamedNumber(nn)) {
-			         if (nn->value.value.integer32
-				     == elem->data.integer) {
-				         ND_PRINT(C_RESET, "%s", nn->name);
-					 ND_PRINT(C_RESET, "(%d)", elem->data.integer);
-					 done++;
-					 break;
+			label = NULL;
+			if (ce != NULL)
+				label = smi_cache_named_number(ce,
+				    elem->data.integer);
+			else {
+				for (nn = smiGetFirstNamedNumber(smiType);
+				     nn;
+				     nn = smiGetNextNamedNumber(nn)) {
+					if (nn->value.value.integer32
+					    == elem->data.integer) {
+						label = nn->name;
+						break;
+					}
 				}
 			}
+			if (label != NULL) {
+				ND_PRINT(C_RESET, "%s", label);
+				ND_PRINT(C_RESET, "(%d)", elem->data.integer);
+				done++;
+			}
 		}
 		break;
 	}
@@ -1213,6 +1411,7 @@ varbind_print(netdissect_options *ndo,
 	int count = 0, ind;
 #ifdef USE_LIBSMI
 	SmiNode *smiNode = NULL;
+	struct smi_cache_entry *ce = NULL;
 #endif
 	int status;
 
@@ -1259,7 +1458,7 @@ varbind_print(netdissect_options *ndo,
 			return;
 		}
 #ifdef USE_LIBSMI
-		smiNode = smi_print_variable(ndo, &elem, &status);
+		smiNode = smi_print_variable(ndo, &elem, &ce, &status);
 #else
 		status = asn1_print(ndo, &elem);
 #endif
@@ -1285,7 +1484,7 @@ varbind_print(netdissect_options *ndo,
 		} else {
 		        if (elem.type != BE_NULL) {
 #ifdef USE_LIBSMI
-				status = smi_print_value(ndo, smiNode, pduid, &elem);
+				status = smi_print_value(ndo, smiNode, ce, pduid, &elem);
 #else
 				status = asn1_print(ndo, &elem);
 #endif
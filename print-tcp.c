@@ -64,6 +64,9 @@ static int tcp_verify_signature(netdissect_options *ndo,
 #endif
 
 static void print_tcp_rst_data(netdissect_options *, const u_char *sp, u_int length);
+static void tcp_analyze(netdissect_options *, const struct ip *,
+                        const struct ip6_hdr *, const struct tcphdr *,
+                        u_int, int, uint32_t, uint32_t);
 static void print_tcp_fastopen_option(netdissect_options *ndo, const u_char *cp,
                                       u_int datalen);
 
@@ -159,6 +162,70 @@ tcp6_cksum(netdissect_options *ndo,
                                 IPPROTO_TCP);
 }
 
+/*
+ * What tcp_print() hands the payload to, by port, in order of
+ * precedence: where both ports are registered, the one listed first
+ * wins.
+ */
+enum tcp_dissector {
+        TCP_NONE,
+        TCP_TELNET,
+        TCP_SMTP,
+        TCP_WHOIS,
+        TCP_BGP,
+        TCP_PPTP,
+        TCP_REDIS,
+        TCP_SSH,
+        TCP_NETBIOS_SSN,
+        TCP_SMB,
+        TCP_BEEP,
+        TCP_OPENFLOW,
+        TCP_FTP,
+        TCP_HTTP,
+        TCP_RTSP,
+        TCP_DOMAIN,
+        TCP_MSDP,
+        TCP_RPKI_RTR,
+        TCP_LDP,
+        TCP_NFS
+};
+
+static const struct nd_port_dissector tcp_dissectors[] = {
+        { TCP_TELNET, ND_PORT_ANY, TELNET_PORT, TELNET_PORT, "telnet" },
+        { TCP_SMTP, ND_PORT_ANY, SMTP_PORT, SMTP_PORT, "smtp" },
+        { TCP_WHOIS, ND_PORT_ANY, WHOIS_PORT, WHOIS_PORT, "whois" },
+        { TCP_BGP, ND_PORT_ANY, BGP_PORT, BGP_PORT, "bgp" },
+        { TCP_PPTP, ND_PORT_ANY, PPTP_PORT, PPTP_PORT, "pptp" },
+        { TCP_REDIS, ND_PORT_ANY, REDIS_PORT, REDIS_PORT, "resp" },
+        { TCP_SSH, ND_PORT_ANY, SSH_PORT, SSH_PORT, "ssh" },
+#ifdef ENABLE_SMB
+        { TCP_NETBIOS_SSN, ND_PORT_ANY, NETBIOS_SSN_PORT, NETBIOS_SSN_PORT, "smb" },
+        { TCP_SMB, ND_PORT_ANY, SMB_PORT, SMB_PORT, "smb" },
+#endif
+        { TCP_BEEP, ND_PORT_ANY, BEEP_PORT, BEEP_PORT, "beep" },
+        { TCP_OPENFLOW, ND_PORT_ANY, OPENFLOW_PORT_OLD, OPENFLOW_PORT_OLD, "openflow" },
+        { TCP_OPENFLOW, ND_PORT_ANY, OPENFLOW_PORT_IANA, OPENFLOW_PORT_IANA, "openflow" },
+        { TCP_FTP, ND_PORT_ANY, FTP_PORT, FTP_PORT, "ftp" },
+        { TCP_HTTP, ND_PORT_ANY, HTTP_PORT, HTTP_PORT, "http" },
+        { TCP_HTTP, ND_PORT_ANY, HTTP_PORT_ALT, HTTP_PORT_ALT, "http" },
+        { TCP_RTSP, ND_PORT_ANY, RTSP_PORT, RTSP_PORT, "rtsp" },
+        { TCP_RTSP, ND_PORT_ANY, RTSP_PORT_ALT, RTSP_PORT_ALT, "rtsp" },
+        { TCP_DOMAIN, ND_PORT_ANY, NAMESERVER_PORT, NAMESERVER_PORT, "domain" },
+        { TCP_MSDP, ND_PORT_ANY, MSDP_PORT, MSDP_PORT, "msdp" },
+        { TCP_RPKI_RTR, ND_PORT_ANY, RPKI_RTR_PORT, RPKI_RTR_PORT, "rpki-rtr" },
+        { TCP_LDP, ND_PORT_ANY, LDP_PORT, LDP_PORT, "ldp" },
+        { TCP_NFS, ND_PORT_ANY, NFS_PORT, NFS_PORT, "nfs" },
+};
+
+static struct nd_port_table tcp_ports;
+
+void
+tcp_init_dissectors(void)
+{
+        nd_port_table_init(&tcp_ports, tcp_dissectors,
+            sizeof(tcp_dissectors) / sizeof(tcp_dissectors[0]));
+}
+
 void
 tcp_print(netdissect_options *ndo,
           const u_char *bp, u_int length,
@@ -176,6 +243,8 @@ tcp_print(netdissect_options *ndo,
         int rev;
         const struct ip6_hdr *ip6;
         u_int header_len;	/* Header length in bytes */
+        int has_ts = 0;
+        uint32_t tsval = 0, tsecr = 0;
 
         ndo->ndo_protocol = "tcp";
         tp = (const struct tcphdr *)bp;
@@ -185,15 +254,19 @@ tcp_print(netdissect_options *ndo,
         else
                 ip6 = NULL;
         ch = '\0';
+        if (ip6)
+                ND_SPAN_CHECK(ip6);
+        else
+                ND_SPAN_CHECK(ip);
         if (!ND_TTEST_2(tp->th_dport)) {
                 if (ip6) {
                         ND_PRINT(C_RESET, "%s > %s:",
-                                 GET_IP6ADDR_STRING(ip6->ip6_src),
-                                 GET_IP6ADDR_STRING(ip6->ip6_dst));
+                                 SPAN_IP6ADDR_STRING(ip6, ip6_src),
+                                 SPAN_IP6ADDR_STRING(ip6, ip6_dst));
                 } else {
                         ND_PRINT(C_RESET, "%s > %s:",
-                                 GET_IPADDR_STRING(ip->ip_src),
-                                 GET_IPADDR_STRING(ip->ip_dst));
+                                 SPAN_IPADDR_STRING(ip, ip_src),
+                                 SPAN_IPADDR_STRING(ip, ip_dst));
                 }
                 nd_trunc_longjmp(ndo);
         }
@@ -202,22 +275,22 @@ tcp_print(netdissect_options *ndo,
         dport = GET_BE_U_2(tp->th_dport);
 
         if (ip6) {
-                if (GET_U_1(ip6->ip6_nxt) == IPPROTO_TCP) {
+                if (SPAN_U_1(ip6, ip6_nxt) == IPPROTO_TCP) {
                         ND_PRINT(C_RESET, "%s.%s > %s.%s: ",
-                                 GET_IP6ADDR_STRING(ip6->ip6_src),
+                                 SPAN_IP6ADDR_STRING(ip6, ip6_src),
                                  tcpport_string(ndo, sport),
-                                 GET_IP6ADDR_STRING(ip6->ip6_dst),
+                                 SPAN_IP6ADDR_STRING(ip6, ip6_dst),
                                  tcpport_string(ndo, dport));
                 } else {
                         ND_PRINT(C_RESET, "%s > %s: ",
                                  tcpport_string(ndo, sport), tcpport_string(ndo, dport));
                 }
         } else {
-                if (GET_U_1(ip->ip_p) == IPPROTO_TCP) {
+                if (SPAN_U_1(ip, ip_p) == IPPROTO_TCP) {
                         ND_PRINT(C_RESET, "%s.%s > %s.%s: ",
-                                 GET_IPADDR_STRING(ip->ip_src),
+                                 SPAN_IPADDR_STRING(ip, ip_src),
                                  tcpport_string(ndo, sport),
-                                 GET_IPADDR_STRING(ip->ip_dst),
+                                 SPAN_IPADDR_STRING(ip, ip_dst),
                                  tcpport_string(ndo, dport));
                 } else {
                         ND_PRINT(C_RESET, "%s > %s: ",
@@ -233,10 +306,11 @@ tcp_print(netdissect_options *ndo,
                 goto invalid;
         }
 
-        seq = GET_BE_U_4(tp->th_seq);
-        ack = GET_BE_U_4(tp->th_ack);
-        win = GET_BE_U_2(tp->th_win);
-        urp = GET_BE_U_2(tp->th_urp);
+        ND_SPAN_CHECK(tp);
+        seq = SPAN_BE_U_4(tp, th_seq);
+        ack = SPAN_BE_U_4(tp, th_ack);
+        win = SPAN_BE_U_2(tp, th_win);
+        urp = SPAN_BE_U_2(tp, th_urp);
 
         if (ndo->ndo_qflag) {
                 ND_PRINT(C_RESET, "tcp %u", length - hlen);
@@ -245,10 +319,12 @@ tcp_print(netdissect_options *ndo,
                                  hlen, length);
                         goto invalid;
                 }
+                if (ndo->ndo_tcp_analysis)
+                        tcp_analyze(ndo, ip, ip6, tp, length - hlen, 0, 0, 0);
                 return;
         }
 
-        flags = GET_U_1(tp->th_flags);
+        flags = SPAN_U_1(tp, th_flags);
         ND_PRINT(C_RESET, "Flags [%s]", bittok2str_nosep(tcp_flag_values, "none", flags));
 
         if (!ndo->ndo_Sflag && (flags & TH_ACK)) {
@@ -392,7 +468,7 @@ tcp_print(netdissect_options *ndo,
                 if (IP_V(ip) == 4) {
                         if (ND_TTEST_LEN(tp->th_sport, length)) {
                                 sum = tcp_cksum(ndo, ip, tp, length);
-                                tcp_sum = GET_BE_U_2(tp->th_sum);
+                                tcp_sum = SPAN_BE_U_2(tp, th_sum);
 
                                 ND_PRINT(C_RESET, ", cksum 0x%04x", tcp_sum);
                                 if (sum != 0)
@@ -404,7 +480,7 @@ tcp_print(netdissect_options *ndo,
                 } else if (IP_V(ip) == 6) {
                         if (ND_TTEST_LEN(tp->th_sport, length)) {
                                 sum = tcp6_cksum(ndo, ip6, tp, length);
-                                tcp_sum = GET_BE_U_2(tp->th_sum);
+                                tcp_sum = SPAN_BE_U_2(tp, th_sum);
 
                                 ND_PRINT(C_RESET, ", cksum 0x%04x", tcp_sum);
                                 if (sum != 0)
@@ -525,9 +601,10 @@ tcp_print(netdissect_options *ndo,
                         case TCPOPT_TIMESTAMP:
                                 datalen = 8;
                                 LENCHECK(datalen);
-                                ND_PRINT(C_RESET, " val %u ecr %u",
-                                             GET_BE_U_4(cp),
-                                             GET_BE_U_4(cp + 4));
+                                tsval = GET_BE_U_4(cp);
+                                tsecr = GET_BE_U_4(cp + 4);
+                                has_ts = 1;
+                                ND_PRINT(C_RESET, " val %u ecr %u", tsval, tsecr);
                                 break;
 
                         case TCPOPT_SIGNATURE:
@@ -708,6 +785,9 @@ tcp_print(netdissect_options *ndo,
          */
         ND_PRINT(C_RESET, ", length %u", length);
 
+        if (ndo->ndo_tcp_analysis)
+                tcp_analyze(ndo, ip, ip6, tp, length, has_ts, tsval, tsecr);
+
         if (length == 0)
                 return;
 
@@ -740,58 +820,98 @@ tcp_print(netdissect_options *ndo,
                         break;
                 case PT_DOMAIN:
                         /* over_tcp: TRUE, is_mdns: FALSE */
-                        domain_print(ndo, bp, length, TRUE, FALSE);
+                        domain_print(ndo, bp, length, TRUE, FALSE, sport, dport,
+                             bp2);
                         break;
                 }
                 return;
         }
 
-        if (IS_SRC_OR_DST_PORT(TELNET_PORT)) {
+        switch (nd_port_lookup(&tcp_ports, sport, dport)) {
+
+        case TCP_TELNET:
                 telnet_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(SMTP_PORT)) {
+                break;
+
+        case TCP_SMTP:
                 ND_PRINT(C_RESET, ": ");
                 smtp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(WHOIS_PORT)) {
+                break;
+
+        case TCP_WHOIS:
                 ND_PRINT(C_RESET, ": ");
                 whois_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(BGP_PORT))
+                break;
+
+        case TCP_BGP:
                 bgp_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(PPTP_PORT))
+                break;
+
+        case TCP_PPTP:
                 pptp_print(ndo, bp);
-        else if (IS_SRC_OR_DST_PORT(REDIS_PORT))
+                break;
+
+        case TCP_REDIS:
                 resp_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(SSH_PORT))
+                break;
+
+        case TCP_SSH:
                 ssh_print(ndo, bp, length);
+                break;
+
 #ifdef ENABLE_SMB
-        else if (IS_SRC_OR_DST_PORT(NETBIOS_SSN_PORT))
+        case TCP_NETBIOS_SSN:
                 nbt_tcp_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(SMB_PORT))
+                break;
+
+        case TCP_SMB:
                 smb_tcp_print(ndo, bp, length);
+                break;
 #endif
-        else if (IS_SRC_OR_DST_PORT(BEEP_PORT))
+
+        case TCP_BEEP:
                 beep_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(OPENFLOW_PORT_OLD) || IS_SRC_OR_DST_PORT(OPENFLOW_PORT_IANA))
+                break;
+
+        case TCP_OPENFLOW:
                 openflow_print(ndo, bp, length);
-        else if (IS_SRC_OR_DST_PORT(FTP_PORT)) {
+                break;
+
+        case TCP_FTP:
                 ND_PRINT(C_RESET, ": ");
                 ftp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(HTTP_PORT) || IS_SRC_OR_DST_PORT(HTTP_PORT_ALT)) {
+                break;
+
+        case TCP_HTTP:
                 ND_PRINT(C_RESET, ": ");
                 http_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(RTSP_PORT) || IS_SRC_OR_DST_PORT(RTSP_PORT_ALT)) {
+                break;
+
+        case TCP_RTSP:
                 ND_PRINT(C_RESET, ": ");
                 rtsp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT)) {
+                break;
+
+        case TCP_DOMAIN:
                 /* over_tcp: TRUE, is_mdns: FALSE */
-                domain_print(ndo, bp, length, TRUE, FALSE);
-        } else if (IS_SRC_OR_DST_PORT(MSDP_PORT)) {
+                domain_print(ndo, bp, length, TRUE, FALSE, sport, dport,
+                             bp2);
+                break;
+
+        case TCP_MSDP:
                 msdp_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(RPKI_RTR_PORT)) {
+                break;
+
+        case TCP_RPKI_RTR:
                 rpki_rtr_print(ndo, bp, length);
-        } else if (IS_SRC_OR_DST_PORT(LDP_PORT)) {
+                break;
+
+        case TCP_LDP:
                 ldp_print(ndo, bp, length);
-        } else if ((IS_SRC_OR_DST_PORT(NFS_PORT)) &&
-                 length >= 4) {
+                break;
+
+        case TCP_NFS:
+        {
                 /*
                  * If data present, header length valid, and NFS port used,
                  * assume NFS.
@@ -802,6 +922,8 @@ tcp_print(netdissect_options *ndo,
                 const struct sunrpc_msg *rp;
                 enum sunrpc_msg_type direction;
 
+                if (length < 4)
+                        break;
                 fraglen = GET_BE_U_4(bp) & 0x7FFFFFFF;
                 if (fraglen > (length) - 4)
                         fraglen = (length) - 4;
@@ -821,6 +943,8 @@ tcp_print(netdissect_options *ndo,
                                 return;
                         }
                 }
+                break;
+        }
         }
 
         return;
@@ -833,6 +957,38 @@ invalid:
         nd_print_invalid(ndo);
 }
 
+/*
+ * Hand a segment to --tcp-analysis.
+ */
+static void
+tcp_analyze(netdissect_options *ndo, const struct ip *ip,
+            const struct ip6_hdr *ip6, const struct tcphdr *tp,
+            u_int length, int has_ts, uint32_t tsval, uint32_t tsecr)
+{
+        struct tcp_analysis_seg seg;
+
+        if (ip6) {
+                seg.src = (const u_char *)ip6->ip6_src;
+                seg.dst = (const u_char *)ip6->ip6_dst;
+                seg.addrlen = sizeof(nd_ipv6);
+        } else {
+                seg.src = (const u_char *)ip->ip_src;
+                seg.dst = (const u_char *)ip->ip_dst;
+                seg.addrlen = sizeof(nd_ipv4);
+        }
+        seg.sport = SPAN_BE_U_2(tp, th_sport);
+        seg.dport = SPAN_BE_U_2(tp, th_dport);
+        seg.flags = SPAN_U_1(tp, th_flags);
+        seg.win = SPAN_BE_U_2(tp, th_win);
+        seg.seq = SPAN_BE_U_4(tp, th_seq);
+        seg.ack = SPAN_BE_U_4(tp, th_ack);
+        seg.length = length;
+        seg.has_ts = has_ts;
+        seg.tsval = tsval;
+        seg.tsecr = tsecr;
+        tcp_analysis_segment(ndo, &seg);
+}
+
 /*
  * RFC1122 says the following on data in RST segments:
  *
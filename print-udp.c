@@ -339,8 +339,160 @@ udpipaddr_noport_print(netdissect_options *ndo, const struct ip *ip)
 	}
 }
 
+/*
+ * What udp_print() hands the payload to, by port, in order of
+ * precedence: where both ports are registered, the one listed first
+ * wins.  AppleTalk-in-UDP takes a look at the payload, so it isn't in
+ * the table, but it keeps its place in the order.
+ */
+enum udp_dissector {
+	UDP_NONE,
+	UDP_DOMAIN,
+	UDP_MDNS,
+	UDP_TIMED,
+	UDP_TFTP,
+	UDP_BOOTP,
+	UDP_RIP,
+	UDP_AODV,
+	UDP_ISAKMP,
+	UDP_ISAKMP_NATT,
+	UDP_ISAKMP_USER,
+	UDP_SNMP,
+	UDP_NTP,
+	UDP_KRB,
+	UDP_L2TP,
+	UDP_NETBIOS_NS,
+	UDP_NETBIOS_DGRAM,
+	UDP_VAT,
+	UDP_ZEPHYR,
+	UDP_RX,
+	UDP_RIPNG,
+	UDP_DHCP6,
+	UDP_AHCP,
+	UDP_BABEL,
+	UDP_HNCP,
+	UDP_WB,
+	UDP_CISCO_AUTORP,
+	UDP_RADIUS,
+	UDP_HSRP,
+	UDP_LWRES,
+	UDP_LDP,
+	UDP_OLSR,
+	UDP_LSPPING,
+	UDP_BCM_LI,
+	UDP_BFD,
+	UDP_SBFD_REPLY,
+	UDP_LMP,
+	UDP_VQP,
+	UDP_SFLOW,
+	UDP_LWAPP_CONTROL,
+	UDP_LWAPP_CONTROL_REPLY,
+	UDP_LWAPP_DATA,
+	UDP_SIP,
+	UDP_SYSLOG,
+	UDP_OTV,
+	UDP_VXLAN,
+	UDP_GENEVE,
+	UDP_LISP,
+	UDP_VXLAN_GPE,
+	UDP_ZEP,
+	UDP_MPLS,
+	UDP_ATALK,
+	UDP_PTP,
+	UDP_SOMEIP,
+	UDP_QUIC
+};
+
+static const struct nd_port_dissector udp_dissectors[] = {
+	{ UDP_DOMAIN, ND_PORT_ANY, NAMESERVER_PORT, NAMESERVER_PORT, "domain" },
+	{ UDP_MDNS, ND_PORT_ANY, MULTICASTDNS_PORT, MULTICASTDNS_PORT, "domain" },
+	{ UDP_TIMED, ND_PORT_ANY, TIMED_PORT, TIMED_PORT, "timed" },
+	{ UDP_TFTP, ND_PORT_ANY, TFTP_PORT, TFTP_PORT, "tftp" },
+	{ UDP_BOOTP, ND_PORT_ANY, BOOTPS_PORT, BOOTPS_PORT, "bootp" },
+	{ UDP_BOOTP, ND_PORT_ANY, BOOTPC_PORT, BOOTPC_PORT, "bootp" },
+	{ UDP_RIP, ND_PORT_ANY, RIP_PORT, RIP_PORT, "rip" },
+	{ UDP_AODV, ND_PORT_ANY, AODV_PORT, AODV_PORT, "aodv" },
+	{ UDP_ISAKMP, ND_PORT_ANY, ISAKMP_PORT, ISAKMP_PORT, "isakmp" },
+	{ UDP_ISAKMP_NATT, ND_PORT_ANY, ISAKMP_PORT_NATT, ISAKMP_PORT_NATT, "isakmp" },
+	{ UDP_ISAKMP_USER, ND_PORT_ANY, ISAKMP_PORT_USER1, ISAKMP_PORT_USER1, "isakmp" },
+	{ UDP_ISAKMP_USER, ND_PORT_ANY, ISAKMP_PORT_USER2, ISAKMP_PORT_USER2, "isakmp" },
+	{ UDP_SNMP, ND_PORT_ANY, SNMP_PORT, SNMP_PORT, "snmp" },
+	{ UDP_SNMP, ND_PORT_ANY, SNMPTRAP_PORT, SNMPTRAP_PORT, "snmp" },
+	{ UDP_NTP, ND_PORT_ANY, NTP_PORT, NTP_PORT, "ntp" },
+	{ UDP_KRB, ND_PORT_ANY, KERBEROS_PORT, KERBEROS_PORT, "krb" },
+	{ UDP_KRB, ND_PORT_ANY, KERBEROS_SEC_PORT, KERBEROS_SEC_PORT, "krb" },
+	{ UDP_L2TP, ND_PORT_ANY, L2TP_PORT, L2TP_PORT, "l2tp" },
+#ifdef ENABLE_SMB
+	{ UDP_NETBIOS_NS, ND_PORT_ANY, NETBIOS_NS_PORT, NETBIOS_NS_PORT, "smb" },
+	{ UDP_NETBIOS_DGRAM, ND_PORT_ANY, NETBIOS_DGRAM_PORT, NETBIOS_DGRAM_PORT, "smb" },
+#endif
+	{ UDP_VAT, ND_PORT_DST, VAT_PORT, VAT_PORT, "vat" },
+	{ UDP_ZEPHYR, ND_PORT_ANY, ZEPHYR_SRV_PORT, ZEPHYR_SRV_PORT, "zephyr" },
+	{ UDP_ZEPHYR, ND_PORT_ANY, ZEPHYR_CLT_PORT, ZEPHYR_CLT_PORT, "zephyr" },
+	{ UDP_RX, ND_PORT_ANY, RX_PORT_LOW, RX_PORT_HIGH, "rx" },
+	{ UDP_RIPNG, ND_PORT_ANY, RIPNG_PORT, RIPNG_PORT, "ripng" },
+	{ UDP_DHCP6, ND_PORT_ANY, DHCP6_SERV_PORT, DHCP6_SERV_PORT, "dhcp6" },
+	{ UDP_DHCP6, ND_PORT_ANY, DHCP6_CLI_PORT, DHCP6_CLI_PORT, "dhcp6" },
+	{ UDP_AHCP, ND_PORT_ANY, AHCP_PORT, AHCP_PORT, "ahcp" },
+	{ UDP_BABEL, ND_PORT_ANY, BABEL_PORT, BABEL_PORT, "babel" },
+	{ UDP_BABEL, ND_PORT_ANY, BABEL_PORT_OLD, BABEL_PORT_OLD, "babel" },
+	{ UDP_HNCP, ND_PORT_ANY, HNCP_PORT, HNCP_PORT, "hncp" },
+	{ UDP_WB, ND_PORT_DST, WB_PORT, WB_PORT, "wb" },
+	{ UDP_CISCO_AUTORP, ND_PORT_ANY, CISCO_AUTORP_PORT, CISCO_AUTORP_PORT, "pim" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_PORT, RADIUS_PORT, "radius" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_ACCOUNTING_PORT, RADIUS_ACCOUNTING_PORT, "radius" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_NEW_PORT, RADIUS_NEW_PORT, "radius" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_NEW_ACCOUNTING_PORT, RADIUS_NEW_ACCOUNTING_PORT, "radius" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_CISCO_COA_PORT, RADIUS_CISCO_COA_PORT, "radius" },
+	{ UDP_RADIUS, ND_PORT_ANY, RADIUS_COA_PORT, RADIUS_COA_PORT, "radius" },
+	{ UDP_HSRP, ND_PORT_DST, HSRP_PORT, HSRP_PORT, "hsrp" },
+	{ UDP_LWRES, ND_PORT_ANY, LWRES_PORT, LWRES_PORT, "lwres" },
+	{ UDP_LDP, ND_PORT_ANY, LDP_PORT, LDP_PORT, "ldp" },
+	{ UDP_OLSR, ND_PORT_ANY, OLSR_PORT, OLSR_PORT, "olsr" },
+	{ UDP_LSPPING, ND_PORT_ANY, MPLS_LSP_PING_PORT, MPLS_LSP_PING_PORT, "lspping" },
+	{ UDP_BCM_LI, ND_PORT_SRC, BCM_LI_PORT, BCM_LI_PORT, "bcm-li" },
+	{ UDP_BFD, ND_PORT_DST, BFD_CONTROL_PORT, BFD_CONTROL_PORT, "bfd" },
+	{ UDP_BFD, ND_PORT_DST, BFD_MULTIHOP_PORT, BFD_MULTIHOP_PORT, "bfd" },
+	{ UDP_BFD, ND_PORT_DST, BFD_LAG_PORT, BFD_LAG_PORT, "bfd" },
+	{ UDP_BFD, ND_PORT_DST, SBFD_PORT, SBFD_PORT, "bfd" },
+	{ UDP_BFD, ND_PORT_DST, BFD_ECHO_PORT, BFD_ECHO_PORT, "bfd" },
+	{ UDP_SBFD_REPLY, ND_PORT_SRC, SBFD_PORT, SBFD_PORT, "bfd" },
+	{ UDP_LMP, ND_PORT_ANY, LMP_PORT, LMP_PORT, "lmp" },
+	{ UDP_VQP, ND_PORT_ANY, VQP_PORT, VQP_PORT, "vqp" },
+	{ UDP_SFLOW, ND_PORT_ANY, SFLOW_PORT, SFLOW_PORT, "sflow" },
+	{ UDP_LWAPP_CONTROL, ND_PORT_DST, LWAPP_CONTROL_PORT, LWAPP_CONTROL_PORT, "lwapp" },
+	{ UDP_LWAPP_CONTROL_REPLY, ND_PORT_SRC, LWAPP_CONTROL_PORT, LWAPP_CONTROL_PORT, "lwapp" },
+	{ UDP_LWAPP_DATA, ND_PORT_ANY, LWAPP_DATA_PORT, LWAPP_DATA_PORT, "lwapp" },
+	{ UDP_SIP, ND_PORT_ANY, SIP_PORT, SIP_PORT, "sip" },
+	{ UDP_SYSLOG, ND_PORT_ANY, SYSLOG_PORT, SYSLOG_PORT, "syslog" },
+	{ UDP_OTV, ND_PORT_ANY, OTV_PORT, OTV_PORT, "otv" },
+	{ UDP_VXLAN, ND_PORT_ANY, VXLAN_PORT, VXLAN_PORT, "vxlan" },
+	{ UDP_GENEVE, ND_PORT_ANY, GENEVE_PORT, GENEVE_PORT, "geneve" },
+	{ UDP_LISP, ND_PORT_ANY, LISP_CONTROL_PORT, LISP_CONTROL_PORT, "lisp" },
+	{ UDP_VXLAN_GPE, ND_PORT_ANY, VXLAN_GPE_PORT, VXLAN_GPE_PORT, "vxlan-gpe" },
+	{ UDP_ZEP, ND_PORT_ANY, ZEP_PORT, ZEP_PORT, "zep" },
+	{ UDP_MPLS, ND_PORT_ANY, MPLS_PORT, MPLS_PORT, "mpls" },
+	{ UDP_PTP, ND_PORT_ANY, PTP_EVENT_PORT, PTP_EVENT_PORT, "ptp" },
+	{ UDP_PTP, ND_PORT_ANY, PTP_GENERAL_PORT, PTP_GENERAL_PORT, "ptp" },
+	{ UDP_SOMEIP, ND_PORT_ANY, SOMEIP_PORT, SOMEIP_PORT, "someip" },
+	{ UDP_QUIC, ND_PORT_ANY, HTTPS_PORT, HTTPS_PORT, "quic" },
+};
+
+static struct nd_port_table udp_ports;
+static int udp_atalk_enabled;
+static int udp_nfs_enabled;
+
 void
-udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
+udp_init_dissectors(void)
+{
+	nd_port_table_init(&udp_ports, udp_dissectors,
+	    sizeof(udp_dissectors) / sizeof(udp_dissectors[0]));
+	udp_atalk_enabled = nd_dissector_enabled("atalk");
+	udp_nfs_enabled = nd_dissector_enabled("nfs");
+}
+
+static void
+udp_print_1(netdissect_options *ndo, const u_char *bp, u_int length,
 	  const u_char *bp2, int fragmented, u_int ttl_hl)
 {
 	const struct udphdr *up;
@@ -351,6 +503,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	u_int ulen;
 	uint16_t udp_sum;
 	const struct ip6_hdr *ip6;
+	u_int id;
 
 	ndo->ndo_protocol = "udp";
 	up = (const struct udphdr *)bp;
@@ -370,8 +523,9 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 		udpipaddr_print(ndo, ip, sport, dport);
 
 	ND_ICHECKMSG_ZU("undersized-udp", length, <, sizeof(struct udphdr));
-	ulen = GET_BE_U_2(up->uh_ulen);
-	udp_sum = GET_BE_U_2(up->uh_sum);
+	ND_SPAN_CHECK(up);
+	ulen = SPAN_BE_U_2(up, uh_ulen);
+	udp_sum = SPAN_BE_U_2(up, uh_sum);
 	/*
 	 * IPv6 Jumbo Datagrams; see RFC 2675.
 	 * If the length is zero, and the length provided to us is
@@ -427,7 +581,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 			break;
 
 		case PT_CNFP:
-			cnfp_print(ndo, cp);
+			cnfp_print(ndo, cp, (const u_char *)ip);
 			break;
 
 		case PT_TFTP:
@@ -462,7 +616,8 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 			break;
 		case PT_DOMAIN:
 			/* over_tcp: FALSE, is_mdns: FALSE */
-			domain_print(ndo, cp, length, FALSE, FALSE);
+			domain_print(ndo, cp, length, FALSE, FALSE, sport, dport,
+			    (const u_char *)ip);
 			break;
 		case PT_QUIC:
 			quic_print(ndo, cp, length);
@@ -476,7 +631,7 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 		enum sunrpc_msg_type direction;
 
 		rp = (const struct sunrpc_msg *)cp;
-		if (ND_TTEST_4(rp->rm_direction)) {
+		if (udp_nfs_enabled && ND_TTEST_4(rp->rm_direction)) {
 			direction = (enum sunrpc_msg_type) GET_BE_U_4(rp->rm_direction);
 			if (dport == NFS_PORT && direction == SUNRPC_CALL) {
 				ND_PRINT(C_RESET, "NFS request xid %u ",
@@ -539,150 +694,245 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 	}
 
 	if (!ndo->ndo_qflag) {
-		if (IS_SRC_OR_DST_PORT(NAMESERVER_PORT))
+		id = nd_port_lookup(&udp_ports, sport, dport);
+		if ((id == UDP_NONE || id > UDP_ATALK) && udp_atalk_enabled &&
+		    (atalk_port(sport) || atalk_port(dport)) &&
+		    GET_U_1(((const struct LAP *)cp)->type) == lapDDP)
+			id = UDP_ATALK;
+		switch (id) {
+
+		case UDP_DOMAIN:
 			/* over_tcp: FALSE, is_mdns: FALSE */
-			domain_print(ndo, cp, length, FALSE, FALSE);
-		else if (IS_SRC_OR_DST_PORT(MULTICASTDNS_PORT))
+			domain_print(ndo, cp, length, FALSE, FALSE, sport, dport,
+			    (const u_char *)ip);
+			return;
+
+		case UDP_MDNS:
 			/* over_tcp: FALSE, is_mdns: TRUE */
-			domain_print(ndo, cp, length, FALSE, TRUE);
-		else if (IS_SRC_OR_DST_PORT(TIMED_PORT))
+			domain_print(ndo, cp, length, FALSE, TRUE, sport, dport,
+			    (const u_char *)ip);
+			return;
+
+		case UDP_TIMED:
 			timed_print(ndo, (const u_char *)cp);
-		else if (IS_SRC_OR_DST_PORT(TFTP_PORT))
+			return;
+
+		case UDP_TFTP:
 			tftp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(BOOTPC_PORT) || IS_SRC_OR_DST_PORT(BOOTPS_PORT))
+			return;
+
+		case UDP_BOOTP:
 			bootp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(RIP_PORT))
+			return;
+
+		case UDP_RIP:
 			rip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(AODV_PORT))
+			return;
+
+		case UDP_AODV:
 			aodv_print(ndo, cp, length,
 			    ip6 != NULL);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT))
-			 isakmp_print(ndo, cp, length, bp2);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_NATT))
-			 isakmp_rfc3948_print(ndo, cp, length, bp2, IP_V(ip), fragmented, ttl_hl);
-		else if (IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER1) || IS_SRC_OR_DST_PORT(ISAKMP_PORT_USER2))
+			return;
+
+		case UDP_ISAKMP:
+		case UDP_ISAKMP_USER:
 			isakmp_print(ndo, cp, length, bp2);
-		else if (IS_SRC_OR_DST_PORT(SNMP_PORT) || IS_SRC_OR_DST_PORT(SNMPTRAP_PORT))
+			return;
+
+		case UDP_ISAKMP_NATT:
+			isakmp_rfc3948_print(ndo, cp, length, bp2, IP_V(ip), fragmented, ttl_hl);
+			return;
+
+		case UDP_SNMP:
 			snmp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(NTP_PORT))
+			return;
+
+		case UDP_NTP:
 			ntp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(KERBEROS_PORT) || IS_SRC_OR_DST_PORT(KERBEROS_SEC_PORT))
+			return;
+
+		case UDP_KRB:
 			krb_print(ndo, (const u_char *)cp);
-		else if (IS_SRC_OR_DST_PORT(L2TP_PORT))
+			return;
+
+		case UDP_L2TP:
 			l2tp_print(ndo, cp, length);
+			return;
+
 #ifdef ENABLE_SMB
-		else if (IS_SRC_OR_DST_PORT(NETBIOS_NS_PORT))
+		case UDP_NETBIOS_NS:
 			nbt_udp137_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(NETBIOS_DGRAM_PORT))
+			return;
+
+		case UDP_NETBIOS_DGRAM:
 			nbt_udp138_print(ndo, cp, length);
+			return;
 #endif
-		else if (dport == VAT_PORT)
+
+		case UDP_VAT:
 			vat_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(ZEPHYR_SRV_PORT) || IS_SRC_OR_DST_PORT(ZEPHYR_CLT_PORT))
+			return;
+
+		case UDP_ZEPHYR:
 			zephyr_print(ndo, cp, length);
-		/*
-		 * Since there are 10 possible ports to check, I think
-		 * a <> test would be more efficient
-		 */
-		else if ((sport >= RX_PORT_LOW && sport <= RX_PORT_HIGH) ||
-			 (dport >= RX_PORT_LOW && dport <= RX_PORT_HIGH))
+			return;
+
+		case UDP_RX:
 			rx_print(ndo, cp, length, sport, dport,
 				 (const u_char *) ip);
-		else if (IS_SRC_OR_DST_PORT(RIPNG_PORT))
+			return;
+
+		case UDP_RIPNG:
 			ripng_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(DHCP6_SERV_PORT) || IS_SRC_OR_DST_PORT(DHCP6_CLI_PORT))
+			return;
+
+		case UDP_DHCP6:
 			dhcp6_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(AHCP_PORT))
+			return;
+
+		case UDP_AHCP:
 			ahcp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(BABEL_PORT) || IS_SRC_OR_DST_PORT(BABEL_PORT_OLD))
+			return;
+
+		case UDP_BABEL:
 			babel_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(HNCP_PORT))
+			return;
+
+		case UDP_HNCP:
 			hncp_print(ndo, cp, length);
-		/*
-		 * Kludge in test for whiteboard packets.
-		 */
-		else if (dport == WB_PORT)
+			return;
+
+		case UDP_WB:
 			wb_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(CISCO_AUTORP_PORT))
+			return;
+
+		case UDP_CISCO_AUTORP:
 			cisco_autorp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(RADIUS_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_NEW_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_ACCOUNTING_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_NEW_ACCOUNTING_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_CISCO_COA_PORT) ||
-			 IS_SRC_OR_DST_PORT(RADIUS_COA_PORT) )
+			return;
+
+		case UDP_RADIUS:
 			radius_print(ndo, cp, length);
-		else if (dport == HSRP_PORT)
+			return;
+
+		case UDP_HSRP:
 			hsrp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(LWRES_PORT))
+			return;
+
+		case UDP_LWRES:
 			lwres_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(LDP_PORT))
+			return;
+
+		case UDP_LDP:
 			ldp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(OLSR_PORT))
+			return;
+
+		case UDP_OLSR:
 			olsr_print(ndo, cp, length,
 					(IP_V(ip) == 6) ? 1 : 0);
-		else if (IS_SRC_OR_DST_PORT(MPLS_LSP_PING_PORT))
+			return;
+
+		case UDP_LSPPING:
 			lspping_print(ndo, cp, length);
-		else if (sport == BCM_LI_PORT)
+			return;
+
+		case UDP_BCM_LI:
 			bcm_li_print(ndo, cp, length);
-		else if (dport == BFD_CONTROL_PORT ||
-			 dport == BFD_MULTIHOP_PORT ||
-			 dport == BFD_LAG_PORT ||
-			 dport == SBFD_PORT ||
-			 dport == BFD_ECHO_PORT )
+			return;
+
+		case UDP_BFD:
 			bfd_print(ndo, cp, length, dport);
-		else if (sport == SBFD_PORT)
+			return;
+
+		case UDP_SBFD_REPLY:
 			bfd_print(ndo, cp, length, sport);
-		else if (IS_SRC_OR_DST_PORT(LMP_PORT))
+			return;
+
+		case UDP_LMP:
 			lmp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VQP_PORT))
+			return;
+
+		case UDP_VQP:
 			vqp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(SFLOW_PORT))
+			return;
+
+		case UDP_SFLOW:
 			sflow_print(ndo, cp, length);
-		else if (dport == LWAPP_CONTROL_PORT)
+			return;
+
+		case UDP_LWAPP_CONTROL:
 			lwapp_control_print(ndo, cp, length, 1);
-		else if (sport == LWAPP_CONTROL_PORT)
+			return;
+
+		case UDP_LWAPP_CONTROL_REPLY:
 			lwapp_control_print(ndo, cp, length, 0);
-		else if (IS_SRC_OR_DST_PORT(LWAPP_DATA_PORT))
+			return;
+
+		case UDP_LWAPP_DATA:
 			lwapp_data_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(SIP_PORT))
+			return;
+
+		case UDP_SIP:
 			sip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(SYSLOG_PORT))
+			return;
+
+		case UDP_SYSLOG:
 			syslog_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(OTV_PORT))
+			return;
+
+		case UDP_OTV:
 			otv_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VXLAN_PORT))
+			return;
+
+		case UDP_VXLAN:
 			vxlan_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(GENEVE_PORT))
+			return;
+
+		case UDP_GENEVE:
 			geneve_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(LISP_CONTROL_PORT))
+			return;
+
+		case UDP_LISP:
 			lisp_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(VXLAN_GPE_PORT))
+			return;
+
+		case UDP_VXLAN_GPE:
 			vxlan_gpe_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(ZEP_PORT))
+			return;
+
+		case UDP_ZEP:
 			zep_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(MPLS_PORT))
+			return;
+
+		case UDP_MPLS:
 			mpls_print(ndo, cp, length);
-		else if ((atalk_port(sport) || atalk_port(dport)) &&
-			 GET_U_1(((const struct LAP *)cp)->type) == lapDDP) {
+			return;
+
+		case UDP_ATALK:
 			if (ndo->ndo_vflag)
 				ND_PRINT(C_RESET, "kip ");
 			llap_print(ndo, cp, length);
-		} else if (IS_SRC_OR_DST_PORT(PTP_EVENT_PORT) ||
-			IS_SRC_OR_DST_PORT(PTP_GENERAL_PORT)) {
+			return;
+
+		case UDP_PTP:
 			ptp_print(ndo, cp, length);
-		} else if (IS_SRC_OR_DST_PORT(SOMEIP_PORT))
+			return;
+
+		case UDP_SOMEIP:
 			someip_print(ndo, cp, length);
-		else if (IS_SRC_OR_DST_PORT(HTTPS_PORT) &&
-			 quic_detect(ndo, cp, length))
-			quic_print(ndo, cp, length);
-		else {
-			if (ulen > length && !fragmented)
-				ND_PRINT(C_RESET, "UDP, bad length %u > %u",
-				    ulen, length);
-			else
-				ND_PRINT(C_RESET, "UDP, length %u", ulen);
+			return;
+
+		case UDP_QUIC:
+			if (quic_detect(ndo, cp, length)) {
+				quic_print(ndo, cp, length);
+				return;
+			}
+			break;
 		}
+		if (ulen > length && !fragmented)
+			ND_PRINT(C_RESET, "UDP, bad length %u > %u",
+			    ulen, length);
+		else
+			ND_PRINT(C_RESET, "UDP, length %u", ulen);
 	} else {
 		if (ulen > length && !fragmented)
 			ND_PRINT(C_RESET, "UDP, bad length %u > %u",
@@ -695,3 +945,16 @@ udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
 invalid:
 	nd_print_invalid(ndo);
 }
+
+void
+udp_print(netdissect_options *ndo, const u_char *bp, u_int length,
+	  const u_char *bp2, int fragmented, u_int ttl_hl)
+{
+	if (!ndo->ndo_profile) {
+		udp_print_1(ndo, bp, length, bp2, fragmented, ttl_hl);
+		return;
+	}
+	nd_profile_enter(ndo, ND_PROFILE_UDP, 0, length);
+	udp_print_1(ndo, bp, length, bp2, fragmented, ttl_hl);
+	nd_profile_exit(ndo);
+}
@@ -246,12 +246,44 @@ static const struct printer printers[] = {
 	{ NULL,                 0 },
 };
 
+static int PRINTFLIKE(2, 3) ndo_printf(netdissect_options *,
+				       FORMAT_STRING(const char *), ...);
+static int PRINTFLIKE(2, 3) ndo_printf_color(netdissect_options *,
+					     FORMAT_STRING(const char *), ...);
+
 void
 init_print(netdissect_options *ndo, uint32_t localnet, uint32_t mask)
 {
 
 	init_addrtoname(ndo, localnet, mask);
 	init_checksum();
+	init_dissectors();
+	nd_quick_init(ndo);
+	if (ndo->ndo_color && ndo->ndo_printf == ndo_printf)
+		ndo->ndo_printf = ndo_printf_color;
+}
+
+/*
+ * printers[], indexed by DLT, for lookup_printer(), which the PPI and
+ * PKTAP printers call for every packet; the DLTs in use are all below
+ * DLT_PRINTERS, and any others are searched for.
+ */
+#define DLT_PRINTERS	512
+
+static if_printer dlt_printers[DLT_PRINTERS];
+static int dlt_printers_ready;
+
+static void
+init_dlt_printers(void)
+{
+	const struct printer *p;
+
+	dlt_printers_ready = 1;
+	/* the first entry for a DLT wins, as with a search */
+	for (p = printers; p->f; ++p)
+		if (p->type >= 0 && p->type < DLT_PRINTERS &&
+		    dlt_printers[p->type] == NULL)
+			dlt_printers[p->type] = p->f;
 }
 
 if_printer
@@ -259,9 +291,16 @@ lookup_printer(int type)
 {
 	const struct printer *p;
 
-	for (p = printers; p->f; ++p)
-		if (type == p->type)
-			return p->f;
+	if (!dlt_printers_ready)
+		init_dlt_printers();
+	if (type >= 0 && type < DLT_PRINTERS) {
+		if (dlt_printers[type] != NULL)
+			return dlt_printers[type];
+	} else {
+		for (p = printers; p->f; ++p)
+			if (type == p->type)
+				return p->f;
+	}
 
 #if defined(DLT_USER2) && defined(DLT_PKTAP)
 	/*
@@ -297,6 +336,30 @@ has_printer(int type)
 	return (lookup_printer(type) != NULL);
 }
 
+/*
+ * Map a printer back to its DLT, for the dissector profile.  The same
+ * printer is asked about for every packet, so remember the last answer.
+ */
+static u_int
+if_printer_dlt(if_printer f)
+{
+	static if_printer last_f;
+	static u_int last_dlt;
+	const struct printer *p;
+
+	if (f == last_f)
+		return last_dlt;
+	last_f = f;
+	last_dlt = 0xffff;
+	for (p = printers; p->f; ++p) {
+		if (f == p->f) {
+			last_dlt = p->type;
+			break;
+		}
+	}
+	return last_dlt;
+}
+
 if_printer
 get_if_printer(int type)
 {
@@ -322,6 +385,9 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 
 	if (ndo->ndo_print_sampling && packets_captured % ndo->ndo_print_sampling != 0)
 		return;
+	if ((ndo->ndo_print_flow_sampling || ndo->ndo_print_rate) &&
+	    !nd_print_sample(ndo, if_printer_dlt(ndo->ndo_if_printer), h, sp))
+		return;
 
 #ifdef ENABLE_INSTRUMENT_FUNCTIONS
 	if (pretty_print_packet_level == -1)
@@ -394,6 +460,7 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	tvbuf.tv_sec = h->ts.tv_sec;
 	tvbuf.tv_usec = h->ts.tv_usec;
 	ts_print(ndo, &tvbuf);
+	ndo->ndo_ts = tvbuf;
 
 	/*
 	 * Printers must check that they're not walking off the end of
@@ -409,7 +476,13 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	switch (setjmp(ndo->ndo_early_end)) {
 	case 0:
 		/* Print the packet. */
-		(ndo->ndo_if_printer)(ndo, h, sp);
+		if (ndo->ndo_profile) {
+			nd_profile_enter(ndo, ND_PROFILE_LINK,
+			    if_printer_dlt(ndo->ndo_if_printer), h->len);
+			(ndo->ndo_if_printer)(ndo, h, sp);
+			nd_profile_exit(ndo);
+		} else
+			(ndo->ndo_if_printer)(ndo, h, sp);
 		break;
 	case ND_TRUNCATED:
 		/* A printer quit because the packet was truncated; report it */
@@ -422,6 +495,10 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 #endif
 		break;
 	}
+	if (ndo->ndo_profile)
+		nd_profile_unwind(ndo);
+	/* A printer may have quit in the middle of a styled ND_PRINT() */
+	ndo->ndo_style = ND_STYLE_DEFAULT;
 	hdrlen = ndo->ndo_ll_hdr_len;
 
 	/*
@@ -432,6 +509,9 @@ pretty_print_packet(netdissect_options *ndo, const struct pcap_pkthdr *h,
 	 */
 	nd_pop_all_packet_info(ndo);
 
+	/* Names the printers got are no longer used */
+	addrtoname_packet_done();
+
 	/*
 	 * Restore the original snapend, as a printer might have
 	 * changed it.
@@ -566,6 +646,46 @@ ndo_printf(netdissect_options *ndo, FORMAT_STRING(const char *fmt), ...)
 	return (ret);
 }
 
+static const char *const nd_style_escapes[ND_STYLE_COUNT] = {
+	"\033[0m",	/* ND_STYLE_DEFAULT */
+	"\033[31m",	/* ND_STYLE_RED */
+	"\033[32m",	/* ND_STYLE_GREEN */
+	"\033[33m",	/* ND_STYLE_YELLOW */
+	"\033[34m",	/* ND_STYLE_BLUE */
+	"\033[35m",	/* ND_STYLE_MAGENTA */
+	"\033[36m",	/* ND_STYLE_CYAN */
+};
+
+/*
+ * ndo_printf() with --color: switch the terminal to the style of the
+ * text first, if it isn't in it already.  The packet's closing newline
+ * is in the default style, so no line is left colored.
+ */
+/* VARARGS */
+static int PRINTFLIKE(2, 3)
+ndo_printf_color(netdissect_options *ndo, FORMAT_STRING(const char *fmt), ...)
+{
+	va_list args;
+	int ret;
+
+	if (ndo->ndo_style != ndo->ndo_style_out) {
+		if (fputs(nd_style_escapes[ndo->ndo_style], stdout) == EOF)
+			ndo_error(ndo, S_ERR_ND_WRITE_FILE,
+				  "Unable to write output: %s",
+				  pcap_strerror(errno));
+		ndo->ndo_style_out = ndo->ndo_style;
+	}
+
+	va_start(args, fmt);
+	ret = vfprintf(stdout, fmt, args);
+	va_end(args);
+
+	if (ret < 0)
+		ndo_error(ndo, S_ERR_ND_WRITE_FILE,
+			  "Unable to write output: %s", pcap_strerror(errno));
+	return (ret);
+}
+
 void
 ndo_set_function_pointers(netdissect_options *ndo)
 {
@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Flight-recorder ring.
+ *
+ * Each packet is stored as its pcap header followed by its data,
+ * rounded up to RB_ALIGN bytes, in one arena.  Records are appended at
+ * the tail; one that doesn't fit before the end of the arena goes at
+ * its start instead, the space left at the end being skipped, and
+ * records are dropped from the head until there's room.  So the
+ * packets are either all in [head, tail), or in [head, wrap) followed
+ * by [0, tail).
+ *
+ * Adding a packet is a copy, no allocation, and the arena is touched
+ * when it's allocated, so that filling it in doesn't take page faults.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "netdissect-stdinc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <pcap.h>
+
+#include "ringbuf.h"
+
+#define RB_ALIGN	8
+#define RB_RECLEN(caplen) \
+	((sizeof(struct pcap_pkthdr) + (caplen) + RB_ALIGN - 1) & \
+	 ~(size_t)(RB_ALIGN - 1))
+
+struct ring_buffer {
+	u_char *arena;
+	size_t size;
+	size_t head;		/* oldest record */
+	size_t tail;		/* where the next record goes */
+	size_t wrap;		/* end of the records at the end of the
+				   arena, if wrapped */
+	int wrapped;		/* the records wrap around */
+	struct ring_buffer_stats stats;
+};
+
+struct ring_buffer *
+ring_buffer_new(size_t size)
+{
+	struct ring_buffer *rb;
+
+	rb = calloc(1, sizeof(*rb));
+	if (rb == NULL)
+		return (NULL);
+	rb->size = size & ~(size_t)(RB_ALIGN - 1);
+	rb->arena = malloc(rb->size);
+	if (rb->arena == NULL) {
+		free(rb);
+		return (NULL);
+	}
+	memset(rb->arena, 0, rb->size);
+	return (rb);
+}
+
+static size_t
+ring_buffer_reclen(const struct ring_buffer *rb, size_t off)
+{
+	struct pcap_pkthdr hdr;
+
+	memcpy(&hdr, rb->arena + off, sizeof(hdr));
+	return (RB_RECLEN(hdr.caplen));
+}
+
+static void
+ring_buffer_evict(struct ring_buffer *rb)
+{
+	rb->head += ring_buffer_reclen(rb, rb->head);
+	rb->stats.packets--;
+	rb->stats.evicted++;
+	if (rb->wrapped && rb->head == rb->wrap) {
+		rb->head = 0;
+		rb->wrapped = 0;
+	}
+	if (rb->stats.packets == 0)
+		rb->head = rb->tail = rb->wrapped = 0;
+}
+
+int
+ring_buffer_add(struct ring_buffer *rb, const struct pcap_pkthdr *h,
+    const u_char *sp)
+{
+	size_t len = RB_RECLEN(h->caplen);
+
+	if (len > rb->size)
+		return (0);
+	for (;;) {
+		if (!rb->wrapped) {
+			if (rb->tail + len <= rb->size)
+				break;
+			if (rb->head == rb->tail) {
+				/* empty */
+				rb->head = rb->tail = 0;
+				break;
+			}
+			/* carry on at the start */
+			rb->wrap = rb->tail;
+			rb->tail = 0;
+			rb->wrapped = 1;
+		}
+		if (rb->wrapped) {
+			if (rb->tail + len <= rb->head)
+				break;
+			ring_buffer_evict(rb);
+		}
+	}
+
+	memcpy(rb->arena + rb->tail, h, sizeof(*h));
+	memcpy(rb->arena + rb->tail + sizeof(*h), sp, h->caplen);
+	rb->tail += len;
+	rb->stats.packets++;
+	return (1);
+}
+
+static void
+ring_buffer_dump_range(const struct ring_buffer *rb, pcap_dumper_t *p,
+    size_t off, size_t end)
+{
+	struct pcap_pkthdr hdr;
+
+	while (off < end) {
+		memcpy(&hdr, rb->arena + off, sizeof(hdr));
+		pcap_dump((u_char *)p, &hdr, rb->arena + off + sizeof(hdr));
+		off += RB_RECLEN(hdr.caplen);
+	}
+}
+
+void
+ring_buffer_dump(const struct ring_buffer *rb, pcap_dumper_t *p)
+{
+	if (rb->stats.packets == 0)
+		return;
+	if (rb->wrapped) {
+		ring_buffer_dump_range(rb, p, rb->head, rb->wrap);
+		ring_buffer_dump_range(rb, p, 0, rb->tail);
+	} else
+		ring_buffer_dump_range(rb, p, rb->head, rb->tail);
+}
+
+void
+ring_buffer_get_stats(const struct ring_buffer *rb,
+    struct ring_buffer_stats *stats)
+{
+	*stats = rb->stats;
+	if (rb->wrapped)
+		stats->bytes = (rb->wrap - rb->head) + rb->tail;
+	else
+		stats->bytes = rb->tail - rb->head;
+}
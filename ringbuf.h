@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+#ifndef ringbuf_h
+#define ringbuf_h
+
+/*
+ * Flight-recorder ring, used for --ring-buffer.
+ *
+ * Holds the most recent packets that fit in an arena allocated up
+ * front, the oldest being dropped to make room for new ones, so that
+ * what led up to an event can be written out when it happens.
+ */
+struct ring_buffer;
+
+struct ring_buffer_stats {
+	u_int packets;		/* packets in the ring */
+	uint64_t bytes;		/* arena bytes they take */
+	uint64_t evicted;	/* packets dropped to make room */
+};
+
+/*
+ * Returns NULL if the arena can't be allocated.
+ */
+extern struct ring_buffer *ring_buffer_new(size_t);
+
+/*
+ * Returns 0 if the packet is too big to ever fit.
+ */
+extern int ring_buffer_add(struct ring_buffer *, const struct pcap_pkthdr *,
+    const u_char *);
+
+/*
+ * Write the packets in the ring, oldest first.
+ */
+extern void ring_buffer_dump(const struct ring_buffer *, pcap_dumper_t *);
+
+extern void ring_buffer_get_stats(const struct ring_buffer *,
+    struct ring_buffer_stats *);
+
+#endif /* ringbuf_h */
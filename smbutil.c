@@ -342,6 +342,20 @@ write_bits(netdissect_options *ndo,
     }
 }
 
+/*
+ * Number of UCS-2 code units starting at s, up to n, that were captured.
+ */
+static u_int
+unistr_captured(netdissect_options *ndo, const u_char *s, uint32_t n)
+{
+    u_int avail;
+
+    if (!ND_TTEST_LEN(s, 0))
+	return 0;
+    avail = ND_BYTES_AVAILABLE_AFTER(s) / 2;
+    return ND_MIN(avail, n);
+}
+
 /* convert a UCS-2 string into an ASCII string */
 #define MAX_UNISTR_SIZE	1000
 static const u_char *
@@ -349,7 +363,7 @@ unistr(netdissect_options *ndo, char (*buf)[MAX_UNISTR_SIZE+1],
        const u_char *s, uint32_t strsize, int is_null_terminated,
        int use_unicode)
 {
-    u_int c;
+    u_int c, n;
     size_t l = 0;
     const u_char *sp;
 
@@ -379,6 +393,16 @@ unistr(netdissect_options *ndo, char (*buf)[MAX_UNISTR_SIZE+1],
 	    }
 	} else {
 	    for (;;) {
+		/*
+		 * Look through what was captured without checking
+		 * each code unit; the terminator, or the end of the
+		 * captured data, is then dealt with below.
+		 */
+		for (n = unistr_captured(ndo, sp, UINT32_MAX);
+		    n != 0 && EXTRACT_LE_U_2(sp) != 0; n--) {
+		    sp += 2;
+		    strsize += 2;
+		}
 		c = GET_LE_U_2(sp);
 		sp += 2;
 		strsize += 2;
@@ -420,6 +444,25 @@ unistr(netdissect_options *ndo, char (*buf)[MAX_UNISTR_SIZE+1],
 	}
     } else {
 	while (strsize > 1) {
+	    /*
+	     * Convert the code units that were captured in bulk,
+	     * stopping at a null terminator, which is dealt with
+	     * below along with the end of the captured data.
+	     */
+	    for (n = unistr_captured(ndo, s, strsize / 2); n != 0; n--) {
+		c = EXTRACT_LE_U_2(s);
+		if (c == 0)
+		    break;
+		if (l < MAX_UNISTR_SIZE) {
+		    /* printable ASCII, or '.' */
+		    (*buf)[l] = ND_ASCII_ISPRINT(c) ? (char)c : '.';
+		    l++;
+		}
+		s += 2;
+		strsize -= 2;
+	    }
+	    if (strsize <= 1)
+		break;
 	    c = GET_LE_U_2(s);
 	    s += 2;
 	    strsize -= 2;
@@ -463,62 +506,275 @@ trunc:
     return NULL;
 }
 
+/*
+ * smb_fdata() descriptor strings are compiled, the first time each one
+ * is used, into a program of these operations, so that dissecting a
+ * packet doesn't parse the string again.  Within an item, in square
+ * brackets, the code of an operation is its descriptor character;
+ * otherwise, and for text to print in an item, it's an SMB_OP_ value.
+ */
+#define SMB_OP_END	0	/* end of the program */
+#define SMB_OP_TEXT	1	/* print the text */
+#define SMB_OP_REPEAT	2	/* '*': run the rest of the program repeatedly */
+#define SMB_OP_CHECK	3	/* '|': stop at the end of the buffer */
+#define SMB_OP_SKIP	4	/* '%': skip to the end of the buffer */
+#define SMB_OP_DONE	5	/* '#': stop */
+#define SMB_OP_ITEM	6	/* '[': the following len operations */
+
+struct smb_op {
+    u_char code;
+    u_int len;		/* length of the text; operations in the item */
+    int arg;		/* numeric argument; for 'l', the length's type */
+    const char *str;	/* the text; for '{', the bit names */
+};
+
+/*
+ * Compiled programs, by the address of their descriptor string; the
+ * descriptor strings are all constants, and there are fewer of them
+ * than this.
+ */
+#define SMB_PROGS	1024	/* power of 2 */
+
+static struct smb_prog {
+    const char *fmt;
+    struct smb_op *ops;
+} smb_progs[SMB_PROGS];
+
+static int smb_fdata_depth;
+
+/*
+ * Compile the descriptors of an item, terminated by a null character
+ * where the closing square bracket was.
+ */
+static struct smb_op *
+smb_fdata_compile_item(char *fmt, struct smb_op *op)
+{
+    char *start, *p;
+
+    while (*fmt) {
+	op->code = *fmt;
+	switch (*fmt) {
+
+	case '{':
+	    p = strchr(++fmt, '}');
+	    if (p == NULL)
+		p = fmt + strlen(fmt);
+	    op->str = fmt;
+	    fmt = (*p != '\0') ? p + 1 : p;
+	    *p = '\0';
+	    break;
+
+	case 'P':
+	case 's':
+	case 'h':
+	case 'n':
+	case 'T':
+	    op->arg = atoi(fmt + 1);
+	    fmt++;
+	    while (ND_ASCII_ISDIGIT(*fmt))
+		fmt++;
+	    break;
+
+	case 'c':
+	    fmt++;
+	    while (ND_ASCII_ISDIGIT(*fmt))
+		fmt++;
+	    break;
+
+	case 'l':
+	    fmt++;
+	    op->arg = *fmt;
+	    if (*fmt != '\0')
+		fmt++;
+	    break;
+
+	case 'a':
+	case 'A':
+	case 'r':
+	case 'b':
+	case 'd':
+	case 'D':
+	case 'L':
+	case 'u':
+	case 'U':
+	case 'M':
+	case 'B':
+	case 'w':
+	case 'W':
+	case 'S':
+	case 'R':
+	case 'Z':
+	case 'Y':
+	case 'C':
+	    fmt++;
+	    break;
+
+	default:
+	    /*
+	     * Not a formatting character; print it, and any more
+	     * that follow it.
+	     */
+	    start = fmt;
+	    while (*fmt && strchr("aA{PrbdDLuUMBwWlSRZYcChnT", *fmt) == NULL)
+		fmt++;
+	    op->code = SMB_OP_TEXT;
+	    op->str = start;
+	    op->len = ND_BYTES_BETWEEN(fmt, start);
+	    break;
+	}
+	op++;
+    }
+    return op;
+}
+
+/*
+ * Compile fmt, which is modified, into ops; a program has at most one
+ * operation per character of its descriptor string, plus SMB_OP_END.
+ */
+static void
+smb_fdata_compile(char *fmt, struct smb_op *op)
+{
+    char *start, *p;
+    struct smb_op *item;
+
+    while (*fmt) {
+	switch (*fmt) {
+
+	case '*':
+	    op->code = SMB_OP_REPEAT;
+	    fmt++;
+	    break;
+
+	case '|':
+	    op->code = SMB_OP_CHECK;
+	    fmt++;
+	    break;
+
+	case '%':
+	    op->code = SMB_OP_SKIP;
+	    fmt++;
+	    break;
+
+	case '#':
+	    op->code = SMB_OP_DONE;
+	    fmt++;
+	    break;
+
+	case '[':
+	    fmt++;
+	    p = strchr(fmt, ']');
+	    if (p == NULL || (size_t)(p - fmt + 1) > 128) {
+		/* overrun; nothing after it is ever done */
+		op->code = SMB_OP_DONE;
+		op[1].code = SMB_OP_END;
+		return;
+	    }
+	    *p = '\0';
+	    item = op;
+	    item->code = SMB_OP_ITEM;
+	    op = smb_fdata_compile_item(fmt, op + 1) - 1;
+	    item->len = (u_int)(op - item);
+	    fmt = p + 1;
+	    break;
+
+	default:
+	    /*
+	     * Not a formatting character, so just print it, and any
+	     * more that follow it.
+	     */
+	    start = fmt;
+	    while (*fmt && strchr("*|%#[", *fmt) == NULL)
+		fmt++;
+	    op->code = SMB_OP_TEXT;
+	    op->str = start;
+	    op->len = ND_BYTES_BETWEEN(fmt, start);
+	    break;
+	}
+	op++;
+    }
+    op->code = SMB_OP_END;
+}
+
+/*
+ * Get the program for a descriptor string, compiling it if this is the
+ * first time it's been used.
+ */
+static const struct smb_op *
+smb_fdata_prog(netdissect_options *ndo, const char *fmt)
+{
+    struct smb_prog *prog;
+    struct smb_op *ops;
+    char *copy;
+    size_t len;
+    u_int i, n;
+
+    i = (u_int)((uintptr_t)fmt ^ ((uintptr_t)fmt >> 11)) & (SMB_PROGS - 1);
+    for (n = 0; n < SMB_PROGS; n++) {
+	prog = &smb_progs[(i + n) & (SMB_PROGS - 1)];
+	if (prog->fmt == fmt)
+	    return prog->ops;
+	if (prog->fmt == NULL)
+	    break;
+    }
+    if (n == SMB_PROGS) {
+	/* full, which shouldn't happen; replace one */
+	prog = &smb_progs[i];
+	free(prog->ops);
+    }
+
+    /* the program, followed by the copy of fmt it refers to */
+    len = strlen(fmt);
+    ops = malloc((len + 1) * sizeof(*ops) + len + 1);
+    if (ops == NULL)
+	(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC, "%s: malloc", __func__);
+    copy = (char *)(ops + len + 1);
+    memcpy(copy, fmt, len + 1);
+    smb_fdata_compile(copy, ops);
+    prog->fmt = fmt;
+    prog->ops = ops;
+    return ops;
+}
+
+/*
+ * Dissect an item, the operations from op up to end.
+ */
 static const u_char *
-smb_fdata1(netdissect_options *ndo,
-           const u_char *buf, const char *fmt, const u_char *maxbuf,
-           int unicodestr)
+smb_fdata_item(netdissect_options *ndo,
+               const u_char *buf, const struct smb_op *op,
+               const struct smb_op *end, const u_char *maxbuf,
+               int unicodestr)
 {
     int reverse = 0;
     const char *attrib_fmt = "READONLY|HIDDEN|SYSTEM|VOLUME|DIR|ARCHIVE|";
     char strbuf[MAX_UNISTR_SIZE+1];
 
-    while (*fmt && buf<maxbuf) {
-	switch (*fmt) {
+    for (; op < end && buf < maxbuf; op++) {
+	switch (op->code) {
+	case SMB_OP_TEXT:
+	    ND_PRINT(C_RESET, "%.*s", (int)op->len, op->str);
+	    break;
+
 	case 'a':
 	    write_bits(ndo, GET_U_1(buf), attrib_fmt);
 	    buf++;
-	    fmt++;
 	    break;
 
 	case 'A':
 	    write_bits(ndo, GET_LE_U_2(buf), attrib_fmt);
 	    buf += 2;
-	    fmt++;
 	    break;
 
 	case '{':
-	  {
-	    char bitfmt[128];
-	    char *p;
-	    u_int l;
-
-	    p = strchr(++fmt, '}');
-	    l = ND_BYTES_BETWEEN(p, fmt);
-
-	    if (l > sizeof(bitfmt) - 1)
-		l = sizeof(bitfmt)-1;
-
-	    strncpy(bitfmt, fmt, l);
-	    bitfmt[l] = '\0';
-	    fmt = p + 1;
-	    write_bits(ndo, GET_U_1(buf), bitfmt);
+	    write_bits(ndo, GET_U_1(buf), op->str);
 	    buf++;
 	    break;
-	  }
 
 	case 'P':
-	  {
-	    int l = atoi(fmt + 1);
-	    ND_TCHECK_LEN(buf, l);
-	    buf += l;
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
+	    ND_TCHECK_LEN(buf, op->arg);
+	    buf += op->arg;
 	    break;
-	  }
 	case 'r':
 	    reverse = !reverse;
-	    fmt++;
 	    break;
 	case 'b':
 	  {
@@ -526,7 +782,6 @@ smb_fdata1(netdissect_options *ndo,
 	    x = GET_U_1(buf);
 	    ND_PRINT(C_RESET, "%u (0x%x)", x, x);
 	    buf += 1;
-	    fmt++;
 	    break;
 	  }
 	case 'd':
@@ -536,7 +791,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_S_2(buf);
 	    ND_PRINT(C_RESET, "%d (0x%x)", x, x);
 	    buf += 2;
-	    fmt++;
 	    break;
 	  }
 	case 'D':
@@ -546,7 +800,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_S_4(buf);
 	    ND_PRINT(C_RESET, "%d (0x%x)", x, x);
 	    buf += 4;
-	    fmt++;
 	    break;
 	  }
 	case 'L':
@@ -556,7 +809,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_U_8(buf);
 	    ND_PRINT(C_RESET, "%" PRIu64 " (0x%" PRIx64 ")", x, x);
 	    buf += 8;
-	    fmt++;
 	    break;
 	  }
 	case 'u':
@@ -566,7 +818,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_U_2(buf);
 	    ND_PRINT(C_RESET, "%u (0x%x)", x, x);
 	    buf += 2;
-	    fmt++;
 	    break;
 	  }
 	case 'U':
@@ -576,7 +827,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_U_4(buf);
 	    ND_PRINT(C_RESET, "%u (0x%x)", x, x);
 	    buf += 4;
-	    fmt++;
 	    break;
 	  }
 	case 'M':
@@ -592,7 +842,6 @@ smb_fdata1(netdissect_options *ndo,
 	    x = (((uint64_t)x1) << 32) | x2;
 	    ND_PRINT(C_RESET, "%" PRIu64 " (0x%" PRIx64 ")", x, x);
 	    buf += 8;
-	    fmt++;
 	    break;
 	  }
 	case 'B':
@@ -601,7 +850,6 @@ smb_fdata1(netdissect_options *ndo,
 	    x = GET_U_1(buf);
 	    ND_PRINT(C_RESET, "0x%X", x);
 	    buf += 1;
-	    fmt++;
 	    break;
 	  }
 	case 'w':
@@ -611,7 +859,6 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_U_2(buf);
 	    ND_PRINT(C_RESET, "0x%X", x);
 	    buf += 2;
-	    fmt++;
 	    break;
 	  }
 	case 'W':
@@ -621,13 +868,11 @@ smb_fdata1(netdissect_options *ndo,
 			  GET_LE_U_4(buf);
 	    ND_PRINT(C_RESET, "0x%X", x);
 	    buf += 4;
-	    fmt++;
 	    break;
 	  }
 	case 'l':
 	  {
-	    fmt++;
-	    switch (*fmt) {
+	    switch (op->arg) {
 
 	    case 'b':
 		stringlen = GET_U_1(buf);
@@ -654,18 +899,16 @@ smb_fdata1(netdissect_options *ndo,
 		buf += 4;
 		break;
 	    }
-	    fmt++;
 	    break;
 	  }
 	case 'S':
 	case 'R':	/* like 'S', but always ASCII */
 	  {
 	    /*XXX unistr() */
-	    buf = unistr(ndo, &strbuf, buf, 0, 1, (*fmt == 'R') ? 0 : unicodestr);
+	    buf = unistr(ndo, &strbuf, buf, 0, 1, (op->code == 'R') ? 0 : unicodestr);
 	    ND_PRINT(C_RESET, "%s", strbuf);
 	    if (buf == NULL)
 		goto trunc;
-	    fmt++;
 	    break;
 	  }
 	case 'Z':
@@ -675,22 +918,18 @@ smb_fdata1(netdissect_options *ndo,
 		ND_PRINT(C_RESET, "Error! ASCIIZ buffer of type %u", GET_U_1(buf));
 		return maxbuf;	/* give up */
 	    }
-	    buf = unistr(ndo, &strbuf, buf + 1, 0, 1, (*fmt == 'Y') ? 0 : unicodestr);
+	    buf = unistr(ndo, &strbuf, buf + 1, 0, 1, (op->code == 'Y') ? 0 : unicodestr);
 	    ND_PRINT(C_RESET, "%s", strbuf);
 	    if (buf == NULL)
 		goto trunc;
-	    fmt++;
 	    break;
 	  }
 	case 's':
 	  {
-	    int l = atoi(fmt + 1);
+	    int l = op->arg;
 	    ND_TCHECK_LEN(buf, l);
 	    ND_PRINT(C_RESET, "%-*.*s", l, l, buf);
 	    buf += l;
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
 	    break;
 	  }
 	case 'c':
@@ -702,9 +941,6 @@ smb_fdata1(netdissect_options *ndo,
 	    ND_TCHECK_LEN(buf, stringlen);
 	    ND_PRINT(C_RESET, "%-*.*s", (int)stringlen, (int)stringlen, buf);
 	    buf += stringlen;
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
 	    break;
 	  }
 	case 'C':
@@ -717,30 +953,25 @@ smb_fdata1(netdissect_options *ndo,
 	    ND_PRINT(C_RESET, "%s", strbuf);
 	    if (buf == NULL)
 		goto trunc;
-	    fmt++;
 	    break;
 	  }
 	case 'h':
 	  {
-	    int l = atoi(fmt + 1);
+	    int l = op->arg;
 	    ND_TCHECK_LEN(buf, l);
 	    while (l--) {
 		ND_PRINT(C_RESET, "%02x", GET_U_1(buf));
 		buf++;
 	    }
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
 	    break;
 	  }
 	case 'n':
 	  {
-	    int t = atoi(fmt+1);
 	    char nbuf[255];
 	    int name_type;
 	    int len;
 
-	    switch (t) {
+	    switch (op->arg) {
 	    case 1:
 		name_type = name_extract(ndo, startbuf, ND_BYTES_BETWEEN(buf, startbuf),
 		    maxbuf, nbuf);
@@ -760,9 +991,6 @@ smb_fdata1(netdissect_options *ndo,
 		buf += 16;
 		break;
 	    }
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
 	    break;
 	  }
 	case 'T':
@@ -772,7 +1000,7 @@ smb_fdata1(netdissect_options *ndo,
 	    const char *tstring;
 	    uint32_t x;
 
-	    switch (atoi(fmt + 1)) {
+	    switch (op->arg) {
 	    case 1:
 		x = GET_LE_U_4(buf);
 		if (x == 0 || x == 0xFFFFFFFF)
@@ -807,19 +1035,12 @@ smb_fdata1(netdissect_options *ndo,
 	    } else
 		tstring = "NULL\n";
 	    ND_PRINT(C_RESET, "%s", tstring);
-	    fmt++;
-	    while (ND_ASCII_ISDIGIT(*fmt))
-		fmt++;
 	    break;
 	  }
-	default:
-	    ND_PRINT(C_RESET, "%c", *fmt);
-	    fmt++;
-	    break;
 	}
     }
 
-    if (buf >= maxbuf && *fmt)
+    if (buf >= maxbuf && op < end)
 	ND_PRINT(C_RESET, "END OF BUFFER\n");
 
     return(buf);
@@ -829,39 +1050,35 @@ trunc:
     return(NULL);
 }
 
-const u_char *
-smb_fdata(netdissect_options *ndo,
-          const u_char *buf, const char *fmt, const u_char *maxbuf,
-          int unicodestr)
+static const u_char *
+smb_fdata_run(netdissect_options *ndo,
+              const u_char *buf, const struct smb_op *op,
+              const u_char *maxbuf, int unicodestr)
 {
-    static int depth = 0;
-    char s[128];
-    char *p;
-
-    while (*fmt) {
-	switch (*fmt) {
-	case '*':
+    for (; op->code != SMB_OP_END; op++) {
+	switch (op->code) {
+	case SMB_OP_REPEAT:
 	    /*
 	     * List of multiple instances of something described by the
 	     * remainder of the string (which may itself include a list
 	     * of multiple instances of something, so we recurse).
 	     */
-	    fmt++;
+	    op++;
 	    while (buf < maxbuf) {
 		const u_char *buf2;
-		depth++;
+		smb_fdata_depth++;
 		/*
 		 * In order to avoid stack exhaustion recurse at most 10
 		 * levels; that "should not happen", as no SMB structure
 		 * should be nested *that* deeply, and we thus shouldn't
 		 * have format strings with that level of nesting.
 		 */
-		if (depth == 10) {
+		if (smb_fdata_depth == 10) {
 			ND_PRINT(C_RESET, "(too many nested levels, not recursing)");
 			buf2 = buf;
 		} else
-			buf2 = smb_fdata(ndo, buf, fmt, maxbuf, unicodestr);
-		depth--;
+			buf2 = smb_fdata_run(ndo, buf, op, maxbuf, unicodestr);
+		smb_fdata_depth--;
 		if (buf2 == NULL)
 		    return(NULL);
 		if (buf2 == buf)
@@ -870,49 +1087,37 @@ smb_fdata(netdissect_options *ndo,
 	    }
 	    return(buf);
 
-	case '|':
+	case SMB_OP_CHECK:
 	    /*
 	     * Just do a bounds check.
 	     */
-	    fmt++;
 	    if (buf >= maxbuf)
 		return(buf);
 	    break;
 
-	case '%':
+	case SMB_OP_SKIP:
 	    /*
 	     * XXX - unused?
 	     */
-	    fmt++;
 	    buf = maxbuf;
 	    break;
 
-	case '#':
+	case SMB_OP_DONE:
 	    /*
 	     * Done?
 	     */
-	    fmt++;
 	    return(buf);
-	    break;
 
-	case '[':
+	case SMB_OP_ITEM:
 	    /*
 	     * Format of an item, enclosed in square brackets; dissect
-	     * the item with smb_fdata1().
+	     * the item with smb_fdata_item().
 	     */
-	    fmt++;
 	    if (buf >= maxbuf)
 		return(buf);
-	    memset(s, 0, sizeof(s));
-	    p = strchr(fmt, ']');
-	    if ((size_t)(p - fmt + 1) > sizeof(s)) {
-		/* overrun */
-		return(buf);
-	    }
-	    strncpy(s, fmt, p - fmt);
-	    s[p - fmt] = '\0';
-	    fmt = p + 1;
-	    buf = smb_fdata1(ndo, buf, s, maxbuf, unicodestr);
+	    buf = smb_fdata_item(ndo, buf, op + 1, op + 1 + op->len, maxbuf,
+		unicodestr);
+	    op += op->len;
 	    if (buf == NULL) {
 		/*
 		 * Truncated.
@@ -920,22 +1125,21 @@ smb_fdata(netdissect_options *ndo,
 		 * If so, print it before quitting, so we don't
 		 * get stuff in the middle of the line.
 		 */
-		if (*fmt == '\n')
+		if (op[1].code == SMB_OP_TEXT && op[1].str[0] == '\n')
 		    ND_PRINT(C_RESET, "\n");
 		return(NULL);
 	    }
 	    break;
 
-	default:
+	case SMB_OP_TEXT:
 	    /*
 	     * Not a formatting character, so just print it.
 	     */
-	    ND_PRINT(C_RESET, "%c", *fmt);
-	    fmt++;
+	    ND_PRINT(C_RESET, "%.*s", (int)op->len, op->str);
 	    break;
 	}
     }
-    if (!depth && buf < maxbuf) {
+    if (!smb_fdata_depth && buf < maxbuf) {
 	u_int len = ND_BYTES_BETWEEN(maxbuf, buf);
 	ND_PRINT(C_RESET, "Data: (%u bytes)\n", len);
 	smb_data_print(ndo, buf, len);
@@ -944,6 +1148,15 @@ smb_fdata(netdissect_options *ndo,
     return(buf);
 }
 
+const u_char *
+smb_fdata(netdissect_options *ndo,
+          const u_char *buf, const char *fmt, const u_char *maxbuf,
+          int unicodestr)
+{
+    return smb_fdata_run(ndo, buf, smb_fdata_prog(ndo, fmt), maxbuf,
+	unicodestr);
+}
+
 typedef struct {
     const char *name;
     int code;
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * TCP performance analysis (--tcp-analysis).
+ *
+ * tcp_print() hands every segment it prints to tcp_analysis_segment(),
+ * which keeps, per connection and direction, the next sequence number
+ * expected and one segment being timed, and annotates the segment:
+ *
+ *	[rtt N ms]	the segment acknowledges the timed one, or echoes
+ *			its time stamp option value
+ *	[retransmission], [out-of-order], [previous segment not captured]
+ *	[keep-alive], [zero window]
+ *
+ * Round trip times are taken as in RFC 6298: one segment at a time,
+ * not one that was retransmitted; connections using the time stamp
+ * option are timed by the echo of the value sent with it instead.
+ * Either way, the SYN is timed like data, so the handshake gives the
+ * first samples.  A segment filling in a hole is out of order rather
+ * than retransmitted if it arrives within a round trip time (or 3 ms)
+ * of the one that left the hole.
+ *
+ * There is a fixed number of connections; the one seen least recently
+ * makes room for a new one, and its counts go to the evicted totals.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+#include "addrtostr.h"
+#include "tcp.h"
+
+#define SEQ_LT(a, b)	((int32_t)((a) - (b)) < 0)
+#define SEQ_GT(a, b)	((int32_t)((a) - (b)) > 0)
+#define SEQ_GEQ(a, b)	((int32_t)((a) - (b)) >= 0)
+
+#define TCPA_OOO_MIN_NS	3000000		/* reordering window, at least */
+
+struct tcpa_key {
+	u_char addr[2][16];	/* lower address and port first */
+	uint16_t port[2];
+	u_char af6;
+};
+
+/* One direction of a connection, from key.addr[i]. */
+struct tcpa_dir {
+	uint64_t packets;
+	uint64_t bytes;		/* payload */
+	uint32_t nxt;		/* sequence number expected next */
+	uint32_t hole_lo;	/* hole left by the last segment... */
+	uint32_t hole_hi;
+	uint64_t hole_ns;	/* ...which arrived then */
+	uint32_t timed_end;	/* the segment being timed ends here... */
+	uint64_t timed_ns;	/* ...and was sent then, 0 if none */
+	uint32_t tsval;		/* time stamp value being timed... */
+	uint64_t tsval_ns;	/* ...first sent then, 0 if none */
+	u_int retransmissions;
+	u_int out_of_order;
+	u_int not_captured;
+	u_int zero_windows;
+	u_char seen;		/* nxt is valid */
+	u_char zero_window;	/* the last window was 0 */
+};
+
+struct tcpa_flow {
+	struct tcpa_flow *hnext;	/* hash chain */
+	struct tcpa_flow *newer;	/* LRU list */
+	struct tcpa_flow *older;
+	struct tcpa_key key;
+	u_int first;			/* index of the side seen first */
+	u_char timestamps;		/* uses the time stamp option */
+	uint64_t first_ns;
+	uint64_t last_ns;
+	struct tcpa_dir dir[2];
+	u_int rtt_samples;
+	uint64_t rtt_min_ns;
+	uint64_t rtt_max_ns;
+	uint64_t rtt_sum_ns;
+};
+
+static struct tcpa_flow *tcpa_flows;	/* all of them */
+static u_int tcpa_max;			/* size of tcpa_flows */
+static u_int tcpa_used;
+static struct tcpa_flow **tcpa_hash;
+static u_int tcpa_hash_mask;
+static struct tcpa_flow *tcpa_newest, *tcpa_oldest;
+
+static struct {
+	u_int flows;
+	uint64_t packets;
+	uint64_t bytes;
+	u_int retransmissions;
+	u_int out_of_order;
+	u_int not_captured;
+	u_int zero_windows;
+} tcpa_evicted;
+
+static void
+tcpa_init(netdissect_options *ndo)
+{
+	u_int n;
+
+	tcpa_max = ndo->ndo_tcp_analysis;
+	for (n = 1; n < tcpa_max; n <<= 1)
+		;
+	tcpa_flows = calloc(tcpa_max, sizeof(*tcpa_flows));
+	tcpa_hash = calloc(n, sizeof(*tcpa_hash));
+	if (tcpa_flows == NULL || tcpa_hash == NULL)
+		(*ndo->ndo_error)(ndo, S_ERR_ND_MEM_ALLOC,
+		    "%s: calloc", __func__);
+	tcpa_hash_mask = n - 1;
+}
+
+static uint32_t
+tcpa_hash_key(const struct tcpa_key *k)
+{
+	const u_char *p = (const u_char *)k;
+	uint32_t h = 2166136261U;	/* FNV-1a */
+	size_t i;
+
+	for (i = 0; i < sizeof(*k); i++) {
+		h ^= p[i];
+		h *= 16777619U;
+	}
+	return (h);
+}
+
+static void
+tcpa_unlink_lru(struct tcpa_flow *f)
+{
+	if (f->newer != NULL)
+		f->newer->older = f->older;
+	else
+		tcpa_newest = f->older;
+	if (f->older != NULL)
+		f->older->newer = f->newer;
+	else
+		tcpa_oldest = f->newer;
+}
+
+static void
+tcpa_link_newest(struct tcpa_flow *f)
+{
+	f->older = tcpa_newest;
+	f->newer = NULL;
+	if (tcpa_newest != NULL)
+		tcpa_newest->newer = f;
+	else
+		tcpa_oldest = f;
+	tcpa_newest = f;
+}
+
+/*
+ * Make room by dropping the connection seen least recently.
+ */
+static struct tcpa_flow *
+tcpa_evict(void)
+{
+	struct tcpa_flow *f = tcpa_oldest, **fp;
+	u_int i;
+
+	for (fp = &tcpa_hash[tcpa_hash_key(&f->key) & tcpa_hash_mask];
+	    *fp != f; fp = &(*fp)->hnext)
+		;
+	*fp = f->hnext;
+	tcpa_unlink_lru(f);
+
+	tcpa_evicted.flows++;
+	for (i = 0; i < 2; i++) {
+		tcpa_evicted.packets += f->dir[i].packets;
+		tcpa_evicted.bytes += f->dir[i].bytes;
+		tcpa_evicted.retransmissions += f->dir[i].retransmissions;
+		tcpa_evicted.out_of_order += f->dir[i].out_of_order;
+		tcpa_evicted.not_captured += f->dir[i].not_captured;
+		tcpa_evicted.zero_windows += f->dir[i].zero_windows;
+	}
+	return (f);
+}
+
+static struct tcpa_flow *
+tcpa_lookup(const struct tcpa_key *k, u_int side, uint64_t now)
+{
+	struct tcpa_flow *f, **head;
+
+	head = &tcpa_hash[tcpa_hash_key(k) & tcpa_hash_mask];
+	for (f = *head; f != NULL; f = f->hnext) {
+		if (memcmp(&f->key, k, sizeof(*k)) == 0) {
+			if (f != tcpa_newest) {
+				tcpa_unlink_lru(f);
+				tcpa_link_newest(f);
+			}
+			return (f);
+		}
+	}
+
+	if (tcpa_used < tcpa_max)
+		f = &tcpa_flows[tcpa_used++];
+	else
+		f = tcpa_evict();
+	memset(f, 0, sizeof(*f));
+	memcpy(&f->key, k, sizeof(*k));
+	f->first = side;
+	f->first_ns = now;
+	f->hnext = *head;
+	*head = f;
+	tcpa_link_newest(f);
+	return (f);
+}
+
+static void
+tcpa_rtt_sample(netdissect_options *ndo, struct tcpa_flow *f, uint64_t ns)
+{
+	if (f->rtt_samples == 0 || ns < f->rtt_min_ns)
+		f->rtt_min_ns = ns;
+	if (ns > f->rtt_max_ns)
+		f->rtt_max_ns = ns;
+	f->rtt_sum_ns += ns;
+	f->rtt_samples++;
+	ND_PRINT(C_RESET, " [rtt %" PRIu64 ".%03u ms]", ns / 1000000,
+	    (u_int)(ns / 1000 % 1000));
+}
+
+static uint64_t
+tcpa_now(netdissect_options *ndo)
+{
+	uint64_t ns = (uint64_t)ndo->ndo_ts.tv_sec * 1000000000;
+
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	if (ndo->ndo_tstamp_precision == PCAP_TSTAMP_PRECISION_NANO)
+		return (ns + ndo->ndo_ts.tv_usec);
+#endif
+	return (ns + (uint64_t)ndo->ndo_ts.tv_usec * 1000);
+}
+
+void
+tcp_analysis_segment(netdissect_options *ndo, const struct tcp_analysis_seg *seg)
+{
+	struct tcpa_key key;
+	struct tcpa_flow *f;
+	struct tcpa_dir *d, *o;
+	u_int side, seglen;
+	uint32_t end;
+	uint64_t now, ooo_ns;
+	int c;
+
+	if (tcpa_flows == NULL)
+		tcpa_init(ndo);
+	now = tcpa_now(ndo);
+
+	/* The same key for both directions */
+	memset(&key, 0, sizeof(key));
+	key.af6 = (seg->addrlen == 16);
+	c = memcmp(seg->src, seg->dst, seg->addrlen);
+	side = (c > 0 || (c == 0 && seg->sport > seg->dport));
+	memcpy(key.addr[side], seg->src, seg->addrlen);
+	memcpy(key.addr[!side], seg->dst, seg->addrlen);
+	key.port[side] = seg->sport;
+	key.port[!side] = seg->dport;
+
+	f = tcpa_lookup(&key, side, now);
+	f->last_ns = now;
+	d = &f->dir[side];
+	o = &f->dir[!side];
+	d->packets++;
+	d->bytes += seg->length;
+	if (seg->has_ts)
+		f->timestamps = 1;
+
+	/* A SYN with a new sequence number is a new connection */
+	if ((seg->flags & (TH_SYN|TH_ACK)) == TH_SYN && d->seen &&
+	    seg->seq + 1 != d->nxt) {
+		d->seen = o->seen = 0;
+		d->timed_ns = o->timed_ns = 0;
+		d->tsval_ns = o->tsval_ns = 0;
+	}
+
+	/*
+	 * Does this acknowledge, or echo the time stamp of, what the
+	 * other side is timing?
+	 */
+	if (seg->has_ts && o->tsval_ns != 0 && (seg->flags & TH_ACK)) {
+		if (seg->tsecr == o->tsval) {
+			tcpa_rtt_sample(ndo, f, now - o->tsval_ns);
+			o->tsval_ns = 0;
+		} else if (SEQ_GT(seg->tsecr, o->tsval))
+			o->tsval_ns = 0;	/* echoed a later one */
+	}
+	if (!f->timestamps && o->timed_ns != 0 && (seg->flags & TH_ACK) &&
+	    SEQ_GEQ(seg->ack, o->timed_end)) {
+		tcpa_rtt_sample(ndo, f, now - o->timed_ns);
+		o->timed_ns = 0;
+	}
+
+	if (seg->flags & TH_RST)
+		return;
+
+	/* SYN and FIN take up a sequence number each */
+	seglen = seg->length + ((seg->flags & TH_SYN) != 0) +
+	    ((seg->flags & TH_FIN) != 0);
+	end = seg->seq + seglen;
+	if (!d->seen) {
+		d->seen = 1;
+		d->nxt = end;
+		c = 1;		/* new data */
+	} else if (seglen == 0)
+		c = 0;
+	else if (SEQ_GT(seg->seq, d->nxt)) {
+		ND_PRINT(C_RESET, " [previous segment not captured]");
+		d->not_captured++;
+		d->hole_lo = d->nxt;
+		d->hole_hi = seg->seq;
+		d->hole_ns = now;
+		d->nxt = end;
+		c = 1;
+	} else if (SEQ_LT(seg->seq, d->nxt)) {
+		if (seg->length <= 1 && !(seg->flags & (TH_SYN|TH_FIN)) &&
+		    seg->seq + 1 == d->nxt) {
+			ND_PRINT(C_RESET, " [keep-alive]");
+			c = 0;
+		} else {
+			ooo_ns = TCPA_OOO_MIN_NS;
+			if (f->rtt_samples != 0 && f->rtt_min_ns > ooo_ns)
+				ooo_ns = f->rtt_min_ns;
+			if (SEQ_GEQ(seg->seq, d->hole_lo) &&
+			    SEQ_LT(seg->seq, d->hole_hi) &&
+			    now - d->hole_ns < ooo_ns) {
+				ND_PRINT(C_RESET, " [out-of-order]");
+				d->out_of_order++;
+			} else {
+				ND_PRINT(C_RESET, " [retransmission]");
+				d->retransmissions++;
+				/* Karn: don't time a retransmitted segment */
+				if (d->timed_ns != 0 &&
+				    SEQ_LT(seg->seq, d->timed_end))
+					d->timed_ns = 0;
+			}
+			if (SEQ_GT(end, d->nxt))
+				d->nxt = end;
+			c = 0;
+		}
+	} else {
+		d->nxt = end;
+		c = 1;
+	}
+	if (c) {
+		if (!f->timestamps && d->timed_ns == 0) {
+			d->timed_end = end;
+			d->timed_ns = now;
+		}
+		if (seg->has_ts && d->tsval_ns == 0) {
+			d->tsval = seg->tsval;
+			d->tsval_ns = now;
+		}
+	}
+
+	if (seg->win == 0 && !(seg->flags & TH_SYN)) {
+		ND_PRINT(C_RESET, " [zero window]");
+		if (!d->zero_window)
+			d->zero_windows++;
+		d->zero_window = 1;
+	} else
+		d->zero_window = 0;
+}
+
+static void
+tcpa_endpoint(const struct tcpa_flow *f, u_int side, char *buf, size_t size)
+{
+	char addr[INET6_ADDRSTRLEN];
+
+	if (f->key.af6)
+		addrtostr6(f->key.addr[side], addr, sizeof(addr));
+	else
+		addrtostr(f->key.addr[side], addr, sizeof(addr));
+	snprintf(buf, size, "%s.%u", addr, f->key.port[side]);
+}
+
+static void
+tcpa_print_dir(FILE *fp, const char *arrow, const struct tcpa_dir *d,
+	       uint64_t ns)
+{
+	(void)fprintf(fp, "    %s %" PRIu64 " packet%s, %" PRIu64 " byte%s",
+	    arrow, d->packets, PLURAL_SUFFIX(d->packets), d->bytes,
+	    PLURAL_SUFFIX(d->bytes));
+	if (ns != 0)
+		(void)fprintf(fp, " (%.1f kbit/s)",
+		    (double)d->bytes * 8e6 / (double)ns);
+	(void)fprintf(fp, ", %u retransmitted, %u out of order, %u not captured, %u zero window%s\n",
+	    d->retransmissions, d->out_of_order, d->not_captured,
+	    d->zero_windows, PLURAL_SUFFIX(d->zero_windows));
+}
+
+static int
+tcpa_cmp(const void *a, const void *b)
+{
+	const struct tcpa_flow *fa = *(const struct tcpa_flow * const *)a;
+	const struct tcpa_flow *fb = *(const struct tcpa_flow * const *)b;
+
+	if (fa->first_ns != fb->first_ns)
+		return (fa->first_ns < fb->first_ns ? -1 : 1);
+	return (fa < fb ? -1 : fa > fb);
+}
+
+/*
+ * Print what's known of each connection, the ones seen first first.
+ */
+void
+tcp_analysis_print(FILE *fp)
+{
+	const struct tcpa_flow **sorted, *f;
+	char src[INET6_ADDRSTRLEN + 8], dst[INET6_ADDRSTRLEN + 8];
+	uint64_t ns;
+	u_int i;
+
+	if (tcpa_flows == NULL)
+		return;
+	sorted = calloc(tcpa_used, sizeof(*sorted));
+	if (sorted == NULL)
+		return;
+	for (i = 0; i < tcpa_used; i++)
+		sorted[i] = &tcpa_flows[i];
+	qsort(sorted, tcpa_used, sizeof(*sorted), tcpa_cmp);
+
+	(void)fprintf(fp, "TCP analysis: %u connection%s", tcpa_used,
+	    PLURAL_SUFFIX(tcpa_used));
+	if (tcpa_evicted.flows != 0)
+		(void)fprintf(fp, ", %u more evicted (%" PRIu64 " packets, %" PRIu64 " bytes, %u retransmitted, %u out of order, %u not captured, %u zero window%s)",
+		    tcpa_evicted.flows, tcpa_evicted.packets,
+		    tcpa_evicted.bytes, tcpa_evicted.retransmissions,
+		    tcpa_evicted.out_of_order, tcpa_evicted.not_captured,
+		    tcpa_evicted.zero_windows,
+		    PLURAL_SUFFIX(tcpa_evicted.zero_windows));
+	(void)fprintf(fp, "\n");
+	for (i = 0; i < tcpa_used; i++) {
+		f = sorted[i];
+		ns = f->last_ns - f->first_ns;
+		tcpa_endpoint(f, f->first, src, sizeof(src));
+		tcpa_endpoint(f, !f->first, dst, sizeof(dst));
+		(void)fprintf(fp, "  %s > %s: %" PRIu64 ".%06u s\n", src, dst,
+		    ns / 1000000000, (u_int)(ns / 1000 % 1000000));
+		tcpa_print_dir(fp, ">", &f->dir[f->first], ns);
+		tcpa_print_dir(fp, "<", &f->dir[!f->first], ns);
+		if (f->rtt_samples != 0)
+			(void)fprintf(fp, "    rtt min %.3f avg %.3f max %.3f ms, %u sample%s\n",
+			    (double)f->rtt_min_ns / 1e6,
+			    (double)f->rtt_sum_ns / f->rtt_samples / 1e6,
+			    (double)f->rtt_max_ns / 1e6, f->rtt_samples,
+			    PLURAL_SUFFIX(f->rtt_samples));
+	}
+	free(sorted);
+}
@@ -153,11 +153,37 @@ The Regents of the University of California.  All rights reserved.\n";
 #include <sys/sysctl.h>
 #endif /* __FreeBSD__ */
 
+/*
+ * -C/-G rotation is done off the capture path where there are threads;
+ * with Capsicum, files can only be created through the capture thread's
+ * directory descriptor, so there it stays synchronous.
+ */
+#if defined(HAVE_PTHREAD_CREATE) && !defined(HAVE_CAPSICUM)
+#define ASYNC_ROTATION
+#include <pthread.h>
+#endif
+
+/*
+ * --fanout spreads a live capture over several handles, each with its
+ * own thread, with Linux's PACKET_FANOUT socket option.
+ */
+#if defined(__linux__) && defined(HAVE_PTHREAD_CREATE) && \
+    defined(HAVE_PCAP_BREAKLOOP)
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+#include <pthread.h>
+#ifdef PACKET_FANOUT
+#define FANOUT_CAPTURE
+#endif
+#endif
+
 #include "netdissect-stdinc.h"
 #include "netdissect.h"
 #include "interface.h"
 #include "addrtoname.h"
 #include "machdep.h"
+#include "dumpwriter.h"
+#include "ringbuf.h"
 #include "pcap-missing.h"
 #include "ascii_strcasecmp.h"
 
@@ -189,7 +215,10 @@ static int64_t Cflag;			/* rotate dump files after this many bytes */
 #else
 static long Cflag;			/* rotate dump files after this many bytes */
 #endif
-static int Cflag_count;			/* Keep track of which file number we're writing */
+static u_int rotations;			/* -C/-G rotations done */
+static u_int rotations_sync;		/* ... that had to open a file */
+static uint64_t rotation_ns;		/* time the capture spent on them */
+static uint64_t rotation_max_ns;
 #ifdef HAVE_PCAP_FINDALLDEVS
 static int Dflag;			/* list available devices and exit */
 #endif
@@ -212,8 +241,7 @@ static char *remote_interfaces_source;	/* list available devices from this sourc
 extern int dflag;
 int dflag;				/* print filter code */
 static int Gflag;			/* rotate dump files after this many seconds */
-static int Gflag_count;			/* number of files created with Gflag rotation */
-static time_t Gflag_time;		/* The last time_t the dump file was rotated. */
+static time_t Gflag_time;		/* when the capture started */
 static int Lflag;			/* list available data link types and exit */
 static int Iflag;			/* rfmon (monitor) mode */
 #ifdef HAVE_PCAP_SET_TSTAMP_TYPE
@@ -227,6 +255,14 @@ static int Qflag = -1;			/* restrict captured packet by send/receive direction *
 #endif
 #ifdef HAVE_PCAP_DUMP_FLUSH
 static int Uflag;			/* "unbuffered" output of dump files */
+static int group_commit;		/* write them in batches instead */
+#else
+#undef HAVE_DUMP_WRITER			/* it's for -U */
+#endif
+#ifdef HAVE_DUMP_WRITER
+static struct dump_writer_params dump_writer_params = {
+	DUMP_WRITER_DEFAULT_COMMIT_BYTES, DUMP_WRITER_DEFAULT_LATENCY_MS, 0, 0
+};
 #endif
 static int Wflag;			/* recycle output files after this number of files */
 static int WflagChars;
@@ -251,7 +287,21 @@ static void print_usage(FILE *);
 
 static void print_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
 static void dump_packet_and_trunc(u_char *, const struct pcap_pkthdr *, const u_char *);
+#ifdef ASYNC_ROTATION
+static void rotation_init(void);
+#endif
 static void dump_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void dump_packet_outputs(u_char *, const struct pcap_pkthdr *, const u_char *);
+static void ring_packet(u_char *, const struct pcap_pkthdr *, const u_char *);
+static int ring_loop(int, pcap_handler, u_char *);
+static void ring_finish(void);
+#ifdef FANOUT_CAPTURE
+static void fanout_open(const char *, netdissect_options *, char *);
+static int fanout_loop(struct bpf_program *);
+static void fanout_breakloop(void);
+static int fanout_stats(struct pcap_stat *);
+static u_int fanout_packets(void);
+#endif
 
 #ifdef SIGNAL_REQ_INFO
 static void requestinfo(int);
@@ -288,7 +338,6 @@ static const struct tok status_flags[] = {
 #endif
 
 static pcap_t *pd;
-static pcap_dumper_t *pdd = NULL;
 
 static int supports_monitor_mode;
 
@@ -302,11 +351,83 @@ struct dump_info {
 	pcap_t	*pd;
 	pcap_dumper_t *pdd;
 	netdissect_options *ndo;
+	char	*filter;		/* --output filter, or NULL */
+	struct bpf_program fcode;
+	int	Cflag_count;		/* which file number we're writing */
+	int	Gflag_count;		/* number of files created with -G */
+	time_t	Gflag_time;		/* the last time the file was rotated */
+	uint64_t sliced;		/* packets cut short by --slice-headers */
+	uint64_t sliced_bytes;		/* and the bytes cut off them */
 #ifdef HAVE_CAPSICUM
 	int	dirfd;
 #endif
 };
 
+/*
+ * The savefiles being written: the -w file, if any, first, then the
+ * --output files, each getting the packets that match its own filter
+ * as well as the capture filter.
+ */
+static struct dump_info *outputs;
+static u_int noutputs;
+
+#ifdef FANOUT_CAPTURE
+struct fanout_worker {
+	pthread_t thread;
+	pcap_t	*pd;
+	struct dump_info *dump_info;	/* the savefile it writes */
+	/*
+	 * Packets captured; counted by the worker's thread and read by the
+	 * main thread, which doesn't lock for it but mustn't see a cached
+	 * or half-written value.
+	 */
+	volatile u_int packets;
+	u_int	drops;			/* dropped by the kernel, last we looked */
+	int	status;			/* what pcap_loop() returned */
+};
+
+static struct {
+	u_int	n;			/* handles; 0 without --fanout */
+	int	mode;			/* PACKET_FANOUT_HASH, _CPU or _LB */
+	int	limit_reached;		/* a thread reached the -W limit */
+	struct fanout_worker *workers;
+	pthread_mutex_t rotation_mtx;	/* threads rotate one at a time */
+} fanout = { 0, PACKET_FANOUT_HASH, 0, NULL, PTHREAD_MUTEX_INITIALIZER };
+
+#define ROTATION_LOCK()		pthread_mutex_lock(&fanout.rotation_mtx)
+#define ROTATION_UNLOCK()	pthread_mutex_unlock(&fanout.rotation_mtx)
+#else
+#define ROTATION_LOCK()
+#define ROTATION_UNLOCK()
+#endif
+
+/*
+ * --slice-headers: write packets with only their headers, and up to
+ * payload bytes after them.
+ */
+static struct {
+	int	enabled;
+	u_int	payload;
+	int	dlt;			/* the link-layer header type */
+} slice;
+
+/*
+ * --ring-buffer: instead of writing every packet to the -w file, keep
+ * the latest ones in memory and write them out when triggered.
+ */
+static struct {
+	uint64_t size;			/* 0 without --ring-buffer */
+	struct ring_buffer *rb;
+	pcap_t	*pd;			/* what the files are written for */
+	char	*trigger_filter;	/* --ring-trigger, or NULL */
+	struct bpf_program trigger;
+	long	after;			/* --ring-after */
+	long	remaining;		/* packets to go before writing */
+	int	pending;		/* triggered, not written yet */
+	u_int	dumps;			/* files written */
+	volatile sig_atomic_t signalled;	/* SIGNAL_FLUSH_PCAP */
+} ring;
+
 #if defined(HAVE_PCAP_SET_PARSER_DEBUG)
 /*
  * We have pcap_set_parser_debug() in libpcap; declare it (it's not declared
@@ -693,6 +814,26 @@ show_remote_devices_and_exit(void)
 #define OPTION_COUNT			136
 #define OPTION_PRINT_SAMPLING		137
 #define OPTION_COLOR	138
+#define OPTION_SUMMARY			139
+#define OPTION_PROFILE_DISSECTORS	140
+#define OPTION_GROUP_COMMIT		141
+#define OPTION_DIRECT_IO		142
+#define OPTION_PREALLOCATE		143
+#define OPTION_PRINT_FLOW_SAMPLING	144
+#define OPTION_PRINT_RATE_LIMIT		145
+#define OPTION_OUTPUT			146
+#define OPTION_FANOUT			147
+#define OPTION_RING_BUFFER		148
+#define OPTION_RING_TRIGGER		149
+#define OPTION_RING_AFTER		150
+#define OPTION_SLICE_HEADERS		151
+#define OPTION_NAME_CACHE_SIZE		152
+#define OPTION_NAME_SNAPSHOT		153
+#define OPTION_WRITE_NAME_SNAPSHOT	154
+#define OPTION_TCP_ANALYSIS		155
+#define OPTION_FLOW_EXPORT_SUMMARY	156
+#define OPTION_DNS_ANALYSIS		157
+#define OPTION_DISABLE_DISSECTOR	158
 
 static const struct option longopts[] = {
 #if defined(HAVE_PCAP_CREATE) || defined(_WIN32)
@@ -727,6 +868,11 @@ static const struct option longopts[] = {
 	{ "absolute-tcp-sequence-numbers", no_argument, NULL, 'S' },
 #ifdef HAVE_PCAP_DUMP_FLUSH
 	{ "packet-buffered", no_argument, NULL, 'U' },
+#endif
+#ifdef HAVE_DUMP_WRITER
+	{ "group-commit", required_argument, NULL, OPTION_GROUP_COMMIT },
+	{ "direct-io", no_argument, NULL, OPTION_DIRECT_IO },
+	{ "preallocate", required_argument, NULL, OPTION_PREALLOCATE },
 #endif
 	{ "linktype", required_argument, NULL, 'y' },
 #ifdef HAVE_PCAP_SET_IMMEDIATE_MODE
@@ -738,11 +884,30 @@ static const struct option longopts[] = {
 	{ "relinquish-privileges", required_argument, NULL, 'Z' },
 	{ "count", no_argument, NULL, OPTION_COUNT },
 	{ "fp-type", no_argument, NULL, OPTION_FP_TYPE },
+	{ "name-cache-size", required_argument, NULL, OPTION_NAME_CACHE_SIZE },
+	{ "name-snapshot", required_argument, NULL, OPTION_NAME_SNAPSHOT },
+	{ "write-name-snapshot", required_argument, NULL, OPTION_WRITE_NAME_SNAPSHOT },
 	{ "number", no_argument, NULL, '#' },
 	{ "print", no_argument, NULL, OPTION_PRINT },
 	{ "print-sampling", required_argument, NULL, OPTION_PRINT_SAMPLING },
+	{ "print-flow-sampling", required_argument, NULL, OPTION_PRINT_FLOW_SAMPLING },
+	{ "print-rate-limit", required_argument, NULL, OPTION_PRINT_RATE_LIMIT },
+	{ "output", required_argument, NULL, OPTION_OUTPUT },
+#ifdef FANOUT_CAPTURE
+	{ "fanout", required_argument, NULL, OPTION_FANOUT },
+#endif
+	{ "ring-buffer", required_argument, NULL, OPTION_RING_BUFFER },
+	{ "ring-trigger", required_argument, NULL, OPTION_RING_TRIGGER },
+	{ "ring-after", required_argument, NULL, OPTION_RING_AFTER },
+	{ "slice-headers", optional_argument, NULL, OPTION_SLICE_HEADERS },
 	{ "version", no_argument, NULL, OPTION_VERSION },
 	{ "color", no_argument, NULL, OPTION_COLOR },
+	{ "summary", no_argument, NULL, OPTION_SUMMARY },
+	{ "tcp-analysis", optional_argument, NULL, OPTION_TCP_ANALYSIS },
+	{ "flow-export-summary", optional_argument, NULL, OPTION_FLOW_EXPORT_SUMMARY },
+	{ "dns-analysis", optional_argument, NULL, OPTION_DNS_ANALYSIS },
+	{ "disable-dissector", required_argument, NULL, OPTION_DISABLE_DISSECTOR },
+	{ "profile-dissectors", no_argument, NULL, OPTION_PROFILE_DISSECTORS },
 	{ NULL, 0, NULL, 0 }
 };
 
@@ -752,6 +917,18 @@ static const struct option longopts[] = {
 #define LIST_REMOTE_INTERFACES_USAGE
 #endif
 
+#ifdef HAVE_DUMP_WRITER
+#define GROUP_COMMIT_USAGE " [ --group-commit size[,msec] ]"
+#define DIRECT_IO_USAGE " [ --direct-io ] [ --preallocate size ]"
+#else
+#define GROUP_COMMIT_USAGE
+#define DIRECT_IO_USAGE
+#endif
+
+#ifdef FANOUT_CAPTURE
+#define FANOUT_USAGE "[ --fanout n[:hash|cpu|lb] ]"
+#endif
+
 #ifdef HAVE_PCAP_SET_IMMEDIATE_MODE
 #define IMMEDIATE_MODE_USAGE " [ --immediate-mode ]"
 #else
@@ -830,7 +1007,7 @@ getWflagChars(int x)
 
 
 static void
-MakeFilename(char *buffer, char *orig_name, int cnt, int max_chars)
+MakeFilename(char *buffer, char *orig_name, time_t t, int cnt, int max_chars)
 {
         char *filename = malloc(PATH_MAX + 1);
         if (filename == NULL)
@@ -840,8 +1017,8 @@ MakeFilename(char *buffer, char *orig_name, int cnt, int max_chars)
         if (Gflag != 0) {
           struct tm *local_tm;
 
-          /* Convert Gflag_time to a usable format */
-          if ((local_tm = localtime(&Gflag_time)) == NULL) {
+          /* Convert the rotation time to a usable format */
+          if ((local_tm = localtime(&t)) == NULL) {
                   error("%s: localtime", __func__);
           }
 
@@ -862,6 +1039,395 @@ MakeFilename(char *buffer, char *orig_name, int cnt, int max_chars)
         free(filename);
 }
 
+/*
+ * Parse a size in bytes, optionally followed by k, m or g for KiB, MiB
+ * or GiB.  If endpp is null, nothing may follow the size; otherwise,
+ * *endpp is set to point after it.
+ */
+static uint64_t
+parse_size(const char *arg, char **endpp, const char *what)
+{
+	uint64_t size;
+	char *endp;
+	u_int shift = 0;
+
+	errno = 0;
+	size = strtoint64_t(arg, &endp, 10);
+	if (endp == arg || errno != 0 || (int64_t)size <= 0)
+		error("invalid %s %s", what, arg);
+	switch (*endp) {
+
+	case 'k':
+	case 'K':
+		shift = 10;
+		endp++;
+		break;
+
+	case 'm':
+	case 'M':
+		shift = 20;
+		endp++;
+		break;
+
+	case 'g':
+	case 'G':
+		shift = 30;
+		endp++;
+		break;
+	}
+	if (size > (uint64_t)INT64_MAX >> shift)
+		error("%s %s is too large", what, arg);
+	size <<= shift;
+	if (endpp != NULL)
+		*endpp = endp;
+	else if (*endp != '\0')
+		error("invalid %s %s", what, arg);
+	return (size);
+}
+
+#ifdef HAVE_DUMP_WRITER
+/*
+ * --group-commit=size[,msec]
+ */
+static void
+parse_group_commit(const char *arg)
+{
+	char *endp;
+	long msec;
+
+	dump_writer_params.commit_bytes =
+	    (size_t)parse_size(arg, &endp, "group commit size");
+	if (*endp == ',') {
+		errno = 0;
+		msec = strtol(endp + 1, &endp, 10);
+		if (errno != 0 || *endp != '\0' || msec < 0 || msec > 60000)
+			error("invalid group commit latency %s", arg);
+		dump_writer_params.latency_ms = (u_int)msec;
+	} else if (*endp != '\0')
+		error("invalid group commit size %s", arg);
+}
+#endif /* HAVE_DUMP_WRITER */
+
+#if defined(HAVE_DUMP_WRITER) || defined(HAVE_CAPSICUM)
+/*
+ * Get a stream for a newly created dump file.  With -U, write it in
+ * batches rather than flushing it after every packet.
+ */
+static FILE *
+dump_fdopen(int fd, const char *name)
+{
+	FILE *fp;
+
+#ifdef HAVE_DUMP_WRITER
+	if (group_commit) {
+		fp = dump_writer_fdopen(fd, &dump_writer_params);
+		if (fp == NULL) {
+			error("unable to set up writing of file %s: %s",
+			    name, pcap_strerror(errno));
+		}
+		return (fp);
+	}
+#endif
+	fp = fdopen(fd, "w");
+	if (fp == NULL)
+		error("unable to fdopen file %s", name);
+	return (fp);
+}
+#endif
+
+static pcap_dumper_t *
+dump_open(pcap_t *p, const char *name)
+{
+#ifdef HAVE_DUMP_WRITER
+	int fd;
+
+	if (group_commit && strcmp(name, "-") != 0) {
+		fd = open(name, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+		if (fd < 0) {
+			error("unable to open file %s: %s", name,
+			    pcap_strerror(errno));
+		}
+		return (pcap_dump_fopen(p, dump_fdopen(fd, name)));
+	}
+#endif
+	return (pcap_dump_open(p, name));
+}
+
+/*
+ * Close a dump file, reporting any error writing it; with -U, or on a
+ * full disk, that may be the first time the data is written.
+ */
+static void
+dump_close(pcap_dumper_t *p, const char *name)
+{
+	FILE *fp = pcap_dump_file(p);
+	int ok;
+
+	ok = fflush(fp) != EOF && !ferror(fp);
+#ifdef HAVE_DUMP_WRITER
+	if (ok && dump_writer_finish(fp) == -1)
+		ok = 0;
+#endif
+	if (!ok)
+		warning("error writing %s: %s", name, pcap_strerror(errno));
+	pcap_dump_close(p);
+}
+
+#ifdef HAVE_PCAP_DUMP_FLUSH
+/*
+ * With -U, after a packet has been written: flush it out or, with
+ * group commit, which writes it out within the latency bound, check
+ * that the batches written so far made it.  A write error ends the
+ * capture rather than letting it go on writing nowhere.
+ */
+static void
+dump_flush(struct dump_info *dump_info)
+{
+	FILE *fp = pcap_dump_file(dump_info->pdd);
+
+	if ((!group_commit && pcap_dump_flush(dump_info->pdd) == -1) ||
+	    ferror(fp))
+		error("error writing %s: %s", dump_info->CurrentFileName,
+		    pcap_strerror(errno));
+}
+#endif
+
+/*
+ * Add a savefile to write, at the end of the list or at the front.
+ */
+static void
+add_output(char *name, char *filter, int front)
+{
+	struct dump_info *dump_info;
+
+	outputs = realloc(outputs, (noutputs + 1) * sizeof(*outputs));
+	if (outputs == NULL)
+		error("%s: realloc", __func__);
+	if (front) {
+		memmove(&outputs[1], &outputs[0], noutputs * sizeof(*outputs));
+		dump_info = &outputs[0];
+	} else
+		dump_info = &outputs[noutputs];
+	noutputs++;
+	memset(dump_info, 0, sizeof(*dump_info));
+	dump_info->WFileName = name;
+	dump_info->filter = filter;
+}
+
+/*
+ * --output=file:filter
+ */
+static void
+parse_output(const char *arg)
+{
+	const char *colon;
+	char *name;
+
+	colon = strchr(arg, ':');
+	if (colon == NULL || colon == arg)
+		error("invalid output %s, expected file:filter", arg);
+	name = malloc(colon - arg + 1);
+	if (name == NULL)
+		error("%s: malloc", __func__);
+	memcpy(name, arg, colon - arg);
+	name[colon - arg] = '\0';
+	if (strcmp(name, "-") == 0)
+		error("--output can't write to the standard output, use -w");
+	add_output(name, strdup(colon + 1), 0);
+	if (outputs[noutputs - 1].filter == NULL)
+		error("%s: strdup", __func__);
+}
+
+#ifdef FANOUT_CAPTURE
+/*
+ * --fanout=n[:hash|cpu|lb]
+ */
+static void
+parse_fanout(const char *arg)
+{
+	unsigned long n;
+	char *endp;
+
+	errno = 0;
+	n = strtoul(arg, &endp, 10);
+	if (endp == arg || errno != 0 || n == 0 || n > 256)
+		error("invalid fanout %s", arg);
+	fanout.n = (u_int)n;
+	if (*endp == '\0')
+		return;
+	if (strcmp(endp, ":hash") == 0)
+		fanout.mode = PACKET_FANOUT_HASH;
+	else if (strcmp(endp, ":cpu") == 0)
+		fanout.mode = PACKET_FANOUT_CPU;
+	else if (strcmp(endp, ":lb") == 0)
+		fanout.mode = PACKET_FANOUT_LB;
+	else
+		error("invalid fanout %s", arg);
+}
+
+/*
+ * Replace the -w output with one per thread, named file.0, file.1...
+ */
+static void
+fanout_outputs(void)
+{
+	char *WFileName = outputs[0].WFileName;
+	size_t len;
+	char *name;
+	u_int i;
+
+	noutputs = 0;
+	len = strlen(WFileName) + sizeof(".4294967295");
+	for (i = 0; i < fanout.n; i++) {
+		name = malloc(len);
+		if (name == NULL)
+			error("%s: malloc", __func__);
+		snprintf(name, len, "%s.%u", WFileName, i);
+		add_output(name, NULL, 0);
+	}
+}
+#endif /* FANOUT_CAPTURE */
+
+/*
+ * --print-rate-limit=rate[,burst]; the burst defaults to the rate.
+ */
+static void
+parse_print_rate_limit(netdissect_options *ndo, const char *arg)
+{
+	unsigned long rate, burst;
+	char *endp;
+
+	errno = 0;
+	rate = strtoul(arg, &endp, 10);
+	if (endp == arg || errno != 0 || rate == 0 || rate > 1000000)
+		error("invalid print rate limit %s", arg);
+	burst = rate;
+	if (*endp == ',') {
+		burst = strtoul(endp + 1, &endp, 10);
+		if (errno != 0 || burst == 0 || burst > 1000000)
+			error("invalid print rate limit %s", arg);
+	}
+	if (*endp != '\0')
+		error("invalid print rate limit %s", arg);
+	ndo->ndo_print_rate = (u_int)rate;
+	ndo->ndo_print_burst = (u_int)burst;
+}
+
+/*
+ * Report what --print-flow-sampling and --print-rate-limit left out.
+ */
+static void
+print_sampling_stats(void)
+{
+	struct nd_sampling_stats stats;
+
+	nd_sampling_get_stats(&stats);
+	if (stats.flow_skipped != 0)
+		(void)fprintf(stderr,
+		    "%" PRIu64 " packet%s not printed, not in a sampled flow\n",
+		    stats.flow_skipped, PLURAL_SUFFIX(stats.flow_skipped));
+	if (stats.rate_suppressed != 0)
+		(void)fprintf(stderr,
+		    "%" PRIu64 " packet%s not printed, over the print rate limit\n",
+		    stats.rate_suppressed, PLURAL_SUFFIX(stats.rate_suppressed));
+}
+
+/*
+ * Report the address-name caches that had to evict names to stay
+ * within --name-cache-size.
+ */
+static void
+print_name_cache_stats(void)
+{
+	struct addrtoname_cache_stats stats;
+	uint64_t lookups;
+	u_int i;
+
+	for (i = 0; i < ADDRTONAME_CACHES; i++) {
+		addrtoname_get_cache_stats(i, &stats);
+		if (stats.evictions == 0)
+			continue;
+		lookups = stats.hits + stats.misses;
+		(void)fprintf(stderr,
+		    "%s name cache: %" PRIu64 " lookup%s, %" PRIu64 " hit%s, %" PRIu64 " eviction%s\n",
+		    stats.name, lookups, PLURAL_SUFFIX(lookups),
+		    stats.hits, PLURAL_SUFFIX(stats.hits),
+		    stats.evictions, PLURAL_SUFFIX(stats.evictions));
+	}
+}
+
+/*
+ * Set up --ring-buffer, in place of opening the -w file.
+ */
+static void
+ring_init(int Oflag, bpf_u_int32 netmask)
+{
+	int snaplen = pcap_snapshot(pd);
+
+	if (ring.size < sizeof(struct pcap_pkthdr) + (uint64_t)snaplen) {
+		error("ring buffer size %" PRIu64 " can't hold a packet of the snapshot length %d",
+		    ring.size, snaplen);
+	}
+	ring.rb = ring_buffer_new((size_t)ring.size);
+	if (ring.rb == NULL)
+		error("unable to allocate a ring buffer of %" PRIu64 " bytes",
+		    ring.size);
+	if (ring.trigger_filter != NULL &&
+	    pcap_compile(pd, &ring.trigger, ring.trigger_filter, Oflag,
+	    netmask) < 0)
+		error("%s: %s", ring.trigger_filter, pcap_geterr(pd));
+
+	/*
+	 * The capture handle is gone by the time the last file is
+	 * written if we're reading savefiles with -V.
+	 */
+#ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
+	ring.pd = pcap_open_dead_with_tstamp_precision(pcap_datalink(pd),
+	    snaplen, pcap_get_tstamp_precision(pd));
+#else
+	ring.pd = pcap_open_dead(pcap_datalink(pd), snaplen);
+#endif
+	if (ring.pd == NULL)
+		error("%s: pcap_open_dead failed", __func__);
+}
+
+/*
+ * Report what --slice-headers has cut off.
+ */
+static void
+print_slice_stats(void)
+{
+	uint64_t sliced = 0, bytes = 0;
+	u_int i;
+
+	if (!slice.enabled)
+		return;
+	for (i = 0; i < noutputs; i++) {
+		sliced += outputs[i].sliced;
+		bytes += outputs[i].sliced_bytes;
+	}
+	(void)fprintf(stderr,
+	    "%" PRIu64 " packet%s sliced, %" PRIu64 " byte%s of payload not written\n",
+	    sliced, PLURAL_SUFFIX(sliced), bytes, PLURAL_SUFFIX(bytes));
+}
+
+/*
+ * Report what --ring-buffer holds and has written.
+ */
+static void
+print_ring_stats(void)
+{
+	struct ring_buffer_stats stats;
+
+	if (ring.rb == NULL)
+		return;
+	ring_buffer_get_stats(ring.rb, &stats);
+	(void)fprintf(stderr,
+	    "%u packet%s in the ring buffer, %" PRIu64 " overwritten, %u file%s written\n",
+	    stats.packets, PLURAL_SUFFIX(stats.packets), stats.evicted,
+	    ring.dumps, PLURAL_SUFFIX(ring.dumps));
+}
+
 static char *
 get_next_file(FILE *VFile, char *ptr)
 {
@@ -1450,6 +2016,92 @@ open_interface(const char *device, netdissect_options *ndo, char *ebuf)
 	return (pc);
 }
 
+/*
+ * Open the first file of an output.
+ */
+static void
+open_output(struct dump_info *dump_info)
+{
+	char *WFileName = dump_info->WFileName;
+#ifdef HAVE_CAPSICUM
+	cap_rights_t rights;
+#endif
+
+	dump_info->pd = pd;
+	dump_info->Gflag_time = Gflag_time;
+
+	/* Do not exceed the default PATH_MAX for files. */
+	dump_info->CurrentFileName = (char *)malloc(PATH_MAX + 1);
+
+	if (dump_info->CurrentFileName == NULL)
+		error("malloc of dump_info->CurrentFileName");
+
+	/* We do not need numbering for dumpfiles if Cflag isn't set. */
+	if (Cflag != 0)
+	  MakeFilename(dump_info->CurrentFileName, WFileName,
+	      dump_info->Gflag_time, 0, WflagChars);
+	else
+	  MakeFilename(dump_info->CurrentFileName, WFileName,
+	      dump_info->Gflag_time, 0, 0);
+
+	dump_info->pdd = dump_open(pd, dump_info->CurrentFileName);
+	if (dump_info->pdd == NULL)
+		error("%s", pcap_geterr(pd));
+#ifdef HAVE_CAPSICUM
+	set_dumper_capsicum_rights(dump_info->pdd);
+	if (Cflag != 0 || Gflag != 0) {
+		/*
+		 * basename() and dirname() may modify their input buffer
+		 * and they do since FreeBSD 12.0, but they didn't before.
+		 * Hence use the return value only, but always assume the
+		 * input buffer has been modified and would need to be
+		 * reset before the next use.
+		 */
+		char *WFileName_copy;
+
+		if ((WFileName_copy = strdup(WFileName)) == NULL) {
+			error("Unable to allocate memory for file %s",
+			    WFileName);
+		}
+		DIAG_OFF_C11_EXTENSIONS
+		dump_info->WFileName = strdup(basename(WFileName_copy));
+		DIAG_ON_C11_EXTENSIONS
+		if (dump_info->WFileName == NULL) {
+			error("Unable to allocate memory for file %s",
+			    WFileName);
+		}
+		free(WFileName_copy);
+
+		if ((WFileName_copy = strdup(WFileName)) == NULL) {
+			error("Unable to allocate memory for file %s",
+			    WFileName);
+		}
+		DIAG_OFF_C11_EXTENSIONS
+		char *WFileName_dirname = dirname(WFileName_copy);
+		DIAG_ON_C11_EXTENSIONS
+		dump_info->dirfd = open(WFileName_dirname,
+		    O_DIRECTORY | O_RDONLY);
+		if (dump_info->dirfd < 0) {
+			error("unable to open directory %s",
+			    WFileName_dirname);
+		}
+		free(WFileName_dirname);
+		free(WFileName_copy);
+
+		cap_rights_init(&rights, CAP_CREATE, CAP_FCNTL,
+		    CAP_FTRUNCATE, CAP_LOOKUP, CAP_SEEK, CAP_WRITE);
+		if (cap_rights_limit(dump_info->dirfd, &rights) < 0 &&
+		    errno != ENOSYS) {
+			error("unable to limit directory rights");
+		}
+		if (cap_fcntls_limit(dump_info->dirfd, CAP_FCNTL_GETFL) < 0 &&
+		    errno != ENOSYS) {
+			error("unable to limit dump descriptor fcntls");
+		}
+	}
+#endif	/* HAVE_CAPSICUM */
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1464,7 +2116,6 @@ main(int argc, char **argv)
 #ifndef _WIN32
 	void (*oldhandler)(int);
 #endif
-	struct dump_info dumpinfo;
 	u_char *pcap_userdata;
 	char ebuf[PCAP_ERRBUF_SIZE];
 	char VFileLine[PATH_MAX + 1];
@@ -1487,8 +2138,10 @@ main(int argc, char **argv)
 	int Oflag = 1;			/* run filter code optimizer */
 	int yflag_dlt = -1;
 	const char *yflag_dlt_name = NULL;
+	const char *dissector;
 	int print = 0;
 	long Cflagmult;
+	unsigned long name_cache_size, tcp_analysis, flow_export, dns_analysis;
 
 	netdissect_options Ndo;
 	netdissect_options *ndo = &Ndo;
@@ -1687,9 +2340,6 @@ main(int argc, char **argv)
 			if (Gflag < 0)
 				error("invalid number of seconds %s", optarg);
 
-                        /* We will create one file initially. */
-                        Gflag_count = 0;
-
 			/* Grab the current time for rotation use. */
 			if ((Gflag_time = time(NULL)) == (time_t)-1) {
 				error("%s: can't get current time: %s",
@@ -1972,6 +2622,122 @@ main(int argc, char **argv)
 				error("invalid print sampling %s", optarg);
 			break;
 
+		case OPTION_PRINT_FLOW_SAMPLING:
+			print = 1;
+			ndo->ndo_print_flow_sampling = atoi(optarg);
+			if (ndo->ndo_print_flow_sampling <= 0)
+				error("invalid print flow sampling %s", optarg);
+			break;
+
+		case OPTION_PRINT_RATE_LIMIT:
+			print = 1;
+			++ndo->ndo_Sflag;
+			parse_print_rate_limit(ndo, optarg);
+			break;
+
+		case OPTION_NAME_CACHE_SIZE:
+			errno = 0;
+			name_cache_size = strtoul(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    name_cache_size == 0 || name_cache_size > 1 << 24)
+				error("invalid name cache size %s", optarg);
+			ndo->ndo_name_cache_size = (u_int)name_cache_size;
+			break;
+
+		case OPTION_NAME_SNAPSHOT:
+			if (addrtoname_load_snapshot(optarg, ebuf,
+			    sizeof(ebuf)) == -1)
+				error("%s", ebuf);
+			break;
+
+		case OPTION_TCP_ANALYSIS:
+			ndo->ndo_tcp_analysis = 65536;
+			if (optarg == NULL)
+				break;
+			errno = 0;
+			tcp_analysis = strtoul(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    tcp_analysis == 0 || tcp_analysis > 1 << 24)
+				error("invalid TCP connection count %s", optarg);
+			ndo->ndo_tcp_analysis = (u_int)tcp_analysis;
+			break;
+
+		case OPTION_FLOW_EXPORT_SUMMARY:
+			ndo->ndo_flow_export = 10;
+			if (optarg == NULL)
+				break;
+			errno = 0;
+			flow_export = strtoul(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    flow_export == 0 || flow_export > 86400)
+				error("invalid flow export summary interval %s",
+				    optarg);
+			ndo->ndo_flow_export = (u_int)flow_export;
+			break;
+
+		case OPTION_DNS_ANALYSIS:
+			ndo->ndo_dns_analysis = 65536;
+			if (optarg == NULL)
+				break;
+			errno = 0;
+			dns_analysis = strtoul(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    dns_analysis == 0 || dns_analysis > 1 << 24)
+				error("invalid DNS query count %s", optarg);
+			ndo->ndo_dns_analysis = (u_int)dns_analysis;
+			break;
+
+		case OPTION_DISABLE_DISSECTOR:
+			if (nd_disable_dissector(optarg) == -1)
+				error("too many dissectors disabled");
+			break;
+
+		case OPTION_WRITE_NAME_SNAPSHOT:
+			if (addrtoname_write_snapshot(optarg, ebuf,
+			    sizeof(ebuf)) == -1)
+				error("%s", ebuf);
+			exit_tcpdump(S_SUCCESS);
+			break;
+
+		case OPTION_OUTPUT:
+			parse_output(optarg);
+			break;
+
+#ifdef FANOUT_CAPTURE
+		case OPTION_FANOUT:
+			parse_fanout(optarg);
+			break;
+#endif
+
+		case OPTION_RING_BUFFER:
+			ring.size = parse_size(optarg, NULL, "ring buffer size");
+			if ((size_t)ring.size != ring.size)
+				error("invalid ring buffer size %s", optarg);
+			break;
+
+		case OPTION_RING_TRIGGER:
+			ring.trigger_filter = optarg;
+			break;
+
+		case OPTION_RING_AFTER:
+			errno = 0;
+			ring.after = strtol(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    ring.after < 0 || ring.after > INT_MAX)
+				error("invalid ring after count %s", optarg);
+			break;
+
+		case OPTION_SLICE_HEADERS:
+			slice.enabled = 1;
+			if (optarg == NULL)
+				break;
+			errno = 0;
+			slice.payload = strtoul(optarg, &end, 10);
+			if (optarg == end || *end != '\0' || errno != 0 ||
+			    slice.payload > MAXIMUM_SNAPLEN)
+				error("invalid slice payload length %s", optarg);
+			break;
+
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
 		case OPTION_TSTAMP_MICRO:
 			ndo->ndo_tstamp_precision = PCAP_TSTAMP_PRECISION_MICRO;
@@ -2001,8 +2767,35 @@ main(int argc, char **argv)
 			++ndo->ndo_color;
 			break;
 
-		default:
-			print_usage(stderr);
+		case OPTION_SUMMARY:
+			++ndo->ndo_summary;
+			break;
+
+		case OPTION_PROFILE_DISSECTORS:
+			++ndo->ndo_profile;
+			nd_profile_init();
+			break;
+
+#ifdef HAVE_DUMP_WRITER
+		case OPTION_GROUP_COMMIT:
+			parse_group_commit(optarg);
+			++Uflag;
+			break;
+
+		case OPTION_DIRECT_IO:
+			dump_writer_params.direct = 1;
+			++Uflag;
+			break;
+
+		case OPTION_PREALLOCATE:
+			dump_writer_params.preallocate =
+			    parse_size(optarg, NULL, "preallocation size");
+			++Uflag;
+			break;
+#endif
+
+		default:
+			print_usage(stderr);
 			exit_tcpdump(S_ERR_HOST_PROGRAM);
 			/* NOTREACHED */
 		}
@@ -2016,6 +2809,44 @@ main(int argc, char **argv)
 		show_remote_devices_and_exit();
 #endif
 
+	if (WFileName != NULL)
+		add_output(WFileName, NULL, 1);
+
+#ifdef FANOUT_CAPTURE
+	if (fanout.n != 0) {
+		if (RFileName != NULL || VFileName != NULL)
+			error("--fanout can only be used for a live capture");
+		if (WFileName == NULL || strcmp(WFileName, "-") == 0 ||
+		    noutputs != 1)
+			error("--fanout requires -w with a file name, and no --output");
+		if (print || cnt != -1)
+			error("--fanout can't be used with --print or -c");
+		fanout_outputs();
+	}
+#endif
+
+	if (ring.size != 0) {
+		if (WFileName == NULL || strcmp(WFileName, "-") == 0 ||
+		    noutputs != 1)
+			error("--ring-buffer requires -w with a file name, and no --output");
+		if (Cflag != 0 || Gflag != 0)
+			error("--ring-buffer can't be used with -C or -G");
+#ifdef FANOUT_CAPTURE
+		if (fanout.n != 0)
+			error("--ring-buffer can't be used with --fanout");
+#endif
+	} else if (ring.trigger_filter != NULL || ring.after != 0)
+		error("--ring-trigger and --ring-after require --ring-buffer");
+	if (slice.enabled && noutputs == 0)
+		error("--slice-headers requires -w or --output");
+
+#ifdef HAVE_DUMP_WRITER
+	/* the standard output is left to stdio */
+	if (Uflag && noutputs != 0 &&
+	    (WFileName == NULL || strcmp(WFileName, "-") != 0))
+		group_commit = 1;
+#endif
+
 #if defined(DLT_LINUX_SLL2) && defined(HAVE_PCAP_SET_DATALINK)
 /* Set default linktype DLT_LINUX_SLL2 when capturing on the "any" device */
 		if (device != NULL &&
@@ -2055,7 +2886,7 @@ main(int argc, char **argv)
 	 * XXX - would there be some value appropriate for all cases,
 	 * based on, say, the buffer size and packet input rate?
 	 */
-	if ((WFileName == NULL || print) && (isatty(1) || lflag))
+	if ((noutputs == 0 || print) && (isatty(1) || lflag))
 		timeout = 100;
 
 #ifdef WITH_CHROOT
@@ -2239,6 +3070,10 @@ main(int argc, char **argv)
 			error("%s", ebuf);
 #endif /* HAVE_PCAP_FINDALLDEVS */
 		}
+#ifdef FANOUT_CAPTURE
+		if (fanout.n != 0)
+			fanout_open(device, ndo, ebuf);
+#endif
 
 		/*
 		 * Let user own process after capture device has
@@ -2316,6 +3151,8 @@ main(int argc, char **argv)
 #endif	/* HAVE_CASPER */
 
 	init_print(ndo, localnet, netmask);
+	if ((dissector = nd_unknown_dissector()) != NULL)
+		error("unknown dissector %s", dissector);
 
 #ifndef _WIN32
 	(void)setsignal(SIGPIPE, cleanup);
@@ -2374,7 +3211,7 @@ DIAG_OFF_ASSIGN_ENUM
 DIAG_ON_ASSIGN_ENUM
 		}
 
-		if (WFileName) {
+		if (noutputs != 0) {
 DIAG_OFF_ASSIGN_ENUM
 			capng_update(
 				CAPNG_ADD,
@@ -2385,8 +3222,11 @@ DIAG_ON_ASSIGN_ENUM
 		}
 		capng_apply(CAPNG_SELECT_BOTH);
 #endif /* HAVE_LIBCAP_NG */
-		if (username || chroot_dir)
+		if (username || chroot_dir) {
+			/* the services and ethers files may be out of reach */
+			addrtoname_load_tables(ndo);
 			droproot(username, chroot_dir);
+		}
 
 	}
 #endif /* _WIN32 */
@@ -2413,112 +3253,57 @@ DIAG_ON_ASSIGN_ENUM
 		}
 	}
 #endif
-	if (WFileName) {
-		/* Do not exceed the default PATH_MAX for files. */
-		dumpinfo.CurrentFileName = (char *)malloc(PATH_MAX + 1);
-
-		if (dumpinfo.CurrentFileName == NULL)
-			error("malloc of dumpinfo.CurrentFileName");
-
-		/* We do not need numbering for dumpfiles if Cflag isn't set. */
-		if (Cflag != 0)
-		  MakeFilename(dumpinfo.CurrentFileName, WFileName, 0, WflagChars);
-		else
-		  MakeFilename(dumpinfo.CurrentFileName, WFileName, 0, 0);
-
-		pdd = pcap_dump_open(pd, dumpinfo.CurrentFileName);
+	if (noutputs != 0) {
+		slice.dlt = pcap_datalink(pd);
+		if (ring.size != 0)
+			ring_init(Oflag, netmask);
+		else for (i = 0; i < (int)noutputs; i++) {
+			open_output(&outputs[i]);
+			if (outputs[i].filter != NULL &&
+			    pcap_compile(pd, &outputs[i].fcode, outputs[i].filter,
+			    Oflag, netmask) < 0) {
+				error("%s: %s", outputs[i].filter,
+				    pcap_geterr(pd));
+			}
+		}
 #ifdef HAVE_LIBCAP_NG
 		/* Give up CAP_DAC_OVERRIDE capability.
 		 * Only allow it to be restored if the -C or -G flag have been
-		 * set since we may need to create more files later on.
+		 * set, or we're writing out a ring buffer, since we may need
+		 * to create more files later on.
 		 */
 		capng_update(
 			CAPNG_DROP,
-			(Cflag || Gflag ? 0 : CAPNG_PERMITTED)
+			(Cflag || Gflag || ring.size != 0 ? 0 : CAPNG_PERMITTED)
 				| CAPNG_EFFECTIVE,
 			CAP_DAC_OVERRIDE
 			);
 		capng_apply(CAPNG_SELECT_BOTH);
 #endif /* HAVE_LIBCAP_NG */
-		if (pdd == NULL)
-			error("%s", pcap_geterr(pd));
-#ifdef HAVE_CAPSICUM
-		set_dumper_capsicum_rights(pdd);
-#endif
-		if (Cflag != 0 || Gflag != 0) {
-#ifdef HAVE_CAPSICUM
-			/*
-			 * basename() and dirname() may modify their input buffer
-			 * and they do since FreeBSD 12.0, but they didn't before.
-			 * Hence use the return value only, but always assume the
-			 * input buffer has been modified and would need to be
-			 * reset before the next use.
-			 */
-			char *WFileName_copy;
-
-			if ((WFileName_copy = strdup(WFileName)) == NULL) {
-				error("Unable to allocate memory for file %s",
-				    WFileName);
-			}
-			DIAG_OFF_C11_EXTENSIONS
-			dumpinfo.WFileName = strdup(basename(WFileName_copy));
-			DIAG_ON_C11_EXTENSIONS
-			if (dumpinfo.WFileName == NULL) {
-				error("Unable to allocate memory for file %s",
-				    WFileName);
-			}
-			free(WFileName_copy);
-
-			if ((WFileName_copy = strdup(WFileName)) == NULL) {
-				error("Unable to allocate memory for file %s",
-				    WFileName);
-			}
-			DIAG_OFF_C11_EXTENSIONS
-			char *WFileName_dirname = dirname(WFileName_copy);
-			DIAG_ON_C11_EXTENSIONS
-			dumpinfo.dirfd = open(WFileName_dirname,
-			    O_DIRECTORY | O_RDONLY);
-			if (dumpinfo.dirfd < 0) {
-				error("unable to open directory %s",
-				    WFileName_dirname);
-			}
-			free(WFileName_dirname);
-			free(WFileName_copy);
-
-			cap_rights_init(&rights, CAP_CREATE, CAP_FCNTL,
-			    CAP_FTRUNCATE, CAP_LOOKUP, CAP_SEEK, CAP_WRITE);
-			if (cap_rights_limit(dumpinfo.dirfd, &rights) < 0 &&
-			    errno != ENOSYS) {
-				error("unable to limit directory rights");
-			}
-			if (cap_fcntls_limit(dumpinfo.dirfd, CAP_FCNTL_GETFL) < 0 &&
-			    errno != ENOSYS) {
-				error("unable to limit dump descriptor fcntls");
-			}
-#else	/* !HAVE_CAPSICUM */
-			dumpinfo.WFileName = WFileName;
-#endif
+		if (ring.size != 0)
+			callback = ring_packet;
+		else if (Cflag != 0 || Gflag != 0) {
 			callback = dump_packet_and_trunc;
-			dumpinfo.pd = pd;
-			dumpinfo.pdd = pdd;
-			pcap_userdata = (u_char *)&dumpinfo;
-		} else {
+#ifdef ASYNC_ROTATION
+			rotation_init();
+#endif
+		} else
 			callback = dump_packet;
-			dumpinfo.WFileName = WFileName;
-			dumpinfo.pd = pd;
-			dumpinfo.pdd = pdd;
-			pcap_userdata = (u_char *)&dumpinfo;
-		}
+		/* a single unfiltered output needs no checking */
+		if (noutputs > 1 || outputs[0].filter != NULL)
+			callback = dump_packet_outputs;
+		pcap_userdata = (u_char *)&outputs[0];
 		if (print) {
 			dlt = pcap_datalink(pd);
 			ndo->ndo_if_printer = get_if_printer(dlt);
-			dumpinfo.ndo = ndo;
-		} else
-			dumpinfo.ndo = NULL;
+			outputs[0].ndo = ndo;
+		}
 
 #ifdef HAVE_PCAP_DUMP_FLUSH
-		if (Uflag)
-			pcap_dump_flush(pdd);
+		if (Uflag && ring.size == 0) {
+			for (i = 0; i < (int)noutputs; i++)
+				pcap_dump_flush(outputs[i].pdd);
+		}
 #endif
 	} else {
 		dlt = pcap_datalink(pd);
@@ -2539,7 +3324,7 @@ DIAG_ON_ASSIGN_ENUM
 	(void)setsignal(SIGNAL_FLUSH_PCAP, flushpcap);
 #endif
 
-	if (ndo->ndo_vflag > 0 && WFileName && RFileName == NULL && !print) {
+	if (ndo->ndo_vflag > 0 && noutputs != 0 && RFileName == NULL && !print) {
 		/*
 		 * When capturing to a file, if "--print" wasn't specified,
 		 *"-v" means tcpdump should, once per second,
@@ -2582,7 +3367,7 @@ DIAG_ON_ASSIGN_ENUM
 		 * to a file from the -V file).  Print a message to
 		 * the standard error on UN*X.
 		 */
-		if (!ndo->ndo_vflag && !WFileName) {
+		if (!ndo->ndo_vflag && noutputs == 0) {
 			(void)fprintf(stderr,
 			    "%s: verbose output suppressed, use -v[v]... for full protocol decode\n",
 			    program_name);
@@ -2602,19 +3387,29 @@ DIAG_ON_ASSIGN_ENUM
 	}
 
 #ifdef HAVE_CAPSICUM
-	cansandbox = (VFileName == NULL && zflag == NULL);
+	cansandbox = (VFileName == NULL && zflag == NULL && ring.size == 0);
 #ifdef HAVE_CASPER
 	cansandbox = (cansandbox && (ndo->ndo_nflag || capdns != NULL));
 #else
 	cansandbox = (cansandbox && ndo->ndo_nflag);
 #endif /* HAVE_CASPER */
+	if (cansandbox)
+		addrtoname_load_tables(ndo);
 	if (cansandbox && cap_enter() < 0 && errno != ENOSYS)
 		error("unable to enter the capability mode");
 #endif	/* HAVE_CAPSICUM */
 
 	do {
-		status = pcap_loop(pd, cnt, callback, pcap_userdata);
-		if (WFileName == NULL) {
+#ifdef FANOUT_CAPTURE
+		if (fanout.n != 0)
+			status = fanout_loop(&fcode);
+		else
+#endif
+		if (ring.size != 0)
+			status = ring_loop(cnt, callback, pcap_userdata);
+		else
+			status = pcap_loop(pd, cnt, callback, pcap_userdata);
+		if (noutputs == 0) {
 			/*
 			 * We're printing packets.  Flush the printed output,
 			 * so it doesn't get intermingled with error output.
@@ -2637,7 +3432,11 @@ DIAG_ON_ASSIGN_ENUM
 			VFileName = NULL;
 			ret = NULL;
 		}
-		if (status == -1) {
+		if (status == -1
+#ifdef FANOUT_CAPTURE
+		    && fanout.n == 0	/* the thread has reported it */
+#endif
+		    ) {
 			/*
 			 * Error.  Report it.
 			 */
@@ -2675,7 +3474,7 @@ DIAG_ON_ASSIGN_ENUM
 					 * link-layer header type from the
 					 * previous one.
 					 */
-					if (WFileName != NULL) {
+					if (noutputs != 0) {
 						/*
 						 * We're writing raw packets
 						 * that match the filter to
@@ -2709,6 +3508,12 @@ DIAG_ON_ASSIGN_ENUM
 				if (pcap_setfilter(pd, &fcode) < 0)
 					error("%s", pcap_geterr(pd));
 
+				/*
+				 * Rotated files are opened with the new one.
+				 */
+				for (i = 0; i < (int)noutputs; i++)
+					outputs[i].pd = pd;
+
 				/*
 				 * Report the new file.
 				 */
@@ -2727,10 +3532,34 @@ DIAG_ON_ASSIGN_ENUM
 	}
 	while (ret != NULL);
 
+	if (ring.size != 0)
+		ring_finish();
+
 	if (count_mode && RFileName != NULL)
 		fprintf(stdout, "%u packet%s\n", packets_captured,
 			PLURAL_SUFFIX(packets_captured));
 
+	if (ndo->ndo_flow_export)
+		flow_export_print(ndo);
+	nd_profile_print(stderr);
+	tcp_analysis_print(stderr);
+	dns_analysis_print(stderr);
+	/* for a live capture, info() has reported these */
+	if (RFileName != NULL) {
+		print_sampling_stats();
+		print_name_cache_stats();
+		print_slice_stats();
+		print_ring_stats();
+	}
+
+	/* close the savefiles here, where a write error can be reported */
+	for (i = 0; i < (int)noutputs; i++) {
+		if (outputs[i].pdd != NULL) {
+			dump_close(outputs[i].pdd, outputs[i].CurrentFileName);
+			outputs[i].pdd = NULL;
+		}
+	}
+
 	free(cmdbuf);
 	pcap_freecode(&fcode);
 	exit_tcpdump(status == -1 ? S_ERR_HOST_PROGRAM : S_SUCCESS);
@@ -2792,6 +3621,9 @@ cleanup(int signo _U_)
 	 * the ANSI C standard doesn't say it is).
 	 */
 	pcap_breakloop(pd);
+#ifdef FANOUT_CAPTURE
+	fanout_breakloop();
+#endif
 #else
 	/*
 	 * We don't have "pcap_breakloop()"; this isn't safe, but
@@ -2830,11 +3662,30 @@ info(int verbose)
 {
 	struct pcap_stat stats;
 
+	/*
+	 * On request (rather than at exit, where main() does it), report
+	 * the dissector profile and the TCP and DNS analyses so far; that works
+	 * for savefiles, too.
+	 */
+	if (!verbose) {
+		nd_profile_print(stderr);
+		tcp_analysis_print(stderr);
+		dns_analysis_print(stderr);
+	}
+
 	/*
 	 * Older versions of libpcap didn't set ps_ifdrop on some
 	 * platforms; initialize it to 0 to handle that.
 	 */
 	stats.ps_ifdrop = 0;
+#ifdef FANOUT_CAPTURE
+	if (fanout.n != 0) {
+		if (fanout_stats(&stats) < 0) {
+			infoprint = 0;
+			return;
+		}
+	} else
+#endif
 	if (pcap_stats(pd, &stats) < 0) {
 		(void)fprintf(stderr, "pcap_stats: %s\n", pcap_geterr(pd));
 		infoprint = 0;
@@ -2867,6 +3718,40 @@ info(int verbose)
 		    stats.ps_ifdrop, PLURAL_SUFFIX(stats.ps_ifdrop));
 	} else
 		putc('\n', stderr);
+#ifdef FANOUT_CAPTURE
+	if (verbose && fanout.n != 0) {
+		u_int i, packets;
+
+		for (i = 0; i < fanout.n; i++) {
+			packets = fanout.workers[i].packets;
+			(void)fprintf(stderr,
+			    "thread %u: %u packet%s captured, %u dropped by kernel\n",
+			    i, packets, PLURAL_SUFFIX(packets),
+			    fanout.workers[i].drops);
+		}
+	}
+#endif
+	print_sampling_stats();
+	print_name_cache_stats();
+	print_slice_stats();
+	print_ring_stats();
+	if (rotations != 0) {
+		(void)fprintf(stderr,
+		    "%u file rotation%s (%u opening a file), taking %" PRIu64
+		    " us on average and %" PRIu64 " us at most\n",
+		    rotations, PLURAL_SUFFIX(rotations), rotations_sync,
+		    rotation_ns / rotations / 1000, rotation_max_ns / 1000);
+	}
+	if (verbose && nd_smi_module_loaded) {
+		struct nd_smi_cache_stats smi_stats;
+
+		nd_smi_cache_get_stats(&smi_stats);
+		(void)fprintf(stderr,
+		    "SMI OID cache: %u lookup%s, %u hit%s, %u eviction%s\n",
+		    smi_stats.lookups, PLURAL_SUFFIX(smi_stats.lookups),
+		    smi_stats.hits, PLURAL_SUFFIX(smi_stats.hits),
+		    smi_stats.evictions, PLURAL_SUFFIX(smi_stats.evictions));
+	}
 	infoprint = 0;
 }
 
@@ -2923,17 +3808,371 @@ compress_savefile(const char *filename)
 }
 #endif /* HAVE_FORK && HAVE_VFORK */
 
+/*
+ * Finish with a rotated-out dump file: close it and, if asked to,
+ * compress it.  Frees name.
+ */
 static void
-dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+retire_dump_file(pcap_dumper_t *p, char *name)
 {
-	struct dump_info *dump_info;
+	dump_close(p, name);
+	if (zflag != NULL)
+		compress_savefile(name);
+	free(name);
+}
 
-	++packets_captured;
+#ifdef ASYNC_ROTATION
+/*
+ * A worker thread keeps a spare file open for each output, under a
+ * temporary name in the output directory; rotating switches to one, and queues for the
+ * worker the renaming of the spare to its real name, the retiring of
+ * the old file and the making of the next spare.  If the spare isn't
+ * ready yet, one is made on the spot; if that fails too, rotation is
+ * synchronous.
+ */
+struct rotation_job {
+	struct rotation_job *next;
+	pcap_dumper_t *old_pdd;		/* file to retire */
+	char *old_name;
+	char *tmp_name;			/* rename this file... */
+	char *new_name;			/* ...to this */
+};
 
-	++infodelay;
+static struct {
+	int enabled;
+	pid_t pid;			/* of the process with the worker */
+	char *dir;			/* where files go, with a trailing '/' */
+	u_int seq;			/* for temporary names */
+	pthread_t thread;
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;		/* to the worker */
+	pthread_cond_t idle;		/* from the worker */
+	int busy;			/* the worker is running a job */
+	int stop;
+	struct rotation_job *jobs;
+	struct rotation_job **jobs_tail;
+	u_int want;			/* spares to keep ready */
+	u_int nspares;			/* spares ready */
+	FILE **spares;
+	char **spare_names;
+	int spare_failed;		/* don't retry until the next rotation */
+} rot;
 
-	dump_info = (struct dump_info *)user;
+/*
+ * Create a spare file.  Failing isn't fatal; rotation will just open
+ * the file itself.
+ */
+static FILE *
+rotation_make_spare(char **namep)
+{
+	size_t namelen;
+	char *name;
+	FILE *fp;
+	u_int seq;
+	int fd;
+
+	namelen = strlen(rot.dir) + sizeof(".tcpdump-4294967295-4294967295.tmp");
+	name = malloc(namelen);
+	if (name == NULL)
+		return (NULL);
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	do {
+		pthread_mutex_lock(&rot.mtx);
+		seq = rot.seq++;
+		pthread_mutex_unlock(&rot.mtx);
+		snprintf(name, namelen, "%s.tcpdump-%u-%u.tmp", rot.dir,
+		    (u_int)rot.pid, seq);
+		fd = open(name, O_CREAT | O_EXCL | O_WRONLY, 0666);
+	} while (fd < 0 && errno == EEXIST);
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	if (fd < 0) {
+		free(name);
+		return (NULL);
+	}
+#ifdef HAVE_DUMP_WRITER
+	if (group_commit)
+		fp = dump_writer_fdopen(fd, &dump_writer_params);
+	else
+#endif
+		fp = fdopen(fd, "w");
+	if (fp == NULL) {
+		close(fd);
+		unlink(name);
+		free(name);
+		return (NULL);
+	}
+	*namep = name;
+	return (fp);
+}
 
+static void
+rotation_run_job(struct rotation_job *job)
+{
+	int ret;
+
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	ret = rename(job->tmp_name, job->new_name);
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	if (ret == -1) {
+		(void)fprintf(stderr, "%s: can't rename %s to %s: %s\n",
+		    program_name, job->tmp_name, job->new_name,
+		    pcap_strerror(errno));
+	}
+	retire_dump_file(job->old_pdd, job->old_name);
+	free(job->tmp_name);
+	free(job->new_name);
+	free(job);
+}
+
+static void *
+rotation_thread(void *arg _U_)
+{
+	struct rotation_job *job;
+	char *name = NULL;
+	FILE *fp;
+
+	pthread_mutex_lock(&rot.mtx);
+	for (;;) {
+		if (rot.jobs != NULL) {
+			job = rot.jobs;
+			rot.jobs = job->next;
+			if (rot.jobs == NULL)
+				rot.jobs_tail = &rot.jobs;
+			rot.busy = 1;
+			pthread_mutex_unlock(&rot.mtx);
+			rotation_run_job(job);
+			pthread_mutex_lock(&rot.mtx);
+			rot.busy = 0;
+			pthread_cond_broadcast(&rot.idle);
+			continue;
+		}
+		if (rot.stop)
+			break;
+		if (rot.nspares < rot.want && !rot.spare_failed) {
+			pthread_mutex_unlock(&rot.mtx);
+			fp = rotation_make_spare(&name);
+			pthread_mutex_lock(&rot.mtx);
+			if (fp != NULL) {
+				rot.spares[rot.nspares] = fp;
+				rot.spare_names[rot.nspares] = name;
+				rot.nspares++;
+			} else
+				rot.spare_failed = 1;
+			continue;
+		}
+		pthread_cond_wait(&rot.cond, &rot.mtx);
+	}
+	pthread_mutex_unlock(&rot.mtx);
+	return (NULL);
+}
+
+/*
+ * At exit, finish the queued work and remove the spares.
+ */
+static void
+rotation_atexit(void)
+{
+	if (getpid() != rot.pid)
+		return;		/* a child that failed to exec */
+	pthread_mutex_lock(&rot.mtx);
+	rot.stop = 1;
+	pthread_cond_signal(&rot.cond);
+	pthread_mutex_unlock(&rot.mtx);
+	pthread_join(rot.thread, NULL);
+	while (rot.nspares != 0) {
+		rot.nspares--;
+		fclose(rot.spares[rot.nspares]);
+		unlink(rot.spare_names[rot.nspares]);
+		free(rot.spare_names[rot.nspares]);
+	}
+}
+
+static void
+rotation_init(void)
+{
+	const char *WFileName, *p;
+	sigset_t all, old;
+	size_t dirlen;
+	u_int i;
+
+	/*
+	 * The spares are created where the files go, so they can be
+	 * renamed; that has to be a single directory, and if it depends
+	 * on the time (-G with a strftime() format in the directory part),
+	 * it's not known in advance.
+	 */
+	WFileName = outputs[0].WFileName;
+	p = strrchr(WFileName, '/');
+	dirlen = p != NULL ? (size_t)(p - WFileName + 1) : 0;
+	if (Gflag != 0 && memchr(WFileName, '%', dirlen) != NULL)
+		return;
+	for (i = 1; i < noutputs; i++) {
+		p = strrchr(outputs[i].WFileName, '/');
+		if ((p != NULL ? (size_t)(p - outputs[i].WFileName + 1) : 0) !=
+		    dirlen || memcmp(outputs[i].WFileName, WFileName, dirlen) != 0)
+			return;
+	}
+	rot.dir = malloc(dirlen + 1);
+	rot.spares = calloc(noutputs, sizeof(*rot.spares));
+	rot.spare_names = calloc(noutputs, sizeof(*rot.spare_names));
+	if (rot.dir == NULL || rot.spares == NULL || rot.spare_names == NULL)
+		error("%s: malloc", __func__);
+	memcpy(rot.dir, WFileName, dirlen);
+	rot.dir[dirlen] = '\0';
+	rot.want = noutputs;
+
+	rot.pid = getpid();
+	rot.jobs_tail = &rot.jobs;
+	pthread_mutex_init(&rot.mtx, NULL);
+	pthread_cond_init(&rot.cond, NULL);
+	pthread_cond_init(&rot.idle, NULL);
+	/* leave the signals to the capture thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	if (pthread_create(&rot.thread, NULL, rotation_thread, NULL) != 0) {
+		pthread_sigmask(SIG_SETMASK, &old, NULL);
+		return;
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+	atexit(rotation_atexit);
+	rot.enabled = 1;
+}
+
+/*
+ * Switch to a spare and queue the rest; returns 0 if there's no spare
+ * and none could be made, after letting the worker finish all its
+ * work, so that nothing is still writing a file about to be reopened.
+ */
+static int
+rotation_switch(struct dump_info *dump_info, pcap_dumper_t *old_pdd,
+    char *old_name)
+{
+	struct rotation_job *job;
+	char *name = NULL;
+	FILE *fp;
+
+	if (!rot.enabled)
+		return (0);
+	job = calloc(1, sizeof(*job));
+	if (job == NULL)
+		error("%s: malloc", __func__);
+	job->new_name = strdup(dump_info->CurrentFileName);
+	if (job->new_name == NULL)
+		error("%s: malloc", __func__);
+
+	fp = NULL;
+	pthread_mutex_lock(&rot.mtx);
+	if (rot.nspares != 0) {
+		rot.nspares--;
+		fp = rot.spares[rot.nspares];
+		name = rot.spare_names[rot.nspares];
+	}
+	rot.spare_failed = 0;
+	pthread_mutex_unlock(&rot.mtx);
+	if (fp == NULL) {
+		/* the worker hasn't got to it yet */
+		fp = rotation_make_spare(&name);
+		if (fp == NULL) {
+			free(job->new_name);
+			free(job);
+			pthread_mutex_lock(&rot.mtx);
+			while (rot.jobs != NULL || rot.busy)
+				pthread_cond_wait(&rot.idle, &rot.mtx);
+			pthread_mutex_unlock(&rot.mtx);
+			return (0);
+		}
+		rotations_sync++;
+	}
+
+	dump_info->pdd = pcap_dump_fopen(dump_info->pd, fp);
+	if (dump_info->pdd == NULL)
+		error("%s", pcap_geterr(pd));
+	job->old_pdd = old_pdd;
+	job->old_name = old_name;
+	job->tmp_name = name;
+	pthread_mutex_lock(&rot.mtx);
+	*rot.jobs_tail = job;
+	rot.jobs_tail = &job->next;
+	pthread_cond_signal(&rot.cond);
+	pthread_mutex_unlock(&rot.mtx);
+	return (1);
+}
+#endif /* ASYNC_ROTATION */
+
+/*
+ * Rotate to dump_info->CurrentFileName, retiring old_pdd, which was
+ * written as old_name (freed here).  start is when the rotation began.
+ */
+static void
+next_dump_file(struct dump_info *dump_info, pcap_dumper_t *old_pdd,
+    char *old_name, uint64_t start)
+{
+	uint64_t elapsed;
+#ifdef HAVE_CAPSICUM
+	FILE *fp;
+	int fd;
+#endif
+
+#ifdef ASYNC_ROTATION
+	if (!rotation_switch(dump_info, old_pdd, old_name))
+#endif
+	{
+		rotations_sync++;
+		retire_dump_file(old_pdd, old_name);
+#ifdef HAVE_LIBCAP_NG
+		capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+		capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+#ifdef HAVE_CAPSICUM
+		fd = openat(dump_info->dirfd, dump_info->CurrentFileName,
+		    O_CREAT | O_WRONLY | O_TRUNC, 0644);
+		if (fd < 0) {
+			error("unable to open file %s",
+			    dump_info->CurrentFileName);
+		}
+		fp = dump_fdopen(fd, dump_info->CurrentFileName);
+		dump_info->pdd = pcap_dump_fopen(dump_info->pd, fp);
+#else	/* !HAVE_CAPSICUM */
+		dump_info->pdd = dump_open(dump_info->pd, dump_info->CurrentFileName);
+#endif
+#ifdef HAVE_LIBCAP_NG
+		capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+		capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+		if (dump_info->pdd == NULL)
+			error("%s", pcap_geterr(pd));
+#ifdef HAVE_CAPSICUM
+		set_dumper_capsicum_rights(dump_info->pdd);
+#endif
+	}
+
+	elapsed = nd_profile_now() - start;
+	rotations++;
+	rotation_ns += elapsed;
+	if (elapsed > rotation_max_ns)
+		rotation_max_ns = elapsed;
+}
+
+/*
+ * Write a packet to an output, first rotating the file if -C or -G say
+ * it's time to.
+ */
+static void
+dump_write(struct dump_info *dump_info, const struct pcap_pkthdr *h,
+    const u_char *sp)
+{
 	/*
 	 * XXX - this won't force the file to rotate on the specified time
 	 * boundary, but it will rotate on the first packet received after the
@@ -2954,40 +4193,55 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 
 
 		/* If the time is greater than the specified window, rotate */
-		if (t - Gflag_time >= Gflag) {
-#ifdef HAVE_CAPSICUM
-			FILE *fp;
-			int fd;
-#endif
+		if (t - dump_info->Gflag_time >= Gflag) {
+			uint64_t start = nd_profile_now();
+			pcap_dumper_t *old_pdd;
+			char *old_name;
+			u_int i;
 
+			ROTATION_LOCK();
 			/* Update the Gflag_time */
-			Gflag_time = t;
+			dump_info->Gflag_time = t;
 			/* Update Gflag_count */
-			Gflag_count++;
+			dump_info->Gflag_count++;
 			/*
-			 * Close the current file and open a new one.
+			 * Switch from the current file to a new one.
 			 */
-			pcap_dump_close(dump_info->pdd);
-
-			/*
-			 * Compress the file we just closed, if the user asked for it
-			 */
-			if (zflag != NULL)
-				compress_savefile(dump_info->CurrentFileName);
+			old_pdd = dump_info->pdd;
+			old_name = dump_info->CurrentFileName;
 
 			/*
 			 * Check to see if we've exceeded the Wflag (when
 			 * not using Cflag).
 			 */
-			if (Cflag == 0 && Wflag > 0 && Gflag_count >= Wflag) {
+			if (Cflag == 0 && Wflag > 0 &&
+			    dump_info->Gflag_count >= Wflag) {
+				retire_dump_file(old_pdd, old_name);
+#ifdef FANOUT_CAPTURE
+				if (fanout.n != 0) {
+					/*
+					 * Stop all the threads; each retires
+					 * its own file, see fanout_thread().
+					 */
+					dump_info->pdd = NULL;
+					dump_info->CurrentFileName = NULL;
+					fanout.limit_reached = 1;
+					ROTATION_UNLOCK();
+					fanout_breakloop();
+					return;
+				}
+#endif
+				for (i = 0; i < noutputs; i++) {
+					if (&outputs[i] != dump_info)
+						retire_dump_file(outputs[i].pdd,
+						    outputs[i].CurrentFileName);
+				}
 				(void)fprintf(stderr, "Maximum file limit reached: %d\n",
 				    Wflag);
 				info(1);
 				exit_tcpdump(S_SUCCESS);
 				/* NOTREACHED */
 			}
-			if (dump_info->CurrentFileName != NULL)
-				free(dump_info->CurrentFileName);
 			/* Allocate space for max filename + \0. */
 			dump_info->CurrentFileName = (char *)malloc(PATH_MAX + 1);
 			if (dump_info->CurrentFileName == NULL)
@@ -2997,7 +4251,7 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 			 * so multiple files would end with 1,2,3 in the filename.
 			 * The counting is handled with the -C flow after this.
 			 */
-			Cflag_count = 0;
+			dump_info->Cflag_count = 0;
 
 			/*
 			 * This is always the first file in the Cflag
@@ -3005,41 +4259,14 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 			 * We also don't need numbering if Cflag is not set.
 			 */
 			if (Cflag != 0)
-				MakeFilename(dump_info->CurrentFileName, dump_info->WFileName, 0,
-				    WflagChars);
+				MakeFilename(dump_info->CurrentFileName, dump_info->WFileName,
+				    dump_info->Gflag_time, 0, WflagChars);
 			else
-				MakeFilename(dump_info->CurrentFileName, dump_info->WFileName, 0, 0);
+				MakeFilename(dump_info->CurrentFileName, dump_info->WFileName,
+				    dump_info->Gflag_time, 0, 0);
 
-#ifdef HAVE_LIBCAP_NG
-			capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
-			capng_apply(CAPNG_SELECT_BOTH);
-#endif /* HAVE_LIBCAP_NG */
-#ifdef HAVE_CAPSICUM
-			fd = openat(dump_info->dirfd,
-			    dump_info->CurrentFileName,
-			    O_CREAT | O_WRONLY | O_TRUNC, 0644);
-			if (fd < 0) {
-				error("unable to open file %s",
-				    dump_info->CurrentFileName);
-			}
-			fp = fdopen(fd, "w");
-			if (fp == NULL) {
-				error("unable to fdopen file %s",
-				    dump_info->CurrentFileName);
-			}
-			dump_info->pdd = pcap_dump_fopen(dump_info->pd, fp);
-#else	/* !HAVE_CAPSICUM */
-			dump_info->pdd = pcap_dump_open(dump_info->pd, dump_info->CurrentFileName);
-#endif
-#ifdef HAVE_LIBCAP_NG
-			capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
-			capng_apply(CAPNG_SELECT_BOTH);
-#endif /* HAVE_LIBCAP_NG */
-			if (dump_info->pdd == NULL)
-				error("%s", pcap_geterr(pd));
-#ifdef HAVE_CAPSICUM
-			set_dumper_capsicum_rights(dump_info->pdd);
-#endif
+			next_dump_file(dump_info, old_pdd, old_name, start);
+			ROTATION_UNLOCK();
 		}
 	}
 
@@ -3064,71 +4291,76 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 		if (size == -1)
 			error("ftell fails on output file");
 		if (size > Cflag) {
-#ifdef HAVE_CAPSICUM
-			FILE *fp;
-			int fd;
-#endif
+			uint64_t start = nd_profile_now();
+			pcap_dumper_t *old_pdd;
+			char *old_name;
 
+			ROTATION_LOCK();
 			/*
-			 * Close the current file and open a new one.
+			 * Switch from the current file to a new one.
 			 */
-			pcap_dump_close(dump_info->pdd);
+			old_pdd = dump_info->pdd;
+			old_name = dump_info->CurrentFileName;
 
-			/*
-			 * Compress the file we just closed, if the user
-			 * asked for it.
-			 */
-			if (zflag != NULL)
-				compress_savefile(dump_info->CurrentFileName);
-
-			Cflag_count++;
+			dump_info->Cflag_count++;
 			if (Wflag > 0) {
-				if (Cflag_count >= Wflag)
-					Cflag_count = 0;
+				if (dump_info->Cflag_count >= Wflag)
+					dump_info->Cflag_count = 0;
 			}
-			if (dump_info->CurrentFileName != NULL)
-				free(dump_info->CurrentFileName);
 			dump_info->CurrentFileName = (char *)malloc(PATH_MAX + 1);
 			if (dump_info->CurrentFileName == NULL)
 				error("%s: malloc", __func__);
-			MakeFilename(dump_info->CurrentFileName, dump_info->WFileName, Cflag_count, WflagChars);
-#ifdef HAVE_LIBCAP_NG
-			capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
-			capng_apply(CAPNG_SELECT_BOTH);
-#endif /* HAVE_LIBCAP_NG */
-#ifdef HAVE_CAPSICUM
-			fd = openat(dump_info->dirfd, dump_info->CurrentFileName,
-			    O_CREAT | O_WRONLY | O_TRUNC, 0644);
-			if (fd < 0) {
-				error("unable to open file %s",
-				    dump_info->CurrentFileName);
-			}
-			fp = fdopen(fd, "w");
-			if (fp == NULL) {
-				error("unable to fdopen file %s",
-				    dump_info->CurrentFileName);
-			}
-			dump_info->pdd = pcap_dump_fopen(dump_info->pd, fp);
-#else	/* !HAVE_CAPSICUM */
-			dump_info->pdd = pcap_dump_open(dump_info->pd, dump_info->CurrentFileName);
-#endif
-#ifdef HAVE_LIBCAP_NG
-			capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
-			capng_apply(CAPNG_SELECT_BOTH);
-#endif /* HAVE_LIBCAP_NG */
-			if (dump_info->pdd == NULL)
-				error("%s", pcap_geterr(pd));
-#ifdef HAVE_CAPSICUM
-			set_dumper_capsicum_rights(dump_info->pdd);
-#endif
+			MakeFilename(dump_info->CurrentFileName, dump_info->WFileName,
+			    dump_info->Gflag_time, dump_info->Cflag_count, WflagChars);
+			next_dump_file(dump_info, old_pdd, old_name, start);
+			ROTATION_UNLOCK();
 		}
 	}
 
 	pcap_dump((u_char *)dump_info->pdd, h, sp);
 #ifdef HAVE_PCAP_DUMP_FLUSH
 	if (Uflag)
-		pcap_dump_flush(dump_info->pdd);
+		dump_flush(dump_info);
 #endif
+}
+
+/*
+ * With --slice-headers, return the header to write the packet with:
+ * one in *sliced, with the captured length cut down to the end of the
+ * packet's headers and the payload allowed after them, if that's
+ * shorter.  What's cut off is counted in dump_info.
+ */
+static const struct pcap_pkthdr *
+slice_packet(struct dump_info *dump_info, const struct pcap_pkthdr *h,
+    const u_char *sp, struct pcap_pkthdr *sliced)
+{
+	u_int len;
+
+	if (!slice.enabled)
+		return (h);
+	len = nd_headers_length(slice.dlt, sp, h->caplen);
+	if (h->caplen - len <= slice.payload)
+		return (h);
+	*sliced = *h;
+	sliced->caplen = len + slice.payload;
+	dump_info->sliced++;
+	dump_info->sliced_bytes += h->caplen - sliced->caplen;
+	return (sliced);
+}
+
+static void
+dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct dump_info *dump_info;
+	struct pcap_pkthdr sliced;
+
+	++packets_captured;
+
+	++infodelay;
+
+	dump_info = (struct dump_info *)user;
+
+	dump_write(dump_info, slice_packet(dump_info, h, sp, &sliced), sp);
 
 	if (dump_info->ndo != NULL)
 		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
@@ -3138,10 +4370,48 @@ dump_packet_and_trunc(u_char *user, const struct pcap_pkthdr *h, const u_char *s
 		info(0);
 }
 
+/*
+ * Write the packet to each output whose filter it matches; all of them
+ * are checked against the one copy of the packet that libpcap handed
+ * us.  user is the first output, which is the one that has the ndo if
+ * we're printing too.
+ */
+static void
+dump_packet_outputs(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct dump_info *dump_info;
+	const struct pcap_pkthdr *wh;
+	struct pcap_pkthdr sliced;
+	u_int i;
+
+	++packets_captured;
+
+	++infodelay;
+
+	/* the filters see the whole packet */
+	wh = slice_packet((struct dump_info *)user, h, sp, &sliced);
+	for (i = 0; i < noutputs; i++) {
+		dump_info = &outputs[i];
+		if (dump_info->filter != NULL &&
+		    pcap_offline_filter(&dump_info->fcode, h, sp) == 0)
+			continue;
+		dump_write(dump_info, wh, sp);
+	}
+
+	dump_info = (struct dump_info *)user;
+	if (dump_info->ndo != NULL)
+		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
+
+	--infodelay;
+	if (infoprint)
+		info(0);
+}
+
 static void
 dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 {
 	struct dump_info *dump_info;
+	struct pcap_pkthdr sliced;
 
 	++packets_captured;
 
@@ -3149,10 +4419,180 @@ dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 
 	dump_info = (struct dump_info *)user;
 
-	pcap_dump((u_char *)dump_info->pdd, h, sp);
+	pcap_dump((u_char *)dump_info->pdd,
+	    slice_packet(dump_info, h, sp, &sliced), sp);
 #ifdef HAVE_PCAP_DUMP_FLUSH
 	if (Uflag)
-		pcap_dump_flush(dump_info->pdd);
+		dump_flush(dump_info);
+#endif
+
+	if (dump_info->ndo != NULL)
+		pretty_print_packet(dump_info->ndo, h, sp, packets_captured);
+
+	--infodelay;
+	if (infoprint)
+		info(0);
+}
+
+/*
+ * Write the ring buffer to a new file.  Returns 0 on failure, which
+ * has been reported; this may run in a child process, so it doesn't
+ * exit.
+ *
+ * The file is written under a temporary name and renamed once it's
+ * complete, so that whatever picks it up never sees part of one.
+ */
+static int
+ring_write(const char *name)
+{
+	char *tmpname;
+	size_t len;
+	FILE *fp;
+	pcap_dumper_t *p;
+	int ok = 0;
+
+	/* with -W, another writer may still have the same name */
+	len = strlen(name) + sizeof(".4294967295.tmp");
+	tmpname = malloc(len);
+	if (tmpname == NULL) {
+		fprintf(stderr, "%s: %s: malloc\n", program_name, __func__);
+		return (0);
+	}
+	snprintf(tmpname, len, "%s.%u.tmp", name, (u_int)getpid());
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_ADD, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	fp = fopen(tmpname, "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: unable to open file %s: %s\n",
+		    program_name, tmpname, pcap_strerror(errno));
+		goto done;
+	}
+	p = pcap_dump_fopen(ring.pd, fp);
+	if (p == NULL) {
+		fprintf(stderr, "%s: %s: %s\n", program_name, tmpname,
+		    pcap_geterr(ring.pd));
+		fclose(fp);
+		unlink(tmpname);
+		goto done;
+	}
+	ring_buffer_dump(ring.rb, p);
+	if (fflush(fp) == EOF || ferror(fp)) {
+		fprintf(stderr, "%s: error writing file %s: %s\n",
+		    program_name, tmpname, pcap_strerror(errno));
+		pcap_dump_close(p);
+		unlink(tmpname);
+		goto done;
+	}
+	pcap_dump_close(p);
+	if (rename(tmpname, name) < 0) {
+		fprintf(stderr, "%s: unable to rename %s to %s: %s\n",
+		    program_name, tmpname, name, pcap_strerror(errno));
+		unlink(tmpname);
+		goto done;
+	}
+	ok = 1;
+done:
+#ifdef HAVE_LIBCAP_NG
+	capng_update(CAPNG_DROP, CAPNG_EFFECTIVE, CAP_DAC_OVERRIDE);
+	capng_apply(CAPNG_SELECT_BOTH);
+#endif /* HAVE_LIBCAP_NG */
+	free(tmpname);
+	if (ok && zflag != NULL)
+		compress_savefile(name);
+	return (ok);
+}
+
+/*
+ * Write the ring buffer out to the next file, named like the files
+ * written with -C, and recycling names with -W.  Where we can fork,
+ * a child process does the writing from its copy-on-write snapshot
+ * of the ring, so that the capture carries on meanwhile.
+ */
+static void
+ring_dump(void)
+{
+	char *name;
+#ifdef HAVE_FORK
+	pid_t child;
+#endif
+
+	ring.pending = 0;
+	name = malloc(PATH_MAX + 1);
+	if (name == NULL)
+		error("%s: malloc", __func__);
+	if (Wflag > 0) {
+		MakeFilename(name, outputs[0].WFileName, 0,
+		    (int)(ring.dumps % Wflag), WflagChars);
+	} else
+		MakeFilename(name, outputs[0].WFileName, 0, (int)ring.dumps, 0);
+	ring.dumps++;
+
+#ifdef HAVE_FORK
+	/*
+	 * Reap the writers that are done; SIGCHLD signals can merge, and
+	 * one per signal isn't enough to keep up with frequent triggers.
+	 */
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+	child = fork();
+	if (child == 0)
+		_exit(ring_write(name) ? S_SUCCESS : S_ERR_HOST_PROGRAM);
+	if (child != -1) {
+		free(name);
+		return;
+	}
+	/* write it ourselves, then */
+#endif
+	(void)ring_write(name);
+	free(name);
+}
+
+/*
+ * A trigger fired: write out the ring buffer now, or, with --ring-after,
+ * once that many more packets have been captured.  Triggers while
+ * that's pending are part of the same event.
+ */
+static void
+ring_trigger(void)
+{
+	if (ring.pending)
+		return;
+	if (ring.after == 0) {
+		ring_dump();
+		return;
+	}
+	ring.pending = 1;
+	ring.remaining = ring.after;
+}
+
+static void
+ring_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct dump_info *dump_info;
+	struct pcap_pkthdr sliced;
+
+	++packets_captured;
+
+	++infodelay;
+
+	dump_info = (struct dump_info *)user;
+
+	(void)ring_buffer_add(ring.rb,
+	    slice_packet(dump_info, h, sp, &sliced), sp);
+	if (ring.pending) {
+		if (--ring.remaining == 0)
+			ring_dump();
+	} else if (ring.trigger_filter != NULL &&
+	    pcap_offline_filter(&ring.trigger, h, sp) != 0)
+		ring_trigger();
+#ifndef HAVE_PCAP_BREAKLOOP
+	/* otherwise ring_loop() sees to it */
+	if (ring.signalled) {
+		ring.signalled = 0;
+		ring_trigger();
+	}
 #endif
 
 	if (dump_info->ndo != NULL)
@@ -3163,6 +4603,229 @@ dump_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 		info(0);
 }
 
+/*
+ * pcap_loop() for --ring-buffer: SIGNAL_FLUSH_PCAP breaks out of the
+ * loop so that the trigger is handled outside the signal handler, and
+ * then we carry on.
+ */
+static int
+ring_loop(int cnt, pcap_handler callback, u_char *user)
+{
+	u_int captured;
+	int status;
+
+	for (;;) {
+		captured = packets_captured;
+		status = pcap_loop(pd, cnt, callback, user);
+		if (status != -2 || !ring.signalled)
+			return (status);
+		ring.signalled = 0;
+		ring_trigger();
+		if (cnt > 0) {
+			cnt -= (int)(packets_captured - captured);
+			if (cnt <= 0)
+				return (0);
+		}
+	}
+}
+
+/*
+ * At the end of the capture, write out the ring buffer if a trigger
+ * is still counting down, and wait for the files being written.
+ */
+static void
+ring_finish(void)
+{
+	if (ring.pending)
+		ring_dump();
+#ifdef HAVE_FORK
+	while (waitpid(-1, NULL, 0) > 0 || errno == EINTR)
+		;
+#endif
+}
+
+#ifdef FANOUT_CAPTURE
+/*
+ * Open the other handles and join them all, the first one included,
+ * to one fanout group.  This is done right after the first handle is
+ * opened, while we still have the privileges to.
+ */
+static void
+fanout_open(const char *device, netdissect_options *ndo, char *ebuf)
+{
+	struct fanout_worker *w;
+	int arg;
+	u_int i;
+
+	fanout.workers = calloc(fanout.n, sizeof(*fanout.workers));
+	if (fanout.workers == NULL)
+		error("%s: calloc", __func__);
+	arg = (getpid() & 0xffff) | fanout.mode << 16;
+	if (fanout.mode == PACKET_FANOUT_HASH)
+		arg |= PACKET_FANOUT_FLAG_DEFRAG << 16;
+	for (i = 0; i < fanout.n; i++) {
+		w = &fanout.workers[i];
+		if (i == 0)
+			w->pd = pd;
+		else {
+			w->pd = open_interface(device, ndo, ebuf);
+			if (w->pd == NULL)
+				error("%s", ebuf);
+		}
+		if (setsockopt(pcap_fileno(w->pd), SOL_PACKET, PACKET_FANOUT,
+		    &arg, sizeof(arg)) < 0)
+			error("can't join a fanout group on %s: %s", device,
+			    pcap_strerror(errno));
+	}
+}
+
+static void
+fanout_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
+{
+	struct fanout_worker *w = (struct fanout_worker *)user;
+	struct pcap_pkthdr sliced;
+
+	w->packets++;
+	if (w->dump_info->pdd != NULL) {
+		dump_write(w->dump_info,
+		    slice_packet(w->dump_info, h, sp, &sliced), sp);
+	}
+}
+
+static void *
+fanout_thread(void *arg)
+{
+	struct fanout_worker *w = (struct fanout_worker *)arg;
+	pcap_dumper_t *pdd;
+	char *name = NULL;
+
+	w->status = pcap_loop(w->pd, -1, fanout_packet, (u_char *)w);
+	if (w->status == -1) {
+		(void)fprintf(stderr, "%s: pcap_loop: %s\n",
+		    program_name, pcap_geterr(w->pd));
+	}
+	/* when one thread stops, they all do */
+	fanout_breakloop();
+
+	/* flushpcap() may be looking at pdd; let go of it under the lock */
+	ROTATION_LOCK();
+	pdd = NULL;
+	if (fanout.limit_reached) {
+		pdd = w->dump_info->pdd;
+		name = w->dump_info->CurrentFileName;
+		w->dump_info->pdd = NULL;
+		w->dump_info->CurrentFileName = NULL;
+	}
+	ROTATION_UNLOCK();
+	if (pdd != NULL)
+		retire_dump_file(pdd, name);
+	return (NULL);
+}
+
+/*
+ * Run the capture, a thread per handle, each writing its own output,
+ * until one of them stops; returns what pcap_loop() would.
+ */
+static int
+fanout_loop(struct bpf_program *fcode)
+{
+	struct fanout_worker *w;
+	sigset_t all, old;
+	int status = 0;
+	u_int i;
+
+	for (i = 0; i < fanout.n; i++) {
+		w = &fanout.workers[i];
+		w->dump_info = &outputs[i];
+		if (i == 0)
+			continue;
+#ifdef HAVE_PCAP_SET_DATALINK
+		if (pcap_datalink(w->pd) != pcap_datalink(pd) &&
+		    pcap_set_datalink(w->pd, pcap_datalink(pd)) < 0)
+			error("%s", pcap_geterr(w->pd));
+#endif
+		if (pcap_setfilter(w->pd, fcode) < 0)
+			error("%s", pcap_geterr(w->pd));
+	}
+
+	/* leave the signals to this thread */
+	sigfillset(&all);
+	pthread_sigmask(SIG_SETMASK, &all, &old);
+	for (i = 0; i < fanout.n; i++) {
+		w = &fanout.workers[i];
+		if (pthread_create(&w->thread, NULL, fanout_thread, w) != 0)
+			error("%s: can't create a thread", __func__);
+	}
+	pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+	for (i = 0; i < fanout.n; i++) {
+		w = &fanout.workers[i];
+		pthread_join(w->thread, NULL);
+		if (w->status == -1)
+			status = -1;
+		else if (w->status == -2 && status == 0)
+			status = -2;
+	}
+	if (fanout.limit_reached) {
+		(void)fprintf(stderr, "Maximum file limit reached: %d\n",
+		    Wflag);
+		status = 0;
+	}
+	return (status);
+}
+
+static void
+fanout_breakloop(void)
+{
+	u_int i;
+
+	if (fanout.workers == NULL)
+		return;
+	for (i = 0; i < fanout.n; i++) {
+		if (fanout.workers[i].pd != NULL)
+			pcap_breakloop(fanout.workers[i].pd);
+	}
+}
+
+static u_int
+fanout_packets(void)
+{
+	u_int i, packets = 0;
+
+	for (i = 0; i < fanout.n; i++)
+		packets += fanout.workers[i].packets;
+	return (packets);
+}
+
+/*
+ * Add up the statistics of all the handles; the interface drops are
+ * the interface's, so they're counted once.
+ */
+static int
+fanout_stats(struct pcap_stat *stats)
+{
+	struct pcap_stat ps;
+	u_int i;
+
+	memset(stats, 0, sizeof(*stats));
+	for (i = 0; i < fanout.n; i++) {
+		ps.ps_ifdrop = 0;
+		if (pcap_stats(fanout.workers[i].pd, &ps) < 0) {
+			(void)fprintf(stderr, "pcap_stats: %s\n",
+			    pcap_geterr(fanout.workers[i].pd));
+			return (-1);
+		}
+		stats->ps_recv += ps.ps_recv;
+		stats->ps_drop += ps.ps_drop;
+		if (i == 0)
+			stats->ps_ifdrop = ps.ps_ifdrop;
+		fanout.workers[i].drops = ps.ps_drop;
+	}
+	packets_captured = fanout_packets();
+	return (0);
+}
+#endif /* FANOUT_CAPTURE */
+
 static void
 print_packet(u_char *user, const struct pcap_pkthdr *h, const u_char *sp)
 {
@@ -3193,8 +4856,38 @@ requestinfo(int signo _U_)
 static void
 flushpcap(int signo _U_)
 {
-	if (pdd != NULL)
-		pcap_dump_flush(pdd);
+	u_int i;
+
+	if (ring.size != 0) {
+		/*
+		 * Write out the ring buffer; that's done outside the
+		 * signal handler, after the current packet if we're in
+		 * the middle of one.
+		 */
+		ring.signalled = 1;
+#ifdef HAVE_PCAP_BREAKLOOP
+		pcap_breakloop(pd);
+#endif
+		return;
+	}
+#ifdef FANOUT_CAPTURE
+	/*
+	 * With --fanout, the capture threads swap their files under the
+	 * rotation lock, and drop them once the -W limit is reached.  The
+	 * signal is handled by the main thread, which only waits for them
+	 * and never holds the lock, so taking it here can't deadlock.
+	 */
+	if (fanout.n != 0)
+		ROTATION_LOCK();
+#endif
+	for (i = 0; i < noutputs; i++) {
+		if (outputs[i].pdd != NULL)
+			pcap_dump_flush(outputs[i].pdd);
+	}
+#ifdef FANOUT_CAPTURE
+	if (fanout.n != 0)
+		ROTATION_UNLOCK();
+#endif
 }
 #endif
 
@@ -3203,6 +4896,10 @@ print_packets_captured (void)
 {
 	static u_int prev_packets_captured, first = 1;
 
+#ifdef FANOUT_CAPTURE
+	if (fanout.n != 0)
+		packets_captured = fanout_packets();
+#endif
 	if (infodelay == 0 && (first || packets_captured != prev_packets_captured)) {
 		fprintf(stderr, "Got %u\r", packets_captured);
 		first = 0;
@@ -3273,9 +4970,19 @@ print_usage(FILE *f)
 	(void)fprintf(f,
 "Usage: %s [-Abd" D_FLAG "efhH" I_FLAG J_FLAG "KlLnNOpqStu" U_FLAG "vxX#]" B_FLAG_USAGE " [ -c count ] [--count]\n", program_name);
 	(void)fprintf(f,
-"\t\t[ -C file_size ] [ -E algo:secret ] [ -F file ] [ -G seconds ]\n");
+"\t\t[ -C file_size ] [ --disable-dissector name ]\n");
+	(void)fprintf(f,
+"\t\t[ --dns-analysis[=queries] ]" DIRECT_IO_USAGE "\n");
+	(void)fprintf(f,
+"\t\t[ -E algo:secret ] [ -F file ] [ -G seconds ]" GROUP_COMMIT_USAGE "\n");
+	(void)fprintf(f,
+"\t\t[ --flow-export-summary[=seconds] ]\n");
 	(void)fprintf(f,
 "\t\t[ -i interface ]" IMMEDIATE_MODE_USAGE j_FLAG_USAGE "\n");
+#ifdef FANOUT_CAPTURE
+	(void)fprintf(f,
+"\t\t" FANOUT_USAGE "\n");
+#endif
 #ifdef HAVE_PCAP_FINDALLDEVS_EX
 	(void)fprintf(f,
 "\t\t" LIST_REMOTE_INTERFACES_USAGE "\n");
@@ -3285,13 +4992,27 @@ print_usage(FILE *f)
 "\t\t" m_FLAG_USAGE "\n");
 #endif
 	(void)fprintf(f,
-"\t\t[ -M secret ] [ --number ] [ --print ]\n");
+"\t\t[ -M secret ] [ --name-cache-size entries ]\n");
+	(void)fprintf(f,
+"\t\t[ --name-snapshot file ] [ --number ]\n");
+	(void)fprintf(f,
+"\t\t[ --print ] [ --profile-dissectors ]\n");
+	(void)fprintf(f,
+"\t\t[ --print-sampling nth ] [ --print-flow-sampling n ]\n");
+	(void)fprintf(f,
+"\t\t[ --print-rate-limit rate[,burst] ]" Q_FLAG_USAGE " [ -r file ]\n");
+	(void)fprintf(f,
+"\t\t[ --ring-buffer size ] [ --ring-trigger filter ] [ --ring-after count ]\n");
+	(void)fprintf(f,
+"\t\t[ --slice-headers[=payload] ]\n");
+	(void)fprintf(f,
+"\t\t[ -s snaplen ] [ --summary ] [ -T type ] [ --tcp-analysis[=connections] ]\n");
 	(void)fprintf(f,
-"\t\t[ --print-sampling nth ]" Q_FLAG_USAGE " [ -r file ]\n");
+"\t\t[ --version ]\n");
 	(void)fprintf(f,
-"\t\t[ -s snaplen ] [ -T type ] [ --version ]\n");
+"\t\t[ -V file ] [ -w file ] [ --output file:filter ]\n");
 	(void)fprintf(f,
-"\t\t[ -V file ] [ -w file ] [ -W filecount ] [ -y datalinktype ]\n");
+"\t\t[ -W filecount ] [ --write-name-snapshot file ] [ -y datalinktype ]\n");
 #ifdef HAVE_PCAP_SET_TSTAMP_PRECISION
 	(void)fprintf(f,
 "\t\t[ --time-stamp-precision precision ] [ --micro ] [ --nano ]\n");
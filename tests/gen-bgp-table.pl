@@ -0,0 +1,140 @@
+#!/usr/bin/env perl
+#
+# Write a savefile of a BGP full-table transfer, for benchmarking the
+# UPDATE printer, to the standard output.
+#
+# usage:
+#	perl gen-bgp-table.pl [-4 ipv4-prefixes] [-6 ipv6-prefixes]
+#	    [-u prefixes-per-update] > bgp-table.pcap
+#	tcpdump-bench -v -n 3 bgp-table.pcap
+#
+# The defaults, 900000 IPv4 prefixes, no IPv6 ones and 8 prefixes to
+# an UPDATE, are about the size of the IPv4 Internet table.  The
+# prefixes are distinct /24s with every fourth one a /22 and every
+# sixteenth a /20, and the IPv6 ones, sent in MP_REACH_NLRI, distinct
+# /48s.  Each UPDATE has its own AS path; the UPDATEs are packed into
+# TCP segments of up to 64000 bytes, from 192.0.2.1 port 179, and the
+# transfer ends with an End-of-RIB marker.
+#
+use strict;
+use warnings;
+use Getopt::Std;
+
+my %opts;
+getopts('4:6:u:', \%opts) or
+    die "usage: $0 [-4 count] [-6 count] [-u per-update]\n";
+my $n4 = defined $opts{'4'} ? $opts{'4'} : 900000;
+my $n6 = defined $opts{'6'} ? $opts{'6'} : 0;
+my $per_update = $opts{'u'} || 8;
+
+my $SEGMENT_MAX = 64000;
+my $src = pack('C4', 192, 0, 2, 1);
+my $dst = pack('C4', 192, 0, 2, 2);
+my ($seq, $ack) = (1000, 500);
+my ($sec, $usec) = (1000000000, 0);
+my $id = 0;
+
+binmode STDOUT;
+# Global header: microsecond time stamps, snaplen 262144, Ethernet
+print pack('VvvVVVV', 0xa1b2c3d4, 2, 4, 0, 0, 262144, 1);
+
+sub cksum {
+	my ($data) = @_;
+	my $sum = 0;
+
+	$data .= "\0" if length($data) % 2;
+	$sum += $_ for unpack('n*', $data);
+	$sum = ($sum & 0xffff) + ($sum >> 16) while $sum >> 16;
+	return ~$sum & 0xffff;
+}
+
+sub segment {
+	my ($payload) = @_;
+	my ($ip, $tcp, $frame);
+
+	$tcp = pack('nnNNnnnn', 179, 40000, $seq, $ack, 0x5018, 65535, 0, 0);
+	substr($tcp, 16, 2) = pack('n', cksum($src . $dst .
+	    pack('nn', 6, length($tcp) + length($payload)) . $tcp . $payload));
+	$ip = pack('CCnnnCCn', 0x45, 0, 20 + length($tcp) + length($payload),
+	    ++$id, 0x4000, 64, 6, 0) . $src . $dst;
+	substr($ip, 10, 2) = pack('n', cksum($ip));
+	$frame = pack('H12H12n', '020000000002', '020000000001', 0x0800) .
+	    $ip . $tcp . $payload;
+	print pack('VVVV', $sec, $usec, length($frame), length($frame)), $frame;
+	$seq += length($payload);
+	$usec += 1000;
+	if ($usec >= 1000000) {
+		$sec++;
+		$usec -= 1000000;
+	}
+}
+
+my $pending = '';
+
+sub message {
+	my ($type, $body) = @_;
+	my $msg = ("\xff" x 16) . pack('nC', 19 + length($body), $type) . $body;
+
+	if (length($pending) + length($msg) > $SEGMENT_MAX) {
+		segment($pending);
+		$pending = '';
+	}
+	$pending .= $msg;
+}
+
+sub attr {
+	my ($flags, $type, $value) = @_;
+
+	return length($value) > 255 ?
+	    pack('CCn', $flags | 0x10, $type, length($value)) . $value :
+	    pack('CCC', $flags, $type, length($value)) . $value;
+}
+
+# ORIGIN, AS_PATH of three 2-byte ASes and MED varying by UPDATE
+sub common_attrs {
+	my ($u) = @_;
+
+	return attr(0x40, 1, "\0") .
+	    attr(0x40, 2, pack('CCnnn', 2, 3, 64512 + $u % 1000,
+	    1 + $u % 60000, 1 + $u % 397)) .
+	    attr(0x80, 4, pack('N', $u % 1000));
+}
+
+sub update {
+	my ($attrs, $nlri) = @_;
+
+	message(2, pack('nn', 0, length($attrs)) . $attrs . $nlri);
+}
+
+my $u = 0;
+my $i = 0;
+while ($i < $n4) {
+	my $nlri = '';
+	my $k;
+
+	for ($k = 0; $k < $per_update && $i < $n4; $k++, $i++) {
+		my $addr = (1 << 24) + ($i << 8);
+		my $plen = $i % 16 == 0 ? 20 : $i % 4 == 0 ? 22 : 24;
+
+		$nlri .= pack('C', $plen) .
+		    substr(pack('N', $addr), 0, ($plen + 7) >> 3);
+	}
+	update(common_attrs($u) . attr(0x40, 3, $src), $nlri);
+	$u++;
+}
+$i = 0;
+while ($i < $n6) {
+	my $nlri = '';
+	my $k;
+
+	for ($k = 0; $k < $per_update && $i < $n6; $k++, $i++) {
+		$nlri .= pack('CnN', 48, 0x2a00, $i);
+	}
+	# AFI IPv6, SAFI unicast, a 16-byte next hop, no SNPAs
+	update(common_attrs($u) . attr(0x80, 14, pack('nCC', 2, 1, 16) .
+	    pack('nx14', 0x2001) . "\0" . $nlri), '');
+	$u++;
+}
+# End-of-RIB
+update('', '');
+segment($pending) if length($pending);
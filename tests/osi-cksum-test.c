@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2026 The TCPDUMP project
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that: (1) source code
+ * distributions retain the above copyright notice and this paragraph
+ * in its entirety, and (2) distributions including binary code include
+ * the above copyright notice and this paragraph in its entirety in
+ * the documentation or other materials provided with the distribution.
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND
+ * WITHOUT ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, WITHOUT
+ * LIMITATION, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE.
+ */
+
+/*
+ * Check create_osi_cksum() against the original byte-at-a-time
+ * implementation, for random PDUs, lengths and checksum offsets, both
+ * with the portable code (before init_checksum()) and with whatever
+ * init_checksum() picks for this CPU.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#include "netdissect-stdinc.h"
+
+#include "netdissect.h"
+
+#define MAX_LENGTH	5000	/* the reference overflows beyond ~5800 */
+#define ROUNDS		20000
+
+static uint16_t
+reference_osi_cksum(const uint8_t *pptr, int checksum_offset, int length)
+{
+    int x;
+    int y;
+    uint32_t mul;
+    uint32_t c0;
+    uint32_t c1;
+    uint16_t checksum;
+    int idx;
+
+    c0 = 0;
+    c1 = 0;
+
+    for (idx = 0; idx < length; idx++) {
+        /*
+         * Ignore the contents of the checksum field.
+         */
+        if (idx == checksum_offset ||
+            idx == checksum_offset+1) {
+            c1 += c0;
+            pptr++;
+        } else {
+            c0 = c0 + *(pptr++);
+            c1 += c0;
+        }
+    }
+
+    c0 = c0 % 255;
+    c1 = c1 % 255;
+
+    mul = (length - checksum_offset)*(c0);
+
+    x = mul - c0 - c1;
+    y = c1 - mul - 1;
+
+    if ( y >= 0 ) y++;
+    if ( x < 0 ) x--;
+
+    x %= 255;
+    y %= 255;
+
+
+    if (x == 0) x = 255;
+    if (y == 0) y = 255;
+
+    y &= 0x00FF;
+    checksum = ((x << 8) | y);
+
+    return checksum;
+}
+
+static u_int
+run(const char *what, uint8_t *buf)
+{
+    u_int round, failures = 0;
+    int length, offset, i;
+    uint16_t got, want;
+
+    for (round = 0; round < ROUNDS; round++) {
+        length = rand() % (MAX_LENGTH + 1);
+        /* the caller allows offsets up to and including the length */
+        offset = length ? rand() % (length + 1) : 0;
+        /* mostly random data, sometimes all 0xff to stress the sums */
+        for (i = 0; i < length; i++)
+            buf[i] = (round % 8 == 0) ? 0xff : (uint8_t)rand();
+        want = reference_osi_cksum(buf, offset, length);
+        got = create_osi_cksum(buf, offset, length);
+        if (got != want) {
+            if (failures++ < 10)
+                printf("%s: length %d offset %d: got 0x%04x, expected 0x%04x\n",
+                       what, length, offset, got, want);
+        }
+    }
+    return failures;
+}
+
+int
+main(void)
+{
+    static uint8_t buf[MAX_LENGTH + 1];
+    u_int failures;
+
+    srand(0x150);
+    failures = run("generic", buf);
+    init_checksum();
+    failures += run("dispatched", buf);
+    if (failures != 0) {
+        printf("osi-cksum-test: %u failures\n", failures);
+        return 1;
+    }
+    printf("osi-cksum-test: passed\n");
+    return 0;
+}
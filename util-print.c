@@ -245,29 +245,47 @@ static void
 ts_date_hmsfrac_print(netdissect_options *ndo, long sec, long usec,
 		      enum date_flag date_flag, enum time_flag time_flag)
 {
+	/*
+	 * localtime() can take longer than dissecting the packet, and
+	 * packets come many to the second, so a second is converted
+	 * only once.
+	 */
+	static struct {
+		long sec;
+		enum date_flag date_flag;
+		enum time_flag time_flag;
+		char timestr[32];
+	} last = { -1, WITHOUT_DATE, UTC_TIME, "" };
 	time_t Time = sec;
 	struct tm *tm;
-	char timestr[32];
 
 	if ((unsigned)sec & 0x80000000) {
 		ND_PRINT(C_RESET, "[Error converting time]");
 		return;
 	}
 
-	if (time_flag == LOCAL_TIME)
-		tm = localtime(&Time);
-	else
-		tm = gmtime(&Time);
+	if (sec != last.sec || date_flag != last.date_flag ||
+	    time_flag != last.time_flag) {
+		if (time_flag == LOCAL_TIME)
+			tm = localtime(&Time);
+		else
+			tm = gmtime(&Time);
 
-	if (!tm) {
-		ND_PRINT(C_RESET, "[Error converting time]");
-		return;
+		if (!tm) {
+			ND_PRINT(C_RESET, "[Error converting time]");
+			return;
+		}
+		if (date_flag == WITH_DATE)
+			strftime(last.timestr, sizeof(last.timestr),
+			    "%Y-%m-%d %H:%M:%S", tm);
+		else
+			strftime(last.timestr, sizeof(last.timestr),
+			    "%H:%M:%S", tm);
+		last.sec = sec;
+		last.date_flag = date_flag;
+		last.time_flag = time_flag;
 	}
-	if (date_flag == WITH_DATE)
-		strftime(timestr, sizeof(timestr), "%Y-%m-%d %H:%M:%S", tm);
-	else
-		strftime(timestr, sizeof(timestr), "%H:%M:%S", tm);
-	ND_PRINT(C_RESET, "%s", timestr);
+	ND_PRINT(C_RESET, "%s", last.timestr);
 
 	ts_frac_print(ndo, usec);
 }